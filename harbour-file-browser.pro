@@ -70,6 +70,7 @@ SOURCES += src/harbour-file-browser.cpp \
     src/filemodel.cpp \
     src/filemodelworker.cpp \
     src/filedata.cpp \
+    src/filedataworker.cpp \
     src/engine.cpp \
     src/fileworker.cpp \
     src/searchengine.cpp \
@@ -78,10 +79,29 @@ SOURCES += src/harbour-file-browser.cpp \
     src/statfileinfo.cpp \
     src/globals.cpp \
     src/settingshandler.cpp \
+    src/capturetimecache.cpp \
+    src/imageprobe.cpp \
+    src/treewalker.cpp \
+    src/directorysizeindex.cpp \
+    src/diskusagemodel.cpp \
+    src/diskspacecache.cpp \
+    src/mounttable.cpp \
+    src/processrunner.cpp \
+    src/textdocumentmodel.cpp \
+    src/hexviewmodel.cpp \
+    src/filecopier.cpp \
+    src/transferprogress.cpp \
+    src/filejobqueue.cpp \
+    src/treecopier.cpp \
+    src/treedeleter.cpp \
+    src/transferjournal.cpp \
+    src/transferplanner.cpp \
+    src/readonlyfile.cpp \
 
 HEADERS += src/filemodel.h \
     src/filemodelworker.h \
     src/filedata.h \
+    src/filedataworker.h \
     src/engine.h \
     src/fileworker.h \
     src/searchengine.h \
@@ -90,6 +110,24 @@ HEADERS += src/filemodel.h \
     src/statfileinfo.h \
     src/globals.h \
     src/settingshandler.h \
+    src/capturetimecache.h \
+    src/imageprobe.h \
+    src/treewalker.h \
+    src/directorysizeindex.h \
+    src/diskusagemodel.h \
+    src/diskspacecache.h \
+    src/mounttable.h \
+    src/processrunner.h \
+    src/textdocumentmodel.h \
+    src/hexviewmodel.h \
+    src/filecopier.h \
+    src/transferprogress.h \
+    src/filejobqueue.h \
+    src/treecopier.h \
+    src/treedeleter.h \
+    src/transferjournal.h \
+    src/transferplanner.h \
+    src/readonlyfile.h \
 
 SOURCES += src/jhead/jhead-api.cpp \
     src/jhead/exif.c \
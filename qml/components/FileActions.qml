@@ -55,6 +55,7 @@ Item {
     property bool showEdit: true
 
     property int _itemSize: Theme.iconSizeMedium
+    property var _renameBatch: null // renames started after RenameDialog was accepted
 
     // emitted after the action has been completed
     signal selectAllTriggered
@@ -77,6 +78,29 @@ Item {
         id: fileData
     }
 
+    Connections {
+        target: engine
+        onIoRequestFinished: {
+            var batch = _renameBatch;
+            var index = (batch === null ? -1 : batch.requests.indexOf(requestId));
+            if (index < 0) return;
+
+            if (error !== "") {
+                batch.errors.push(error);
+            } else {
+                batch.newFiles[index] = result[0];
+                if (result[1] !== "") batch.errors.push(result[1]);
+            }
+
+            if (--batch.pending > 0) return;
+            _renameBatch = null;
+
+            // TODO show all error messages
+            if (batch.errors.length !== 0) errorCallback(batch.errors[0]);
+            renameTriggered(batch.oldFiles, batch.newFiles);
+        }
+    }
+
     Label {
         id: label
         visible: showLabel
@@ -168,7 +192,7 @@ Item {
 
         IconButton {
             visible: showRename
-            enabled: selectedCount > 0 && selectedCount <= 20
+            enabled: selectedCount > 0 && selectedCount <= 20 && _renameBatch === null
             icon.width: _itemSize; icon.height: _itemSize
             icon.source: "../images/toolbar-rename.png"
             icon.color: Theme.primaryColor
@@ -178,9 +202,8 @@ Item {
                 var dialog = pageStack.push(Qt.resolvedUrl("../pages/RenameDialog.qml"),
                                             { 'files': files })
                 dialog.accepted.connect(function() {
-                    // TODO show all error messages
-                    if (dialog.errorMessages.length !== 0) errorCallback(dialog.errorMessage[0]);
-                    renameTriggered(files, dialog.newFiles);
+                    _renameBatch = { oldFiles: files, newFiles: files.slice(), errors: [],
+                                     requests: dialog.requestIds, pending: dialog.requestIds.length };
                 })
             }
         }
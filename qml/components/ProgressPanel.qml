@@ -38,6 +38,12 @@ Item {
     // small text displayed on panel
     property string text: ""
 
+    // details shown below the small text, e.g. transferred bytes
+    property string detailText: ""
+
+    // progress between 0 and 1, no progress bar is shown if negative
+    property real progress: -1
+
     // open status of the panel
     property alias open: dockedPanel.open
 
@@ -45,6 +51,8 @@ Item {
     function showText(txt) {
         headerText = txt;
         text = "";
+        detailText = "";
+        progress = -1;
         dockedPanel.show();
     }
 
@@ -68,7 +76,8 @@ Item {
         id: dockedPanel
 
         width: parent.width
-        height: Theme.itemSizeExtraLarge + Theme.paddingLarge
+        height: Theme.itemSizeExtraLarge + Theme.paddingLarge +
+                (progressDetails.visible ? progressDetails.height : 0)
 
         dock: Dock.Top
         open: false
@@ -133,5 +142,27 @@ Item {
             font.pixelSize: Theme.fontSizeTiny
             color: Theme.primaryColor
         }
+        Label {
+            id: progressDetails
+            visible: dockedPanel.open && text !== ""
+            anchors.left: progressHeader.left
+            anchors.right: cancelButton.left
+            anchors.rightMargin: Theme.paddingLarge
+            anchors.top: progressText.bottom
+            text: progressPanel.detailText
+            truncationMode: TruncationMode.Fade
+            font.pixelSize: Theme.fontSizeTiny
+            color: Theme.secondaryColor
+        }
+        Rectangle {
+            id: progressBar
+            visible: progressPanel.progress >= 0
+            anchors.left: parent.left
+            anchors.bottom: parent.bottom
+            height: Theme.paddingSmall
+            width: parent.width * Math.min(1, Math.max(0, progressPanel.progress))
+            color: Theme.highlightColor
+            Behavior on width { NumberAnimation { duration: 200 } }
+        }
     }
 }
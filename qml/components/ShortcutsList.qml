@@ -197,13 +197,21 @@ SilicaListView {
 
                 function updateText() {
                     if (visible) {
-                        var space = engine.diskSpace(model.location);
-                        text = (space.length > 0 ? space[0] + " \u2022 " + space[1] + " \u2022 " : "");
+                        engine.requestDiskSpace(model.location);
                     } else {
                         text = "";
                     }
                 }
 
+                Connections {
+                    target: engine
+                    onDiskSpaceReady: {
+                        if (path !== model.location || !sizeInfo.visible) return;
+                        sizeInfo.text = (info.percentage ? info.percentage + " \u2022 " + info.summary + " \u2022 " : "");
+                    }
+                    onDiskSpaceInvalidated: sizeInfo.updateText()
+                }
+
                 Component.onCompleted: {
                     updateText();
                 }
@@ -399,6 +407,13 @@ SilicaListView {
         }
     }
 
+    Connections {
+        target: engine
+        onExternalDrivesChanged: {
+            if (sections.indexOf("external") >= 0) view.updateModel();
+        }
+    }
+
     Connections {
         target: main
         onBookmarkAdded: {
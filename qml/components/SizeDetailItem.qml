@@ -68,25 +68,43 @@ Item {
         placeholderText: qsTr("files")
     }
 
-    // TODO load size info asynchronously
-    Component.onCompleted: {
-        var sizes = engine.fileSizeInfo(files);
-        sizeLabel.text = (sizes[0] === "-" ? qsTr("unknown size") : sizes[0]);
+    property int _requestId: -1
+
+    function _showSizes(sizes, finished) {
+        // partial results are marked until the calculation is finished
+        var suffix = finished ? "" : " …";
+
+        if (sizes[0] === "-") {
+            sizeLabel.text = finished ? qsTr("unknown size") : "";
+        } else if (sizes[3] !== "-" && sizes[3] !== sizes[0]) {
+            sizeLabel.text = qsTr("%1 (%2 on disk)").arg(sizes[0]).arg(sizes[3]) + suffix;
+        } else {
+            sizeLabel.text = sizes[0] + suffix;
+        }
 
         var dirsCnt = parseInt(sizes[1], 10);
         if (dirsCnt > 0) {
-            dirCountLabel.text = qsTr("%n directories", "", dirsCnt);
-        } else {
+            dirCountLabel.text = qsTr("%n directories", "", dirsCnt) + suffix;
+        } else if (finished) {
             dirCountLabel.visible = false;
             dirCountLabel.height = 0;
         }
 
         var filesCnt = parseInt(sizes[2], 10);
         if (filesCnt > 0) {
-            fileCountLabel.text = qsTr("%n file(s)", "", filesCnt);
-        } else {
+            fileCountLabel.text = qsTr("%n file(s)", "", filesCnt) + suffix;
+        } else if (finished) {
             fileCountLabel.visible = false;
             fileCountLabel.height = 0;
         }
     }
+
+    Connections {
+        target: engine
+        onFileSizeInfoProgress: if (requestId === _requestId) _showSizes(info, false)
+        onFileSizeInfoReady: if (requestId === _requestId) _showSizes(info, true)
+    }
+
+    Component.onCompleted: _requestId = engine.requestFileSizeInfo(files)
+    Component.onDestruction: engine.cancelFileSizeInfo(_requestId)
 }
@@ -191,16 +191,18 @@ Rectangle {
 
     Connections {
         target: engine
-        onProgressChanged: progressPanel.text = engine.progressFilename
+        onProgressChanged: {
+            progressPanel.text = engine.progressFilename;
+            progressPanel.progress = engine.progress / 100;
+        }
+        onTransferProgressChanged: progressPanel.detailText = engine.transferSummary
         onWorkerDone: progressPanel.hide()
         onWorkerErrorOccurred: {
             // the error signal goes to all pages in pagestack, show it only in the active one
             _successful = false;
             if (progressPanel.open) {
                 progressPanel.hide();
-                if (message === "Unknown error")
-                    filename = qsTr("Trying to move between phone and SD Card? It does not work, try copying.");
-                else if (message === "Failure to write block")
+                if (message === "Failure to write block")
                     filename = qsTr("Perhaps the storage is full?");
                 notificationPanel.showText(message, filename);
             }
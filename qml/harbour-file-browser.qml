@@ -47,6 +47,9 @@ ApplicationWindow {
     property var currentPage: ({type: "dir", path: initialDirectory})
     property var activePage: ({type: "dir", path: initialDirectory})
 
+    // interrupted file operations are pointed out once per session
+    property bool interruptedJobsNoticeShown: false
+
     // Proxy functions for heavy libraries
     // The basic functions are proxied here. If more functions
     // are needed, the JS file should be loaded in the component.
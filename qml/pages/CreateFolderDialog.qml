@@ -27,14 +27,14 @@ import "../components"
 Dialog {
     property string path: ""
 
-    // return value
-    property string errorMessage: ""
+    // return value: the result is sent with engine.ioRequestFinished()
+    property int requestId: -1
 
     id: dialog
     allowedOrientations: Orientation.All
     canAccept: folderName.text !== ""
 
-    onAccepted: errorMessage = engine.mkdir(path, folderName.text);
+    onAccepted: requestId = engine.requestMkdir(path, folderName.text);
 
     SilicaFlickable {
         id: flickable
@@ -71,6 +71,7 @@ Page {
     property int _nameElideMode: _nameTruncMode === TruncationMode.Fade ?
                                     Text.ElideNone : (_fnElide === 'middle' ?
                                                           Text.ElideMiddle : Text.ElideRight)
+    property int _mkdirRequest: -1
 
     signal clearViewFilter()
     signal multiSelectionStarted(var index)
@@ -146,11 +147,18 @@ Page {
                     var dialog = pageStack.push(Qt.resolvedUrl("CreateFolderDialog.qml"),
                                           { path: page.dir })
                     dialog.accepted.connect(function() {
-                        if (dialog.errorMessage !== "")
-                            notificationPanel.showText(dialog.errorMessage, "")
+                        _mkdirRequest = dialog.requestId
                     })
                 }
             }
+            MenuItem {
+                visible: engine.jobs.count > 0
+                text: qsTr("File operations")
+                onClicked: {
+                    pullDownMenu._filterBlocked = true;
+                    pageStack.push(Qt.resolvedUrl("TransfersPage.qml"));
+                }
+            }
             MenuItem {
                 visible: engine.clipboardCount > 0
                 text: qsTr("Paste") +
@@ -384,6 +392,16 @@ Page {
         flickable: fileList
     }
 
+    Connections {
+        target: engine
+        onIoRequestFinished: {
+            if (requestId !== _mkdirRequest) return
+            _mkdirRequest = -1
+            var message = (error !== "" ? error : result)
+            if (message !== "") notificationPanel.showText(message, "")
+        }
+    }
+
     Connections {
         id: quickSelectionConnections
         property int startIndex: -1
@@ -494,9 +512,7 @@ Page {
             // the error signal goes to all pages in pagestack, show it only in the active one
             if (progressPanel.open) {
                 progressPanel.hide();
-                if (message === "Unknown error")
-                    filename = qsTr("Trying to move between phone and SD Card? It does not work, try copying.");
-                else if (message === "Failure to write block")
+                if (message === "Failure to write block")
                     filename = qsTr("Perhaps the storage is full?");
 
                 notificationPanel.showText(message, filename);
@@ -540,6 +556,13 @@ Page {
                 pageStack.pushAttached(Qt.resolvedUrl("ShortcutsPage.qml"), { currentPath: dir });
             }
             coverText = Paths.lastPartOfPath(page.dir)+"/"; // update cover
+
+            if (!main.interruptedJobsNoticeShown && engine.jobs.interruptedCount > 0) {
+                main.interruptedJobsNoticeShown = true;
+                notificationPanel.showTextWithTimer(
+                            qsTr("%n file operation(s) did not complete", "", engine.jobs.interruptedCount),
+                            qsTr("Resume them from “File operations” in the pull-down menu."));
+            }
         } else if (status === PageStatus.Activating) {
             console.log("page: activating --", dir);
             main.activePage = {type: "dir", path: dir};
@@ -0,0 +1,123 @@
+/*
+ * This file is part of File Browser.
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+import QtQuick 2.2
+import Sailfish.Silica 1.0
+import harbour.file.browser.DiskUsageModel 1.0
+import "../components"
+import "../js/paths.js" as Paths
+
+Page {
+    id: page
+    allowedOrientations: Orientation.All
+    property string dir: "/"
+
+    DiskUsageModel {
+        id: usageModel
+        path: page.dir
+    }
+
+    SilicaListView {
+        id: usageList
+        anchors.fill: parent
+        model: usageModel
+        VerticalScrollDecorator { flickable: usageList }
+
+        PullDownMenu {
+            MenuItem {
+                text: usageModel.showDirectories ? qsTr("Show largest files") : qsTr("Show largest folders")
+                onClicked: usageModel.showDirectories = !usageModel.showDirectories
+            }
+            MenuItem {
+                text: usageModel.busy ? qsTr("Stop") : qsTr("Refresh")
+                onClicked: usageModel.busy ? usageModel.cancel() : usageModel.refresh()
+            }
+        }
+
+        header: PageHeader {
+            title: usageModel.showDirectories ? qsTr("Largest folders") : qsTr("Largest files")
+            description: usageModel.busy ?
+                             qsTr("%1 in %n file(s) scanned", "", usageModel.scannedFiles).arg(usageModel.scannedSize) :
+                             Paths.formatPathForTitle(page.dir)
+        }
+
+        delegate: ListItem {
+            id: usageItem
+            width: ListView.view.width
+            contentHeight: nameLabel.height + pathLabel.height + 2*Theme.paddingSmall
+
+            Label {
+                id: sizeLabel
+                anchors {
+                    right: parent.right; rightMargin: Theme.horizontalPageMargin
+                    verticalCenter: nameLabel.verticalCenter
+                }
+                text: model.size
+                color: usageItem.highlighted ? Theme.highlightColor : Theme.secondaryColor
+                font.pixelSize: Theme.fontSizeSmall
+            }
+            Label {
+                id: nameLabel
+                y: Theme.paddingSmall
+                anchors {
+                    left: parent.left; leftMargin: Theme.horizontalPageMargin
+                    right: sizeLabel.left; rightMargin: Theme.paddingMedium
+                }
+                text: model.name
+                textFormat: Text.PlainText
+                truncationMode: TruncationMode.Fade
+                color: usageItem.highlighted ? Theme.highlightColor : Theme.primaryColor
+            }
+            Label {
+                id: pathLabel
+                anchors {
+                    left: parent.left; leftMargin: Theme.horizontalPageMargin
+                    right: parent.right; rightMargin: Theme.horizontalPageMargin
+                    top: nameLabel.bottom
+                }
+                text: model.path
+                textFormat: Text.PlainText
+                color: usageItem.highlighted ? Theme.secondaryHighlightColor : Theme.secondaryColor
+                font.pixelSize: Theme.fontSizeExtraSmall
+                elide: Text.ElideLeft
+            }
+
+            onClicked: {
+                if (usageModel.showDirectories) {
+                    navigate_goToFolder(model.path);
+                } else {
+                    pageStack.animatorPush(Qt.resolvedUrl("FilePage.qml"), { file: model.path });
+                }
+            }
+        }
+
+        ViewPlaceholder {
+            enabled: usageList.count === 0 && !usageModel.busy
+            text: qsTr("Nothing found")
+        }
+
+        BusyIndicator {
+            anchors.centerIn: parent
+            size: BusyIndicatorSize.Large
+            running: usageList.count === 0 && usageModel.busy
+        }
+    }
+}
@@ -36,12 +36,28 @@ Page {
     property string file: "/"
     property alias notificationPanel: notificationPanel
     property bool _hasMoved: false
+    property int _chmodRequest: -1
 
     FileData {
         id: fileData
         file: page.file
+        asynchronous: true
         property string category
-        Component.onCompleted: category = typeCategory()
+        onMimeTypeChanged: category = typeCategory()
+        onReadyChanged: attachContents()
+    }
+
+    Connections {
+        target: engine
+        onIoRequestFinished: {
+            if (requestId !== _chmodRequest) return
+            _chmodRequest = -1
+            var message = (error !== "" ? error : result)
+            if (message === "")
+                fileData.refresh();
+            else
+                notificationPanel.showTextWithTimer(message, "");
+        }
     }
 
     ConsoleModel {
@@ -95,14 +111,18 @@ Page {
                     var dialog = pageStack.push(Qt.resolvedUrl("PermissionsDialog.qml"),
                                                 { path: page.file })
                     dialog.accepted.connect(function() {
-                        if (dialog.errorMessage === "")
-                            fileData.refresh();
-                        else
-                            notificationPanel.showTextWithTimer(dialog.errorMessage, "");
+                        _chmodRequest = dialog.requestId
                     })
                 }
             }
 
+            MenuItem {
+                text: qsTr("Analyze Disk Usage")
+                visible: fileData.isDir
+                onClicked: pageStack.push(Qt.resolvedUrl("DiskUsagePage.qml"),
+                                          { dir: fileData.isSymLink ? fileData.symLinkTarget : page.file })
+            }
+
             MenuItem {
                 text: qsTr("View Raw Contents")
                 visible: !fileData.isDir
@@ -348,9 +368,7 @@ Page {
             // update cover
             coverText = Paths.lastPartOfPath(page.file);
         } else if (status === PageStatus.Active) {
-            if (!canNavigateForward) {
-                viewContents(true);
-            }
+            attachContents();
         }
     }
 
@@ -374,6 +392,14 @@ Page {
                });
     }
 
+    function attachContents() {
+        // file details are loaded asynchronously, so wait until they are
+        // ready and the page is active before attaching the contents page
+        if (status === PageStatus.Active && fileData.ready && !canNavigateForward && !_hasMoved) {
+            viewContents(true);
+        }
+    }
+
     function viewContents(asAttached, forceRawView) {
         if (fileData.isDir) {
             // dirs are special cases - there's no way to display their contents, so go to them
@@ -30,6 +30,8 @@ Page {
     property var files
     property alias notificationPanel: notificationPanel
     property bool _hasMoved: false
+    property var _typeRequests: ({}) // request id to [path, type]
+    property var _types: ({}) // path to "dir" or "file"
 
     on_HasMovedChanged: {
         if (!_hasMoved) return;
@@ -158,24 +160,49 @@ Page {
         }
     }
 
-    function getFiles() {
-        var ret = [];
+    // file types are checked in the background, lists are updated as results come in
+    Component.onCompleted: {
+        var requests = {};
         for (var i = 0; i < files.length; i++) {
-            if (engine.pathIsFile(files[i])) ret.push(files[i]);
+            requests[engine.requestPathIsDirectory(files[i])] = [files[i], "dir"];
+            requests[engine.requestPathIsFile(files[i])] = [files[i], "file"];
         }
-        if (ret.length === 0) ret.push(qsTr("none"));
-        return ret;
+        _typeRequests = requests;
     }
 
-    function getDirectories() {
+    Connections {
+        target: engine
+        onIoRequestFinished: {
+            var request = _typeRequests[requestId];
+            if (request === undefined) return;
+            delete _typeRequests[requestId];
+            if (result !== true) return;
+
+            // assign a new object so bindings using the types are updated
+            var types = {};
+            for (var path in _types) types[path] = _types[path];
+            types[request[0]] = request[1];
+            _types = types;
+        }
+    }
+
+    function filesOfType(type) {
         var ret = [];
         for (var i = 0; i < files.length; i++) {
-            if (engine.pathIsDirectory(files[i])) ret.push(files[i]);
+            if (_types[files[i]] === type) ret.push(files[i]);
         }
         if (ret.length === 0) ret.push(qsTr("none"));
         return ret;
     }
 
+    function getFiles() {
+        return filesOfType("file");
+    }
+
+    function getDirectories() {
+        return filesOfType("dir");
+    }
+
     NotificationPanel {
         id: notificationPanel
         page: page
@@ -46,6 +46,7 @@ Dialog {
 
     canAccept: path !== "" && _isReady
     property bool _isReady: false
+    property int _checkRequest: -1
     property var _pathRegex: new RegExp('', 'i')
     property real _searchLeftMargin: Theme.itemSizeSmall+Theme.paddingMedium // = SearchField::textLeftMargin
     property string _fnElide: settings.read("General/FilenameElideMode", "fade")
@@ -159,13 +160,23 @@ Dialog {
 
                     var search = Paths.lastPartOfPath(path).replace(/([-.[\](){}\\*?*^$|])/g, "\\$1")
                     dialog._pathRegex = new RegExp(search, 'i')
-                    if (text === "" || !engine.pathIsDirectory(text)) {
-                        // Theme.errorColor looks too harsh
-                        color = Theme.secondaryHighlightColor
-                        _isReady = false
-                    } else {
-                        color = Theme.primaryColor
-                        _isReady = true
+
+                    // Theme.errorColor looks too harsh
+                    color = Theme.secondaryHighlightColor
+                    _isReady = false
+                    _checkRequest = (text === "" ? -1 : engine.requestPathIsDirectory(text))
+                }
+
+                Connections {
+                    target: engine
+                    onIoRequestFinished: {
+                        if (requestId !== _checkRequest) return
+                        _checkRequest = -1
+
+                        if (result === true) {
+                            pathField.color = Theme.primaryColor
+                            _isReady = true
+                        }
                     }
                 }
 
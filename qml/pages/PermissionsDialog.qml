@@ -28,15 +28,15 @@ import "../components"
 Dialog {
     property string path: ""
 
-    // return value
-    property string errorMessage: ""
+    // return value: the result is sent with engine.ioRequestFinished()
+    property int requestId: -1
 
     id: dialog
     allowedOrientations: Orientation.All
 
     property int _executeWidth: executeLabel.width
 
-    onAccepted: errorMessage = engine.chmod(path,
+    onAccepted: requestId = engine.requestChmod(path,
                         ownerRead.checked, ownerWrite.checked, ownerExecute.checked,
                         groupRead.checked, groupWrite.checked, groupExecute.checked,
                         othersRead.checked, othersWrite.checked, othersExecute.checked);
@@ -32,20 +32,18 @@ Dialog {
     canAccept: _readyCount === files.length
 
     property var files: []
-    property var newFiles: []
     property string basePath: ""
-    property string errorMessages: []
     property int _readyCount: 0
 
+    // return value: one request per file, results are sent with engine.ioRequestFinished()
+    property var requestIds: []
+
     Component.onCompleted: basePath = Paths.dirName(files[0])
 
     onAccepted: {
         for (var i = 0; i < repeater.count; i++) {
             var item = repeater.itemAt(i);
-            if (!item) continue;
-            var res = engine.rename(item.originalName, item.nameField.text);
-            if (res[1] !== "") errorMessages.push(res[1])
-            newFiles.push(res[0]);
+            requestIds.push(engine.requestRename(item.originalName, item.nameField.text));
         }
     }
 
@@ -111,8 +109,10 @@ Dialog {
                         }
 
                         property bool notifiedAsReady: false
-                        onTextChanged: {
-                            if (text === "" || engine.exists(basePath+text)) {
+                        property int _existsRequest: -1
+
+                        function setReady(ready) {
+                            if (!ready) {
                                 // Theme.errorColor looks too harsh
                                 color = Theme.secondaryHighlightColor
                                 if (notifiedAsReady) {
@@ -128,6 +128,21 @@ Dialog {
                             }
                         }
 
+                        onTextChanged: {
+                            // checked in the background, results for old text are ignored
+                            setReady(false);
+                            _existsRequest = (text === "" ? -1 : engine.requestExists(basePath+text));
+                        }
+
+                        Connections {
+                            target: engine
+                            onIoRequestFinished: {
+                                if (requestId !== newNameLabel._existsRequest) return;
+                                newNameLabel._existsRequest = -1;
+                                newNameLabel.setReady(result === false);
+                            }
+                        }
+
                         Component.onCompleted: {
                             text = Paths.lastPartOfPath(parent.originalName)
                             dialog._readyCount = 0; notifiedAsReady = false;
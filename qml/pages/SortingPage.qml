@@ -58,6 +58,7 @@ Page {
                     ListElement { label: qsTr("Name"); value: "name" }
                     ListElement { label: qsTr("Size"); value: "size" }
                     ListElement { label: qsTr("Modification time"); value: "modificationtime" }
+                    ListElement { label: qsTr("Capture time (photos)"); value: "capturetime" }
                     ListElement { label: qsTr("File type"); value: "type" }
                 }
 
@@ -0,0 +1,151 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+import QtQuick 2.2
+import Sailfish.Silica 1.0
+
+Page {
+    id: page
+    allowedOrientations: Orientation.All
+
+    property var jobs: engine.jobs
+
+    function _statusText(status, type) {
+        if (status === "queued") return qsTr("Waiting");
+        if (status === "done") return qsTr("Finished");
+        if (status === "failed") return qsTr("Failed");
+        if (status === "cancelled") return qsTr("Cancelled");
+        if (status === "interrupted") return qsTr("Interrupted");
+        if (type === "delete") return qsTr("Deleting");
+        if (type === "copy") return qsTr("Copying");
+        if (type === "move") return qsTr("Moving");
+        if (type === "link") return qsTr("Linking");
+        return "";
+    }
+
+    SilicaListView {
+        id: jobList
+        anchors.fill: parent
+        model: jobs
+        VerticalScrollDecorator { flickable: jobList }
+
+        PullDownMenu {
+            MenuItem {
+                text: qsTr("Clear finished")
+                onClicked: jobs.clearFinished()
+            }
+        }
+
+        header: PageHeader {
+            title: qsTr("File operations")
+            description: jobs.runningCount > 0 ?
+                             qsTr("%n running", "", jobs.runningCount) : ""
+        }
+
+        delegate: ListItem {
+            id: jobItem
+            width: ListView.view.width
+            contentHeight: nameLabel.height + detailLabel.height + 2*Theme.paddingMedium
+            menu: (model.status === "queued" || model.status === "running" || model.resumable) ? contextMenu : null
+
+            Label {
+                id: statusLabel
+                anchors {
+                    right: parent.right; rightMargin: Theme.horizontalPageMargin
+                    verticalCenter: nameLabel.verticalCenter
+                }
+                text: model.status === "running" ?
+                          "%1 %2%".arg(_statusText(model.status, model.type)).arg(model.progress) :
+                          _statusText(model.status, model.type)
+                color: model.status === "failed" ? Theme.errorColor :
+                       (jobItem.highlighted ? Theme.highlightColor : Theme.secondaryColor)
+                font.pixelSize: Theme.fontSizeSmall
+            }
+            Label {
+                id: nameLabel
+                y: Theme.paddingMedium
+                anchors {
+                    left: parent.left; leftMargin: Theme.horizontalPageMargin
+                    right: statusLabel.left; rightMargin: Theme.paddingMedium
+                }
+                text: model.name
+                textFormat: Text.PlainText
+                truncationMode: TruncationMode.Fade
+                color: jobItem.highlighted ? Theme.highlightColor : Theme.primaryColor
+            }
+            Label {
+                id: detailLabel
+                anchors {
+                    left: parent.left; leftMargin: Theme.horizontalPageMargin
+                    right: parent.right; rightMargin: Theme.horizontalPageMargin
+                    top: nameLabel.bottom
+                }
+                text: model.errorMessage !== "" ? model.errorMessage :
+                      (model.status === "running" && model.currentFile !== "" ?
+                           model.currentFile : model.destination)
+                textFormat: Text.PlainText
+                color: jobItem.highlighted ? Theme.secondaryHighlightColor : Theme.secondaryColor
+                font.pixelSize: Theme.fontSizeExtraSmall
+                elide: Text.ElideLeft
+            }
+            Rectangle {
+                visible: model.status === "running"
+                anchors.bottom: parent.bottom
+                height: Theme.paddingSmall / 2
+                width: parent.width * model.progress / 100
+                color: Theme.highlightColor
+            }
+
+            Component {
+                id: contextMenu
+                ContextMenu {
+                    MenuItem {
+                        visible: model.status === "queued"
+                        text: qsTr("Start next")
+                        onClicked: jobs.setPriority(model.jobId, model.priority + 1)
+                    }
+                    MenuItem {
+                        visible: model.status === "queued" || model.status === "running"
+                        text: qsTr("Cancel")
+                        onClicked: jobs.cancel(model.jobId)
+                    }
+                    MenuItem {
+                        visible: model.resumable
+                        text: qsTr("Resume")
+                        onClicked: jobs.resume(model.jobId)
+                    }
+                    MenuItem {
+                        visible: model.resumable
+                        text: qsTr("Discard")
+                        onClicked: {
+                            var jobId = model.jobId;
+                            jobItem.remorseAction(qsTr("Discarding"), function() { jobs.discard(jobId); });
+                        }
+                    }
+                }
+            }
+        }
+
+        ViewPlaceholder {
+            enabled: jobList.count === 0
+            text: qsTr("No file operations")
+        }
+    }
+}
@@ -23,6 +23,9 @@
 import QtQuick 2.0
 import Sailfish.Silica 1.0
 
+import harbour.file.browser.TextDocumentModel 1.0
+import harbour.file.browser.HexViewModel 1.0
+
 import "../components"
 import "../js/paths.js" as Paths
 
@@ -30,10 +33,298 @@ Page {
     id: page
     allowedOrientations: Orientation.All
     property string path: ""
+    property int _readRequest: -1
+
+    // text files are shown line by line, binary files row by row as hex
+    // dump, and errors are shown as preview from engine.readFile()
+    readonly property bool _isText: document.errorMessage === "" && !document.binary
+    readonly property bool _isBinary: document.errorMessage === "" && document.binary
+    property int _hexColumns: 0 // automatic
+    property bool _searchVisible: false
+    property int _matchLine: -1
+    property double _hexTopOffset: 0
+
+    TextDocumentModel {
+        id: document
+        path: page.path
+        onLoaded: {
+            if (errorMessage !== "") {
+                _readRequest = engine.requestReadFile(page.path);
+            }
+        }
+    }
+
+    HexViewModel {
+        id: hexDocument
+        path: _isBinary ? page.path : ""
+        bytesPerRow: _hexColumns > 0 ? _hexColumns : (page.isPortrait ? 8 : 16)
+        onBytesPerRowChanged: {
+            // keep the same bytes in view
+            hexView.positionViewAtIndex(rowForOffset(_hexTopOffset), ListView.Beginning);
+        }
+    }
+
+    BusyIndicator {
+        anchors.centerIn: parent
+        size: BusyIndicatorSize.Large
+        running: _readRequest >= 0 ||
+                 (_isText && document.indexing && document.lineCount === 0) ||
+                 (_isBinary && hexDocument.loading)
+    }
+
+    SilicaListView {
+        id: hexView
+        anchors.fill: parent
+        visible: _isBinary
+        model: _isBinary ? hexDocument : null
+        VerticalScrollDecorator { flickable: hexView }
+
+        onMovementEnded: {
+            var row = indexAt(0, contentY + (headerItem ? headerItem.height : 0));
+            if (row >= 0) _hexTopOffset = hexDocument.offsetForRow(row);
+        }
+
+        header: PageHeader {
+            title: Paths.lastPartOfPath(page.path)
+            description: qsTr("Binary file")
+        }
+
+        delegate: Label {
+            x: Theme.horizontalPageMargin
+            width: hexView.width - 2*x
+            text: model.text
+            wrapMode: Text.WrapAnywhere
+            font.pixelSize: Theme.fontSizeTiny
+            font.family: "Monospace"
+            color: Theme.secondaryColor
+        }
+
+        PullDownMenu {
+            enabled: hexDocument.size > 0
+            visible: enabled
+            MenuItem {
+                text: hexDocument.bytesPerRow === 8 ?
+                          qsTr("Show 16 bytes per row") :
+                          qsTr("Show 8 bytes per row")
+                onClicked: _hexColumns = (hexDocument.bytesPerRow === 8 ? 16 : 8)
+            }
+            MenuItem {
+                text: qsTr("Go to offset")
+                onClicked: pageStack.push(goToOffsetDialog)
+            }
+        }
+
+        ViewPlaceholder {
+            enabled: _isBinary && !hexDocument.loading && hexDocument.errorMessage !== ""
+            text: hexDocument.errorMessage
+        }
+    }
+
+    Component {
+        id: goToOffsetDialog
+
+        Dialog {
+            property double offset: offsetField.text.indexOf("0x") === 0 ?
+                                        parseInt(offsetField.text.substring(2), 16) :
+                                        parseInt(offsetField.text, 10)
+
+            canAccept: offsetField.acceptableInput && offset < hexDocument.size
+            onAccepted: {
+                _hexTopOffset = offset;
+                hexView.positionViewAtIndex(hexDocument.rowForOffset(offset), ListView.Beginning);
+            }
+
+            Column {
+                width: parent.width
+
+                DialogHeader { acceptText: qsTr("Go to offset") }
+
+                TextField {
+                    id: offsetField
+                    width: parent.width
+                    inputMethodHints: Qt.ImhNoPredictiveText | Qt.ImhNoAutoUppercase
+                    label: qsTr("Offset in bytes, prefix hexadecimal numbers with 0x")
+                    placeholderText: label
+                    validator: RegExpValidator { regExp: /^(0x[0-9a-fA-F]+|[0-9]+)$/ }
+                    EnterKey.enabled: acceptableInput
+                    EnterKey.iconSource: "image://theme/icon-m-enter-accept"
+                    EnterKey.onClicked: accept()
+                    Component.onCompleted: forceActiveFocus()
+                }
+            }
+        }
+    }
+
+    SilicaListView {
+        id: textView
+        anchors.fill: parent
+        visible: _isText
+        model: _isText ? document : null
+        VerticalScrollDecorator { flickable: textView }
+
+        header: Column {
+            width: textView.width
+
+            PageHeader {
+                title: Paths.lastPartOfPath(page.path)
+                description: document.indexing ?
+                                 qsTr("Indexing lines… %1%").arg(Math.round(100*document.progress)) :
+                                 qsTr("%n line(s)", "", document.lineCount)
+            }
+
+            SearchField {
+                id: searchField
+                width: parent.width
+                visible: _searchVisible
+                placeholderText: qsTr("Search in file")
+                inputMethodHints: Qt.ImhNoPredictiveText
+                EnterKey.enabled: text.length > 0
+                EnterKey.iconSource: "image://theme/icon-m-search"
+                EnterKey.onClicked: startSearch()
+                onVisibleChanged: if (visible) forceActiveFocus()
+
+                function startSearch() {
+                    _matchLine = -1;
+                    document.search(text, regexSwitch.checked, caseSwitch.checked);
+                    focus = false;
+                }
+            }
+
+            TextSwitch {
+                id: caseSwitch
+                visible: _searchVisible
+                text: qsTr("Match case")
+                onCheckedChanged: if (searchField.text !== "") searchField.startSearch()
+            }
+
+            TextSwitch {
+                id: regexSwitch
+                visible: _searchVisible
+                text: qsTr("Regular expression")
+                onCheckedChanged: if (searchField.text !== "") searchField.startSearch()
+            }
+        }
+
+        delegate: Label {
+            x: Theme.horizontalPageMargin
+            width: textView.width - 2*x
+            text: model.text
+            wrapMode: Text.WrapAnywhere
+            font.pixelSize: Theme.fontSizeTiny
+            font.family: "Monospace"
+            color: (index === _matchLine) ? Theme.highlightColor : Theme.secondaryColor
+        }
+
+        PullDownMenu {
+            enabled: document.lineCount > 0
+            visible: enabled
+            MenuItem {
+                text: _searchVisible ? qsTr("Hide search") : qsTr("Search")
+                onClicked: {
+                    _searchVisible = !_searchVisible;
+                    if (!_searchVisible) {
+                        document.cancelSearch();
+                        _matchLine = -1;
+                    }
+                }
+            }
+            MenuItem {
+                text: qsTr("Go to line")
+                onClicked: pageStack.push(goToLineDialog)
+            }
+        }
+
+        ViewPlaceholder {
+            enabled: _isText && !document.indexing && document.lineCount === 0
+            text: qsTr("Empty file")
+        }
+    }
+
+    function showMatch(forward) {
+        var line = forward ? document.nextMatchLine(_matchLine) : document.previousMatchLine(_matchLine);
+        if (line < 0) line = forward ? document.nextMatchLine(-1) : document.previousMatchLine(-1); // wrap
+        if (line < 0) return;
+        _matchLine = line;
+        textView.positionViewAtIndex(line, ListView.Center);
+    }
+
+    Connections {
+        target: document
+        // jump to the first match as soon as it is found and indexed
+        onMatchesChanged: if (_matchLine < 0 && document.matchCount > 0) showMatch(true)
+        onLineCountChanged: if (_matchLine < 0 && document.matchCount > 0) showMatch(true)
+    }
+
+    DockedPanel {
+        id: searchPanel
+        width: parent.width
+        height: Theme.itemSizeMedium
+        dock: Dock.Bottom
+        open: _isText && _searchVisible && (document.searching || document.matchCount > 0 || document.searchError !== "")
+
+        IconButton {
+            id: previousButton
+            anchors { left: parent.left; leftMargin: Theme.horizontalPageMargin; verticalCenter: parent.verticalCenter }
+            icon.source: "image://theme/icon-m-up"
+            enabled: document.matchCount > 0
+            onClicked: showMatch(false)
+        }
+
+        Label {
+            anchors { left: previousButton.right; right: nextButton.left; verticalCenter: parent.verticalCenter }
+            horizontalAlignment: Text.AlignHCenter
+            truncationMode: TruncationMode.Fade
+            color: Theme.highlightColor
+            text: {
+                if (document.searchError !== "") return document.searchError;
+                var count = document.matchesClipped ?
+                            qsTr("more than %n line(s)", "", document.matchCount) :
+                            qsTr("%n line(s)", "", document.matchCount);
+                return document.searching ? qsTr("Searching… %1").arg(count) : count;
+            }
+        }
+
+        IconButton {
+            id: nextButton
+            anchors { right: parent.right; rightMargin: Theme.horizontalPageMargin; verticalCenter: parent.verticalCenter }
+            icon.source: "image://theme/icon-m-down"
+            enabled: document.matchCount > 0
+            onClicked: showMatch(true)
+        }
+    }
+
+    Component {
+        id: goToLineDialog
+
+        Dialog {
+            canAccept: lineField.acceptableInput
+            onAccepted: textView.positionViewAtIndex(parseInt(lineField.text, 10)-1, ListView.Beginning)
+
+            Column {
+                width: parent.width
+
+                DialogHeader { acceptText: qsTr("Go to line") }
+
+                TextField {
+                    id: lineField
+                    width: parent.width
+                    inputMethodHints: Qt.ImhDigitsOnly
+                    label: qsTr("Line between 1 and %1").arg(document.lineCount)
+                    placeholderText: label
+                    validator: IntValidator { bottom: 1; top: document.lineCount }
+                    EnterKey.enabled: acceptableInput
+                    EnterKey.iconSource: "image://theme/icon-m-enter-accept"
+                    EnterKey.onClicked: accept()
+                    Component.onCompleted: forceActiveFocus()
+                }
+            }
+        }
+    }
 
     SilicaFlickable {
         id: flickable
         anchors.fill: parent
+        visible: !_isText && !_isBinary
         contentHeight: column.height
         VerticalScrollDecorator { flickable: flickable }
 
@@ -96,8 +387,22 @@ Page {
     onStatusChanged: {
         if (status === PageStatus.Activating) {
             coverText = Paths.lastPartOfPath(page.path);
+        }
+    }
+
+    Connections {
+        target: engine
+        onIoRequestFinished: {
+            if (requestId !== _readRequest) return;
+            _readRequest = -1;
+
+            if (error !== "") {
+                message.text = error;
+                return;
+            }
+
             // reading file returns three texts, message, portrait and landscape texts
-            var txts = engine.readFile(page.path);
+            var txts = result;
             message.text = txts[0] === "" ? "" : "⸻ %1 ⸻".arg(txts[0]);
             portraitText.text = txts[1];
             landscapeText.text = txts[2];
@@ -0,0 +1,150 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QMutexLocker>
+#include <QDebug>
+#include "capturetimecache.h"
+#include "jhead/jhead-api.h"
+
+// Upper limit of cached entries. The cache is simply cleared when this
+// is reached. This is about 1 MiB of memory.
+#ifndef CAPTURETIMECACHE_MAX_ENTRIES
+#define CAPTURETIMECACHE_MAX_ENTRIES 30000
+#endif
+
+uint qHash(const CaptureTimeCache::Key& key, uint seed)
+{
+    return qHash(static_cast<quint64>(key.device), seed)
+            ^ qHash(static_cast<quint64>(key.inode), seed)
+            ^ qHash(key.modTime, seed);
+}
+
+namespace {
+    // Scans files taken from a shared list until all are processed.
+    // Multiple instances run in parallel.
+    class ScanRunnable : public QRunnable
+    {
+    public:
+        ScanRunnable(const QList<StatFileInfo>& files, QAtomicInt& next,
+                     std::function<void(const StatFileInfo&)> scanFile,
+                     std::function<bool()> isCancelled) :
+            m_files(files), m_next(next), m_scanFile(scanFile), m_isCancelled(isCancelled) {}
+
+        void run() override {
+            for (;;) {
+                int i = m_next.fetchAndAddRelaxed(1);
+                if (i >= m_files.size() || m_isCancelled()) return;
+                m_scanFile(m_files.at(i));
+            }
+        }
+
+    private:
+        const QList<StatFileInfo>& m_files;
+        QAtomicInt& m_next;
+        std::function<void(const StatFileInfo&)> m_scanFile;
+        std::function<bool()> m_isCancelled;
+    };
+}
+
+CaptureTimeCache::CaptureTimeCache() {}
+
+CaptureTimeCache* CaptureTimeCache::instance()
+{
+    static CaptureTimeCache cache;
+    return &cache;
+}
+
+bool CaptureTimeCache::canHaveCaptureTime(const StatFileInfo &file)
+{
+    if (!file.isFileAtEnd()) return false;
+    QString suffix = file.suffix().toLower();
+    return suffix == "jpg" || suffix == "jpeg" || suffix == "jpe";
+}
+
+qint64 CaptureTimeCache::captureTimeOrModTime(const StatFileInfo &file) const
+{
+    if (canHaveCaptureTime(file)) {
+        QMutexLocker locker(&m_mutex);
+        qint64 time = m_cache.value(keyFor(file), 0);
+        if (time != 0) return time;
+    }
+
+    return file.lastModifiedStat();
+}
+
+QList<StatFileInfo> CaptureTimeCache::uncached(const QList<StatFileInfo> &files) const
+{
+    QList<StatFileInfo> todo;
+    QMutexLocker locker(&m_mutex);
+
+    for (const auto& i : files) {
+        if (canHaveCaptureTime(i) && !m_cache.contains(keyFor(i))) {
+            todo.append(i);
+        }
+    }
+
+    return todo;
+}
+
+void CaptureTimeCache::scan(const QList<StatFileInfo> &files, std::function<bool ()> isCancelled)
+{
+    QList<StatFileInfo> todo = uncached(files);
+    if (todo.isEmpty()) return;
+    qDebug() << "[CaptureTimeCache] scanning" << todo.size() << "files";
+
+    auto scanFile = [&](const StatFileInfo& file){
+        QByteArray path = file.absoluteFilePath().toUtf8();
+        insert(keyFor(file), static_cast<qint64>(jhead_readCaptureTime(path.constData())));
+    };
+
+    // Reading headers is mostly waiting for I/O, so we use a private
+    // pool to not block the global pool used elsewhere.
+    QThreadPool pool;
+    QAtomicInt next(0);
+    int threads = qBound(1, QThread::idealThreadCount(), todo.size());
+    pool.setMaxThreadCount(threads);
+
+    for (int i = 0; i < threads; ++i) {
+        pool.start(new ScanRunnable(todo, next, scanFile, isCancelled));
+    }
+
+    pool.waitForDone();
+}
+
+CaptureTimeCache::Key CaptureTimeCache::keyFor(const StatFileInfo &file)
+{
+    return Key{file.device(), file.inode(), file.lastModifiedStat()};
+}
+
+void CaptureTimeCache::insert(const CaptureTimeCache::Key &key, qint64 captureTime)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_cache.size() >= CAPTURETIMECACHE_MAX_ENTRIES) {
+        qDebug() << "[CaptureTimeCache] cache is full, clearing";
+        m_cache.clear();
+    }
+
+    m_cache.insert(key, captureTime);
+}
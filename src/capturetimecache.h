@@ -0,0 +1,78 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CAPTURETIMECACHE_H
+#define CAPTURETIMECACHE_H
+
+#include <functional>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include "statfileinfo.h"
+
+/**
+ * @brief The CaptureTimeCache class provides the EXIF capture time of photos.
+ *
+ * Capture times are read with jhead and cached per file, keyed by device,
+ * inode, and modification time. Files are scanned in parallel, and results are
+ * stored as soon as they are available, so an interrupted scan is not lost.
+ * The cache is shared by all directory listings and is thread-safe.
+ */
+class CaptureTimeCache
+{
+public:
+    static CaptureTimeCache* instance();
+
+    // Returns true if the file can have a capture time, i.e. if it is a JPEG file.
+    static bool canHaveCaptureTime(const StatFileInfo& file);
+
+    // Returns the capture time as seconds since epoch, or the modification
+    // time if the file has no capture time. Never reads the file: files
+    // that have not been scanned yet fall back to the modification time.
+    qint64 captureTimeOrModTime(const StatFileInfo& file) const;
+
+    // Returns the files that can have a capture time but are not cached yet.
+    QList<StatFileInfo> uncached(const QList<StatFileInfo>& files) const;
+
+    // Reads capture times of all files that are not cached yet. Blocks until
+    // all files are scanned or isCancelled() returns true. Large lists should
+    // be scanned in batches, so that listings can be updated in between.
+    void scan(const QList<StatFileInfo>& files, std::function<bool()> isCancelled);
+
+private:
+    struct Key {
+        dev_t device;
+        ino_t inode;
+        qint64 modTime;
+        bool operator==(const Key& other) const {
+            return device == other.device && inode == other.inode && modTime == other.modTime;
+        }
+    };
+    friend uint qHash(const CaptureTimeCache::Key& key, uint seed);
+
+    explicit CaptureTimeCache();
+    static Key keyFor(const StatFileInfo& file);
+    void insert(const Key& key, qint64 captureTime);
+
+    QHash<Key, qint64> m_cache; // 0 if the file has no capture time
+    mutable QMutex m_mutex;
+};
+
+#endif // CAPTURETIMECACHE_H
@@ -22,18 +22,25 @@
 
 #include "consolemodel.h"
 #include "globals.h"
+#include "processrunner.h"
 
 enum {
     ModelDataRole = Qt::UserRole + 1
 };
 
 ConsoleModel::ConsoleModel(QObject *parent) :
-    QAbstractListModel(parent), m_process(nullptr)
+    QAbstractListModel(parent)
 {
+    ProcessRunner* runner = ProcessRunner::instance();
+    connect(runner, SIGNAL(lineRead(int, QString)), this, SLOT(handleProcessLine(int, QString)));
+    connect(runner, SIGNAL(finished(int, int, bool, QString)), this, SLOT(handleProcessFinish(int, int, bool)));
+    connect(runner, SIGNAL(failed(int, QProcess::ProcessError)), this, SLOT(handleProcessError(int, QProcess::ProcessError)));
 }
 
 ConsoleModel::~ConsoleModel()
 {
+    // the process is killed when ConsoleModel is destroyed (usually when Page is closed)
+    if (m_requestId >= 0) ProcessRunner::instance()->cancel(m_requestId);
 }
 
 int ConsoleModel::rowCount(const QModelIndex &parent) const
@@ -89,36 +96,28 @@ void ConsoleModel::appendLine(QString line)
 bool ConsoleModel::executeCommand(QString command, QStringList arguments)
 {
     // don't execute the command if an old command is still running
-    if (m_process && m_process->state() != QProcess::NotRunning) {
-        // if the old process doesn't stop in 1/2 secs, then don't run the new command
-        if (!m_process->waitForFinished(500))
-            return false;
-    }
+    if (m_requestId >= 0) return false;
+
     setLines(QStringList());
-    m_process = new QProcess(this);
-    m_process->setReadChannel(QProcess::StandardOutput);
-    m_process->setProcessChannelMode(QProcess::MergedChannels); // merged stderr channel with stdout channel
-    connect(m_process, SIGNAL(readyReadStandardOutput()), this, SLOT(readProcessChannels()));
-    connect(m_process, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(handleProcessFinish(int, QProcess::ExitStatus)));
-    connect(m_process, SIGNAL(error(QProcess::ProcessError)), this, SLOT(handleProcessError(QProcess::ProcessError)));
-    m_process->start(command, arguments);
-    // the process is killed when ConsoleModel is destroyed (usually when Page is closed)
-    // should we run the process in bg thread to allow the command to finish(?)
+    m_command = command;
+    m_requestId = ProcessRunner::instance()->run(command, arguments,
+        ProcessRunner::MergeErrorStream | ProcessRunner::StreamLines, 0 /* no timeout */);
 
     return true;
 }
 
-void ConsoleModel::readProcessChannels()
+void ConsoleModel::handleProcessLine(int requestId, QString line)
 {
-    while (m_process->canReadLine()) {
-        QString line = m_process->readLine();
-        appendLine(line);
-    }
+    if (requestId != m_requestId) return;
+    appendLine(line);
 }
 
-void ConsoleModel::handleProcessFinish(int exitCode, QProcess::ExitStatus status)
+void ConsoleModel::handleProcessFinish(int requestId, int exitCode, bool crashed)
 {
-    if (status == QProcess::CrashExit) {
+    if (requestId != m_requestId) return;
+    m_requestId = -1;
+
+    if (crashed) {
         exitCode = -99999; // special error code to catch crashes
         appendLine(tr("** crashed"));
     } else if (exitCode != 0) {
@@ -127,10 +126,13 @@ void ConsoleModel::handleProcessFinish(int exitCode, QProcess::ExitStatus status
     emit processExited(exitCode);
 }
 
-void ConsoleModel::handleProcessError(QProcess::ProcessError error)
+void ConsoleModel::handleProcessError(int requestId, QProcess::ProcessError error)
 {
+    if (requestId != m_requestId) return;
+    m_requestId = -1;
+
     if (error == QProcess::FailedToStart) {
-        appendLine(tr("** command “%1” not found").arg(m_process->program()));
+        appendLine(tr("** command “%1” not found").arg(m_command));
     } else if (error == QProcess::Crashed) {
         appendLine(tr("** crashed"));
     } else if (error == QProcess::Timedout) {
@@ -57,12 +57,13 @@ signals:
     void processExited(int exitCode);
 
 private slots:
-    void readProcessChannels();
-    void handleProcessFinish(int exitCode, QProcess::ExitStatus status);
-    void handleProcessError(QProcess::ProcessError error);
+    void handleProcessLine(int requestId, QString line);
+    void handleProcessFinish(int requestId, int exitCode, bool crashed);
+    void handleProcessError(int requestId, QProcess::ProcessError error);
 
 private:
-    QProcess *m_process;
+    int m_requestId = {-1};
+    QString m_command;
     QStringList m_lines;
 };
 
@@ -0,0 +1,213 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <sys/stat.h>
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QDataStream>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QMutexLocker>
+#include <QDebug>
+#include "directorysizeindex.h"
+#include "mounttable.h"
+
+// Upper limit of entries per volume. The volume index is simply
+// cleared when this is reached. This is about 20 MiB of memory.
+#ifndef DIRECTORYSIZEINDEX_MAX_ENTRIES
+#define DIRECTORYSIZEINDEX_MAX_ENTRIES 200000
+#endif
+
+// Maximum age of entries in seconds. Files changed in place by other
+// programs don't change the directory, so entries are rescanned after this.
+#ifndef DIRECTORYSIZEINDEX_MAX_AGE
+#define DIRECTORYSIZEINDEX_MAX_AGE (7*24*60*60)
+#endif
+
+#define DIRECTORYSIZEINDEX_MAGIC 0x46425349 // FBSI
+#define DIRECTORYSIZEINDEX_VERSION 3
+
+DirectorySizeIndex::DirectorySizeIndex()
+{
+    m_directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/size-index";
+}
+
+DirectorySizeIndex* DirectorySizeIndex::instance()
+{
+    static DirectorySizeIndex index;
+    return &index;
+}
+
+qint64 DirectorySizeIndex::modTimeOf(const struct stat &st)
+{
+    return qint64(st.st_mtim.tv_sec) * 1000000000LL + qint64(st.st_mtim.tv_nsec);
+}
+
+bool DirectorySizeIndex::lookup(dev_t device, ino_t inode, qint64 modTime,
+                                const QByteArray& path, Entry *entry)
+{
+    QMutexLocker locker(&m_mutex);
+    const Volume& vol = volume(device);
+    auto it = vol.entries.constFind(quint64(inode));
+    if (it == vol.entries.constEnd() || it->modTime != modTime
+            || it->pathHash != qHash(path, 0) || isExpired(*it)) {
+        return false;
+    }
+    *entry = *it;
+    return true;
+}
+
+void DirectorySizeIndex::insert(dev_t device, ino_t inode, const QByteArray& path, const Entry &entry)
+{
+    QMutexLocker locker(&m_mutex);
+    Volume& vol = volume(device);
+
+    if (vol.entries.size() >= DIRECTORYSIZEINDEX_MAX_ENTRIES) {
+        qDebug() << "[DirectorySizeIndex] index is full, clearing volume" << device;
+        vol.entries.clear();
+    }
+
+    auto it = vol.entries.insert(quint64(inode), entry);
+    it->pathHash = qHash(path, 0);
+    it->indexedAt = currentTime();
+    vol.dirty = true;
+}
+
+void DirectorySizeIndex::invalidate(const QString &directory)
+{
+    struct stat st;
+    if (::stat(QFile::encodeName(directory).constData(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    Volume& vol = volume(st.st_dev);
+    if (vol.entries.remove(quint64(st.st_ino)) > 0) {
+        vol.dirty = true;
+    }
+}
+
+void DirectorySizeIndex::save()
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (auto it = m_volumes.begin(); it != m_volumes.end(); ++it) {
+        if (!it->dirty || !it->persistent) continue;
+        write(dev_t(it.key()), *it);
+        it->dirty = false;
+    }
+}
+
+qint64 DirectorySizeIndex::currentTime()
+{
+    return QDateTime::currentMSecsSinceEpoch() / 1000;
+}
+
+bool DirectorySizeIndex::isExpired(const Entry& entry)
+{
+    // entries from the future are expired too, the clock may have been wrong
+    const qint64 age = currentTime() - entry.indexedAt;
+    return age < 0 || age > DIRECTORYSIZEINDEX_MAX_AGE;
+}
+
+DirectorySizeIndex::Volume& DirectorySizeIndex::volume(dev_t device)
+{
+    auto it = m_volumes.find(quint64(device));
+    if (it != m_volumes.end()) return *it;
+
+    Volume& vol = m_volumes[quint64(device)];
+    vol.persistent = hasStableInodes(device);
+    if (vol.persistent) load(device, vol);
+    return vol;
+}
+
+bool DirectorySizeIndex::hasStableInodes(dev_t device)
+{
+    // FAT file systems have no inode numbers, the kernel makes them up
+    // when a file is accessed. The same is true for many FUSE file systems.
+    const auto mounts = MountTable::instance()->mounts();
+    for (const auto& i : mounts) {
+        if (i.device != quint64(device)) continue;
+        return !(i.type == "vfat" || i.type == "msdos" || i.type == "exfat"
+                 || i.type.startsWith("fuse"));
+    }
+    return false; // unknown
+}
+
+QString DirectorySizeIndex::indexFile(dev_t device) const
+{
+    return m_directory + "/" + QString::number(quint64(device), 16) + ".idx";
+}
+
+void DirectorySizeIndex::load(dev_t device, Volume &volume)
+{
+    QFile file(indexFile(device));
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic, version, count;
+    in >> magic >> version >> count;
+    if (magic != DIRECTORYSIZEINDEX_MAGIC || version != DIRECTORYSIZEINDEX_VERSION
+            || count > DIRECTORYSIZEINDEX_MAX_ENTRIES) {
+        qDebug() << "[DirectorySizeIndex] ignoring invalid index" << file.fileName();
+        return;
+    }
+
+    volume.entries.reserve(int(count));
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        quint64 inode;
+        Entry entry;
+        in >> inode >> entry.modTime >> entry.apparentSize
+           >> entry.allocatedSize >> entry.files >> entry.dirs >> entry.pathHash
+           >> entry.indexedAt;
+        if (!isExpired(entry)) volume.entries.insert(inode, entry);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << "[DirectorySizeIndex] ignoring corrupted index" << file.fileName();
+        volume.entries.clear();
+    }
+}
+
+void DirectorySizeIndex::write(dev_t device, const Volume &volume)
+{
+    if (!QDir().mkpath(m_directory)) return;
+
+    QSaveFile file(indexFile(device));
+    if (!file.open(QIODevice::WriteOnly)) return;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << quint32(DIRECTORYSIZEINDEX_MAGIC) << quint32(DIRECTORYSIZEINDEX_VERSION)
+        << quint32(volume.entries.size());
+
+    for (auto it = volume.entries.constBegin(); it != volume.entries.constEnd(); ++it) {
+        out << it.key() << it->modTime << it->apparentSize
+            << it->allocatedSize << it->files << it->dirs << it->pathHash
+            << it->indexedAt;
+    }
+
+    if (!file.commit()) {
+        qDebug() << "[DirectorySizeIndex] failed to save index" << file.fileName();
+    }
+}
@@ -0,0 +1,98 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DIRECTORYSIZEINDEX_H
+#define DIRECTORYSIZEINDEX_H
+
+#include <sys/types.h>
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+#include <QString>
+#include <QMutex>
+
+/**
+ * @brief The DirectorySizeIndex class remembers size info of directories.
+ *
+ * For every scanned directory, the index stores the sizes and number of the
+ * files directly inside it, and the names of its subdirectories. Entries are
+ * keyed by device and inode, and are only valid as long as the directory's
+ * modification time does not change. Adding, removing, or renaming entries
+ * changes the modification time, so only changed directories have to be
+ * listed again. Files changed in place don't change the modification time,
+ * so FileWorker invalidates directories it writes to. Other programs can
+ * change files in place too, so entries also expire after a while.
+ *
+ * Some file systems, e.g. FAT and many FUSE file systems, hand out inode
+ * numbers when files are accessed, so the same number can belong to another
+ * directory later on. Entries therefore also remember a hash of the path.
+ *
+ * There is one index per volume. It is loaded from the cache directory when
+ * first needed and written back by save(). Volumes without stable inode
+ * numbers are only indexed in memory. The index is thread-safe.
+ */
+class DirectorySizeIndex
+{
+public:
+    struct Entry {
+        qint64 modTime = {0}; // nanoseconds
+        qint64 apparentSize = {0};
+        qint64 allocatedSize = {0};
+        qint64 files = {0};
+        QList<QByteArray> dirs; // names of subdirectories
+        uint pathHash = {0}; // set by insert()
+        qint64 indexedAt = {0}; // seconds since epoch, set by insert()
+    };
+
+    static DirectorySizeIndex* instance();
+    static qint64 modTimeOf(const struct stat& st);
+
+    // Returns true and sets 'entry' if the directory has a valid entry.
+    bool lookup(dev_t device, ino_t inode, qint64 modTime, const QByteArray& path, Entry* entry);
+    void insert(dev_t device, ino_t inode, const QByteArray& path, const Entry& entry);
+
+    // Drops the entry of the given directory, e.g. after changing files in it.
+    void invalidate(const QString& directory);
+
+    // Writes all changed volumes to disk.
+    void save();
+
+private:
+    struct Volume {
+        QHash<quint64, Entry> entries; // by inode
+        bool dirty = {false};
+        bool persistent = {false}; // false if inode numbers are not stable
+    };
+
+    explicit DirectorySizeIndex();
+    Volume& volume(dev_t device); // loads the volume if needed
+    static bool hasStableInodes(dev_t device);
+    static qint64 currentTime();
+    static bool isExpired(const Entry& entry);
+    QString indexFile(dev_t device) const;
+    void load(dev_t device, Volume& volume);
+    void write(dev_t device, const Volume& volume);
+
+    QHash<quint64, Volume> m_volumes; // by device
+    QString m_directory;
+    QMutex m_mutex;
+};
+
+#endif // DIRECTORYSIZEINDEX_H
@@ -0,0 +1,113 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <QFile>
+#include <QMutexLocker>
+#include "diskspacecache.h"
+
+// Maximum age of cached info in milliseconds. Other apps may write
+// to the same volumes, so info is not cached forever.
+#ifndef DISKSPACECACHE_MAX_AGE
+#define DISKSPACECACHE_MAX_AGE 30000
+#endif
+
+int DiskSpaceCache::Info::percentage() const
+{
+    // like 'df': the share of space usable by normal users, rounded up
+    qint64 usable = used + available;
+    if (usable <= 0) return 0;
+    return int(std::ceil(double(used) * 100.0 / double(usable)));
+}
+
+DiskSpaceCache::DiskSpaceCache() {}
+
+DiskSpaceCache* DiskSpaceCache::instance()
+{
+    static DiskSpaceCache cache;
+    return &cache;
+}
+
+bool DiskSpaceCache::lookup(const QString &path, Info *info)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto device = m_devices.constFind(path);
+    if (device == m_devices.constEnd()) return false;
+
+    auto entry = m_entries.constFind(*device);
+    if (entry == m_entries.constEnd() || !isFresh(*entry)) return false;
+
+    *info = entry->info;
+    return true;
+}
+
+DiskSpaceCache::Info DiskSpaceCache::query(const QString &path)
+{
+    Info info;
+    if (lookup(path, &info)) return info;
+
+    QByteArray encoded = QFile::encodeName(path);
+    struct stat st;
+    struct statvfs vfs;
+
+    if (::stat(encoded.constData(), &st) != 0 || ::statvfs(encoded.constData(), &vfs) != 0) {
+        return info;
+    }
+
+    qint64 blockSize = qint64(vfs.f_frsize);
+    info.valid = true;
+    info.total = qint64(vfs.f_blocks) * blockSize;
+    info.free = qint64(vfs.f_bfree) * blockSize;
+    info.available = qint64(vfs.f_bavail) * blockSize;
+    info.used = info.total - info.free;
+    info.inodesTotal = qint64(vfs.f_files);
+    info.inodesFree = qint64(vfs.f_ffree);
+
+    QMutexLocker locker(&m_mutex);
+    m_devices.insert(path, quint64(st.st_dev));
+    Entry& entry = m_entries[quint64(st.st_dev)];
+    entry.info = info;
+    entry.age.start();
+    return info;
+}
+
+void DiskSpaceCache::invalidate(const QString &path)
+{
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) != 0) return;
+
+    QMutexLocker locker(&m_mutex);
+    m_entries.remove(quint64(st.st_dev));
+}
+
+void DiskSpaceCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_devices.clear();
+    m_entries.clear();
+}
+
+bool DiskSpaceCache::isFresh(const Entry &entry) const
+{
+    return entry.age.isValid() && entry.age.elapsed() < DISKSPACECACHE_MAX_AGE;
+}
@@ -0,0 +1,82 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DISKSPACECACHE_H
+#define DISKSPACECACHE_H
+
+#include <sys/types.h>
+#include <QHash>
+#include <QString>
+#include <QMutex>
+#include <QElapsedTimer>
+
+/**
+ * @brief The DiskSpaceCache class provides cached disk space info of volumes.
+ *
+ * Disk space is read with statvfs() and cached per volume, i.e. per device.
+ * Paths are mapped to their volume when they are first queried. Cached info
+ * is refreshed when it is invalidated, e.g. after writing to the volume, or
+ * when it gets too old. The cache is thread-safe, but query() may block on
+ * slow file systems and should not be called from the UI thread.
+ */
+class DiskSpaceCache
+{
+public:
+    struct Info {
+        bool valid = {false};
+        qint64 total = {0}; // bytes
+        qint64 used = {0};
+        qint64 free = {0};
+        qint64 available = {0}; // free space usable by normal users
+        qint64 inodesTotal = {0};
+        qint64 inodesFree = {0};
+        int percentage() const; // used percentage, like 'df'
+    };
+
+    static DiskSpaceCache* instance();
+
+    // Returns cached info without touching the file system.
+    // Returns false if the path is unknown or its info is outdated.
+    bool lookup(const QString& path, Info* info);
+
+    // Returns cached or fresh info. This may block.
+    Info query(const QString& path);
+
+    // Drops cached info of the volume containing the given path. This may block.
+    void invalidate(const QString& path);
+
+    // Drops all cached info, e.g. after mounts changed.
+    void clear();
+
+private:
+    struct Entry {
+        Info info;
+        QElapsedTimer age;
+    };
+
+    explicit DiskSpaceCache();
+    bool isFresh(const Entry& entry) const;
+
+    QHash<QString, quint64> m_devices; // path to device
+    QHash<quint64, Entry> m_entries; // by device
+    QMutex m_mutex;
+};
+
+#endif // DISKSPACECACHE_H
@@ -0,0 +1,400 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <vector>
+#include <sys/stat.h>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QHash>
+#include <QVector>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QDebug>
+#include "diskusagemodel.h"
+#include "treewalker.h"
+#include "globals.h"
+
+enum {
+    PathRole = Qt::UserRole + 1,
+    NameRole = Qt::UserRole + 2,
+    SizeRole = Qt::UserRole + 3,
+    BytesRole = Qt::UserRole + 4
+};
+
+// Keeps the largest entries offered to it in a bounded min-heap.
+// Entries smaller than the current minimum are rejected without locking.
+class DiskUsageModel::TopList
+{
+public:
+    explicit TopList(int limit) : m_limit(qMax(1, limit)) {}
+
+    bool accepts(qint64 size) const { return size > m_threshold.loadAcquire(); }
+
+    void offer(qint64 size, const QByteArray& path)
+    {
+        QMutexLocker locker(&m_mutex);
+        auto smaller = [](const Item& a, const Item& b){ return a.size > b.size; };
+
+        if (int(m_heap.size()) < m_limit) {
+            m_heap.push_back(Item{size, path});
+            std::push_heap(m_heap.begin(), m_heap.end(), smaller);
+        } else if (size > m_heap.front().size) {
+            std::pop_heap(m_heap.begin(), m_heap.end(), smaller);
+            m_heap.back() = Item{size, path};
+            std::push_heap(m_heap.begin(), m_heap.end(), smaller);
+        } else {
+            return;
+        }
+
+        if (int(m_heap.size()) == m_limit) {
+            m_threshold.storeRelease(m_heap.front().size);
+        }
+    }
+
+    QList<Entry> sorted() const
+    {
+        std::vector<Item> items;
+
+        {
+            QMutexLocker locker(&m_mutex);
+            items = m_heap;
+        }
+
+        std::sort(items.begin(), items.end(), [](const Item& a, const Item& b){ return a.size > b.size; });
+
+        QList<Entry> entries;
+        entries.reserve(int(items.size()));
+        for (const auto& i : items) {
+            entries.append(Entry{i.size, QFile::decodeName(i.path)});
+        }
+        return entries;
+    }
+
+private:
+    struct Item {
+        qint64 size;
+        QByteArray path;
+    };
+
+    int m_limit;
+    QAtomicInteger<qint64> m_threshold = {-1};
+    mutable QMutex m_mutex;
+    std::vector<Item> m_heap;
+};
+
+// Results of one scan, shared between the model and the scanner.
+class DiskUsageModel::ScanState
+{
+public:
+    ScanState(QString path, int limit) : root(path), files(limit), dirs(limit) {}
+
+    QString root;
+    QAtomicInt cancelled = {0};
+    TopList files;
+    TopList dirs;
+
+    QMutex mutex;
+    qint64 scannedSize = {0};
+    qint64 scannedFiles = {0};
+};
+
+class DiskUsageModel::Scanner : public QRunnable
+{
+public:
+    Scanner(DiskUsageModel* model, int generation, QSharedPointer<ScanState> state) :
+        m_model(model), m_generation(generation), m_state(state) {}
+
+    void run() override {
+        QByteArray root = QFile::encodeName(m_state->root);
+
+        // like 'du -x': do not follow links and stay on one file system
+        TreeWalker walker(QStringList() << m_state->root);
+        walker.setFollowSymLinks(false);
+
+        walker.setFileVisitor([&](const QByteArray& dir, const char* name, const struct stat& st){
+            qint64 size = qint64(st.st_blocks) * 512;
+            if (!m_state->files.accepts(size)) return;
+
+            QByteArray path = dir;
+            if (!path.endsWith('/')) path.append('/');
+            path.append(name);
+            m_state->files.offer(size, path);
+        });
+
+        walker.setDirVisitor([&](const QByteArray& path, const TreeWalker::Totals& totals){
+            if (path == root || !m_state->dirs.accepts(totals.allocatedSize)) return;
+            m_state->dirs.offer(totals.allocatedSize, path);
+        });
+
+        auto isCancelled = [&](){ return m_state->cancelled.loadAcquire() != 0; };
+        auto progress = [&](const TreeWalker::Totals& totals){
+            setProgress(totals);
+            QMetaObject::invokeMethod(m_model, "updateResults", Qt::QueuedConnection,
+                                      Q_ARG(int, m_generation));
+        };
+
+        TreeWalker::Totals totals = walker.walk(isCancelled, progress);
+        if (isCancelled()) return;
+
+        setProgress(totals);
+        QMetaObject::invokeMethod(m_model, "finishScan", Qt::QueuedConnection,
+                                  Q_ARG(int, m_generation));
+    }
+
+private:
+    void setProgress(const TreeWalker::Totals& totals) {
+        QMutexLocker locker(&m_state->mutex);
+        m_state->scannedSize = totals.allocatedSize;
+        m_state->scannedFiles = totals.files;
+    }
+
+    DiskUsageModel* m_model;
+    int m_generation;
+    QSharedPointer<ScanState> m_state;
+};
+
+DiskUsageModel::DiskUsageModel(QObject *parent) : QAbstractListModel(parent)
+{
+    // scans run one after another; each scan uses multiple threads itself
+    m_pool.setMaxThreadCount(1);
+}
+
+DiskUsageModel::~DiskUsageModel()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+int DiskUsageModel::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return shownEntries().count();
+}
+
+QVariant DiskUsageModel::data(const QModelIndex &index, int role) const
+{
+    const QList<Entry>& entries = shownEntries();
+    if (!index.isValid() || index.row() > entries.count()-1)
+        return QVariant();
+
+    const Entry& entry = entries.at(index.row());
+    switch (role) {
+
+    case Qt::DisplayRole:
+    case PathRole:
+        return entry.path;
+
+    case NameRole:
+        return QFileInfo(entry.path).fileName();
+
+    case SizeRole:
+        return filesizeToString(entry.size);
+
+    case BytesRole:
+        return double(entry.size);
+
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> DiskUsageModel::roleNames() const
+{
+    QHash<int, QByteArray> roles = QAbstractListModel::roleNames();
+    roles.insert(PathRole, QByteArray("path"));
+    roles.insert(NameRole, QByteArray("name"));
+    roles.insert(SizeRole, QByteArray("size"));
+    roles.insert(BytesRole, QByteArray("bytes"));
+    return roles;
+}
+
+void DiskUsageModel::setPath(QString path)
+{
+    if (m_path == path) return;
+    m_path = path;
+    emit pathChanged();
+    refresh();
+}
+
+void DiskUsageModel::setShowDirectories(bool showDirectories)
+{
+    if (m_showDirectories == showDirectories) return;
+    beginResetModel();
+    m_showDirectories = showDirectories;
+    endResetModel();
+    emit showDirectoriesChanged();
+}
+
+void DiskUsageModel::setLimit(int limit)
+{
+    if (m_limit == limit) return;
+    m_limit = limit; // applies to the next scan
+    emit limitChanged();
+}
+
+QString DiskUsageModel::scannedSize() const
+{
+    return filesizeToString(m_scannedSize);
+}
+
+void DiskUsageModel::refresh()
+{
+    cancel();
+
+    beginResetModel();
+    m_files.clear();
+    m_dirs.clear();
+    endResetModel();
+
+    m_scannedSize = 0;
+    m_scannedFiles = 0;
+    emit progressChanged();
+
+    if (m_path.isEmpty()) return;
+
+    qDebug() << "[DiskUsageModel] scanning" << m_path;
+    m_state.reset(new ScanState(m_path, m_limit));
+    m_pool.start(new Scanner(this, ++m_generation, m_state));
+    setBusy(true);
+}
+
+void DiskUsageModel::cancel()
+{
+    if (m_state) {
+        m_state->cancelled.storeRelease(1);
+        m_state.clear();
+    }
+
+    setBusy(false);
+}
+
+void DiskUsageModel::updateResults(int generation)
+{
+    if (generation != m_generation || !m_state) return; // outdated
+
+    updateEntries(m_files, m_state->files.sorted(), !m_showDirectories);
+    updateEntries(m_dirs, m_state->dirs.sorted(), m_showDirectories);
+
+    {
+        QMutexLocker locker(&m_state->mutex);
+        m_scannedSize = m_state->scannedSize;
+        m_scannedFiles = m_state->scannedFiles;
+    }
+    emit progressChanged();
+}
+
+void DiskUsageModel::finishScan(int generation)
+{
+    if (generation != m_generation || !m_state) return; // outdated
+
+    updateResults(generation);
+    m_state.clear();
+    setBusy(false);
+}
+
+void DiskUsageModel::updateEntries(QList<Entry>& current, const QList<Entry>& entries, bool shown)
+{
+    if (!shown) {
+        current = entries;
+        return;
+    }
+
+    // Partial results change only a little between updates. Update the rows
+    // in place instead of resetting, so views keep their scroll position.
+    QSet<QString> newPaths;
+    newPaths.reserve(entries.count());
+    for (const auto& i : entries) newPaths.insert(i.path);
+
+    // remove rows that are gone, from the back so row numbers stay valid
+    for (int last = current.count()-1; last >= 0; --last) {
+        if (newPaths.contains(current.at(last).path)) continue;
+        int first = last;
+        while (first > 0 && !newPaths.contains(current.at(first-1).path)) --first;
+        beginRemoveRows(QModelIndex(), first, last);
+        current.erase(current.begin()+first, current.begin()+last+1);
+        endRemoveRows();
+        last = first;
+    }
+
+    // bring the remaining rows into the new order
+    QHash<QString, int> rows;
+    rows.reserve(current.count());
+    for (int i = 0; i < current.count(); ++i) {
+        rows.insert(current.at(i).path, i);
+    }
+
+    QList<Entry> kept;
+    QVector<int> newRows(current.count(), -1);
+    kept.reserve(current.count());
+    bool reordered = false;
+
+    for (const auto& i : entries) {
+        int row = rows.value(i.path, -1);
+        if (row < 0) continue;
+        if (row != kept.count()) reordered = true;
+        newRows[row] = kept.count();
+        kept.append(i);
+    }
+
+    if (reordered) {
+        emit layoutAboutToBeChanged();
+        QModelIndexList from = persistentIndexList();
+        QModelIndexList to;
+        for (const auto& i : from) {
+            to.append(index(newRows.at(i.row()), i.column()));
+        }
+        current = kept;
+        changePersistentIndexList(from, to);
+        emit layoutChanged();
+    } else {
+        for (int i = 0; i < kept.count(); ++i) {
+            if (current.at(i).size == kept.at(i).size) continue;
+            current[i].size = kept.at(i).size;
+            emit dataChanged(index(i), index(i), {SizeRole, BytesRole});
+        }
+    }
+
+    // insert new rows where they belong
+    for (int first = 0; first < entries.count(); ++first) {
+        if (rows.contains(entries.at(first).path)) continue;
+        int last = first;
+        while (last+1 < entries.count() && !rows.contains(entries.at(last+1).path)) ++last;
+        beginInsertRows(QModelIndex(), first, last);
+        for (int i = first; i <= last; ++i) current.insert(i, entries.at(i));
+        endInsertRows();
+        first = last;
+    }
+}
+
+void DiskUsageModel::setBusy(bool busy)
+{
+    if (m_busy == busy) return;
+    m_busy = busy;
+    emit busyChanged();
+}
+
+const QList<DiskUsageModel::Entry>& DiskUsageModel::shownEntries() const
+{
+    return m_showDirectories ? m_dirs : m_files;
+}
@@ -0,0 +1,110 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DISKUSAGEMODEL_H
+#define DISKUSAGEMODEL_H
+
+#include <QAbstractListModel>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QList>
+
+/**
+ * @brief The DiskUsageModel class lists the largest files or folders below a folder.
+ *
+ * The folder is scanned in the background, staying on its file system.
+ * Only the largest entries are kept while scanning, so memory usage does not
+ * depend on the number of files. Sizes are the space allocated on disk, and
+ * folder sizes include everything below them. The model is updated with
+ * partial results while the scan is running.
+ */
+class DiskUsageModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(QString path READ path() WRITE setPath(QString) NOTIFY pathChanged())
+    Q_PROPERTY(bool showDirectories READ showDirectories() WRITE setShowDirectories(bool) NOTIFY showDirectoriesChanged())
+    Q_PROPERTY(int limit READ limit() WRITE setLimit(int) NOTIFY limitChanged())
+    Q_PROPERTY(bool busy READ busy() NOTIFY busyChanged())
+    Q_PROPERTY(QString scannedSize READ scannedSize() NOTIFY progressChanged())
+    Q_PROPERTY(int scannedFiles READ scannedFiles() NOTIFY progressChanged())
+
+public:
+    explicit DiskUsageModel(QObject *parent = nullptr);
+    ~DiskUsageModel();
+
+    // methods needed by ListView
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QHash<int, QByteArray> roleNames() const;
+
+    // property accessors
+    QString path() const { return m_path; }
+    void setPath(QString path);
+    bool showDirectories() const { return m_showDirectories; }
+    void setShowDirectories(bool showDirectories);
+    int limit() const { return m_limit; }
+    void setLimit(int limit);
+    bool busy() const { return m_busy; }
+    QString scannedSize() const;
+    int scannedFiles() const { return int(m_scannedFiles); }
+
+    // methods accessible from QML
+    Q_INVOKABLE void refresh();
+    Q_INVOKABLE void cancel();
+
+signals:
+    void pathChanged();
+    void showDirectoriesChanged();
+    void limitChanged();
+    void busyChanged();
+    void progressChanged();
+
+private slots:
+    void updateResults(int generation);
+    void finishScan(int generation);
+
+private:
+    struct Entry {
+        qint64 size;
+        QString path;
+    };
+    class TopList;
+    class ScanState;
+    class Scanner;
+
+    void setBusy(bool busy);
+    void updateEntries(QList<Entry>& current, const QList<Entry>& entries, bool shown);
+    const QList<Entry>& shownEntries() const;
+
+    QString m_path;
+    bool m_showDirectories = {false};
+    int m_limit = {50};
+    bool m_busy = {false};
+    qint64 m_scannedSize = {0};
+    qint64 m_scannedFiles = {0};
+    QList<Entry> m_files;
+    QList<Entry> m_dirs;
+
+    int m_generation = {0};
+    QSharedPointer<ScanState> m_state;
+    QThreadPool m_pool;
+};
+
+#endif // DISKUSAGEMODEL_H
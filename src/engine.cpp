@@ -27,46 +27,450 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QCoreApplication>
+#include <QDebug>
 #include <QProcess>
+#include <QRunnable>
+#include <QTimer>
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
 #include <unistd.h>
 #include "globals.h"
-#include "fileworker.h"
+#include "filejobqueue.h"
 #include "statfileinfo.h"
 #include "settingshandler.h"
+#include "treewalker.h"
+#include "directorysizeindex.h"
+#include "diskspacecache.h"
+#include "mounttable.h"
+#include "transferplanner.h"
+#include "hexviewmodel.h"
+
+// Time in milliseconds after which running asynchronous requests are given
+// up. Requests that time out keep running, but their mount is considered
+// stalled until they return, and new requests for it fail immediately.
+#ifndef ENGINE_IO_TIMEOUT
+#define ENGINE_IO_TIMEOUT 8000
+#endif
+
+// Maximum number of asynchronous requests running at the same time for one
+// mount. Others are queued, so that a hanging mount cannot block all threads.
+#ifndef ENGINE_IO_MOUNT_LIMIT
+#define ENGINE_IO_MOUNT_LIMIT 2
+#endif
+
+// Time in milliseconds to wait for background threads when quitting.
+#ifndef ENGINE_EXIT_TIMEOUT
+#define ENGINE_EXIT_TIMEOUT 1000
+#endif
+
+// Transfer throughput is sampled at this interval in milliseconds, and
+// smoothed with an exponential moving average using this weight for new samples.
+#ifndef ENGINE_THROUGHPUT_INTERVAL
+#define ENGINE_THROUGHPUT_INTERVAL 1000
+#endif
+#ifndef ENGINE_THROUGHPUT_SMOOTHING
+#define ENGINE_THROUGHPUT_SMOOTHING 0.3
+#endif
+
+// Interval in milliseconds at which the progress of the file worker is sampled.
+#ifndef ENGINE_PROGRESS_INTERVAL
+#define ENGINE_PROGRESS_INTERVAL 50
+#endif
+
+// Lets runnables report to the engine for as long as it exists. Requests
+// on a hanging file system may outlive the engine, see Engine::~Engine().
+struct EngineHandle
+{
+    QMutex mutex;
+    Engine* engine = {nullptr};
+
+    // calls the method from the engine's event loop, unless the engine is gone
+    template<typename... Args>
+    void invoke(const char* method, Args... args) {
+        QMutexLocker locker(&mutex);
+        if (engine) QMetaObject::invokeMethod(engine, method, Qt::QueuedConnection, args...);
+    }
+};
+
+namespace {
+    QStringList sizeInfoToStringList(const TreeWalker::Totals& totals)
+    {
+        return QStringList() << (totals.apparentSize > 0 ? filesizeToString(totals.apparentSize) : "-")
+                             << QString::number(totals.dirs)
+                             << QString::number(totals.files)
+                             << (totals.allocatedSize > 0 ? filesizeToString(totals.allocatedSize) : "-");
+    }
+
+    // Walks the given paths and reports results to the engine.
+    class FileSizeInfoRunnable : public QRunnable
+    {
+    public:
+        FileSizeInfoRunnable(QSharedPointer<EngineHandle> engine, int requestId, QStringList paths,
+                             QSharedPointer<QAtomicInt> cancelled) :
+            m_engine(engine), m_requestId(requestId), m_paths(paths), m_cancelled(cancelled) {}
+
+        void run() override {
+            TreeWalker walker(m_paths);
+            walker.setIndex(DirectorySizeIndex::instance());
+            auto isCancelled = [&](){ return m_cancelled->loadAcquire() != 0; };
+            auto progress = [&](const TreeWalker::Totals& totals){
+                m_engine->invoke("fileSizeInfoProgress", Q_ARG(int, m_requestId),
+                                 Q_ARG(QStringList, sizeInfoToStringList(totals)));
+            };
+
+            TreeWalker::Totals totals = walker.walk(isCancelled, progress);
+            DirectorySizeIndex::instance()->save();
+            if (isCancelled()) return;
+
+            m_engine->invoke("finishFileSizeInfo", Q_ARG(int, m_requestId),
+                             Q_ARG(QStringList, sizeInfoToStringList(totals)));
+        }
+
+    private:
+        QSharedPointer<EngineHandle> m_engine;
+        int m_requestId;
+        QStringList m_paths;
+        QSharedPointer<QAtomicInt> m_cancelled;
+    };
+
+    // Runs a single request on the request pool and reports the result to the
+    // engine. The timeout starts when the request runs, not when it is queued.
+    class IoRequestRunnable : public QRunnable
+    {
+    public:
+        IoRequestRunnable(QSharedPointer<EngineHandle> engine, int requestId,
+                          std::function<QVariant()> job) :
+            m_engine(engine), m_requestId(requestId), m_job(job) {}
+
+        void run() override {
+            m_engine->invoke("startIoRequestTimer", Q_ARG(int, m_requestId));
+            QVariant result = m_job();
+            m_engine->invoke("finishIoRequest", Q_ARG(int, m_requestId), Q_ARG(QVariant, result));
+        }
+
+    private:
+        QSharedPointer<EngineHandle> m_engine;
+        int m_requestId;
+        std::function<QVariant()> m_job;
+    };
+
+    QVariantMap diskSpaceToVariantMap(const DiskSpaceCache::Info& info)
+    {
+        QVariantMap map;
+        if (!info.valid) return map;
+
+        map.insert("percentage", QString::number(info.percentage()) + "%");
+        map.insert("summary", filesizeToString(info.used) + "/" + filesizeToString(info.total));
+        map.insert("total", double(info.total));
+        map.insert("used", double(info.used));
+        map.insert("free", double(info.free));
+        map.insert("available", double(info.available));
+        map.insert("inodesTotal", double(info.inodesTotal));
+        map.insert("inodesFree", double(info.inodesFree));
+        return map;
+    }
+
+    // Reads disk space info of a batch of paths and reports it to the engine.
+    class DiskSpaceRunnable : public QRunnable
+    {
+    public:
+        DiskSpaceRunnable(QSharedPointer<EngineHandle> engine, QStringList paths) :
+            m_engine(engine), m_paths(paths) {}
+
+        void run() override {
+            for (const auto& path : m_paths) {
+                QVariantMap info = diskSpaceToVariantMap(DiskSpaceCache::instance()->query(path));
+                m_engine->invoke("diskSpaceReady", Q_ARG(QString, path), Q_ARG(QVariantMap, info));
+            }
+        }
+
+    private:
+        QSharedPointer<EngineHandle> m_engine;
+        QStringList m_paths;
+    };
+}
 
 Engine::Engine(QObject *parent) :
     QObject(parent),
     m_clipboardContainsCopy(false),
     m_progress(0),
-    m__isUsingBusybox(QStringList()),
-    m__checkedBusybox(false)
+    m_handle(new EngineHandle),
+    m_walkPool(new QThreadPool),
+    m_requestPool(new QThreadPool)
 {
-    m_fileWorker = new FileWorker;
-    m_settings = qApp->property("settings").value<Settings*>();
+    m_handle->engine = this;
+
+    // requests are short, but some may hang on a stalled mount
+    m_requestPool->setMaxThreadCount(qMax(QThread::idealThreadCount(), 4 * ENGINE_IO_MOUNT_LIMIT));
 
-    // update progress property when worker progresses
-    connect(m_fileWorker, SIGNAL(progressChanged(int, QString)),
-            this, SLOT(setProgress(int, QString)));
+    m_jobs = new FileJobQueue(this); // stops all jobs when deleted
+    m_settings = qApp->property("settings").value<Settings*>();
 
-    // pass worker end signals to QML
-    connect(m_fileWorker, SIGNAL(done()), this, SIGNAL(workerDone()));
-    connect(m_fileWorker, SIGNAL(errorOccurred(QString, QString)),
-            this, SIGNAL(workerErrorOccurred(QString, QString)));
-    connect(m_fileWorker, SIGNAL(fileDeleted(QString)), this, SIGNAL(fileDeleted(QString)));
+    // Progress properties follow the job started last. They are updated while
+    // it runs; workers do not signal progress, so copying many small files
+    // cannot flood the event loop.
+    m_progressTimer.setInterval(ENGINE_PROGRESS_INTERVAL);
+    connect(&m_progressTimer, SIGNAL(timeout()), this, SLOT(sampleProgress()));
+
+    // pass end signals of the current job to QML, after the final progress
+    connect(m_jobs, SIGNAL(jobDone(int)), this, SLOT(handleJobDone(int)));
+    connect(m_jobs, SIGNAL(jobFailed(int, QString, QString)),
+            this, SLOT(handleJobFailed(int, QString, QString)));
+    connect(m_jobs, SIGNAL(jobEnded(int)), this, SLOT(handleJobEnded(int)));
+    connect(m_jobs, SIGNAL(fileDeleted(QString)), this, SIGNAL(fileDeleted(QString)));
+
+    // the mount table must be created in the main thread
+    connect(MountTable::instance(), SIGNAL(changed()), this, SLOT(handleMountsChanged()));
 }
 
 Engine::~Engine()
 {
-    m_fileWorker->cancel(); // ask the background thread to exit its loop
-    // is this the way to force stop the worker thread?
-    m_fileWorker->wait();   // wait until thread stops
-    m_fileWorker->deleteLater();    // delete it
+    // threads still running no longer report to this object
+    {
+        QMutexLocker locker(&m_handle->mutex);
+        m_handle->engine = nullptr;
+    }
+
+    // Size calculations stop when cancelled, but requests on a hanging file
+    // system may never return. Waiting for them would hang the app, so their
+    // pool is leaked instead.
+    for (auto& i : m_sizeInfoRequests) i->storeRelease(1);
+
+    if (m_walkPool->waitForDone(ENGINE_EXIT_TIMEOUT)) {
+        delete m_walkPool;
+    } else {
+        qDebug() << "[Engine] not waiting for hanging background threads";
+    }
+
+    if (m_stalledMounts.isEmpty() && m_requestPool->waitForDone(ENGINE_EXIT_TIMEOUT)) {
+        delete m_requestPool;
+    } else {
+        qDebug() << "[Engine] not waiting for hanging requests";
+    }
+}
+
+int Engine::requestFileSizeInfo(QStringList paths)
+{
+    int requestId = ++m_lastSizeInfoRequest;
+    QSharedPointer<QAtomicInt> cancelled(new QAtomicInt(0));
+    m_sizeInfoRequests.insert(requestId, cancelled);
+    m_walkPool->start(new FileSizeInfoRunnable(m_handle, requestId, paths, cancelled));
+    return requestId;
+}
+
+void Engine::cancelFileSizeInfo(int requestId)
+{
+    QSharedPointer<QAtomicInt> cancelled = m_sizeInfoRequests.take(requestId);
+    if (cancelled) cancelled->storeRelease(1);
+}
+
+void Engine::finishFileSizeInfo(int requestId, QStringList info)
+{
+    if (!m_sizeInfoRequests.remove(requestId)) return; // cancelled
+    emit fileSizeInfoReady(requestId, info);
+}
+
+void Engine::requestDiskSpace(QString path)
+{
+    if (m_diskSpaceRequests.isEmpty()) {
+        // collect all requests made in this event loop iteration,
+        // e.g. by all delegates of a list view
+        QTimer::singleShot(0, this, SLOT(startDiskSpaceRequests()));
+    }
+
+    m_diskSpaceRequests.append(path);
+}
+
+void Engine::startDiskSpaceRequests()
+{
+    QStringList todo;
+
+    for (const auto& path : m_diskSpaceRequests) {
+        DiskSpaceCache::Info info;
+
+        // return no disk space for sdcard parent directory
+        if (path.isEmpty() || path == "/media/sdcard") {
+            emit diskSpaceReady(path, QVariantMap());
+        } else if (DiskSpaceCache::instance()->lookup(path, &info)) {
+            emit diskSpaceReady(path, diskSpaceToVariantMap(info));
+        } else if (!todo.contains(path)) {
+            todo.append(path);
+        }
+    }
+
+    m_diskSpaceRequests.clear();
+    if (!todo.isEmpty()) m_walkPool->start(new DiskSpaceRunnable(m_handle, todo));
+}
+
+int Engine::requestExists(QString filename)
+{
+    return startIoRequest(filename, [filename]() {
+        return QVariant(doExists(filename));
+    });
+}
+
+int Engine::requestPathIsDirectory(QString path)
+{
+    return startIoRequest(path, [path]() {
+        return QVariant(doPathIsDirectory(path));
+    });
+}
+
+int Engine::requestPathIsFile(QString path)
+{
+    return startIoRequest(path, [path]() {
+        return QVariant(doPathIsFile(path));
+    });
+}
+
+int Engine::requestReadFile(QString filename)
+{
+    return startIoRequest(filename, [filename]() {
+        return QVariant(doReadFile(filename));
+    });
+}
+
+int Engine::requestMkdir(QString path, QString name)
+{
+    return startIoRequest(path, [path, name]() {
+        return QVariant(doMkdir(path, name));
+    });
+}
+
+int Engine::requestRename(QString fullOldFilename, QString newName)
+{
+    return startIoRequest(fullOldFilename, [fullOldFilename, newName]() {
+        return QVariant(doRename(fullOldFilename, newName));
+    });
+}
+
+int Engine::requestChmod(QString path,
+                         bool ownerRead, bool ownerWrite, bool ownerExecute,
+                         bool groupRead, bool groupWrite, bool groupExecute,
+                         bool othersRead, bool othersWrite, bool othersExecute)
+{
+    return startIoRequest(path, [path, ownerRead, ownerWrite, ownerExecute,
+                                 groupRead, groupWrite, groupExecute,
+                                 othersRead, othersWrite, othersExecute]() {
+        return QVariant(doChmod(path, ownerRead, ownerWrite, ownerExecute,
+                                groupRead, groupWrite, groupExecute,
+                                othersRead, othersWrite, othersExecute));
+    });
+}
+
+int Engine::startIoRequest(QString path, std::function<QVariant()> job)
+{
+    int requestId = ++m_lastIoRequest;
+    int mountId = MountTable::instance()->mountFor(path).id;
+
+    m_ioRequests[requestId].mountId = mountId;
+    m_ioRequests[requestId].job = job;
+
+    if (m_stalledMounts.value(mountId) > 0) {
+        // Don't queue more requests for a file system that is not responding,
+        // they would only block more threads.
+        qDebug() << "[Engine] file system is not responding, request rejected:" << path;
+        rejectIoRequest(requestId);
+    } else if (m_runningMounts.value(mountId) < ENGINE_IO_MOUNT_LIMIT) {
+        runIoRequest(requestId);
+    } else {
+        m_queuedIoRequests[mountId].enqueue(requestId);
+    }
+
+    return requestId;
+}
+
+void Engine::runIoRequest(int requestId)
+{
+    IoRequest& request = m_ioRequests[requestId];
+    m_runningMounts[request.mountId] += 1;
+    m_requestPool->start(new IoRequestRunnable(m_handle, requestId, request.job));
+    request.job = nullptr;
+}
+
+void Engine::runQueuedIoRequests(int mountId)
+{
+    auto queue = m_queuedIoRequests.find(mountId);
+    if (queue == m_queuedIoRequests.end()) return;
+
+    while (!queue->isEmpty() && m_runningMounts.value(mountId) < ENGINE_IO_MOUNT_LIMIT) {
+        int requestId = queue->dequeue();
+        if (m_stalledMounts.value(mountId) > 0) rejectIoRequest(requestId);
+        else runIoRequest(requestId);
+    }
+
+    if (queue->isEmpty()) m_queuedIoRequests.erase(queue);
+}
+
+void Engine::rejectIoRequest(int requestId)
+{
+    // The error is sent when control returns to
+    // the event loop, so callers know the id.
+    m_ioRequests.remove(requestId);
+    QTimer::singleShot(0, this, [this, requestId]() {
+        emit ioRequestFinished(requestId, QVariant(), tr("The file system is not responding"));
+    });
+}
+
+void Engine::startIoRequestTimer(int requestId)
+{
+    if (!m_ioRequests.contains(requestId)) return; // already finished
+    QTimer::singleShot(ENGINE_IO_TIMEOUT, this, [this, requestId]() { expireIoRequest(requestId); });
+}
+
+void Engine::expireIoRequest(int requestId)
+{
+    auto request = m_ioRequests.find(requestId);
+    if (request == m_ioRequests.end()) return; // already finished
+
+    // The request keeps running. Until it returns, new requests
+    // for the same file system are rejected.
+    request->timedOut = true;
+    int mountId = request->mountId;
+    m_stalledMounts[mountId] += 1;
+    qDebug() << "[Engine] request timed out, file system is stalled:" << requestId;
+
+    emit ioRequestFinished(requestId, QVariant(), tr("The file system is not responding"));
+
+    // requests waiting for the same file system would only time out as well
+    QQueue<int> queued = m_queuedIoRequests.take(mountId);
+    for (int i : queued) rejectIoRequest(i);
+}
+
+void Engine::finishIoRequest(int requestId, QVariant result)
+{
+    auto request = m_ioRequests.find(requestId);
+    if (request == m_ioRequests.end()) return;
+
+    bool timedOut = request->timedOut;
+    int mountId = request->mountId;
+    m_ioRequests.erase(request);
+
+    if (--m_runningMounts[mountId] <= 0) m_runningMounts.remove(mountId);
+
+    if (timedOut) {
+        // the result has been given up already, but the file system is back
+        if (--m_stalledMounts[mountId] <= 0) m_stalledMounts.remove(mountId);
+    } else {
+        emit ioRequestFinished(requestId, result, QString());
+    }
+
+    runQueuedIoRequests(mountId);
+}
+
+void Engine::handleMountsChanged()
+{
+    DiskSpaceCache::instance()->clear();
+    emit diskSpaceInvalidated();
+    emit externalDrivesChanged();
 }
 
 void Engine::deleteFiles(QStringList filenames)
 {
     setProgress(0, "");
-    m_fileWorker->startDeleteFiles(filenames);
+    resetTransferProgress();
+    startJob(m_jobs->enqueue(FileJobQueue::DeleteJob, filenames));
 }
 
 void Engine::cutFiles(QStringList filenames)
@@ -104,25 +508,13 @@ QStringList Engine::listExistingFiles(QString destDirectory)
         return QStringList();
     }
 
-    QStringList existingFiles;
-    foreach (QString filename, m_clipboardFiles) {
-        QFileInfo fileInfo(filename);
-        QString newname = dest.absoluteFilePath(fileInfo.fileName());
-
-        // source and dest filenames are the same? let pasteFiles() create a numbered copy for it.
-        if (filename == newname) {
-            continue;
-        }
-
-        // dest is under source? (directory) let pasteFiles() return an error.
-        if (newname.startsWith(filename)) {
-            return QStringList();
-        }
-        if (QFile::exists(newname)) {
-            existingFiles.append(fileInfo.fileName());
-        }
+    // sources pasted onto themselves get numbered copies, and pasting
+    // into itself is an error that pasteFiles() reports
+    TransferPlanner planner;
+    if (!planner.plan(m_clipboardFiles, destDirectory, m_clipboardContainsCopy)) {
+        return QStringList();
     }
-    return existingFiles;
+    return planner.existingNames();
 }
 
 void Engine::pasteFiles(QString destDirectory, bool asSymlinks)
@@ -133,6 +525,7 @@ void Engine::pasteFiles(QString destDirectory, bool asSymlinks)
     }
 
     setProgress(0, "");
+    resetTransferProgress();
 
     QDir dest(destDirectory);
     if (!dest.exists()) {
@@ -140,22 +533,21 @@ void Engine::pasteFiles(QString destDirectory, bool asSymlinks)
         return;
     }
 
-    // validate that the files can be pasted
-    foreach (QString filename, m_clipboardFiles) {
-        QFileInfo fileInfo(filename);
-        QString newname = dest.absoluteFilePath(fileInfo.fileName());
-
-        // moving and source and dest filenames are the same?
-        if (!m_clipboardContainsCopy && filename == newname) {
-            emit workerErrorOccurred(tr("Cannot overwrite itself"), newname);
-            return;
-        }
-
-        // dest is under source? (directory)
-        if (newname.startsWith(filename) && newname != filename) {
-            emit workerErrorOccurred(tr("Cannot move/copy to itself"), filename);
-            return;
+    // validate that the files can be pasted, the plan is handed to the job
+    TransferPlanner planner;
+    if (!planner.plan(m_clipboardFiles, destDirectory, m_clipboardContainsCopy)) {
+        switch (planner.error()) {
+        case TransferPlanner::MissingTarget:
+            emit workerErrorOccurred(tr("Destination does not exist"), destDirectory);
+            break;
+        case TransferPlanner::OverwritesItself:
+            emit workerErrorOccurred(tr("Cannot overwrite itself"), planner.errorFile());
+            break;
+        default:
+            emit workerErrorOccurred(tr("Cannot move/copy to itself"), planner.errorFile());
+            break;
         }
+        return;
     }
 
     QStringList files = m_clipboardFiles;
@@ -163,17 +555,17 @@ void Engine::pasteFiles(QString destDirectory, bool asSymlinks)
     emit clipboardCountChanged();
 
     if (asSymlinks) {
-        m_fileWorker->startSymlinkFiles(files, destDirectory);
+        startJob(m_jobs->enqueue(FileJobQueue::SymlinkJob, files, destDirectory, 0, planner.targets()));
     } else if (m_clipboardContainsCopy) {
-        m_fileWorker->startCopyFiles(files, destDirectory);
+        startJob(m_jobs->enqueue(FileJobQueue::CopyJob, files, destDirectory, 0, planner.targets()));
     } else {
-        m_fileWorker->startMoveFiles(files, destDirectory);
+        startJob(m_jobs->enqueue(FileJobQueue::MoveJob, files, destDirectory, 0, planner.targets()));
     }
 }
 
 void Engine::cancel()
 {
-    m_fileWorker->cancel();
+    m_jobs->cancel(m_currentJob);
 }
 
 static QStringList subdirs(const QString &dirname, bool includeHidden = false)
@@ -225,22 +617,17 @@ QVariantList Engine::externalDrives() const
     // no candidates found, abort
     if (candidates.isEmpty()) return QVariantList();
 
-    // remove all directories which are not mount points
-    QMap<QString, QString> mps = mountPoints();
-    QMutableStringListIterator i(candidates);
-    while (i.hasNext()) {
-        QString dirname = i.next();
-        if (!mps.contains(dirname)) i.remove();
-    }
-
-    // all candidates eliminated, abort
-    if (candidates.isEmpty()) return QVariantList();
+    // only list directories which are mount points
+    MountTable* mounts = MountTable::instance();
 
     foreach (QString drive, candidates) {
+        MountTable::Mount mount = mounts->mountFor(drive);
+        if (mount.path != drive) continue;
+
         QVariantMap data;
         data.insert("path", drive);
 
-        if (mps[drive].startsWith("/dev/mmc")) {
+        if (mount.source.startsWith("/dev/mmc")) {
             data.insert("title", QObject::tr("SD card"));
         } else {
             data.insert("title", QObject::tr("Removable Media"));
@@ -273,81 +660,23 @@ bool Engine::runningAsRoot()
 
 bool Engine::exists(QString filename)
 {
-    if (filename.isEmpty())
-        return false;
-
-    return QFile::exists(filename);
+    return doExists(filename);
 }
 
-QStringList Engine::fileSizeInfo(QStringList paths)
+bool Engine::doExists(QString filename)
 {
-    if (paths.isEmpty()) return QStringList() << "-" << "0" << "0";
-
-    QStringList result;
-
-    // determine disk usage
-    // cf. docs on Engine::isUsingBusybox
-    QString diskusage = execute("/usr/bin/du", QStringList() << paths <<
-                                (isUsingBusybox("du") ? "-k" : "--bytes") <<
-                                "-x" << "-s" << "-c" << "-L", false);
-    QStringList duLines = diskusage.split(QRegExp("[\n\r]"));
-
-    if (duLines.length() < 2) {
-        result << "-"; // got an invalid result
-    } else {
-        QString duTotalStr = duLines.at(duLines.count()-2).split(QRegExp("[\\s]+"))[0].trimmed();
-        qint64 duTotal = duTotalStr.toLongLong() * (isUsingBusybox("du") ? 1000LL : 1LL); // BusyBox cannot show the real byte count
-        result << (duTotal > 0 ? filesizeToString(duTotal) : "-");
-    }
-
-    // count dirs
-    QString dirs = execute("/bin/find", QStringList() << "-L" << paths << "-type" << "d", false); // same for BusyBox
-    result << QString::number(dirs.split(QRegExp("[\n\r]")).count()-1);
-
-    // count files
-    QString files = execute("/bin/find", QStringList() << "-L" << paths << "(" << "-type" << "f" << "-or" << "-type" << "l" << ")", false); // same for BusyBox
-    result << QString::number(files.split(QRegExp("[\n\r]")).count()-1);
+    if (filename.isEmpty())
+        return false;
 
-    return result;
+    return QFile::exists(filename);
 }
 
-QStringList Engine::diskSpace(QString path)
+QStringList Engine::readFile(QString filename)
 {
-    if (path.isEmpty())
-        return QStringList();
-
-    // return no disk space for sdcard parent directory
-    if (path == "/media/sdcard")
-        return QStringList();
-
-    // run df in POSIX mode for the given path to get disk space
-    // cf. docs on Engine::isUsingBusybox
-    QString blockSize = isUsingBusybox("df") ? "-k" : "--block-size=1024";
-    QString result = execute("/bin/df", QStringList() << "-P" << blockSize << path, false);
-    if (result.isEmpty())
-        return QStringList();
-
-    // split result to lines
-    QStringList lines = result.split(QRegExp("[\n\r]"));
-    if (lines.count() < 2)
-        return QStringList();
-
-    // get second line and its columns
-    QString line = lines.at(1);
-    QStringList columns = line.split(QRegExp("\\s+"), QString::SkipEmptyParts);
-    if (columns.count() < 5)
-        return QStringList();
-
-    QString totalString = columns.at(1);
-    QString usedString = columns.at(2);
-    QString percentageString = columns.at(4);
-    qint64 total = totalString.toLongLong() * 1024LL;
-    qint64 used = usedString.toLongLong() * 1024LL;
-
-    return QStringList() << percentageString << filesizeToString(used)+"/"+filesizeToString(total);
+    return doReadFile(filename);
 }
 
-QStringList Engine::readFile(QString filename)
+QStringList Engine::doReadFile(QString filename)
 {
     int maxLines = 1000;
     int maxSize = 10240;
@@ -437,6 +766,11 @@ QStringList Engine::readFile(QString filename)
 }
 
 QString Engine::mkdir(QString path, QString name)
+{
+    return doMkdir(path, name);
+}
+
+QString Engine::doMkdir(QString path, QString name)
 {
     QDir dir(path);
 
@@ -452,6 +786,11 @@ QString Engine::mkdir(QString path, QString name)
 }
 
 QStringList Engine::rename(QString fullOldFilename, QString newName)
+{
+    return doRename(fullOldFilename, newName);
+}
+
+QStringList Engine::doRename(QString fullOldFilename, QString newName)
 {
     QFile file(fullOldFilename);
     QFileInfo fileInfo(fullOldFilename);
@@ -471,6 +810,16 @@ QString Engine::chmod(QString path,
                       bool ownerRead, bool ownerWrite, bool ownerExecute,
                       bool groupRead, bool groupWrite, bool groupExecute,
                       bool othersRead, bool othersWrite, bool othersExecute)
+{
+    return doChmod(path, ownerRead, ownerWrite, ownerExecute,
+                   groupRead, groupWrite, groupExecute,
+                   othersRead, othersWrite, othersExecute);
+}
+
+QString Engine::doChmod(QString path,
+                        bool ownerRead, bool ownerWrite, bool ownerExecute,
+                        bool groupRead, bool groupWrite, bool groupExecute,
+                        bool othersRead, bool othersWrite, bool othersExecute)
 {
     QFile file(path);
     QFileDevice::Permissions p;
@@ -501,12 +850,22 @@ bool Engine::openNewWindow(QStringList arguments) const
 }
 
 bool Engine::pathIsDirectory(QString path) const
+{
+    return doPathIsDirectory(path);
+}
+
+bool Engine::doPathIsDirectory(QString path)
 {
     StatFileInfo info(path);
     return info.isDirAtEnd();
 }
 
 bool Engine::pathIsFile(QString path) const
+{
+    return doPathIsFile(path);
+}
+
+bool Engine::doPathIsFile(QString path)
 {
     StatFileInfo info(path);
     return info.isFileAtEnd();
@@ -520,87 +879,143 @@ void Engine::setProgress(int progress, QString filename)
     emit progressFilenameChanged();
 }
 
-QMap<QString, QString> Engine::mountPoints() const
+void Engine::startJob(int jobId)
 {
-    // read /proc/mounts and return all mount points for the filesystem
-    QFile file("/proc/mounts");
-    if (!file.open(QFile::ReadOnly | QFile::Text))
-        return QMap<QString, QString>();
+    m_currentJob = jobId;
+    sampleProgress();
+    m_progressTimer.start();
+}
 
-    QTextStream in(&file);
-    QString result = in.readAll();
+void Engine::sampleProgress()
+{
+    if (m_jobs->status(m_currentJob) == FileJobQueue::Queued) {
+        QString waiting = tr("Waiting for other operations on this storage…");
+        if (m_progressFilename != waiting) setProgress(0, waiting);
+        return;
+    }
 
-    // split result to lines
-    QStringList lines = result.split(QRegExp("[\n\r]"));
+    TransferProgress::Snapshot snapshot = m_jobs->progress(m_currentJob);
 
-    // get columns
-    QMap<QString, QString> paired;
-    foreach (QString line, lines) {
-        QStringList columns = line.split(QRegExp("\\s+"), QString::SkipEmptyParts);
-        if (columns.count() < 6) continue; // sanity check
-        paired[columns.at(1)] = columns.at(0);
+    if (snapshot.progress != m_progress || snapshot.filename != m_progressFilename) {
+        setProgress(snapshot.progress, snapshot.filename);
     }
 
-    return paired;
+    // called even without changes, because the throughput may have dropped;
+    // holes only grow along with the bytes done, so they are reported with them
+    m_bytesSparse = snapshot.bytesSparse;
+    if (snapshot.bytesTotal > 0 || m_bytesTotal > 0) {
+        setBytesProgress(snapshot.bytesDone, snapshot.bytesTotal);
+    }
 }
 
-QString Engine::createHexDump(char *buffer, int size, int bytesPerLine)
+void Engine::handleJobDone(int jobId)
 {
-    QString out;
-    QString ascDump;
-    int i;
-    for (i = 0; i < size; ++i) {
-        if ((i % bytesPerLine) == 0) { // line change
-            out += " "+ascDump+"\n"+
-                    QString("%1").arg(QString::number(i, 16), 4, QLatin1Char('0'))+": ";
-            ascDump.clear();
-        }
+    if (jobId != m_currentJob) return;
+    m_progressTimer.stop();
+    sampleProgress();
+    emit workerDone();
+}
 
-        out += QString("%1").arg(QString::number((unsigned char)buffer[i], 16),
-                                       2, QLatin1Char('0'))+" ";
-        if (buffer[i] >= 32 && buffer[i] <= 126)
-            ascDump += buffer[i];
-        else
-            ascDump += ".";
+void Engine::handleJobFailed(int jobId, QString message, QString filename)
+{
+    if (jobId != m_currentJob) return;
+    m_progressTimer.stop();
+    sampleProgress();
+    emit workerErrorOccurred(message, filename);
+}
+
+void Engine::handleJobEnded(int jobId)
+{
+    Q_UNUSED(jobId);
+    // workers drop cached disk space info of volumes they wrote to
+    // right before they end
+    emit diskSpaceInvalidated();
+}
+
+void Engine::setBytesProgress(qint64 bytesDone, qint64 bytesTotal)
+{
+    if (!m_transferTimer.isValid()) {
+        m_transferTimer.start();
+        m_sampleTime = 0;
+        m_sampleBytes = bytesDone;
     }
-    // write out remaining asc dump
-    if ((i % bytesPerLine) > 0) {
-        int emptyBytes = bytesPerLine - (i % bytesPerLine);
-        for (int j = 0; j < emptyBytes; ++j) {
-            out += "   ";
+
+    qint64 now = m_transferTimer.elapsed();
+    qint64 interval = now - m_sampleTime;
+    bool sampled = false;
+    if (interval >= ENGINE_THROUGHPUT_INTERVAL) {
+        double rate = (bytesDone - m_sampleBytes) * 1000.0 / interval;
+        if (m_throughput > 0) {
+            m_throughput = ENGINE_THROUGHPUT_SMOOTHING * rate +
+                    (1 - ENGINE_THROUGHPUT_SMOOTHING) * m_throughput;
+        } else {
+            m_throughput = rate;
         }
+        m_sampleTime = now;
+        m_sampleBytes = bytesDone;
+        sampled = true;
     }
-    out += " "+ascDump;
 
-    return out;
+    if (!sampled && bytesDone == m_bytesDone && bytesTotal == m_bytesTotal) return;
+
+    m_bytesDone = bytesDone;
+    m_bytesTotal = bytesTotal;
+    m_eta = m_throughput > 0 ? int(qMax(Q_INT64_C(0), bytesTotal - bytesDone) / m_throughput + 0.5) : -1;
+    emit transferProgressChanged();
 }
 
-QStringList Engine::makeStringList(QString msg, QString str)
+void Engine::resetTransferProgress()
 {
-    QStringList list;
-    list << msg << str << str;
-    return list;
+    m_bytesDone = 0;
+    m_bytesTotal = 0;
+    m_bytesSparse = 0;
+    m_throughput = 0;
+    m_eta = -1;
+    m_transferTimer.invalidate();
+    emit transferProgressChanged();
 }
 
-bool Engine::isUsingBusybox(QString forCommand)
+QObject* Engine::jobs() const
 {
-    // from SailfishOS 3.3.x.x onwards, GNU coreutils have been replaced
-    // by BusyBox. This means e.g. 'du' no longer recognizes the options we need...
+    return m_jobs;
+}
 
-    if (m__checkedBusybox) return m__isUsingBusybox.contains(forCommand);
+QString Engine::transferSummary() const
+{
+    if (m_bytesTotal <= 0) return QString();
 
-    if (!QFile::exists("/bin/busybox")) {
-        m__isUsingBusybox = QStringList();
+    QString summary = tr("%1 of %2").arg(filesizeToString(m_bytesDone), filesizeToString(m_bytesTotal));
+    if (m_bytesSparse > 0) {
+        summary += ", " + tr("%1 saved as holes").arg(filesizeToString(m_bytesSparse));
+    }
+    if (m_throughput <= 0) return summary;
+
+    summary += ", " + tr("%1/s").arg(filesizeToString(qint64(m_throughput)));
+    if (m_eta < 0 || m_bytesDone >= m_bytesTotal) {
+        return summary;
+    } else if (m_eta < 60) {
+        return summary + ", " + tr("%n second(s) left", "", m_eta);
+    } else if (m_eta < 3600) {
+        return summary + ", " + tr("%n minute(s) left", "", (m_eta + 30) / 60);
     } else {
-        QString result = execute("/bin/busybox", QStringList() << "--list", false);
-        if (result.isEmpty()) {
-            m__isUsingBusybox = QStringList();
-        } else {
-            // split result to lines
-            m__isUsingBusybox = result.split(QRegExp("[\n\r]"));
-        }
+        return summary + ", " + tr("%1:%2 hours left").arg(m_eta / 3600)
+                .arg((m_eta % 3600) / 60, 2, 10, QChar('0'));
     }
+}
 
-    m__checkedBusybox = true;
-    return isUsingBusybox(forCommand);
+QString Engine::createHexDump(char *buffer, int size, int bytesPerLine)
+{
+    QStringList rows;
+    for (int offset = 0; offset < size; offset += bytesPerLine) {
+        rows.append(HexViewModel::formatRow(buffer + offset, qMin(bytesPerLine, size - offset),
+                                            bytesPerLine, offset, 4));
+    }
+    return rows.join('\n');
+}
+
+QStringList Engine::makeStringList(QString msg, QString str)
+{
+    QStringList list;
+    list << msg << str << str;
+    return list;
 }
@@ -22,11 +22,20 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
+#include <functional>
 #include <QDir>
 #include <QVariant>
-
-class FileWorker;
+#include <QHash>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QQueue>
+
+class FileJobQueue;
 class Settings;
+struct EngineHandle;
 
 /**
  * @brief Engine to handle file operations, settings and other generic functionality.
@@ -38,6 +47,12 @@ class Engine : public QObject
     Q_PROPERTY(int clipboardContainsCopy READ clipboardContainsCopy() NOTIFY clipboardContainsCopyChanged())
     Q_PROPERTY(int progress READ progress() NOTIFY progressChanged())
     Q_PROPERTY(QString progressFilename READ progressFilename() NOTIFY progressFilenameChanged())
+    Q_PROPERTY(qint64 bytesDone READ bytesDone() NOTIFY transferProgressChanged())
+    Q_PROPERTY(qint64 bytesTotal READ bytesTotal() NOTIFY transferProgressChanged())
+    Q_PROPERTY(double throughput READ throughput() NOTIFY transferProgressChanged())
+    Q_PROPERTY(int eta READ eta() NOTIFY transferProgressChanged())
+    Q_PROPERTY(QString transferSummary READ transferSummary() NOTIFY transferProgressChanged())
+    Q_PROPERTY(QObject* jobs READ jobs() CONSTANT)
 
 public:
     explicit Engine(QObject *parent = nullptr);
@@ -48,6 +63,12 @@ public:
     bool clipboardContainsCopy() const { return m_clipboardContainsCopy; }
     int progress() const { return m_progress; }
     QString progressFilename() const { return m_progressFilename; }
+    qint64 bytesDone() const { return m_bytesDone; }
+    qint64 bytesTotal() const { return m_bytesTotal; }
+    double throughput() const { return m_throughput; } // bytes per second
+    int eta() const { return m_eta; } // seconds, -1 if unknown
+    QString transferSummary() const;
+    QObject* jobs() const; // all background file operations, as a list model
 
     // methods accessible from QML
 
@@ -60,9 +81,32 @@ public:
     Q_INVOKABLE QStringList listExistingFiles(QString destDirectory);
     Q_INVOKABLE void pasteFiles(QString destDirectory, bool asSymlinks = false);
 
-    // cancel asynch methods
+    // cancel asynch methods; only the operation started last is cancelled,
+    // others can be cancelled through the jobs model
     Q_INVOKABLE void cancel();
 
+    // calculates size info in the background, returns a request id;
+    // results are sent with fileSizeInfoProgress() and fileSizeInfoReady()
+    Q_INVOKABLE int requestFileSizeInfo(QStringList paths);
+    Q_INVOKABLE void cancelFileSizeInfo(int requestId);
+
+    // reads disk space info in the background; requests are batched
+    // and results are sent with diskSpaceReady()
+    Q_INVOKABLE void requestDiskSpace(QString path);
+
+    // asynchronous variants of the synchronous methods below; they return
+    // a request id and results are sent with ioRequestFinished()
+    Q_INVOKABLE int requestExists(QString filename);
+    Q_INVOKABLE int requestPathIsDirectory(QString path);
+    Q_INVOKABLE int requestPathIsFile(QString path);
+    Q_INVOKABLE int requestReadFile(QString filename);
+    Q_INVOKABLE int requestMkdir(QString path, QString name);
+    Q_INVOKABLE int requestRename(QString fullOldFilename, QString newName);
+    Q_INVOKABLE int requestChmod(QString path,
+                                 bool ownerRead, bool ownerWrite, bool ownerExecute,
+                                 bool groupRead, bool groupWrite, bool groupExecute,
+                                 bool othersRead, bool othersWrite, bool othersExecute);
+
     // returns error msg
     Q_INVOKABLE QString errorMessage() const { return m_errorMessage; }
 
@@ -71,11 +115,9 @@ public:
     Q_INVOKABLE QVariantList externalDrives() const;
     Q_INVOKABLE QString storageSettingsPath() /*cached*/; // returns empty without NO_HARBOUR_COMPLIANCE
 
-    // synchronous methods
+    // synchronous methods: they may block on slow file systems
     Q_INVOKABLE bool runningAsRoot();
     Q_INVOKABLE bool exists(QString filename);
-    Q_INVOKABLE QStringList fileSizeInfo(QStringList paths);
-    Q_INVOKABLE QStringList diskSpace(QString path);
     Q_INVOKABLE QStringList readFile(QString filename);
     Q_INVOKABLE QString mkdir(QString path, QString name);
     Q_INVOKABLE QStringList rename(QString fullOldFilename, QString newName);
@@ -92,33 +134,106 @@ signals:
     void clipboardContainsCopyChanged();
     void progressChanged();
     void progressFilenameChanged();
+    void transferProgressChanged();
     void workerDone();
     void workerErrorOccurred(QString message, QString filename);
     void fileDeleted(QString fullname);
 
+    // info: [apparent size, dirs count, files count, allocated size]
+    void fileSizeInfoProgress(int requestId, QStringList info);
+    void fileSizeInfoReady(int requestId, QStringList info);
+
+    // info is empty if there is no info for the path, otherwise it contains
+    // 'percentage' and 'summary' as strings, and 'total', 'used', 'free',
+    // 'available', 'inodesTotal', and 'inodesFree' as numbers
+    void diskSpaceReady(QString path, QVariantMap info);
+    void diskSpaceInvalidated();
+
+    // result is what the synchronous method returns; error is empty unless
+    // the request timed out, in which case result is invalid
+    void ioRequestFinished(int requestId, QVariant result, QString error);
+
+    // emitted when file systems are mounted or unmounted
+    void externalDrivesChanged();
+
 private slots:
-    void setProgress(int progress, QString filename);
+    void sampleProgress();
+    void handleJobDone(int jobId);
+    void handleJobFailed(int jobId, QString message, QString filename);
+    void handleJobEnded(int jobId);
+    void finishFileSizeInfo(int requestId, QStringList info);
+    void startDiskSpaceRequests();
+    void handleMountsChanged();
+    void startIoRequestTimer(int requestId);
+    void finishIoRequest(int requestId, QVariant result);
 
 private:
-    QMap<QString, QString> mountPoints() const;
-    QString createHexDump(char *buffer, int size, int bytesPerLine);
-    QStringList makeStringList(QString msg, QString str = QString());
-    bool isUsingBusybox(QString forCommand);
+    struct IoRequest {
+        int mountId = {-1};
+        bool timedOut = {false};
+        std::function<QVariant()> job; // only while queued
+    };
+
+    void setProgress(int progress, QString filename);
+    void setBytesProgress(qint64 bytesDone, qint64 bytesTotal);
+    void resetTransferProgress();
+    void startJob(int jobId);
+    int startIoRequest(QString path, std::function<QVariant()> job);
+    void runIoRequest(int requestId);
+    void runQueuedIoRequests(int mountId);
+    void rejectIoRequest(int requestId);
+    void expireIoRequest(int requestId);
+    static QString createHexDump(char *buffer, int size, int bytesPerLine);
+    static QStringList makeStringList(QString msg, QString str = QString());
+
+    // implementations of the synchronous methods; asynchronous requests
+    // run them in the background, where the engine may already be gone
+    static bool doExists(QString filename);
+    static QStringList doReadFile(QString filename);
+    static QString doMkdir(QString path, QString name);
+    static QStringList doRename(QString fullOldFilename, QString newName);
+    static QString doChmod(QString path,
+                           bool ownerRead, bool ownerWrite, bool ownerExecute,
+                           bool groupRead, bool groupWrite, bool groupExecute,
+                           bool othersRead, bool othersWrite, bool othersExecute);
+    static bool doPathIsDirectory(QString path);
+    static bool doPathIsFile(QString path);
 
     Settings* m_settings;
     QStringList m_clipboardFiles;
     bool m_clipboardContainsCopy;
     int m_progress;
     QString m_progressFilename;
+    QTimer m_progressTimer;
+    qint64 m_bytesDone = {0};
+    qint64 m_bytesTotal = {0};
+    qint64 m_bytesSparse = {0};
+    double m_throughput = {0};
+    int m_eta = {-1};
+    QElapsedTimer m_transferTimer;
+    qint64 m_sampleTime = {0};
+    qint64 m_sampleBytes = {0};
     QString m_errorMessage;
-    FileWorker* m_fileWorker;
+    FileJobQueue* m_jobs;
+    int m_currentJob = {0};
+
+    int m_lastSizeInfoRequest = {0};
+    QHash<int, QSharedPointer<QAtomicInt>> m_sizeInfoRequests; // cancel flags
+    QStringList m_diskSpaceRequests;
+    int m_lastIoRequest = {0};
+    QHash<int, IoRequest> m_ioRequests;
+    QHash<int, int> m_runningMounts; // mount id to count of running requests
+    QHash<int, QQueue<int>> m_queuedIoRequests; // by mount id
+    QHash<int, int> m_stalledMounts; // mount id to count of timed out requests
+
+    // Short requests have their own pool, so they never wait for
+    // size calculations. Both pools may be leaked at exit, see ~Engine().
+    QSharedPointer<EngineHandle> m_handle;
+    QThreadPool* m_walkPool;
+    QThreadPool* m_requestPool;
 
     // cached paths that we assume won't change during runtime
     QString m_storageSettingsPath = {QStringLiteral("")};
-
-    // don't use these directly, use isUsingBusybox() instead
-    QStringList m__isUsingBusybox;
-    bool m__checkedBusybox;
 };
 
 #endif // ENGINE_H
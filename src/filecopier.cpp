@@ -0,0 +1,423 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#include <linux/falloc.h>
+#include <QCoreApplication>
+#include <QFile>
+#include "filecopier.h"
+#include "transferjournal.h"
+
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+// Number of bytes copied by the kernel between checks for cancellation.
+#ifndef FILECOPIER_CHUNK_SIZE
+#define FILECOPIER_CHUNK_SIZE (8*1024*1024)
+#endif
+
+// Size of the buffer used when the kernel cannot copy.
+#ifndef FILECOPIER_BUFFER_SIZE
+#define FILECOPIER_BUFFER_SIZE (1024*1024)
+#endif
+
+// Files of at least this size get their space reserved before copying.
+#ifndef FILECOPIER_RESERVE_SIZE
+#define FILECOPIER_RESERVE_SIZE (1024*1024)
+#endif
+
+namespace {
+    bool isUnsupported(int error)
+    {
+        // errors meaning that a method does not work for these files,
+        // so that the next method should be tried
+        return error == ENOSYS || error == EXDEV || error == EINVAL ||
+               error == EOPNOTSUPP || error == ENOTTY || error == EBADF;
+    }
+}
+
+FileCopier::FileCopier() {}
+
+FileCopier::~FileCopier()
+{
+    delete[] m_buffer;
+}
+
+bool FileCopier::copy(const QString &source, const QString &dest)
+{
+    m_errorString.clear();
+    m_cancelled = false;
+    m_method = None;
+
+    QByteArray destPath = QFile::encodeName(dest);
+    m_dest = destPath;
+    m_position = 0;
+
+    int in = ::open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return fail(errno);
+
+    struct stat st;
+    if (::fstat(in, &st) != 0) {
+        int error = errno;
+        ::close(in);
+        return fail(error);
+    } else if (!S_ISREG(st.st_mode)) {
+        ::close(in);
+        return fail(QCoreApplication::translate("FileCopier", "Cannot copy this type of file"));
+    }
+
+    // continue an interrupted copy
+    qint64 offset = 0;
+    if (m_journal) {
+        if (m_journal->isComplete(destPath, st)) {
+            ::close(in);
+            reportProgress(qint64(st.st_size));
+            return true;
+        }
+        offset = m_journal->resumeOffset(destPath, st);
+    }
+
+    // Replace existing files instead of writing into them, so that links
+    // to them are not followed and other hard links keep their contents.
+    // Interrupted copies are continued in place, they are our own files.
+    struct stat existing;
+    if (offset == 0 && ::lstat(destPath.constData(), &existing) == 0) {
+        int error = S_ISDIR(existing.st_mode) ? EISDIR :
+                    (::unlink(destPath.constData()) != 0 ? errno : 0);
+        if (error != 0) {
+            ::close(in);
+            return fail(error);
+        }
+    }
+
+    int out = ::open(destPath.constData(),
+                     O_WRONLY | O_CREAT | O_NOFOLLOW | (offset > 0 ? 0 : O_EXCL) | O_CLOEXEC,
+                     st.st_mode & 0777);
+    if (out < 0) {
+        int error = errno;
+        ::close(in);
+        return fail(error);
+    }
+
+    if (m_journal) m_journal->fileStarted(destPath, st);
+
+    bool ok = true;
+    if (offset > 0 && (::ftruncate(out, offset) != 0 || ::lseek(out, offset, SEEK_SET) != offset ||
+                       ::lseek(in, offset, SEEK_SET) != offset)) {
+        ok = fail(errno);
+    } else if (offset > 0) {
+        reportProgress(offset);
+    }
+
+    ok = ok && copyData(in, out, qint64(st.st_size) - offset, st);
+
+    // the mode may have been limited by the umask; setuid, setgid,
+    // and sticky bits are not copied
+    if (ok && ::fchmod(out, st.st_mode & 0777) != 0) ok = fail(errno);
+
+    if (ok && m_verify) ok = syncAndVerify(in, out, st);
+    ::close(in);
+
+    // closing reports delayed write errors on some file systems
+    if (::close(out) != 0 && ok) ok = fail(errno);
+
+    if (ok) {
+        if (m_journal) m_journal->fileFinished(destPath);
+    } else if (!m_journal || !m_cancelled) {
+        if (m_journal) m_journal->fileFailed(destPath);
+        ::unlink(destPath.constData());
+    }
+
+    return ok;
+}
+
+bool FileCopier::copyData(int in, int out, qint64 size, const struct stat& source)
+{
+    qint64 done = 0;
+
+    if (size == 0) {
+        // virtual files may report no size but still have contents
+        return copyByReadWrite(in, out, size, &done) == Done;
+    }
+
+    Status status = copyByCloning(in, out);
+    if (status == Done) {
+        m_method = Clone;
+        reportProgress(size);
+        return true;
+    } else if (status == Failed) {
+        return false;
+    }
+
+    // Files with fewer blocks than their size have holes. Compressing file
+    // systems report fewer blocks as well, then the whole file is data.
+    qint64 allocated = qint64(source.st_blocks) * 512;
+    if (allocated < qint64(source.st_size)) {
+        status = copySparse(in, out, size, &done);
+        if (status != Unsupported) return status == Done;
+    }
+
+    // errors are ignored, reserving is only an optimization
+    qint64 position = qint64(source.st_size) - size;
+    if (size >= FILECOPIER_RESERVE_SIZE || allocated > qint64(source.st_size) + qint64(source.st_blksize)) {
+        ::fallocate(out, FALLOC_FL_KEEP_SIZE, position, qMax(allocated, qint64(source.st_size)) - position);
+    }
+
+    return copySegment(in, out, size, &done) == Done;
+}
+
+FileCopier::Status FileCopier::copySparse(int in, int out, qint64 size, qint64* done)
+{
+    off_t start = ::lseek(in, 0, SEEK_CUR);
+    off_t end = start + size;
+    off_t position = start;
+
+    while (position < end) {
+        if (checkCancelled()) return Failed;
+
+        off_t data = ::lseek(in, position, SEEK_DATA);
+        if (data < 0) {
+            if (errno == ENXIO) {
+                data = end; // only a hole is left
+            } else if (position == start && isUnsupported(errno)) {
+                return Unsupported;
+            } else {
+                fail(errno);
+                return Failed;
+            }
+        }
+        data = qMin(data, end);
+
+        if (data > position) {
+            // extending the file leaves a hole
+            if (::ftruncate(out, data) != 0) {
+                fail(errno);
+                return Failed;
+            }
+            *done += data - position;
+            reportProgress(data - position);
+            if (m_sparse) m_sparse(data - position);
+            position = data;
+            if (position >= end) break;
+        }
+
+        off_t hole = ::lseek(in, position, SEEK_HOLE);
+        if (hole < 0) {
+            fail(errno);
+            return Failed;
+        }
+        hole = qMin(hole, end);
+
+        if (::lseek(in, position, SEEK_SET) != position || ::lseek(out, position, SEEK_SET) != position) {
+            fail(errno);
+            return Failed;
+        }
+
+        qint64 copied = 0;
+        ::fallocate(out, 0, position, hole - position); // keep the data together, if supported
+        if (copySegment(in, out, hole - position, &copied) != Done) return Failed;
+        *done += copied;
+        if (copied < hole - position) break; // the file has been truncated while copying
+        position = hole;
+    }
+
+    return Done;
+}
+
+FileCopier::Status FileCopier::copySegment(int in, int out, qint64 size, qint64* done)
+{
+    Status status = copyByCopyFileRange(in, out, size, done);
+    if (status == Unsupported) status = copyBySendFile(in, out, size, done);
+    if (status == Unsupported) status = copyByReadWrite(in, out, size, done);
+    return status;
+}
+
+bool FileCopier::syncAndVerify(int in, int out, const struct stat& before)
+{
+    if (::fsync(out) != 0) return fail(errno);
+
+    struct stat source, copy;
+    if (::fstat(in, &source) != 0 || ::fstat(out, &copy) != 0) return fail(errno);
+
+    if (source.st_size != before.st_size || source.st_mtim.tv_sec != before.st_mtim.tv_sec ||
+            source.st_mtim.tv_nsec != before.st_mtim.tv_nsec) {
+        return fail(QCoreApplication::translate("FileCopier", "The file was changed while copying"));
+    } else if (copy.st_size != source.st_size) {
+        return fail(QCoreApplication::translate("FileCopier", "The copy is incomplete"));
+    }
+
+    return true;
+}
+
+FileCopier::Status FileCopier::copyByCloning(int in, int out)
+{
+    if (::ioctl(out, FICLONE, in) == 0) return Done;
+
+    // EPERM: the file system refuses to share data with these files,
+    // e.g. swap files; copying the data may still work. Other errors,
+    // e.g. EACCES or EIO, fail the copy.
+    int error = errno;
+    if (isUnsupported(error) || error == EPERM) return Unsupported;
+    fail(error);
+    return Failed;
+}
+
+FileCopier::Status FileCopier::copyByCopyFileRange(int in, int out, qint64 size, qint64* done)
+{
+#ifdef SYS_copy_file_range
+    m_method = CopyFileRange;
+
+    while (*done < size) {
+        if (checkCancelled()) return Failed;
+
+        size_t chunk = size_t(qMin(size - *done, qint64(FILECOPIER_CHUNK_SIZE)));
+        ssize_t count = ::syscall(SYS_copy_file_range, in, nullptr, out, nullptr, chunk, 0u);
+
+        if (count < 0) {
+            int error = errno;
+            if (error == EINTR) continue;
+            if (*done == 0 && isUnsupported(error)) return Unsupported;
+            fail(error);
+            return Failed;
+        } else if (count == 0) {
+            // some virtual file systems report no data instead of an error
+            if (*done == 0) return Unsupported;
+            break; // the file has been truncated while copying
+        }
+
+        *done += count;
+        reportProgress(count);
+    }
+
+    return Done;
+#else
+    Q_UNUSED(in) Q_UNUSED(out) Q_UNUSED(size) Q_UNUSED(done)
+    return Unsupported;
+#endif
+}
+
+FileCopier::Status FileCopier::copyBySendFile(int in, int out, qint64 size, qint64* done)
+{
+    m_method = SendFile;
+
+    while (*done < size) {
+        if (checkCancelled()) return Failed;
+
+        size_t chunk = size_t(qMin(size - *done, qint64(FILECOPIER_CHUNK_SIZE)));
+        ssize_t count = ::sendfile(out, in, nullptr, chunk);
+
+        if (count < 0) {
+            int error = errno;
+            if (error == EINTR) continue;
+            if (*done == 0 && isUnsupported(error)) return Unsupported;
+            fail(error);
+            return Failed;
+        } else if (count == 0) {
+            if (*done == 0) return Unsupported;
+            break;
+        }
+
+        *done += count;
+        reportProgress(count);
+    }
+
+    return Done;
+}
+
+FileCopier::Status FileCopier::copyByReadWrite(int in, int out, qint64 size, qint64* done)
+{
+    m_method = ReadWrite;
+    if (!m_buffer) m_buffer = new char[FILECOPIER_BUFFER_SIZE];
+
+    ::posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // without a known size, everything up to the end of the file is copied
+    while (size == 0 || *done < size) {
+        if (checkCancelled()) return Failed;
+
+        size_t chunk = size == 0 ? size_t(FILECOPIER_BUFFER_SIZE) :
+                                   size_t(qMin(size - *done, qint64(FILECOPIER_BUFFER_SIZE)));
+        ssize_t count = ::read(in, m_buffer, chunk);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            fail(errno);
+            return Failed;
+        } else if (count == 0) {
+            break; // end of file
+        }
+
+        for (ssize_t written = 0; written < count;) {
+            ssize_t result = ::write(out, m_buffer + written, size_t(count - written));
+            if (result < 0) {
+                if (errno == EINTR) continue;
+                fail(errno);
+                return Failed;
+            }
+            written += result;
+        }
+
+        *done += count;
+        reportProgress(count);
+    }
+
+    // the source is not needed anymore, keep more useful data cached
+    ::posix_fadvise(in, 0, 0, POSIX_FADV_DONTNEED);
+    return Done;
+}
+
+bool FileCopier::checkCancelled()
+{
+    if (m_isCancelled && m_isCancelled()) {
+        m_cancelled = true;
+        m_errorString = QCoreApplication::translate("FileCopier", "Cancelled");
+    }
+
+    return m_cancelled;
+}
+
+void FileCopier::reportProgress(qint64 bytes)
+{
+    if (m_journal) {
+        m_position += bytes;
+        m_journal->fileProgressed(m_dest, m_position);
+    }
+
+    if (m_progress) m_progress(bytes);
+}
+
+bool FileCopier::fail(const QString& message)
+{
+    m_errorString = message;
+    return false;
+}
+
+bool FileCopier::fail(int error)
+{
+    return fail(QString::fromLocal8Bit(strerror(error)));
+}
@@ -0,0 +1,120 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILECOPIER_H
+#define FILECOPIER_H
+
+#include <functional>
+#include <QString>
+#include <QByteArray>
+
+struct stat;
+class TransferJournal;
+
+/**
+ * @brief The FileCopier class copies the contents of regular files.
+ *
+ * The fastest method supported by the file systems involved is used:
+ * - cloning the file (reflink) shares all data blocks on btrfs and xfs,
+ * - copy_file_range() copies inside the kernel, possibly on the server for
+ *   network file systems,
+ * - sendfile() copies inside the kernel between any two files,
+ * - a read/write loop with large buffers works everywhere.
+ *
+ * Sparse files, like disk images, keep their holes: only the data found
+ * with SEEK_DATA and SEEK_HOLE is copied. Space of large files, and space
+ * preallocated beyond the end of a file, is reserved up front if the file
+ * system supports it.
+ *
+ * Permissions are copied, ownership and times are not.
+ *
+ * With a journal, progress is recorded so that an interrupted copy can be
+ * resumed: complete copies are skipped and partial copies are continued.
+ */
+class FileCopier
+{
+public:
+    enum Method {
+        None, Clone, CopyFileRange, SendFile, ReadWrite
+    };
+
+    FileCopier();
+    ~FileCopier();
+
+    // Called regularly while copying. Copying stops if it returns true.
+    void setCancelCheck(std::function<bool()> isCancelled) { m_isCancelled = isCancelled; }
+
+    // Called with the number of bytes copied since the last call.
+    void setProgressCallback(std::function<void(qint64 bytes)> progress) { m_progress = progress; }
+
+    // Called with the size of holes that were kept instead of written.
+    // Holes are reported as progress as well.
+    void setSparseCallback(std::function<void(qint64 bytes)> sparse) { m_sparse = sparse; }
+
+    // When enabled, copies are flushed to the storage before copy()
+    // succeeds, and copy() fails if the source changed size or modification
+    // time while copying, or if the copy has a different size. Contents are
+    // not compared. Use this if the source is removed afterwards.
+    void setVerifyEnabled(bool enabled) { m_verify = enabled; }
+
+    // Records progress in the journal and resumes from it. The journal must
+    // outlive all copies. Partial copies are kept when cancelled.
+    void setJournal(TransferJournal* journal) { m_journal = journal; }
+
+    // Copies source to dest, replacing dest if it exists. The partially
+    // written dest is removed if copying fails or is cancelled.
+    bool copy(const QString& source, const QString& dest);
+
+    QString errorString() const { return m_errorString; }
+    bool wasCancelled() const { return m_cancelled; }
+    Method lastMethod() const { return m_method; }
+
+private:
+    enum Status {
+        Done, Unsupported, Failed
+    };
+
+    bool copyData(int in, int out, qint64 size, const struct stat& source);
+    Status copySparse(int in, int out, qint64 size, qint64* done);
+    Status copySegment(int in, int out, qint64 size, qint64* done);
+    bool syncAndVerify(int in, int out, const struct stat& before);
+    Status copyByCloning(int in, int out);
+    Status copyByCopyFileRange(int in, int out, qint64 size, qint64* done);
+    Status copyBySendFile(int in, int out, qint64 size, qint64* done);
+    Status copyByReadWrite(int in, int out, qint64 size, qint64* done);
+    bool checkCancelled();
+    void reportProgress(qint64 bytes);
+    bool fail(const QString& message);
+    bool fail(int error);
+
+    std::function<bool()> m_isCancelled;
+    std::function<void(qint64)> m_progress;
+    std::function<void(qint64)> m_sparse;
+    QString m_errorString;
+    bool m_cancelled = {false};
+    bool m_verify = {false};
+    TransferJournal* m_journal = {nullptr};
+    QByteArray m_dest; // of the current copy
+    qint64 m_position = {0}; // in the current copy
+    Method m_method = {None};
+    char* m_buffer = {nullptr};
+};
+
+#endif // FILECOPIER_H
@@ -26,6 +26,8 @@
 #include <QImageReader>
 #include <QSettings>
 #include "globals.h"
+#include "filedataworker.h"
+#include "imageprobe.h"
 #include "jhead/jhead-api.h"
 
 FileData::FileData(QObject *parent) :
@@ -36,6 +38,10 @@ FileData::FileData(QObject *parent) :
 
 FileData::~FileData()
 {
+    if (m_worker) {
+        m_worker->cancel();
+        m_worker->wait();
+    }
 }
 
 void FileData::setFile(QString file)
@@ -44,9 +50,30 @@ void FileData::setFile(QString file)
         return;
 
     m_file = file;
+    emit fileChanged();
     readInfo();
 }
 
+void FileData::setAsynchronous(bool asynchronous)
+{
+    if (m_asynchronous == asynchronous)
+        return;
+
+    m_asynchronous = asynchronous;
+    emit asynchronousChanged();
+}
+
+void FileData::classBegin()
+{
+    m_componentComplete = false;
+}
+
+void FileData::componentComplete()
+{
+    m_componentComplete = true;
+    if (!m_file.isEmpty()) readInfo();
+}
+
 QString FileData::icon() const
 {
     return infoToIconName(m_fileInfo);
@@ -174,115 +201,180 @@ QString FileData::typeCategory() const
 
 void FileData::readInfo()
 {
-    m_errorMessage = "";
-    m_metaData.clear();
+    if (!m_componentComplete) return; // loaded in componentComplete()
+
+    // results of older requests are dropped when they arrive
+    int generation = ++m_generation;
+    setReady(false);
+
+    if (m_asynchronous) {
+        if (!m_worker) {
+            m_worker = new FileDataWorker(this);
+            connect(m_worker, &FileDataWorker::infoReady, this, &FileData::setInfo);
+            connect(m_worker, &FileDataWorker::mimeTypeReady, this, &FileData::setMimeType);
+            connect(m_worker, &FileDataWorker::metaDataReady, this, &FileData::setMetaData);
+        }
 
-    m_fileInfo.setFile(m_file);
+        m_worker->startLoad(m_file, generation);
+        return;
+    }
 
-    // exists() checks for target existence in symlinks, so ignore it for symlinks
-    if (!m_fileInfo.exists() && !m_fileInfo.isSymLink())
-        m_errorMessage = tr("File does not exist");
+    QString errorMessage;
+    StatFileInfo info = readFileInfo(m_file, &errorMessage);
+    setInfo(generation, info, errorMessage);
 
-    readMetaData();
+    QString mimeTypeComment;
+    QString mimeType = readMimeType(info, &mimeTypeComment);
+    setMimeType(generation, mimeType, mimeTypeComment);
+    setMetaData(generation, readMetaData(info, mimeType));
+}
 
-    emit fileChanged();
-    emit isDirChanged();
-    emit isSymLinkChanged();
-    emit kindChanged();
-    emit iconChanged();
-    emit permissionsChanged();
-    emit ownerChanged();
-    emit groupChanged();
-    emit sizeChanged();
-    emit modifiedChanged();
-    emit createdChanged();
-    emit absolutePathChanged();
-    emit nameChanged();
-    emit suffixChanged();
-    emit symLinkTargetChanged();
-    emit isSymLinkBrokenChanged();
-    emit metaDataChanged();
+void FileData::setReady(bool ready)
+{
+    if (m_ready == ready)
+        return;
+
+    m_ready = ready;
+    emit readyChanged();
+}
+
+void FileData::setInfo(int generation, StatFileInfo info, QString errorMessage)
+{
+    if (generation != m_generation) return; // outdated
+
+    m_fileInfo = info;
+    m_errorMessage = errorMessage;
+    emit infoChanged();
+}
+
+void FileData::setMimeType(int generation, QString mimeType, QString mimeTypeComment)
+{
+    if (generation != m_generation) return; // outdated
+
+    QMimeDatabase db;
+    m_mimeType = db.mimeTypeForName(mimeType);
+    m_mimeTypeName = mimeType;
+    m_mimeTypeComment = mimeTypeComment;
     emit mimeTypeChanged();
-    emit mimeTypeCommentChanged();
-    emit errorMessageChanged();
 }
 
-void FileData::readMetaData()
+void FileData::setMetaData(int generation, QStringList metaData)
+{
+    if (generation != m_generation) return; // outdated
+
+    m_metaData = metaData;
+    emit metaDataChanged();
+    setReady(true);
+}
+
+StatFileInfo FileData::readFileInfo(const QString& file, QString* errorMessage)
+{
+    StatFileInfo info(file);
+
+    // exists() checks for target existence in symlinks, so ignore it for symlinks
+    if (!info.exists() && !info.isSymLink())
+        *errorMessage = tr("File does not exist");
+    else
+        *errorMessage = "";
+
+    return info;
+}
+
+QString FileData::readMimeType(const StatFileInfo& info, QString* mimeTypeComment)
 {
     // special file types
     // do not sniff mimetype or metadata for these, because these can't really be read
 
-    m_mimeType = QMimeType();
-    if (m_fileInfo.isBlkAtEnd()) {
-        m_mimeTypeName = "inode/blockdevice";
-        m_mimeTypeComment = tr("block device");
-        return;
-    } else if (m_fileInfo.isChrAtEnd()) {
-        m_mimeTypeName = "inode/chardevice";
-        m_mimeTypeComment = tr("character device");
-        return;
-    } else if (m_fileInfo.isFifoAtEnd()) {
-        m_mimeTypeName = "inode/fifo";
-        m_mimeTypeComment = tr("pipe");
-        return;
-    } else if (m_fileInfo.isSocketAtEnd()) {
-        m_mimeTypeName = "inode/socket";
-        m_mimeTypeComment = tr("socket");
-        return;
-    } else if (m_fileInfo.isDirAtEnd()) {
-        m_mimeTypeName = "inode/directory";
-        m_mimeTypeComment = tr("folder");
-        return;
+    if (info.isBlkAtEnd()) {
+        *mimeTypeComment = tr("block device");
+        return "inode/blockdevice";
+    } else if (info.isChrAtEnd()) {
+        *mimeTypeComment = tr("character device");
+        return "inode/chardevice";
+    } else if (info.isFifoAtEnd()) {
+        *mimeTypeComment = tr("pipe");
+        return "inode/fifo";
+    } else if (info.isSocketAtEnd()) {
+        *mimeTypeComment = tr("socket");
+        return "inode/socket";
+    } else if (info.isDirAtEnd()) {
+        *mimeTypeComment = tr("folder");
+        return "inode/directory";
     }
 
-    if (!m_fileInfo.exists()) { // catch e.g. broken links
-        m_mimeTypeName = "application/octet-stream";
-        m_mimeTypeComment = tr("unknown");
-        return;
+    if (!info.exists()) { // catch e.g. broken links
+        *mimeTypeComment = tr("unknown");
+        return "application/octet-stream";
     }
 
     // normal files - match content to find mimetype, which means that the file is read
 
     QMimeDatabase db;
-    QString filename = m_fileInfo.isSymLink() ? m_fileInfo.symLinkTarget() :
-                                                m_fileInfo.absoluteFilePath();
-    m_mimeType = db.mimeTypeForFile(filename);
-    m_mimeTypeName = m_mimeType.name();
-    m_mimeTypeComment = m_mimeType.comment();
+    QString filename = info.isSymLink() ? info.symLinkTarget() :
+                                          info.absoluteFilePath();
+    QMimeType mimeType = db.mimeTypeForFile(filename);
+    *mimeTypeComment = mimeType.comment();
+    return mimeType.name();
+}
+
+QStringList FileData::readMetaData(const StatFileInfo& info, const QString& mimeType)
+{
+    QStringList metaData;
+    QString filename = info.isSymLink() ? info.symLinkTarget() :
+                                          info.absoluteFilePath();
 
     // read metadata for images
-    // store in m_metaData, first char is priority, then label:value
-    if (m_mimeType.name() == "image/jpeg" || m_mimeType.name() == "image/png" ||
-            m_mimeType.name() == "image/gif") {
+    // store in metaData, first char is priority, then label:value
+    if (mimeType == "image/jpeg" || mimeType == "image/png" ||
+            mimeType == "image/gif" || mimeType == "image/webp") {
+
+        // read size from the image header, without loading the image
+        ImageProbe::Info image = ImageProbe::probe(filename);
+        QSize s(image.width, image.height);
+
+        if (!image.isValid()) {
+            // fall back to Qt for unusual files the probe does not understand
+            s = QImageReader(filename).size();
+        }
 
-        // read size
-        QImageReader reader(m_file);
-        QSize s = reader.size();
         if (s.width() >= 0 && s.height() >= 0) {
             QString ar = calculateAspectRatio(s.width(), s.height());
-            m_metaData.append("0" + tr("Image Size") +
-                              QString(":%1 x %2 %3").arg(s.width()).arg(s.height()).arg(ar));
+            metaData.append("0" + tr("Image Size") +
+                             QString(":%1 x %2 %3").arg(s.width()).arg(s.height()).arg(ar));
+        }
+
+        if (image.animated) {
+            metaData.append("0" + tr("Animated") + ":" + tr("yes"));
         }
 
         // read exif data
-        QStringList exif = readExifData(filename);
-        foreach (QString e, exif) {
-            m_metaData.append("8"+e);
+        if (mimeType == "image/jpeg") {
+            QStringList exif = readExifData(filename);
+            foreach (QString e, exif) {
+                metaData.append("8"+e);
+            }
         }
 
-        // read comments
-        QStringList textKeys = reader.textKeys();
-        foreach (QString key, textKeys) {
-            QString value = reader.text(key);
-            m_metaData.append("9"+key+":"+value);
+        // read comments; only PNG and JPEG files store them at a place
+        // Qt can reach without scanning the whole file (JPEG comments are
+        // read with the headers, before the compressed image data)
+        if (mimeType == "image/png" || mimeType == "image/jpeg") {
+            QImageReader reader(filename);
+            QStringList textKeys = reader.textKeys();
+            foreach (QString key, textKeys) {
+                QString value = reader.text(key);
+                metaData.append("9"+key+":"+value);
+            }
         }
     }
+
+    return metaData;
 }
 
 const int aspectWidths[] = { 16, 4, 3, 5, 5,  -1 };
 const int aspectHeights[] = { 9, 3, 2, 3, 4,  -1 };
 
-QString FileData::calculateAspectRatio(int width, int height) const
+QString FileData::calculateAspectRatio(int width, int height)
 {
     // Jolla Camera almost 16:9 aspect ratio
     if ((width == 3264 && height == 1840) || (height == 1840 && width == 3264)) {
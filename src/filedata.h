@@ -27,37 +27,48 @@
 #include <QVariantList>
 #include <QMimeType>
 #include <QSize>
+#include <QQmlParserStatus>
 #include "statfileinfo.h"
 
+class FileDataWorker;
+
 /**
  * @brief The FileData class provides info about one file.
+ *
+ * Info is loaded in three stages: basic file info, mime type, and metadata.
+ * Each stage is announced with a single change signal. When 'asynchronous'
+ * is set, stages are loaded in a background thread and results for
+ * outdated files are dropped.
  */
-class FileData : public QObject
+class FileData : public QObject, public QQmlParserStatus
 {
     Q_OBJECT
+    Q_INTERFACES(QQmlParserStatus)
     Q_PROPERTY(QString file READ file() WRITE setFile(QString) NOTIFY fileChanged())
-    Q_PROPERTY(bool isDir READ isDir() NOTIFY isDirChanged())
-    Q_PROPERTY(bool isSymLink READ isSymLink() NOTIFY isSymLinkChanged())
-    Q_PROPERTY(QString kind READ kind() NOTIFY kindChanged())
-    Q_PROPERTY(QString icon READ icon() NOTIFY iconChanged())
-    Q_PROPERTY(QString permissions READ permissions() NOTIFY permissionsChanged())
-    Q_PROPERTY(QString owner READ owner() NOTIFY ownerChanged())
-    Q_PROPERTY(QString group READ group() NOTIFY groupChanged())
-    Q_PROPERTY(QString size READ size() NOTIFY sizeChanged())
-    Q_PROPERTY(QString modified READ modified() NOTIFY modifiedChanged())
-    Q_PROPERTY(QString modifiedLong READ modifiedLong() NOTIFY modifiedChanged())
-    Q_PROPERTY(QString created READ created() NOTIFY createdChanged())
-    Q_PROPERTY(QString absolutePath READ absolutePath() NOTIFY absolutePathChanged())
-    Q_PROPERTY(QString name READ name() NOTIFY nameChanged())
-    Q_PROPERTY(QString suffix READ suffix() NOTIFY suffixChanged())
-    Q_PROPERTY(QString symLinkTarget READ symLinkTarget() NOTIFY symLinkTargetChanged())
-    Q_PROPERTY(bool isSymLinkBroken READ isSymLinkBroken() NOTIFY isSymLinkBrokenChanged())
+    Q_PROPERTY(bool isDir READ isDir() NOTIFY infoChanged())
+    Q_PROPERTY(bool isSymLink READ isSymLink() NOTIFY infoChanged())
+    Q_PROPERTY(QString kind READ kind() NOTIFY infoChanged())
+    Q_PROPERTY(QString icon READ icon() NOTIFY infoChanged())
+    Q_PROPERTY(QString permissions READ permissions() NOTIFY infoChanged())
+    Q_PROPERTY(QString owner READ owner() NOTIFY infoChanged())
+    Q_PROPERTY(QString group READ group() NOTIFY infoChanged())
+    Q_PROPERTY(QString size READ size() NOTIFY infoChanged())
+    Q_PROPERTY(QString modified READ modified() NOTIFY infoChanged())
+    Q_PROPERTY(QString modifiedLong READ modifiedLong() NOTIFY infoChanged())
+    Q_PROPERTY(QString created READ created() NOTIFY infoChanged())
+    Q_PROPERTY(QString absolutePath READ absolutePath() NOTIFY infoChanged())
+    Q_PROPERTY(QString name READ name() NOTIFY infoChanged())
+    Q_PROPERTY(QString suffix READ suffix() NOTIFY infoChanged())
+    Q_PROPERTY(QString symLinkTarget READ symLinkTarget() NOTIFY infoChanged())
+    Q_PROPERTY(bool isSymLinkBroken READ isSymLinkBroken() NOTIFY infoChanged())
     Q_PROPERTY(QString mimeType READ mimeType() NOTIFY mimeTypeChanged())
-    Q_PROPERTY(QString mimeTypeComment READ mimeTypeComment() NOTIFY mimeTypeCommentChanged())
+    Q_PROPERTY(QString mimeTypeComment READ mimeTypeComment() NOTIFY mimeTypeChanged())
     Q_PROPERTY(QStringList metaData READ metaData() NOTIFY metaDataChanged())
     Q_PROPERTY(int dirsCount READ dirsCount NOTIFY dirsCountChanged)
     Q_PROPERTY(int filesCount READ filesCount NOTIFY filesCountChanged)
-    Q_PROPERTY(QString errorMessage READ errorMessage() NOTIFY errorMessageChanged())
+    Q_PROPERTY(QString errorMessage READ errorMessage() NOTIFY infoChanged())
+    Q_PROPERTY(bool asynchronous READ asynchronous() WRITE setAsynchronous(bool) NOTIFY asynchronousChanged())
+    Q_PROPERTY(bool ready READ ready() NOTIFY readyChanged())
 
 public:
     explicit FileData(QObject *parent = nullptr);
@@ -90,6 +101,13 @@ public:
     int dirsCount() const; // warning: expensive
     int filesCount() const; // warning: expensive
     QString errorMessage() const { return m_errorMessage; }
+    bool asynchronous() const { return m_asynchronous; }
+    void setAsynchronous(bool asynchronous);
+    bool ready() const { return m_ready; }
+
+    // QQmlParserStatus: delay loading until all properties are set
+    void classBegin() override;
+    void componentComplete() override;
 
     // methods accessible from QML
     Q_INVOKABLE void refresh();
@@ -99,33 +117,31 @@ public:
 
 signals:
     void fileChanged();
-    void isDirChanged();
-    void isSymLinkChanged();
-    void kindChanged();
-    void iconChanged();
-    void permissionsChanged();
-    void ownerChanged();
-    void groupChanged();
-    void sizeChanged();
-    void modifiedChanged();
-    void createdChanged();
-    void nameChanged();
-    void suffixChanged();
-    void absolutePathChanged();
-    void symLinkTargetChanged();
-    void isSymLinkBrokenChanged();
-    void metaDataChanged();
+    void infoChanged();
     void mimeTypeChanged();
-    void mimeTypeCommentChanged();
+    void metaDataChanged();
     void dirsCountChanged();
     void filesCountChanged();
-    void errorMessageChanged();
+    void asynchronousChanged();
+    void readyChanged();
+
+private slots:
+    void setInfo(int generation, StatFileInfo info, QString errorMessage);
+    void setMimeType(int generation, QString mimeType, QString mimeTypeComment);
+    void setMetaData(int generation, QStringList metaData);
 
 private:
+    friend class FileDataWorker;
+
     void readInfo();
-    void readMetaData();
-    QString calculateAspectRatio(int width, int height) const;
-    QStringList readExifData(QString filename);
+    void setReady(bool ready);
+
+    // loading stages; these are thread-safe
+    static StatFileInfo readFileInfo(const QString& file, QString* errorMessage);
+    static QString readMimeType(const StatFileInfo& info, QString* mimeTypeComment);
+    static QStringList readMetaData(const StatFileInfo& info, const QString& mimeType);
+    static QString calculateAspectRatio(int width, int height);
+    static QStringList readExifData(QString filename);
 
     QString m_file;
     StatFileInfo m_fileInfo;
@@ -134,6 +150,11 @@ private:
     QString m_mimeTypeComment;
     QStringList m_metaData;
     QString m_errorMessage;
+    bool m_asynchronous = {false};
+    bool m_ready = {false};
+    bool m_componentComplete = {true};
+    int m_generation = {0};
+    FileDataWorker* m_worker = {nullptr};
 };
 
 #endif // FILEDATA_H
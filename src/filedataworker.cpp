@@ -0,0 +1,93 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "filedataworker.h"
+#include "filedata.h"
+
+FileDataWorker::FileDataWorker(QObject *parent) : QThread(parent)
+{
+}
+
+FileDataWorker::~FileDataWorker()
+{
+    cancel();
+    wait();
+}
+
+void FileDataWorker::cancel()
+{
+    QMutexLocker locker(&m_mutex);
+    m_cancelled = true;
+}
+
+void FileDataWorker::startLoad(QString file, int generation)
+{
+    QMutexLocker locker(&m_mutex);
+    m_pendingFile = file;
+    m_pendingGeneration = generation;
+    m_hasPending = true;
+    m_cancelled = false;
+
+    if (!m_running) {
+        // The thread may still be returning from run() after it
+        // found no more requests, so wait for it before restarting.
+        wait();
+        m_running = true;
+        start();
+    }
+}
+
+void FileDataWorker::run()
+{
+    forever {
+        QString file;
+        int generation;
+
+        {
+            QMutexLocker locker(&m_mutex);
+            if (!m_hasPending || m_cancelled) {
+                m_running = false;
+                return;
+            }
+
+            file = m_pendingFile;
+            generation = m_pendingGeneration;
+            m_hasPending = false;
+        }
+
+        QString errorMessage;
+        StatFileInfo info = FileData::readFileInfo(file, &errorMessage);
+        emit infoReady(generation, info, errorMessage);
+        if (isSuperseded()) continue;
+
+        QString mimeTypeComment;
+        QString mimeType = FileData::readMimeType(info, &mimeTypeComment);
+        emit mimeTypeReady(generation, mimeType, mimeTypeComment);
+        if (isSuperseded()) continue;
+
+        emit metaDataReady(generation, FileData::readMetaData(info, mimeType));
+    }
+}
+
+bool FileDataWorker::isSuperseded()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_hasPending || m_cancelled;
+}
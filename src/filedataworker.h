@@ -0,0 +1,69 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILEDATAWORKER_H
+#define FILEDATAWORKER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QStringList>
+#include "statfileinfo.h"
+
+/**
+ * @brief This class loads file details for FileData in the background.
+ *
+ * Details are loaded in stages: first basic file info, then the mime type,
+ * and finally format specific metadata. Each stage is delivered with one
+ * signal carrying the generation of the request. Requests replace
+ * each other: when a new request arrives while an older one is being
+ * loaded, the remaining stages of the older request are skipped.
+ */
+class FileDataWorker : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit FileDataWorker(QObject *parent = nullptr);
+    ~FileDataWorker() override;
+    void cancel();
+
+    // starts the thread if it is not already running
+    void startLoad(QString file, int generation);
+
+signals:
+    void infoReady(int generation, StatFileInfo info, QString errorMessage);
+    void mimeTypeReady(int generation, QString mimeType, QString mimeTypeComment);
+    void metaDataReady(int generation, QStringList metaData);
+
+protected:
+    void run() override;
+
+private:
+    bool isSuperseded();
+
+    QMutex m_mutex;
+    QString m_pendingFile = {""};
+    int m_pendingGeneration = {0};
+    bool m_hasPending = {false};
+    bool m_running = {false};
+    bool m_cancelled = {false};
+};
+
+#endif // FILEDATAWORKER_H
@@ -0,0 +1,517 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <QFileInfo>
+#include <QDebug>
+#include "filejobqueue.h"
+#include "fileworker.h"
+#include "mounttable.h"
+#include "transferjournal.h"
+
+// Maximum number of jobs running at the same time, on different devices.
+#ifndef FILEJOBQUEUE_MAX_RUNNING
+#define FILEJOBQUEUE_MAX_RUNNING 4
+#endif
+
+// Maximum number of finished jobs that are kept in the list.
+#ifndef FILEJOBQUEUE_MAX_FINISHED
+#define FILEJOBQUEUE_MAX_FINISHED 20
+#endif
+
+// Interval in milliseconds at which the progress of running jobs is updated.
+#ifndef FILEJOBQUEUE_PROGRESS_INTERVAL
+#define FILEJOBQUEUE_PROGRESS_INTERVAL 250
+#endif
+
+enum {
+    JobIdRole = Qt::UserRole + 1,
+    TypeRole = Qt::UserRole + 2,
+    StatusRole = Qt::UserRole + 3,
+    NameRole = Qt::UserRole + 4,
+    FilenamesRole = Qt::UserRole + 5,
+    DestinationRole = Qt::UserRole + 6,
+    PriorityRole = Qt::UserRole + 7,
+    ProgressRole = Qt::UserRole + 8,
+    CurrentFileRole = Qt::UserRole + 9,
+    BytesDoneRole = Qt::UserRole + 10,
+    BytesTotalRole = Qt::UserRole + 11,
+    ErrorMessageRole = Qt::UserRole + 12,
+    ResumableRole = Qt::UserRole + 13
+};
+
+FileJobQueue::FileJobQueue(QObject *parent) : QAbstractListModel(parent)
+{
+    m_progressTimer.setInterval(FILEJOBQUEUE_PROGRESS_INTERVAL);
+    connect(&m_progressTimer, SIGNAL(timeout()), this, SLOT(updateProgress()));
+    loadInterrupted();
+}
+
+FileJobQueue::~FileJobQueue()
+{
+    // ask all workers to stop first, so they can stop in parallel
+    for (const Job& job : m_jobs) {
+        if (job.worker) job.worker->cancel();
+    }
+    for (const Job& job : m_jobs) {
+        if (job.worker) job.worker->wait();
+    }
+}
+
+int FileJobQueue::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return m_jobs.count();
+}
+
+QVariant FileJobQueue::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() > m_jobs.count()-1)
+        return QVariant();
+
+    const Job& job = m_jobs.at(index.row());
+    switch (role) {
+
+    case JobIdRole:
+        return job.id;
+
+    case TypeRole:
+        switch (job.type) {
+        case DeleteJob: return QStringLiteral("delete");
+        case CopyJob: return QStringLiteral("copy");
+        case MoveJob: return QStringLiteral("move");
+        case SymlinkJob: return QStringLiteral("link");
+        }
+        return QVariant();
+
+    case StatusRole:
+        switch (job.status) {
+        case Queued: return QStringLiteral("queued");
+        case Running: return QStringLiteral("running");
+        case Done: return QStringLiteral("done");
+        case Failed: return QStringLiteral("failed");
+        case Cancelled: return QStringLiteral("cancelled");
+        case Interrupted: return QStringLiteral("interrupted");
+        }
+        return QVariant();
+
+    case Qt::DisplayRole:
+    case NameRole:
+        if (job.filenames.count() == 1) return QFileInfo(job.filenames.first()).fileName();
+        return tr("%n file(s)", "", job.filenames.count());
+
+    case FilenamesRole:
+        return job.filenames;
+
+    case DestinationRole:
+        return job.destDirectory;
+
+    case PriorityRole:
+        return job.priority;
+
+    case ProgressRole:
+        return job.progress.progress;
+
+    case CurrentFileRole:
+        return job.progress.filename;
+
+    case BytesDoneRole:
+        return double(job.progress.bytesDone);
+
+    case BytesTotalRole:
+        return double(job.progress.bytesTotal);
+
+    case ErrorMessageRole:
+        return job.errorMessage;
+
+    case ResumableRole:
+        return isResumable(job);
+
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> FileJobQueue::roleNames() const
+{
+    QHash<int, QByteArray> roles = QAbstractListModel::roleNames();
+    roles.insert(JobIdRole, QByteArray("jobId"));
+    roles.insert(TypeRole, QByteArray("type"));
+    roles.insert(StatusRole, QByteArray("status"));
+    roles.insert(NameRole, QByteArray("name"));
+    roles.insert(FilenamesRole, QByteArray("filenames"));
+    roles.insert(DestinationRole, QByteArray("destination"));
+    roles.insert(PriorityRole, QByteArray("priority"));
+    roles.insert(ProgressRole, QByteArray("progress"));
+    roles.insert(CurrentFileRole, QByteArray("currentFile"));
+    roles.insert(BytesDoneRole, QByteArray("bytesDone"));
+    roles.insert(BytesTotalRole, QByteArray("bytesTotal"));
+    roles.insert(ErrorMessageRole, QByteArray("errorMessage"));
+    roles.insert(ResumableRole, QByteArray("resumable"));
+    return roles;
+}
+
+int FileJobQueue::enqueue(Type type, QStringList filenames, QString destDirectory,
+                          int priority, QStringList targets)
+{
+    pruneFinished();
+
+    Job job;
+    job.id = ++m_lastJob;
+    job.type = type;
+    job.filenames = filenames;
+    job.destDirectory = destDirectory;
+    job.targets = targets;
+    job.priority = priority;
+    job.devices = devicesFor(job);
+
+    // the worker rejects empty names; report it when control returns
+    // to the event loop, so that callers know the id
+    if (filenames.isEmpty() || filenames.contains(QString())) {
+        job.status = Failed;
+        job.errorMessage = tr("Empty filename");
+        int jobId = job.id;
+        QString message = job.errorMessage;
+        QTimer::singleShot(0, this, [this, jobId, message]() {
+            emit jobFailed(jobId, message, QString());
+            emit jobEnded(jobId);
+        });
+    } else if (type == CopyJob || type == MoveJob) {
+        job.journal = TransferJournal::create(type, destDirectory, filenames);
+    }
+
+    beginInsertRows(QModelIndex(), m_jobs.count(), m_jobs.count());
+    m_jobs.append(job);
+    endInsertRows();
+    emit countChanged();
+
+    startQueued();
+    return job.id;
+}
+
+FileJobQueue::Status FileJobQueue::status(int jobId) const
+{
+    int row = rowOf(jobId);
+    if (row < 0) return Done;
+    return m_jobs.at(row).status;
+}
+
+TransferProgress::Snapshot FileJobQueue::progress(int jobId) const
+{
+    int row = rowOf(jobId);
+    if (row < 0) return TransferProgress::Snapshot();
+
+    const Job& job = m_jobs.at(row);
+    if (job.worker) return job.worker->transferProgress().snapshot();
+    return job.progress;
+}
+
+void FileJobQueue::cancel(int jobId)
+{
+    int row = rowOf(jobId);
+    if (row < 0) return;
+    Job& job = m_jobs[row];
+
+    if (job.status == Running) {
+        job.cancelRequested = true;
+        job.worker->cancel();
+    } else if (job.status == Queued) {
+        job.status = Cancelled;
+        job.errorMessage = tr("Cancelled");
+        notifyChanged(jobId, {StatusRole, ErrorMessageRole});
+        emit jobFailed(jobId, job.errorMessage, QString());
+        emit jobEnded(jobId);
+        startQueued(); // jobs waiting behind this one may start now
+    }
+}
+
+void FileJobQueue::setPriority(int jobId, int priority)
+{
+    int row = rowOf(jobId);
+    if (row < 0 || m_jobs.at(row).priority == priority) return;
+
+    m_jobs[row].priority = priority;
+    notifyChanged(jobId, {PriorityRole});
+    startQueued();
+}
+
+void FileJobQueue::clearFinished()
+{
+    for (int row = m_jobs.count()-1; row >= 0; --row) {
+        const Job& job = m_jobs.at(row);
+        if (job.status == Queued || job.status == Running ||
+                job.status == Interrupted || job.worker) continue;
+
+        if (!job.journal.isEmpty()) TransferJournal::discard(job.journal);
+        beginRemoveRows(QModelIndex(), row, row);
+        m_jobs.removeAt(row);
+        endRemoveRows();
+    }
+    emit countChanged();
+}
+
+int FileJobQueue::interruptedCount() const
+{
+    int count = 0;
+    for (const Job& job : m_jobs) {
+        if (job.status == Interrupted) count++;
+    }
+    return count;
+}
+
+void FileJobQueue::resume(int jobId)
+{
+    int row = rowOf(jobId);
+    if (row < 0 || !isResumable(m_jobs.at(row))) return;
+
+    Job& job = m_jobs[row];
+    bool wasInterrupted = (job.status == Interrupted);
+    job.status = Queued;
+    job.cancelRequested = false;
+    job.errorMessage.clear();
+    job.progress = TransferProgress::Snapshot();
+    job.progressSerial = -1;
+    job.devices = devicesFor(job);
+
+    notifyChanged(jobId, QVector<int>());
+    if (wasInterrupted) emit interruptedCountChanged();
+    startQueued();
+}
+
+void FileJobQueue::discard(int jobId)
+{
+    int row = rowOf(jobId);
+    if (row < 0 || !isResumable(m_jobs.at(row))) return;
+
+    bool wasInterrupted = (m_jobs.at(row).status == Interrupted);
+    TransferJournal::discard(m_jobs.at(row).journal);
+
+    beginRemoveRows(QModelIndex(), row, row);
+    m_jobs.removeAt(row);
+    endRemoveRows();
+    emit countChanged();
+    if (wasInterrupted) emit interruptedCountChanged();
+}
+
+void FileJobQueue::handleDone()
+{
+    Job* job = jobFor(sender());
+    if (!job) return;
+
+    job->progress = job->worker->transferProgress().snapshot();
+    job->status = Done;
+    job->journal.clear(); // removed by the worker
+    notifyChanged(job->id, QVector<int>());
+    emit jobDone(job->id);
+}
+
+void FileJobQueue::handleError(QString message, QString filename)
+{
+    Job* job = jobFor(sender());
+    if (!job) return;
+
+    qDebug() << "[FileJobQueue] job" << job->id << "failed:" << message << filename;
+    job->progress = job->worker->transferProgress().snapshot();
+    job->status = job->cancelRequested ? Cancelled : Failed;
+    job->errorMessage = message;
+    notifyChanged(job->id, QVector<int>());
+    emit jobFailed(job->id, message, filename);
+}
+
+void FileJobQueue::handleFinished()
+{
+    Job* job = jobFor(sender());
+    if (!job) return;
+
+    int jobId = job->id;
+    release(*job);
+    notifyChanged(jobId, {ResumableRole});
+    emit jobEnded(jobId);
+    startQueued();
+}
+
+void FileJobQueue::updateProgress()
+{
+    for (Job& job : m_jobs) {
+        if (job.status != Running || !job.worker) continue;
+
+        const TransferProgress& record = job.worker->transferProgress();
+        int serial = record.serial();
+        if (serial == job.progressSerial) continue;
+        job.progressSerial = serial;
+
+        TransferProgress::Snapshot snapshot = record.snapshot();
+        if (snapshot.progress == job.progress.progress &&
+                snapshot.bytesDone == job.progress.bytesDone &&
+                snapshot.filename == job.progress.filename) {
+            continue;
+        }
+
+        job.progress = snapshot;
+        notifyChanged(job.id, {ProgressRole, CurrentFileRole, BytesDoneRole, BytesTotalRole});
+    }
+}
+
+int FileJobQueue::rowOf(int jobId) const
+{
+    for (int row = 0; row < m_jobs.count(); ++row) {
+        if (m_jobs.at(row).id == jobId) return row;
+    }
+    return -1;
+}
+
+FileJobQueue::Job* FileJobQueue::jobFor(QObject *worker)
+{
+    for (Job& job : m_jobs) {
+        if (job.worker && job.worker == worker) return &job;
+    }
+    return nullptr;
+}
+
+void FileJobQueue::notifyChanged(int jobId, const QVector<int>& roles)
+{
+    int row = rowOf(jobId);
+    if (row < 0) return;
+    QModelIndex changed = index(row, 0);
+    emit dataChanged(changed, changed, roles);
+}
+
+void FileJobQueue::startQueued()
+{
+    // Devices of running jobs and of waiting jobs with higher priority are
+    // reserved, so that jobs on the same device keep their order.
+    QSet<quint64> reserved = m_busyDevices;
+    QList<int> queued;
+
+    for (int row = 0; row < m_jobs.count(); ++row) {
+        if (m_jobs.at(row).status == Queued) queued.append(row);
+    }
+
+    std::stable_sort(queued.begin(), queued.end(), [this](int a, int b) {
+        return m_jobs.at(a).priority > m_jobs.at(b).priority;
+    });
+
+    for (int row : queued) {
+        if (m_running >= FILEJOBQUEUE_MAX_RUNNING) break;
+        Job& job = m_jobs[row];
+        bool blocked = job.devices.intersects(reserved);
+        reserved.unite(job.devices);
+        if (!blocked) start(job);
+    }
+}
+
+void FileJobQueue::start(Job& job)
+{
+    job.worker = new FileWorker(this);
+    job.status = Running;
+    m_busyDevices.unite(job.devices);
+    m_running++;
+
+    connect(job.worker, SIGNAL(done()), this, SLOT(handleDone()));
+    connect(job.worker, SIGNAL(errorOccurred(QString, QString)), this, SLOT(handleError(QString, QString)));
+    connect(job.worker, SIGNAL(fileDeleted(QString)), this, SIGNAL(fileDeleted(QString)));
+    connect(job.worker, SIGNAL(finished()), this, SLOT(handleFinished()));
+
+    if (!job.journal.isEmpty()) job.worker->setJournal(job.journal);
+    if (!job.targets.isEmpty()) job.worker->setTargets(job.targets);
+
+    switch (job.type) {
+    case DeleteJob: job.worker->startDeleteFiles(job.filenames); break;
+    case CopyJob: job.worker->startCopyFiles(job.filenames, job.destDirectory); break;
+    case MoveJob: job.worker->startMoveFiles(job.filenames, job.destDirectory); break;
+    case SymlinkJob: job.worker->startSymlinkFiles(job.filenames, job.destDirectory); break;
+    }
+
+    if (!m_progressTimer.isActive()) m_progressTimer.start();
+    notifyChanged(job.id, {StatusRole});
+    emit runningCountChanged();
+    emit jobStarted(job.id);
+}
+
+void FileJobQueue::release(Job& job)
+{
+    job.worker->deleteLater();
+    job.worker = nullptr;
+    m_busyDevices.subtract(job.devices);
+    m_running--;
+
+    if (m_running == 0) m_progressTimer.stop();
+    emit runningCountChanged();
+}
+
+void FileJobQueue::pruneFinished()
+{
+    int finished = 0;
+    for (int row = m_jobs.count()-1; row >= 0; --row) {
+        const Job& job = m_jobs.at(row);
+        if (job.status == Queued || job.status == Running || job.worker || isResumable(job)) continue;
+        if (++finished <= FILEJOBQUEUE_MAX_FINISHED) continue;
+
+        beginRemoveRows(QModelIndex(), row, row);
+        m_jobs.removeAt(row);
+        endRemoveRows();
+        emit countChanged();
+    }
+}
+
+bool FileJobQueue::isResumable(const Job &job)
+{
+    return !job.journal.isEmpty() && !job.worker &&
+            (job.status == Failed || job.status == Cancelled || job.status == Interrupted);
+}
+
+void FileJobQueue::loadInterrupted()
+{
+    for (const TransferJournal::Info& info : TransferJournal::interrupted()) {
+        if (info.type != CopyJob && info.type != MoveJob) continue;
+
+        Job job;
+        job.id = ++m_lastJob;
+        job.type = Type(info.type);
+        job.filenames = info.filenames;
+        job.destDirectory = info.destDirectory;
+        job.status = Interrupted;
+        job.errorMessage = tr("Interrupted");
+        job.journal = info.path;
+        m_jobs.append(job);
+    }
+
+    if (!m_jobs.isEmpty()) {
+        qDebug() << "[FileJobQueue] found" << m_jobs.count() << "interrupted jobs";
+    }
+}
+
+QSet<quint64> FileJobQueue::devicesFor(const Job &job)
+{
+    MountTable* mounts = MountTable::instance();
+    QSet<quint64> devices;
+
+    if (job.type != SymlinkJob) {
+        for (const QString& filename : job.filenames) {
+            devices.insert(mounts->mountFor(filename).device);
+        }
+    }
+
+    if (job.type != DeleteJob) {
+        devices.insert(mounts->mountFor(job.destDirectory).device);
+    }
+
+    return devices;
+}
@@ -0,0 +1,154 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILEJOBQUEUE_H
+#define FILEJOBQUEUE_H
+
+#include <QAbstractListModel>
+#include <QStringList>
+#include <QList>
+#include <QSet>
+#include <QTimer>
+#include "transferprogress.h"
+
+class FileWorker;
+
+/**
+ * @brief The FileJobQueue class runs file operations in the background.
+ *
+ * Jobs are queued and started by priority, then in the order they were
+ * added. Every job runs in its own FileWorker and has its own progress,
+ * cancel handle and error state.
+ *
+ * Each job uses the devices of its source and target paths. Jobs that use
+ * different devices run in parallel. A job that shares a device with a
+ * running job, or with a queued job of higher priority, waits. This keeps
+ * one slow SD card from blocking work on internal storage. It also avoids
+ * slowing down a device with competing transfers.
+ *
+ * The model lists all jobs; finished jobs are kept until they are cleared.
+ *
+ * Copy and move jobs keep a TransferJournal. Jobs that were interrupted in
+ * an earlier session are listed when the queue is created, and can be
+ * resumed or discarded, like failed or cancelled jobs of this session.
+ */
+class FileJobQueue : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count() NOTIFY countChanged())
+    Q_PROPERTY(int runningCount READ runningCount() NOTIFY runningCountChanged())
+    Q_PROPERTY(int interruptedCount READ interruptedCount() NOTIFY interruptedCountChanged())
+
+public:
+    enum Type {
+        DeleteJob, CopyJob, MoveJob, SymlinkJob
+    };
+    enum Status {
+        Queued, Running, Done, Failed, Cancelled, Interrupted
+    };
+
+    explicit FileJobQueue(QObject *parent = nullptr);
+    ~FileJobQueue();
+
+    // methods needed by ListView
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QHash<int, QByteArray> roleNames() const;
+
+    // property accessors
+    int count() const { return m_jobs.count(); }
+    int runningCount() const { return m_running; }
+    int interruptedCount() const;
+
+    // Adds a job and returns its id. The job may start right away.
+    // Targets planned by TransferPlanner can be given for the files.
+    int enqueue(Type type, QStringList filenames, QString destDirectory = QString(),
+                int priority = 0, QStringList targets = QStringList());
+
+    Status status(int jobId) const;
+    TransferProgress::Snapshot progress(int jobId) const;
+
+    // methods accessible from QML
+    Q_INVOKABLE void cancel(int jobId);
+    Q_INVOKABLE void setPriority(int jobId, int priority);
+    Q_INVOKABLE void clearFinished();
+
+    // continues a failed, cancelled or interrupted copy or move job
+    Q_INVOKABLE void resume(int jobId);
+    // forgets a job that could be resumed, and removes its partial files
+    Q_INVOKABLE void discard(int jobId);
+
+signals:
+    void countChanged();
+    void runningCountChanged();
+    void interruptedCountChanged();
+
+    void jobStarted(int jobId);
+    // one of these is sent when a job ends
+    void jobDone(int jobId);
+    void jobFailed(int jobId, QString message, QString filename);
+    // sent after jobDone() or jobFailed(), when the worker has updated caches
+    void jobEnded(int jobId);
+
+    void fileDeleted(QString fullname);
+
+private slots:
+    void handleDone();
+    void handleError(QString message, QString filename);
+    void handleFinished();
+    void updateProgress();
+
+private:
+    struct Job {
+        int id = {0};
+        Type type = {CopyJob};
+        QStringList filenames;
+        QString destDirectory;
+        QStringList targets; // planned by TransferPlanner, may be empty
+        int priority = {0};
+        Status status = {Queued};
+        bool cancelRequested = {false};
+        QSet<quint64> devices;
+        FileWorker* worker = {nullptr};
+        TransferProgress::Snapshot progress;
+        int progressSerial = {-1};
+        QString errorMessage;
+        QString journal;
+    };
+
+    int rowOf(int jobId) const;
+    Job* jobFor(QObject* worker);
+    void notifyChanged(int jobId, const QVector<int>& roles);
+    void startQueued();
+    void start(Job& job);
+    void release(Job& job);
+    void pruneFinished();
+    static QSet<quint64> devicesFor(const Job& job);
+    static bool isResumable(const Job& job);
+    void loadInterrupted();
+
+    int m_lastJob = {0};
+    int m_running = {0};
+    QList<Job> m_jobs; // in order of submission
+    QSet<quint64> m_busyDevices;
+    QTimer m_progressTimer;
+};
+
+#endif // FILEJOBQUEUE_H
@@ -27,6 +27,8 @@
 #include <QSettings>
 #include <QGuiApplication>
 #include <QRegularExpression>
+#include <QHash>
+#include <QVector>
 #include <QDebug>
 
 #include "filemodel.h"
@@ -73,6 +75,7 @@ FileModel::FileModel(QObject *parent) :
     connect(m_worker, &FileModelWorker::error, this, &FileModel::workerErrorOccurred);
     connect(m_worker, &FileModelWorker::entryAdded, this, &FileModel::workerAddedEntry);
     connect(m_worker, &FileModelWorker::entryRemoved, this, &FileModel::workerRemovedEntry);
+    connect(m_worker, &FileModelWorker::entriesReordered, this, &FileModel::workerReorderedEntries);
 }
 
 FileModel::~FileModel()
@@ -505,6 +508,40 @@ void FileModel::workerRemovedEntry(int index, StatFileInfo file)
     updateFileCounts();
 }
 
+void FileModel::workerReorderedEntries(QList<StatFileInfo> files)
+{
+    // a new listing has been requested, this order is outdated
+    if (m_busy || m_partlyBusy || files.count() != m_files.count()) return;
+
+    // keep our own entries, they carry the selection state
+    QHash<QString, int> rows;
+    rows.reserve(m_files.count());
+    for (int i = 0; i < m_files.count(); ++i) {
+        rows.insert(m_files.at(i).absoluteFilePath(), i);
+    }
+
+    QList<StatFileInfo> reordered;
+    QVector<int> newRows(m_files.count(), -1);
+    reordered.reserve(files.count());
+
+    for (const auto& i : files) {
+        int row = rows.value(i.absoluteFilePath(), -1);
+        if (row < 0 || newRows.at(row) >= 0) return; // not the same entries
+        newRows[row] = reordered.count();
+        reordered.append(m_files.at(row));
+    }
+
+    emit layoutAboutToBeChanged();
+    QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    for (const auto& i : from) {
+        to.append(index(newRows.at(i.row()), i.column()));
+    }
+    m_files = reordered;
+    changePersistentIndexList(from, to);
+    emit layoutChanged();
+}
+
 void FileModel::doUpdateAllEntries()
 {
     setBusy(true);
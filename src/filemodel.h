@@ -113,6 +113,7 @@ private slots:
     void workerErrorOccurred(QString message);
     void workerAddedEntry(int index, StatFileInfo file);
     void workerRemovedEntry(int index, StatFileInfo file);
+    void workerReorderedEntries(QList<StatFileInfo> files);
 
 private:
     /**
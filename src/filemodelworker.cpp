@@ -25,11 +25,18 @@
 #include "filemodelworker.h"
 #include "statfileinfo.h"
 #include "settingshandler.h"
+#include "capturetimecache.h"
 
 #ifndef FILEMODEL_SIGNAL_THRESHOLD
 #define FILEMODEL_SIGNAL_THRESHOLD 200
 #endif
 
+// Number of photos whose capture times are read before the listing
+// is sorted again, when sorting by capture time.
+#ifndef FILEMODEL_CAPTURETIME_BATCH
+#define FILEMODEL_CAPTURETIME_BATCH 100
+#endif
+
 FileModelWorker::FileModelWorker(QObject *parent) : QThread(parent) {
     connect(this, &FileModelWorker::error, this, &FileModelWorker::logError);
     connect(this, &FileModelWorker::alreadyRunning, this,
@@ -80,6 +87,10 @@ void FileModelWorker::run()
         logMessage("note: started with NoneMode");
         return;
     }
+
+    if (m_cachedSortCaptureTime && m_cancelled.loadAcquire() != Cancelled) {
+        scanCaptureTimes();
+    }
 }
 
 void FileModelWorker::logMessage(QString message, bool markSilent)
@@ -97,8 +108,15 @@ void FileModelWorker::doStartThread(FileModelWorker::Mode mode, QList<StatFileIn
                                     QString dir, QString nameFilter, Settings* settings)
 {
     if (isRunning()) {
-        emit alreadyRunning(); // we hope everything works out
-        return;
+        if (m_scanningCaptureTimes.loadAcquire()) {
+            // the listing is done, only capture times are still being read:
+            // stop now, the new listing continues with the remaining files
+            cancel();
+            wait();
+        } else {
+            emit alreadyRunning(); // we hope everything works out
+            return;
+        }
     }
 
     m_settings = settings;
@@ -231,6 +249,7 @@ bool FileModelWorker::applySettings() {
     QFlags<QDir::Filter> newFilters = (QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::System);
     QFlags<QDir::SortFlag> newSorting;
     bool sortTime = false;
+    bool sortCaptureTime = false;
 
     // load settings, see SETTINGS.md for details
     if (m_settings) {
@@ -260,6 +279,10 @@ bool FileModelWorker::applySettings() {
         } else if (sortSetting == "modificationtime") {
             // sortBy = QDir::Time; -- no, we sort manually for performance
             sortTime = true;
+        } else if (sortSetting == "capturetime") {
+            // photos are sorted by EXIF capture time, everything
+            // else falls back to modification time
+            sortCaptureTime = true;
         } else if (sortSetting == "type") {
             sortBy = QDir::Type;
         }
@@ -285,9 +308,11 @@ bool FileModelWorker::applySettings() {
     }
 
     if (m_cachedDir.sorting() != newSorting ||
-            m_cachedSortTime != sortTime) {
+            m_cachedSortTime != sortTime ||
+            m_cachedSortCaptureTime != sortCaptureTime) {
         m_cachedDir.setSorting(newSorting);
         m_cachedSortTime = sortTime;
+        m_cachedSortCaptureTime = sortCaptureTime;
         settingsChanged = true;
         if (cancelIfCancelled()) return false;
     }
@@ -326,6 +351,12 @@ bool FileModelWorker::applySettings() {
         sortByModTime(m_finalEntries,
                       newSorting.testFlag(QDir::Reversed),
                       dirsCount);
+    } else if (sortCaptureTime) {
+        // Photos that have not been read yet are sorted by modification
+        // time for now, see scanCaptureTimes().
+        sortByCaptureTime(m_finalEntries,
+                          newSorting.testFlag(QDir::Reversed),
+                          dirsCount);
     }
 
     return true;
@@ -336,6 +367,7 @@ bool FileModelWorker::thresholdAbort(size_t currentChanges, const QList<StatFile
     const size_t signalThreshold = FILEMODEL_SIGNAL_THRESHOLD;
     if (currentChanges >= signalThreshold) {
         logMessage("warning: partial refresh reached threshold, upgraded to full");
+        m_finalEntries = fullFiles;
         emit done(Mode::FullMode, fullFiles);
         return true;
     }
@@ -403,6 +435,82 @@ void FileModelWorker::sortByModTime(QList<StatFileInfo> &files, bool reverse, in
 #undef COMP_LAMBDA
 }
 
+void FileModelWorker::sortByCaptureTime(QList<StatFileInfo> &files, bool reverse, int dirsFirstCount)
+{
+    // Capture times are looked up once per file instead of in
+    // every comparison, as each lookup has to lock the cache.
+    auto cache = CaptureTimeCache::instance();
+    QList<QPair<qint64, StatFileInfo>> keyed;
+    keyed.reserve(files.size());
+
+    for (const auto& i : files) {
+        keyed.append(qMakePair(cache->captureTimeOrModTime(i), i));
+    }
+
+#define COMP_LAMBDA [&](const QPair<qint64, StatFileInfo>& a, const QPair<qint64, StatFileInfo>& b) -> bool
+    auto doSort = COMP_LAMBDA {
+        // newer dates first by default, see sortByModTime()
+        if (!reverse) return a.first > b.first;
+        else return a.first < b.first;
+    };
+
+    if (dirsFirstCount > 0) {
+        std::stable_sort(keyed.begin(), keyed.begin()+dirsFirstCount, doSort);
+        std::stable_sort(keyed.begin()+dirsFirstCount, keyed.end(), doSort);
+    } else {
+        std::stable_sort(keyed.begin(), keyed.end(), doSort);
+    }
+#undef COMP_LAMBDA
+
+    for (int i = 0; i < keyed.size(); ++i) {
+        files[i] = keyed.at(i).second;
+    }
+}
+
+void FileModelWorker::scanCaptureTimes()
+{
+    // The listing has already been published, sorted with the capture times
+    // that were cached. Uncached photos are read in batches, and the listing
+    // is sorted again after each batch. Results are kept even if the scan is
+    // cancelled, so the next listing continues where this one stopped.
+    auto cache = CaptureTimeCache::instance();
+    QList<StatFileInfo> todo = cache->uncached(m_finalEntries);
+    if (todo.isEmpty()) return;
+
+    m_scanningCaptureTimes.storeRelease(1);
+    logMessage(QString("note: reading capture times of %1 files").arg(todo.size()));
+
+    bool reverse = m_cachedDir.sorting().testFlag(QDir::Reversed);
+    int dirsCount = -1; // don't sort dirs separately
+
+    if (m_cachedDir.sorting().testFlag(QDir::DirsFirst)) {
+        dirsCount = 0;
+        for (const auto& i : m_finalEntries) {
+            if (i.isDirAtEnd()) dirsCount++;
+        }
+    }
+
+    auto isCancelled = [&](){ return m_cancelled.loadAcquire() == Cancelled; };
+
+    for (int start = 0; start < todo.size() && !isCancelled(); start += FILEMODEL_CAPTURETIME_BATCH) {
+        cache->scan(todo.mid(start, FILEMODEL_CAPTURETIME_BATCH), isCancelled);
+        if (isCancelled()) break;
+
+        QList<StatFileInfo> sorted = m_finalEntries;
+        sortByCaptureTime(sorted, reverse, dirsCount);
+
+        for (int i = 0; i < sorted.size(); ++i) {
+            if (sorted.at(i).absoluteFilePath() != m_finalEntries.at(i).absoluteFilePath()) {
+                m_finalEntries = sorted;
+                emit entriesReordered(m_finalEntries);
+                break;
+            }
+        }
+    }
+
+    m_scanningCaptureTimes.storeRelease(0);
+}
+
 bool FileModelWorker::cancelIfCancelled()
 {
     if (m_cancelled.loadAcquire() == Cancelled) {
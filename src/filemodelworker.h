@@ -61,6 +61,10 @@ signals:
     void entryAdded(int index, StatFileInfo file);
     void entryRemoved(int index, StatFileInfo file);
 
+    // emitted after done() when sorting by capture time, whenever
+    // newly read capture times change the order of the entries
+    void entriesReordered(QList<StatFileInfo> entries);
+
 protected:
     void run() override;
 
@@ -80,12 +84,15 @@ private:
     bool filesContains(const QList<StatFileInfo> &files, const StatFileInfo &fileData) const;
     uint hashInfo(const StatFileInfo& f);
     void sortByModTime(QList<StatFileInfo>& files, bool reverse, int dirsFirstCount);
+    void sortByCaptureTime(QList<StatFileInfo>& files, bool reverse, int dirsFirstCount);
+    void scanCaptureTimes();
 
     // returns true if cancelled and emits an error
     bool cancelIfCancelled();
 
     QDir m_cachedDir = {""};
     bool m_cachedSortTime = {false};
+    bool m_cachedSortCaptureTime = {false};
     Settings* m_settings = {nullptr};
     FileModelWorker::Mode m_mode = {FullMode};
     QList<StatFileInfo> m_finalEntries = {};
@@ -93,6 +100,7 @@ private:
     QString m_dir = {""};
     QString m_nameFilter = {""};
     QAtomicInt m_cancelled = {KeepRunning}; // atomic so no locks needed
+    QAtomicInt m_scanningCaptureTimes = {0}; // set while only reading capture times
 };
 
 #endif // FILEMODELWORKER_H
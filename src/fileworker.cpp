@@ -21,34 +21,56 @@
  */
 
 #include "fileworker.h"
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <QDateTime>
+#include <QSet>
+#include <QMutex>
 #include "globals.h"
+#include "directorysizeindex.h"
+#include "diskspacecache.h"
+#include "treewalker.h"
+#include "treecopier.h"
+#include "treedeleter.h"
+#include "transferplanner.h"
 
 // creates a "Document (2)" numbered name from the given filename
 static QString createNumberedFilename(QString filename)
 {
     QFileInfo fileinfo(filename);
-    QString suffix = fileinfo.suffix();
-    if (!suffix.isEmpty()) {
-        suffix = "."+suffix;
-    }
-    int dotpos = filename.lastIndexOf('.');
-    QString basename = dotpos >= 0 ? filename.left(dotpos) : filename;
+    QDir dir = fileinfo.dir();
     int number = 2;
-    QString numberedFilename = QString("%1 (%2)%3").arg(basename).arg(number).arg(suffix);
+    QString numberedFilename = dir.absoluteFilePath(TransferPlanner::numberedName(fileinfo.fileName(), number));
     while (QFileInfo::exists(numberedFilename)) {
         ++number;
-        numberedFilename = QString("%1 (%2)%3").arg(basename).arg(number).arg(suffix);
+        numberedFilename = dir.absoluteFilePath(TransferPlanner::numberedName(fileinfo.fileName(), number));
     }
     return numberedFilename;
 }
 
+// returns the planned numbered name for a file pasted onto itself,
+// or probes for a new one if there is no plan or the name has been taken since
+static QString numberedTarget(QString filename, QString planned)
+{
+    struct stat info;
+    if (!planned.isEmpty() && planned != filename &&
+            ::lstat(QFile::encodeName(planned).constData(), &info) != 0) {
+        return planned;
+    }
+    return createNumberedFilename(filename);
+}
+
 FileWorker::FileWorker(QObject *parent) :
     QThread(parent),
     m_mode(DeleteMode),
-    m_cancelled(KeepRunning),
-    m_progress(0)
+    m_cancelled(KeepRunning)
 {
+    m_copier.setCancelCheck([this](){ return m_cancelled.loadAcquire() == Cancelled; });
+    m_copier.setProgressCallback([this](qint64 bytes){ m_transfer.add(bytes, 0); m_journal.flush(); });
+    m_copier.setSparseCallback([this](qint64 bytes){ m_transfer.addSparse(bytes); });
+    m_copier.setJournal(&m_journal);
 }
 
 FileWorker::~FileWorker()
@@ -68,6 +90,7 @@ void FileWorker::startDeleteFiles(QStringList filenames)
     m_mode = DeleteMode;
     m_filenames = filenames;
     m_cancelled.storeRelease(KeepRunning);
+    m_transfer.reset(0);
     start();
 }
 
@@ -85,6 +108,7 @@ void FileWorker::startCopyFiles(QStringList filenames, QString destDirectory)
     m_filenames = filenames;
     m_destDirectory = destDirectory;
     m_cancelled.storeRelease(KeepRunning);
+    m_transfer.reset(0);
     start();
 }
 
@@ -102,6 +126,7 @@ void FileWorker::startMoveFiles(QStringList filenames, QString destDirectory)
     m_filenames = filenames;
     m_destDirectory = destDirectory;
     m_cancelled.storeRelease(KeepRunning);
+    m_transfer.reset(0);
     start();
 }
 
@@ -119,6 +144,7 @@ void FileWorker::startSymlinkFiles(QStringList filenames, QString destDirectory)
     m_filenames = filenames;
     m_destDirectory = destDirectory;
     m_cancelled.storeRelease(KeepRunning);
+    m_transfer.reset(0);
     start();
 }
 
@@ -141,8 +167,39 @@ void FileWorker::run()
     case MoveMode:
     case CopyMode:
         copyOrMoveFiles();
+        m_journal.close(false); // kept for resuming unless the job completed
         break;
     }
+
+    invalidateCaches();
+}
+
+void FileWorker::invalidateCaches()
+{
+    // Most changes also change the modification time of the affected
+    // directories, but files overwritten in place do not. We drop the
+    // changed directories from the index so they are listed again.
+    // Disk space of all touched volumes has changed as well.
+    DirectorySizeIndex* index = DirectorySizeIndex::instance();
+    DiskSpaceCache* diskSpace = DiskSpaceCache::instance();
+
+    if (m_mode != DeleteMode) {
+        index->invalidate(m_destDirectory);
+        diskSpace->invalidate(m_destDirectory);
+    }
+
+    if (m_mode == DeleteMode || m_mode == MoveMode) {
+        QSet<QString> parents;
+        foreach (QString filename, m_filenames) {
+            parents.insert(QFileInfo(filename).absolutePath());
+        }
+        foreach (QString parent, parents) {
+            index->invalidate(parent);
+            diskSpace->invalidate(parent);
+        }
+    }
+
+    index->save();
 }
 
 bool FileWorker::validateFilenames(const QStringList &filenames)
@@ -159,13 +216,12 @@ bool FileWorker::validateFilenames(const QStringList &filenames)
 
 void FileWorker::symlinkFiles()
 {
-    int fileIndex = 0;
-    int fileCount = m_filenames.count();
+    m_transfer.reset(m_filenames.count());
 
     QDir dest(m_destDirectory);
-    foreach (QString filename, m_filenames) {
-        m_progress = 100 * fileIndex / fileCount;
-        emit progressChanged(m_progress, filename);
+    for (int i = 0; i < m_filenames.count(); ++i) {
+        QString filename = m_filenames.at(i);
+        m_transfer.setFilename(filename);
 
         // stop if cancelled
         if (m_cancelled.loadAcquire() == Cancelled) {
@@ -178,7 +234,7 @@ void FileWorker::symlinkFiles()
 
         if (filename == newname) { // pasting over the source file, so copy a renamed file
             if (QFileInfo::exists(newname)) {
-                newname = createNumberedFilename(newname);
+                newname = numberedTarget(newname, m_targets.value(i));
             }
         } else {
             // the destination exists either as a regular file/folder or as a symlink: abort
@@ -194,50 +250,62 @@ void FileWorker::symlinkFiles()
             return;
         }
 
-        fileIndex++;
+        m_transfer.add(0, 1);
     }
 
-    m_progress = 100;
-    emit progressChanged(m_progress, "");
+    m_transfer.finish();
     emit done();
 }
 
-QString FileWorker::deleteFile(QString filename)
+QString FileWorker::deleteFile(QString filename, QString* failedPath)
 {
     QFileInfo info(filename);
     if (!info.exists() && !info.isSymLink())
         return tr("File not found");
 
-    if (info.isDir() && info.isSymLink()) {
-        // only delete the link and do not remove recursively subfolders
-        QFile file(info.absoluteFilePath());
-        bool ok = file.remove();
-        if (!ok)
-            return file.errorString();
+    // progress is only counted when deleting is the operation,
+    // not when replacing existing files
+    bool countProgress = (m_mode == DeleteMode);
+
+    if (info.isDir() && !info.isSymLink()) {
+        TreeDeleter deleter(info.absoluteFilePath());
+        deleter.setThreadCount(TreeDeleter::threadCountFor(info.absoluteFilePath()));
+        deleter.setCancelCheck([this](){ return m_cancelled.loadAcquire() == Cancelled; });
+        if (countProgress) {
+            deleter.setProgressCallback([this](qint64 entries, const QString& name){
+                m_transfer.add(0, entries);
+                if (!name.isEmpty()) m_transfer.setFilename(name);
+            });
+        }
 
-    } else if (info.isDir()) {
-        // this should be custom function to get better error reporting
-        bool ok = QDir(info.absoluteFilePath()).removeRecursively();
-        if (!ok)
-            return tr("Folder delete failed");
+        if (!deleter.remove()) {
+            if (failedPath && !deleter.wasCancelled())
+                *failedPath = deleter.errorPath();
+            return deleter.errorString();
+        }
 
     } else {
+        // symlinks to folders are removed without touching the folder
         QFile file(info.absoluteFilePath());
         bool ok = file.remove();
         if (!ok)
             return file.errorString();
+        if (countProgress)
+            m_transfer.add(0, 1);
     }
     return QString();
 }
 
 void FileWorker::deleteFiles()
 {
-    int fileIndex = 0;
-    int fileCount = m_filenames.count();
+    // count all entries up front so progress is accurate
+    if (!scanSources()) {
+        emit errorOccurred(tr("Cancelled"), "");
+        return;
+    }
 
     foreach (QString filename, m_filenames) {
-        m_progress = 100 * fileIndex / fileCount;
-        emit progressChanged(m_progress, filename);
+        m_transfer.setFilename(filename);
 
         // stop if cancelled
         if (m_cancelled.loadAcquire() == Cancelled) {
@@ -246,30 +314,39 @@ void FileWorker::deleteFiles()
         }
 
         // delete file and stop if errors
-        QString errMsg = deleteFile(filename);
+        QString failedPath;
+        QString errMsg = deleteFile(filename, &failedPath);
         if (!errMsg.isEmpty()) {
-            emit errorOccurred(errMsg, filename);
+            emit errorOccurred(errMsg, failedPath.isEmpty() ? filename : failedPath);
             return;
         }
         emit fileDeleted(filename);
-
-        fileIndex++;
     }
 
-    m_progress = 100;
-    emit progressChanged(m_progress, "");
+    m_transfer.finish();
     emit done();
 }
 
 void FileWorker::copyOrMoveFiles()
 {
-    int fileIndex = 0;
-    int fileCount = m_filenames.count();
+    // moving to another file system cannot rename, so it has to copy
+    struct stat destInfo;
+    m_destDevice = ::stat(QFile::encodeName(m_destDirectory).constData(), &destInfo) == 0 ? destInfo.st_dev : 0;
+
+    // count all bytes and entries up front so progress is accurate
+    if (!scanSources()) {
+        emit errorOccurred(tr("Cancelled"), "");
+        return;
+    }
+
+    if (!m_journalPath.isEmpty()) {
+        m_journal.open(m_journalPath);
+    }
 
     QDir dest(m_destDirectory);
-    foreach (QString filename, m_filenames) {
-        m_progress = 100 * fileIndex / fileCount;
-        emit progressChanged(m_progress, filename);
+    for (int i = 0; i < m_filenames.count(); ++i) {
+        QString filename = m_filenames.at(i);
+        m_transfer.setFilename(filename);
 
         // stop if cancelled
         if (m_cancelled.loadAcquire() == Cancelled) {
@@ -279,12 +356,27 @@ void FileWorker::copyOrMoveFiles()
 
         QFileInfo fileInfo(filename);
         QString newname = dest.absoluteFilePath(fileInfo.fileName());
+        bool crossDevice = (m_mode == MoveMode && isOnOtherDevice(filename));
+        QString resumedTarget = m_journal.targetFor(filename);
+
+        if (!resumedTarget.isEmpty()) {
+            // resuming an interrupted job: keep the target and what is already there
+            newname = resumedTarget;
+            if (m_mode == MoveMode && !fileInfo.exists() && !fileInfo.isSymLink()) {
+                m_transfer.add(0, 1); // moved before the interruption
+                continue;
+            }
 
-        if (filename == newname) { // pasting over the source file, so copy a renamed file
+        } else if (filename == newname) { // pasting over the source file, so copy a renamed file
             if (QFileInfo::exists(newname)) {
-                newname = createNumberedFilename(newname);
+                newname = numberedTarget(newname, m_targets.value(i));
             }
 
+        } else if (crossDevice && fileInfo.isDir() && !fileInfo.isSymLink() &&
+                   QFileInfo(newname).isDir() && !QFileInfo(newname).isSymLink()) {
+            // folders moved to another file system are merged with existing
+            // folders, so that an interrupted move can be completed by moving again
+
         } else {
             // not pasting over the source file, but the destination already has the file: delete it
             if (QFileInfo::exists(newname)) {
@@ -296,6 +388,10 @@ void FileWorker::copyOrMoveFiles()
             }
         }
 
+        if (resumedTarget.isEmpty()) {
+            m_journal.setTarget(filename, newname);
+        }
+
         // move or copy and stop if errors
         QFile file(filename);
         if (m_mode == MoveMode) {
@@ -311,16 +407,42 @@ void FileWorker::copyOrMoveFiles()
                     return;
                 }
 
-            } else if (!file.rename(newname)) {
-                emit errorOccurred(file.errorString(), filename);
-                return;
+            } else if (crossDevice) {
+                // copy and remove each source once its copy is safe
+                QString failedPath;
+                QString errmsg = moveToOtherDevice(filename, newname, &failedPath);
+                if (!errmsg.isEmpty()) {
+                    emit errorOccurred(errmsg, failedPath.isEmpty() ? filename : failedPath);
+                    return;
+                }
+                continue;
+
+            } else if (::rename(QFile::encodeName(filename).constData(),
+                                QFile::encodeName(newname).constData()) != 0) {
+                if (errno != EXDEV) {
+                    emit errorOccurred(QString::fromLocal8Bit(::strerror(errno)), filename);
+                    return;
+                }
+
+                // different mounts of the same file system (e.g. bind mounts)
+                // share a device number but cannot be renamed across
+                QString failedPath;
+                QString errmsg = moveToOtherDevice(filename, newname, &failedPath);
+                if (!errmsg.isEmpty()) {
+                    emit errorOccurred(errmsg, failedPath.isEmpty() ? filename : failedPath);
+                    return;
+                }
+                continue;
             }
 
+            m_transfer.add(0, 1);
+
         } else { // CopyMode
             if (fileInfo.isDir()) {
-                QString errmsg = copyDirRecursively(filename, newname);
+                QString failedPath;
+                QString errmsg = copyDirRecursively(filename, newname, &failedPath);
                 if (!errmsg.isEmpty()) {
-                    emit errorOccurred(errmsg, filename);
+                    emit errorOccurred(errmsg, failedPath.isEmpty() ? filename : failedPath);
                     return;
                 }
             } else {
@@ -329,18 +451,37 @@ void FileWorker::copyOrMoveFiles()
                     emit errorOccurred(errmsg, filename);
                     return;
                 }
+                m_transfer.add(0, 1);
             }
         }
-
-        fileIndex++;
     }
 
-    m_progress = 100;
-    emit progressChanged(m_progress, "");
+    m_journal.close(true);
+    m_transfer.finish();
     emit done();
 }
 
-QString FileWorker::copyDirRecursively(QString srcDirectory, QString destDirectory)
+QString FileWorker::moveToOtherDevice(QString src, QString dest, QString *failedPath)
+{
+    if (QFileInfo(src).isDir()) {
+        return copyDirRecursively(src, dest, failedPath, true);
+    }
+
+    m_copier.setVerifyEnabled(true);
+    bool ok = m_copier.copy(src, dest);
+    m_copier.setVerifyEnabled(false);
+    if (!ok)
+        return m_copier.errorString();
+
+    QFile file(src);
+    if (!file.remove())
+        return file.errorString();
+
+    m_transfer.add(0, 1);
+    return QString();
+}
+
+QString FileWorker::copyDirRecursively(QString srcDirectory, QString destDirectory, QString* failedPath, bool removeSources)
 {
     QFileInfo srcInfo(srcDirectory);
     if (srcInfo.isSymLink()) {
@@ -349,6 +490,7 @@ QString FileWorker::copyDirRecursively(QString srcDirectory, QString destDirecto
         if (!targetFile.link(destDirectory))
             return targetFile.errorString();
 
+        m_transfer.add(0, 1);
         return QString();
     }
 
@@ -356,47 +498,25 @@ QString FileWorker::copyDirRecursively(QString srcDirectory, QString destDirecto
     if (!srcDir.exists())
         return tr("Source folder does not exist");
 
-    QDir destDir(destDirectory);
-    if (!destDir.exists()) {
-        QDir d(destDir);
-        d.cdUp();
-        if (!d.mkdir(destDir.dirName()))
-            return tr("Cannot create target folder %1").arg(destDirectory);
-    }
-
-    // copy files
-    QStringList names = srcDir.entryList(QDir::Files | QDir::Hidden);
-    for (int i = 0 ; i < names.count() ; ++i) {
-        // stop if cancelled
-        if (m_cancelled.loadAcquire() == Cancelled)
-            return tr("Cancelled");
-
-        QString filename = names.at(i);
-        emit progressChanged(m_progress, filename);
-        QString spath = srcDir.absoluteFilePath(filename);
-        QString dpath = destDir.absoluteFilePath(filename);
-        QString errmsg = copyOverwrite(spath, dpath);
-        if (!errmsg.isEmpty())
-            return errmsg;
-    }
-
-    // copy dirs
-    names = srcDir.entryList(QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Hidden);
-    for (int i = 0 ; i < names.count() ; ++i) {
-        // stop if cancelled
-        if (m_cancelled.loadAcquire() == Cancelled)
-            return tr("Cancelled");
-
-        QString filename = names.at(i);
-        emit progressChanged(m_progress, filename);
-        QString spath = srcDir.absoluteFilePath(filename);
-        QString dpath = destDir.absoluteFilePath(filename);
-        QString errmsg = copyDirRecursively(spath, dpath);
-        if (!errmsg.isEmpty())
-            return errmsg;
-    }
+    // files are copied by several threads, depending on the storage
+    TreeCopier copier(srcDirectory, destDirectory);
+    copier.setCopierCount(TreeCopier::copierCountFor(QStringList() << srcDirectory << destDirectory));
+    copier.setRemoveSources(removeSources);
+    copier.setJournal(&m_journal);
+    copier.setCancelCheck([this](){ return m_cancelled.loadAcquire() == Cancelled; });
+    copier.setProgressCallback([this](qint64 bytes, qint64 entries, const QString& filename){
+        m_transfer.add(bytes, entries);
+        if (!filename.isEmpty()) m_transfer.setFilename(filename);
+        m_journal.flush();
+    });
+    copier.setSparseCallback([this](qint64 bytes){ m_transfer.addSparse(bytes); });
+
+    if (copier.copy())
+        return QString();
 
-    return QString();
+    if (failedPath && !copier.wasCancelled())
+        *failedPath = copier.errorPath();
+    return copier.errorString();
 }
 
 QString FileWorker::copyOverwrite(QString src, QString dest)
@@ -411,10 +531,71 @@ QString FileWorker::copyOverwrite(QString src, QString dest)
         return QString();
     }
 
-    // normal file copy
-    QFile sfile(src);
-    if (!sfile.copy(dest))
-        return sfile.errorString();
+    // normal file copy, using the fastest method available
+    if (!m_copier.copy(src, dest))
+        return m_copier.errorString();
 
     return QString();
 }
+
+bool FileWorker::isOtherDevice(dev_t device) const
+{
+    // the device of the destination is unknown if it could not be read
+    return m_destDevice != 0 && device != m_destDevice;
+}
+
+bool FileWorker::isOnOtherDevice(const QString& filename) const
+{
+    struct stat st;
+    return ::lstat(QFile::encodeName(filename).constData(), &st) == 0 && isOtherDevice(st.st_dev);
+}
+
+bool FileWorker::scanSources()
+{
+    // Top-level files are counted here, folders are walked in parallel.
+    // Symbolic links are copied or deleted as links, so they are not followed.
+    // Entries that are moved by renaming count as one entry and no bytes.
+    bool countBytes = (m_mode == CopyMode || m_mode == MoveMode);
+    qint64 bytes = 0;
+    qint64 entries = 0;
+    QStringList dirs;
+    m_transfer.reset(0);
+
+    foreach (QString filename, m_filenames) {
+        struct stat st;
+        if (::lstat(QFile::encodeName(filename).constData(), &st) != 0) continue;
+
+        if (m_mode == MoveMode && (S_ISLNK(st.st_mode) || !isOtherDevice(st.st_dev))) {
+            entries++;
+        } else if (S_ISDIR(st.st_mode)) {
+            dirs.append(filename);
+        } else {
+            entries++;
+            if (S_ISREG(st.st_mode)) bytes += st.st_size;
+        }
+    }
+
+    if (!dirs.isEmpty()) {
+        m_transfer.setFilename(tr("Counting files…"));
+
+        QMutex mutex;
+        TreeWalker walker(dirs);
+        walker.setFollowSymLinks(false);
+        if (countBytes) {
+            walker.setFileVisitor([&](const QByteArray&, const char*, const struct stat& st){
+                QMutexLocker lock(&mutex);
+                bytes += st.st_size;
+            });
+        }
+
+        TreeWalker::Totals totals = walker.walk([this](){
+            return m_cancelled.loadAcquire() == Cancelled;
+        });
+        entries += totals.dirs + totals.files;
+    }
+
+    if (m_cancelled.loadAcquire() == Cancelled) return false;
+
+    m_transfer.reset(entries, countBytes ? bytes : 0);
+    return true;
+}
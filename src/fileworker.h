@@ -23,8 +23,12 @@
 #ifndef FILEWORKER_H
 #define FILEWORKER_H
 
+#include <sys/types.h>
 #include <QThread>
 #include <QDir>
+#include "filecopier.h"
+#include "transferprogress.h"
+#include "transferjournal.h"
 
 /**
  * @brief FileWorker does delete, copy and move files in the background.
@@ -45,9 +49,18 @@ public:
 
     void cancel();
 
-signals: // signals, can be connected from a thread to another
-    void progressChanged(int progress, QString filename);
+    // Copy and move jobs record their progress in this journal and resume
+    // from it, see TransferJournal. Call before starting.
+    void setJournal(QString path) { m_journalPath = path; }
+
+    // Targets planned by TransferPlanner, one for each file, so that numbered
+    // names need not be probed for. Call before starting.
+    void setTargets(QStringList targets) { m_targets = targets; }
 
+    // progress of the current operation, to be sampled from other threads
+    const TransferProgress& transferProgress() const { return m_transfer; }
+
+signals: // signals, can be connected from a thread to another
     // one of these is emitted when thread ends
     void done();
     void errorOccurred(QString message, QString filename);
@@ -67,18 +80,29 @@ private:
 
     bool validateFilenames(const QStringList &filenames);
 
-    QString deleteFile(QString filename);
+    QString deleteFile(QString filename, QString* failedPath = nullptr);
     void deleteFiles();
     void copyOrMoveFiles();
     void symlinkFiles();
-    QString copyDirRecursively(QString srcDirectory, QString destDirectory);
+    QString copyDirRecursively(QString srcDirectory, QString destDirectory,
+                               QString* failedPath = nullptr, bool removeSources = false);
+    QString moveToOtherDevice(QString src, QString dest, QString* failedPath = nullptr);
     QString copyOverwrite(QString src, QString dest);
+    bool scanSources();
+    bool isOtherDevice(dev_t device) const;
+    bool isOnOtherDevice(const QString& filename) const;
+    void invalidateCaches();
 
     FileWorker::Mode m_mode;
     QStringList m_filenames;
+    QStringList m_targets;
     QString m_destDirectory;
+    dev_t m_destDevice = {0};
     QAtomicInt m_cancelled; // atomic so no locks needed
-    int m_progress;
+    TransferProgress m_transfer;
+    FileCopier m_copier;
+    QString m_journalPath;
+    TransferJournal m_journal;
 };
 
 #endif // FILEWORKER_H
@@ -22,7 +22,6 @@
 
 #include "globals.h"
 #include <QLocale>
-#include <QProcess>
 
 QString suffixToIconName(QString suffix)
 {
@@ -114,19 +113,3 @@ QString infoToIconName(const StatFileInfo &info)
     }
     return "file";
 }
-
-QString execute(QString command, QStringList arguments, bool mergeErrorStream)
-{
-    QProcess process;
-    process.setReadChannel(QProcess::StandardOutput);
-    if (mergeErrorStream)
-        process.setProcessChannelMode(QProcess::MergedChannels);
-    process.start(command, arguments);
-    if (!process.waitForStarted())
-        return QString();
-    if (!process.waitForFinished())
-        return QString();
-
-    QByteArray result = process.readAll();
-    return QString::fromUtf8(result);
-}
@@ -38,6 +38,9 @@
 #include "filedata.h"
 #include "searchengine.h"
 #include "engine.h"
+#include "diskusagemodel.h"
+#include "textdocumentmodel.h"
+#include "hexviewmodel.h"
 #include "consolemodel.h"
 #include "settingshandler.h"
 
@@ -52,6 +55,9 @@ int main(int argc, char *argv[])
     qRegisterMetaType<QList<StatFileInfo>>("QList<StatFileInfo>");
     qmlRegisterType<FileModel>("harbour.file.browser.FileModel", 1, 0, "FileModel");
     qmlRegisterType<FileData>("harbour.file.browser.FileData", 1, 0, "FileData");
+    qmlRegisterType<DiskUsageModel>("harbour.file.browser.DiskUsageModel", 1, 0, "DiskUsageModel");
+    qmlRegisterType<TextDocumentModel>("harbour.file.browser.TextDocumentModel", 1, 0, "TextDocumentModel");
+    qmlRegisterType<HexViewModel>("harbour.file.browser.HexViewModel", 1, 0, "HexViewModel");
     qmlRegisterType<SearchEngine>("harbour.file.browser.SearchEngine", 1, 0, "SearchEngine");
     qmlRegisterType<ConsoleModel>("harbour.file.browser.ConsoleModel", 1, 0, "ConsoleModel");
 
@@ -0,0 +1,272 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <limits>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QDebug>
+#include "hexviewmodel.h"
+#include "readonlyfile.h"
+
+// Rows can have at most this many columns.
+#ifndef HEXVIEW_MAX_BYTES_PER_ROW
+#define HEXVIEW_MAX_BYTES_PER_ROW 64
+#endif
+
+enum {
+    TextRole = Qt::UserRole + 1,
+    OffsetRole = Qt::UserRole + 2
+};
+
+namespace {
+    const char hexDigits[] = "0123456789abcdef";
+
+    // two hex digits for every byte value, so that every byte
+    // is formatted with a single lookup
+    struct HexTable {
+        char pairs[256][2];
+
+        HexTable() {
+            for (int i = 0; i < 256; ++i) {
+                pairs[i][0] = hexDigits[i >> 4];
+                pairs[i][1] = hexDigits[i & 0xf];
+            }
+        }
+    };
+
+    const HexTable hexTable;
+}
+
+// One opened file, shared between the model and the loader.
+class HexViewModel::LoadState
+{
+public:
+    explicit LoadState(QString path) : path(path) {}
+
+    QString path;
+    QMutex mutex;
+    QSharedPointer<ReadOnlyFile> file;
+};
+
+class HexViewModel::Loader : public QRunnable
+{
+public:
+    Loader(HexViewModel* model, int generation, QSharedPointer<LoadState> state) :
+        m_model(model), m_generation(generation), m_state(state) {}
+
+    void run() override {
+        QSharedPointer<ReadOnlyFile> file(new ReadOnlyFile(m_state->path));
+        file->advise(0, file->size(), ReadOnlyFile::Random);
+
+        {
+            QMutexLocker locker(&m_state->mutex);
+            m_state->file = file;
+        }
+
+        QMetaObject::invokeMethod(m_model, "finishLoading", Qt::QueuedConnection,
+                                  Q_ARG(int, m_generation));
+    }
+
+private:
+    HexViewModel* m_model;
+    int m_generation;
+    QSharedPointer<LoadState> m_state;
+};
+
+HexViewModel::HexViewModel(QObject *parent) : QAbstractListModel(parent)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+HexViewModel::~HexViewModel()
+{
+    m_pool.waitForDone();
+}
+
+int HexViewModel::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    if (!m_file) return 0;
+
+    qint64 rows = (m_file->size() + m_bytesPerRow - 1) / m_bytesPerRow;
+    return int(qMin(rows, qint64(std::numeric_limits<int>::max())));
+}
+
+QVariant HexViewModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() > rowCount()-1)
+        return QVariant();
+
+    qint64 offset = qint64(index.row()) * m_bytesPerRow;
+
+    switch (role) {
+
+    case Qt::DisplayRole:
+    case TextRole: {
+        // reads less if the file got shorter since it was opened
+        char row[HEXVIEW_MAX_BYTES_PER_ROW];
+        qint64 length = m_file->read(offset, row, qMin(qint64(m_bytesPerRow), m_file->size() - offset));
+        return formatRow(row, int(qMax(qint64(0), length)), m_bytesPerRow, offset, offsetDigits());
+    }
+
+    case OffsetRole:
+        return double(offset);
+
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> HexViewModel::roleNames() const
+{
+    QHash<int, QByteArray> roles = QAbstractListModel::roleNames();
+    roles.insert(TextRole, QByteArray("text"));
+    roles.insert(OffsetRole, QByteArray("offset"));
+    return roles;
+}
+
+void HexViewModel::setPath(QString path)
+{
+    if (m_path == path) return;
+    m_path = path;
+    emit pathChanged();
+    reload();
+}
+
+void HexViewModel::setBytesPerRow(int bytesPerRow)
+{
+    bytesPerRow = qBound(1, bytesPerRow, HEXVIEW_MAX_BYTES_PER_ROW);
+    if (m_bytesPerRow == bytesPerRow) return;
+
+    // rows are formatted on demand, so nothing has to be recomputed
+    beginResetModel();
+    m_bytesPerRow = bytesPerRow;
+    endResetModel();
+    emit bytesPerRowChanged();
+}
+
+double HexViewModel::size() const
+{
+    return m_file ? double(m_file->size()) : 0.0;
+}
+
+int HexViewModel::rowForOffset(double offset) const
+{
+    if (!m_file || offset < 0) return 0;
+    qint64 row = qint64(offset) / m_bytesPerRow;
+    return int(qBound(qint64(0), row, qint64(qMax(0, rowCount()-1))));
+}
+
+double HexViewModel::offsetForRow(int row) const
+{
+    return double(qint64(qMax(0, row)) * m_bytesPerRow);
+}
+
+void HexViewModel::reload()
+{
+    beginResetModel();
+    m_file.clear();
+    m_errorMessage.clear();
+    endResetModel();
+
+    m_state.clear();
+    m_loading = !m_path.isEmpty();
+    emit loaded();
+
+    if (m_path.isEmpty()) return;
+
+    qDebug() << "[HexViewModel] loading" << m_path;
+    m_state.reset(new LoadState(m_path));
+    m_pool.start(new Loader(this, ++m_generation, m_state));
+}
+
+QString HexViewModel::formatRow(const char* data, int length, int bytesPerRow,
+                                qint64 offset, int offsetDigits)
+{
+    bytesPerRow = qBound(1, bytesPerRow, HEXVIEW_MAX_BYTES_PER_ROW);
+    length = qBound(0, length, bytesPerRow);
+    offsetDigits = qBound(1, offsetDigits, 16);
+
+    // offset, ': ', three chars per byte, a space, and one char per byte
+    char buffer[16 + 2 + 3*HEXVIEW_MAX_BYTES_PER_ROW + 1 + HEXVIEW_MAX_BYTES_PER_ROW];
+    char* out = buffer;
+
+    for (int shift = 4*(offsetDigits-1); shift >= 0; shift -= 4) {
+        *out++ = hexDigits[(offset >> shift) & 0xf];
+    }
+
+    *out++ = ':';
+    *out++ = ' ';
+
+    for (int i = 0; i < bytesPerRow; ++i) {
+        if (i < length) {
+            const char* pair = hexTable.pairs[static_cast<unsigned char>(data[i])];
+            *out++ = pair[0];
+            *out++ = pair[1];
+        } else {
+            *out++ = ' ';
+            *out++ = ' ';
+        }
+        *out++ = ' ';
+    }
+
+    *out++ = ' ';
+
+    for (int i = 0; i < length; ++i) {
+        char c = data[i];
+        *out++ = (c >= 32 && c <= 126) ? c : '.';
+    }
+
+    return QString::fromLatin1(buffer, int(out - buffer));
+}
+
+void HexViewModel::finishLoading(int generation)
+{
+    if (generation != m_generation || !m_state) return; // outdated
+
+    QSharedPointer<ReadOnlyFile> file;
+
+    {
+        QMutexLocker locker(&m_state->mutex);
+        file = m_state->file;
+    }
+
+    beginResetModel();
+    if (file && file->isValid()) {
+        m_file = file;
+    } else if (file) {
+        m_errorMessage = file->errorString();
+    }
+    endResetModel();
+
+    m_state.clear();
+    m_loading = false;
+    emit loaded();
+}
+
+int HexViewModel::offsetDigits() const
+{
+    // enough digits for the last offset, at least four
+    int digits = 4;
+    qint64 last = m_file ? m_file->size() - 1 : 0;
+    while (digits < 16 && (last >> (4*digits)) != 0) digits++;
+    return digits;
+}
@@ -0,0 +1,100 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HEXVIEWMODEL_H
+#define HEXVIEWMODEL_H
+
+#include <QAbstractListModel>
+#include <QSharedPointer>
+#include <QThreadPool>
+
+class ReadOnlyFile;
+
+/**
+ * @brief The HexViewModel class provides a hex dump of a file, row by row.
+ *
+ * The file is opened in the background. Rows are read and formatted only
+ * when they are requested, so files of any size can be inspected. Changing
+ * the number of bytes per row does not require any recomputation.
+ */
+class HexViewModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(QString path READ path() WRITE setPath(QString) NOTIFY pathChanged())
+    Q_PROPERTY(int bytesPerRow READ bytesPerRow() WRITE setBytesPerRow(int) NOTIFY bytesPerRowChanged())
+    Q_PROPERTY(double size READ size() NOTIFY loaded())
+    Q_PROPERTY(bool loading READ loading() NOTIFY loaded())
+    Q_PROPERTY(QString errorMessage READ errorMessage() NOTIFY loaded())
+
+public:
+    explicit HexViewModel(QObject *parent = nullptr);
+    ~HexViewModel();
+
+    // methods needed by ListView
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QHash<int, QByteArray> roleNames() const;
+
+    // property accessors
+    QString path() const { return m_path; }
+    void setPath(QString path);
+    int bytesPerRow() const { return m_bytesPerRow; }
+    void setBytesPerRow(int bytesPerRow);
+    double size() const;
+    bool loading() const { return m_loading; }
+    QString errorMessage() const { return m_errorMessage; }
+
+    // methods accessible from QML
+    Q_INVOKABLE int rowForOffset(double offset) const;
+    Q_INVOKABLE double offsetForRow(int row) const;
+    Q_INVOKABLE void reload();
+
+    // Formats one row like this, with 'bytesPerRow' columns:
+    // "0010: 48 65 6c 6c 6f 0a  Hello."
+    // Shorter rows are padded so that all columns line up.
+    static QString formatRow(const char* data, int length, int bytesPerRow,
+                             qint64 offset, int offsetDigits);
+
+signals:
+    void pathChanged();
+    void bytesPerRowChanged();
+    void loaded();
+
+private slots:
+    void finishLoading(int generation);
+
+private:
+    class LoadState;
+    class Loader;
+
+    int offsetDigits() const;
+
+    QString m_path;
+    int m_bytesPerRow = {16};
+    bool m_loading = {false};
+    QString m_errorMessage;
+    QSharedPointer<ReadOnlyFile> m_file;
+
+    int m_generation = {0};
+    QSharedPointer<LoadState> m_state;
+    QThreadPool m_pool;
+};
+
+#endif // HEXVIEWMODEL_H
@@ -0,0 +1,255 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <QFile>
+#include "imageprobe.h"
+
+// enough for the headers of all supported formats, including
+// the NETSCAPE extension of GIFs and the acTL chunk of APNGs
+#define IMAGEPROBE_HEADER_SIZE 16384
+
+// maximum number of extra reads when skipping JPEG segments
+// that do not fit into the header buffer
+#define IMAGEPROBE_MAX_JPEG_SEEKS 32
+
+namespace {
+    inline quint16 be16(const uchar* p) { return quint16((p[0] << 8) | p[1]); }
+    inline quint32 be32(const uchar* p) { return (quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | p[3]; }
+    inline quint16 le16(const uchar* p) { return quint16(p[0] | (p[1] << 8)); }
+    inline quint32 le24(const uchar* p) { return quint32(p[0]) | (quint32(p[1]) << 8) | (quint32(p[2]) << 16); }
+    inline quint32 le32(const uchar* p) { return le24(p) | (quint32(p[3]) << 24); }
+}
+
+ImageProbe::Info ImageProbe::probe(const QString& path)
+{
+    QByteArray buffer;
+    return probe(path, buffer);
+}
+
+QList<ImageProbe::Info> ImageProbe::probe(const QStringList& paths)
+{
+    QList<Info> ret;
+    ret.reserve(paths.length());
+    QByteArray buffer;
+
+    for (const auto& i : paths) {
+        ret.append(probe(i, buffer));
+    }
+
+    return ret;
+}
+
+ImageProbe::Info ImageProbe::probe(const QString& path, QByteArray& buffer)
+{
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return Info();
+
+    if (buffer.size() < IMAGEPROBE_HEADER_SIZE) buffer.resize(IMAGEPROBE_HEADER_SIZE);
+    const uchar* data = reinterpret_cast<const uchar*>(buffer.constData());
+    ssize_t size = ::pread(fd, buffer.data(), IMAGEPROBE_HEADER_SIZE, 0);
+
+    Info info;
+    if (size > 0) info = parse(data, size_t(size), fd);
+
+    ::close(fd);
+    return info;
+}
+
+ImageProbe::Info ImageProbe::parse(const uchar* data, size_t size, int fd)
+{
+    if (size >= 24 && memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0) {
+        return parsePng(data, size);
+    } else if (size >= 13 && (memcmp(data, "GIF87a", 6) == 0 || memcmp(data, "GIF89a", 6) == 0)) {
+        return parseGif(data, size);
+    } else if (size >= 30 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WEBP", 4) == 0) {
+        return parseWebP(data, size);
+    } else if (size >= 4 && data[0] == 0xFF && data[1] == 0xD8) {
+        return parseJpeg(data, size, fd);
+    }
+
+    return Info();
+}
+
+ImageProbe::Info ImageProbe::parsePng(const uchar* data, size_t size)
+{
+    Info info;
+    if (size < 33 || memcmp(data + 12, "IHDR", 4) != 0) return info;
+
+    info.format = Png;
+    info.width = int(be32(data + 16));
+    info.height = int(be32(data + 20));
+    info.bitDepth = data[24];
+
+    // APNGs have an acTL chunk before the first IDAT chunk
+    size_t pos = 33; // skip signature and IHDR
+
+    while (pos + 8 <= size) {
+        size_t length = be32(data + pos);
+        const uchar* type = data + pos + 4;
+        if (memcmp(type, "acTL", 4) == 0) {
+            info.animated = true;
+            break;
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            break;
+        }
+
+        if (length > size) break;
+        pos += 8 + length + 4;
+    }
+
+    return info;
+}
+
+ImageProbe::Info ImageProbe::parseGif(const uchar* data, size_t size)
+{
+    Info info;
+    info.format = Gif;
+    info.width = le16(data + 6);
+    info.height = le16(data + 8);
+    info.bitDepth = ((data[10] >> 4) & 0x07) + 1;
+
+    // GIFs are animated if they have a NETSCAPE2.0 looping extension
+    // or more than one frame. Blocks are only checked as far as they
+    // are in the header buffer.
+    size_t pos = 13;
+    if (data[10] & 0x80) pos += 3 * (1 << ((data[10] & 0x07) + 1)); // global color table
+
+    int frames = 0;
+
+    while (pos < size) {
+        if (data[pos] == 0x21 && pos + 2 < size) { // extension
+            if (data[pos + 1] == 0xFF && pos + 14 <= size && data[pos + 2] == 11 &&
+                    (memcmp(data + pos + 3, "NETSCAPE2.0", 11) == 0 ||
+                     memcmp(data + pos + 3, "ANIMEXTS1.0", 11) == 0)) {
+                info.animated = true;
+                break;
+            }
+            pos += 2;
+        } else if (data[pos] == 0x2C && pos + 10 <= size) { // image descriptor
+            if (++frames > 1) {
+                info.animated = true;
+                break;
+            }
+
+            uchar packed = data[pos + 9];
+            pos += 10;
+            if (packed & 0x80) pos += 3 * (1 << ((packed & 0x07) + 1)); // local color table
+            pos += 1; // LZW minimum code size
+        } else {
+            break; // trailer, garbage, or end of buffer
+        }
+
+        // skip data sub-blocks
+        while (pos < size && data[pos] != 0) {
+            pos += 1 + data[pos];
+        }
+        pos += 1; // block terminator
+    }
+
+    return info;
+}
+
+ImageProbe::Info ImageProbe::parseWebP(const uchar* data, size_t size)
+{
+    Q_UNUSED(size) // parse() made sure the header is complete
+
+    Info info;
+    const uchar* chunk = data + 12;
+    const uchar* payload = chunk + 8;
+
+    if (memcmp(chunk, "VP8 ", 4) == 0) {
+        // lossy: frame tag followed by the start code and dimensions
+        if (payload[3] != 0x9D || payload[4] != 0x01 || payload[5] != 0x2A) return info;
+        info.width = le16(payload + 6) & 0x3FFF;
+        info.height = le16(payload + 8) & 0x3FFF;
+    } else if (memcmp(chunk, "VP8L", 4) == 0) {
+        // lossless: signature byte followed by 14 bit dimensions minus one
+        if (payload[0] != 0x2F) return info;
+        quint32 bits = le32(payload + 1);
+        info.width = int(bits & 0x3FFF) + 1;
+        info.height = int((bits >> 14) & 0x3FFF) + 1;
+    } else if (memcmp(chunk, "VP8X", 4) == 0) {
+        // extended: flags followed by 24 bit canvas dimensions minus one
+        info.animated = (payload[0] & 0x02);
+        info.width = int(le24(payload + 4)) + 1;
+        info.height = int(le24(payload + 7)) + 1;
+    } else {
+        return info;
+    }
+
+    info.format = WebP;
+    info.bitDepth = 8;
+    return info;
+}
+
+ImageProbe::Info ImageProbe::parseJpeg(const uchar* data, size_t size, int fd)
+{
+    Info info;
+    uchar extra[10];
+    int seeks = 0;
+    off_t pos = 2;
+
+    // Returns a pointer to 'count' bytes at 'pos', either from the
+    // header buffer or read into 'extra'. Returns nullptr on failure.
+    auto bytesAt = [&](off_t offset, size_t count) -> const uchar* {
+        if (offset + off_t(count) <= off_t(size)) return data + offset;
+        if (count > sizeof(extra) || ++seeks > IMAGEPROBE_MAX_JPEG_SEEKS) return nullptr;
+        if (::pread(fd, extra, count, offset) != ssize_t(count)) return nullptr;
+        return extra;
+    };
+
+    while (true) {
+        const uchar* p = bytesAt(pos, 2);
+        if (!p || p[0] != 0xFF) return info;
+
+        uchar marker = p[1];
+        if (marker == 0xFF) { // fill byte
+            pos += 1;
+            continue;
+        } else if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) { // no payload
+            pos += 2;
+            continue;
+        } else if (marker == 0xD9 || marker == 0xDA) { // end of image or start of scan
+            return info;
+        }
+
+        bool isSof = marker >= 0xC0 && marker <= 0xCF &&
+                marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+
+        if (isSof) {
+            p = bytesAt(pos + 2, 8);
+            if (!p) return info;
+            info.format = Jpeg;
+            info.bitDepth = p[2];
+            info.height = be16(p + 3);
+            info.width = be16(p + 5);
+            return info;
+        }
+
+        p = bytesAt(pos + 2, 2);
+        if (!p) return info;
+        quint16 length = be16(p);
+        if (length < 2) return info;
+        pos += 2 + length;
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGEPROBE_H
+#define IMAGEPROBE_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QByteArray>
+
+/**
+ * @brief The ImageProbe class reads image dimensions from file headers.
+ *
+ * Only the first few kilobytes of a file are read, and no pixel data is decoded.
+ * Supported formats are PNG (including APNG), GIF, WebP (lossy, lossless, and
+ * extended), and JPEG. JPEG files with very large APP segments (e.g. big EXIF
+ * thumbnails) need a few additional small reads to skip to the frame header.
+ */
+class ImageProbe
+{
+public:
+    enum Format { Unknown, Png, Gif, WebP, Jpeg };
+
+    struct Info {
+        Format format = {Unknown};
+        int width = {-1};
+        int height = {-1};
+        int bitDepth = {0}; // bits per channel/sample, 0 if unknown
+        bool animated = {false};
+        bool isValid() const { return format != Unknown && width >= 0 && height >= 0; }
+    };
+
+    // Probes a single file. Returns an invalid Info if the file
+    // cannot be read or is not a supported image.
+    static Info probe(const QString& path);
+
+    // Probes all files in order. The read buffer is shared between files,
+    // so this is the preferred way to probe whole directory listings.
+    static QList<Info> probe(const QStringList& paths);
+
+private:
+    static Info probe(const QString& path, QByteArray& buffer);
+    static Info parse(const uchar* data, size_t size, int fd);
+    static Info parsePng(const uchar* data, size_t size);
+    static Info parseGif(const uchar* data, size_t size);
+    static Info parseWebP(const uchar* data, size_t size);
+    static Info parseJpeg(const uchar* data, size_t size, int fd);
+};
+
+#endif // IMAGEPROBE_H
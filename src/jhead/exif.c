@@ -31,16 +31,7 @@
 
 #include <math.h>
 
-static unsigned char * DirWithThumbnailPtrs;
-static double FocalplaneXRes;
-static double FocalplaneUnits;
-static int ExifImageWidth;
-int MotorolaOrder = 0;
-
-// for fixing the rotation.
-static void * OrientationPtr[2];
-static int    OrientationNumFormat[2];
-int NumOrientations = 0;
+// Parser state lives in JheadContext_t (see jhead.h).
 
 typedef struct {
     unsigned short Tag;
@@ -322,9 +313,9 @@ static const TagTable_t TagTable[] = {
 //--------------------------------------------------------------------------
 // Convert a 16 bit unsigned value to file's native byte order
 //--------------------------------------------------------------------------
-static void Put16u(void * Short, unsigned short PutValue)
+static void Put16u(JheadContext_t * Ctx, void * Short, unsigned short PutValue)
 {
-    if (MotorolaOrder){
+    if (Ctx->MotorolaOrder){
         ((uchar *)Short)[0] = (uchar)(PutValue>>8);
         ((uchar *)Short)[1] = (uchar)PutValue;
     }else{
@@ -336,9 +327,9 @@ static void Put16u(void * Short, unsigned short PutValue)
 //--------------------------------------------------------------------------
 // Convert a 16 bit unsigned value from file's native byte order
 //--------------------------------------------------------------------------
-int Get16u(void * Short)
+int Get16u(JheadContext_t * Ctx, void * Short)
 {
-    if (MotorolaOrder){
+    if (Ctx->MotorolaOrder){
         return (((uchar *)Short)[0] << 8) | ((uchar *)Short)[1];
     }else{
         return (((uchar *)Short)[1] << 8) | ((uchar *)Short)[0];
@@ -348,9 +339,9 @@ int Get16u(void * Short)
 //--------------------------------------------------------------------------
 // Convert a 32 bit signed value from file's native byte order
 //--------------------------------------------------------------------------
-int Get32s(void * Long)
+int Get32s(JheadContext_t * Ctx, void * Long)
 {
-    if (MotorolaOrder){
+    if (Ctx->MotorolaOrder){
         return  ((( char *)Long)[0] << 24) | (((uchar *)Long)[1] << 16)
               | (((uchar *)Long)[2] << 8 ) | (((uchar *)Long)[3] << 0 );
     }else{
@@ -362,9 +353,9 @@ int Get32s(void * Long)
 //--------------------------------------------------------------------------
 // Convert a 32 bit unsigned value to file's native byte order
 //--------------------------------------------------------------------------
-void Put32u(void * Value, unsigned PutValue)
+void Put32u(JheadContext_t * Ctx, void * Value, unsigned PutValue)
 {
-    if (MotorolaOrder){
+    if (Ctx->MotorolaOrder){
         ((uchar *)Value)[0] = (uchar)(PutValue>>24);
         ((uchar *)Value)[1] = (uchar)(PutValue>>16);
         ((uchar *)Value)[2] = (uchar)(PutValue>>8);
@@ -380,15 +371,15 @@ void Put32u(void * Value, unsigned PutValue)
 //--------------------------------------------------------------------------
 // Convert a 32 bit unsigned value from file's native byte order
 //--------------------------------------------------------------------------
-unsigned Get32u(void * Long)
+unsigned Get32u(JheadContext_t * Ctx, void * Long)
 {
-    return (unsigned)Get32s(Long) & 0xffffffff;
+    return (unsigned)Get32s(Ctx, Long) & 0xffffffff;
 }
 
 //--------------------------------------------------------------------------
 // Display a number as one of its many formats
 //--------------------------------------------------------------------------
-void PrintFormatNumber(void * ValuePtr, int Format, int ByteCount)
+void PrintFormatNumber(JheadContext_t * Ctx, void * ValuePtr, int Format, int ByteCount)
 {
     int s,n;
 
@@ -396,17 +387,17 @@ void PrintFormatNumber(void * ValuePtr, int Format, int ByteCount)
         switch(Format){
             case FMT_SBYTE:
             case FMT_BYTE:      xprintf("%02x",*(uchar *)ValuePtr); s=1;  break;
-            case FMT_USHORT:    xprintf("%d",Get16u(ValuePtr)); s=2;      break;
+            case FMT_USHORT:    xprintf("%d",Get16u(Ctx, ValuePtr)); s=2;      break;
             case FMT_ULONG:     
-            case FMT_SLONG:     xprintf("%d",Get32s(ValuePtr)); s=4;      break;
-            case FMT_SSHORT:    xprintf("%hd",(signed short)Get16u(ValuePtr)); s=2; break;
+            case FMT_SLONG:     xprintf("%d",Get32s(Ctx, ValuePtr)); s=4;      break;
+            case FMT_SSHORT:    xprintf("%hd",(signed short)Get16u(Ctx, ValuePtr)); s=2; break;
             case FMT_URATIONAL:
-                xprintf("%u/%u",Get32s(ValuePtr), Get32s(4+(char *)ValuePtr));
+                xprintf("%u/%u",Get32s(Ctx, ValuePtr), Get32s(Ctx, 4+(char *)ValuePtr));
                 s = 8;
                 break;
 
             case FMT_SRATIONAL: 
-                xprintf("%d/%d",Get32s(ValuePtr), Get32s(4+(char *)ValuePtr));
+                xprintf("%d/%d",Get32s(Ctx, ValuePtr), Get32s(Ctx, 4+(char *)ValuePtr));
                 s = 8;
                 break;
 
@@ -429,7 +420,7 @@ void PrintFormatNumber(void * ValuePtr, int Format, int ByteCount)
 //--------------------------------------------------------------------------
 // Evaluate number, be it int, rational, or float from directory.
 //--------------------------------------------------------------------------
-double ConvertAnyFormat(void * ValuePtr, int Format)
+double ConvertAnyFormat(JheadContext_t * Ctx, void * ValuePtr, int Format)
 {
     double Value;
     Value = 0;
@@ -438,15 +429,15 @@ double ConvertAnyFormat(void * ValuePtr, int Format)
         case FMT_SBYTE:     Value = *(signed char *)ValuePtr;  break;
         case FMT_BYTE:      Value = *(uchar *)ValuePtr;        break;
 
-        case FMT_USHORT:    Value = Get16u(ValuePtr);          break;
-        case FMT_ULONG:     Value = Get32u(ValuePtr);          break;
+        case FMT_USHORT:    Value = Get16u(Ctx, ValuePtr);          break;
+        case FMT_ULONG:     Value = Get32u(Ctx, ValuePtr);          break;
 
         case FMT_URATIONAL:
         case FMT_SRATIONAL: 
             {
                 int Num,Den;
-                Num = Get32s(ValuePtr);
-                Den = Get32s(4+(char *)ValuePtr);
+                Num = Get32s(Ctx, ValuePtr);
+                Den = Get32s(Ctx, 4+(char *)ValuePtr);
                 if (Den == 0){
                     Value = 0;
                 }else{
@@ -459,8 +450,8 @@ double ConvertAnyFormat(void * ValuePtr, int Format)
                 break;
             }
 
-        case FMT_SSHORT:    Value = (signed short)Get16u(ValuePtr);  break;
-        case FMT_SLONG:     Value = Get32s(ValuePtr);                break;
+        case FMT_SSHORT:    Value = (signed short)Get16u(Ctx, ValuePtr);  break;
+        case FMT_SLONG:     Value = Get32s(Ctx, ValuePtr);                break;
 
         // Not sure if this is correct (never seen float used in Exif format)
         case FMT_SINGLE:    Value = (double)*(float *)ValuePtr;      break;
@@ -475,7 +466,7 @@ double ConvertAnyFormat(void * ValuePtr, int Format)
 //--------------------------------------------------------------------------
 // Process one of the nested EXIF directories.
 //--------------------------------------------------------------------------
-static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase, 
+static void ProcessExifDir(JheadContext_t * Ctx, unsigned char * DirStart, unsigned char * OffsetBase, 
         unsigned ExifLength, int NestingLevel)
 {
     int de;
@@ -494,7 +485,7 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
     IndentString[NestingLevel * 4] = '\0';
 
 
-    NumDirEntries = Get16u(DirStart);
+    NumDirEntries = Get16u(Ctx, DirStart);
     #define DIR_ENTRY_ADDR(Start, Entry) (Start+2+12*(Entry))
 
     {
@@ -527,9 +518,11 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
         unsigned char * DirEntry;
         DirEntry = DIR_ENTRY_ADDR(DirStart, de);
 
-        Tag = Get16u(DirEntry);
-        Format = Get16u(DirEntry+2);
-        Components = Get32u(DirEntry+4);
+        if (Ctx->DateTimeOnly && Ctx->DateTimeOriginalFound) return;
+
+        Tag = Get16u(Ctx, DirEntry);
+        Format = Get16u(Ctx, DirEntry+2);
+        Components = Get32u(Ctx, DirEntry+4);
 
         if ((Format-1) >= NUM_FORMATS) {
             // (-1) catches illegal zero case as unsigned underflows to positive large.
@@ -546,7 +539,7 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
 
         if (ByteCount > 4){
             unsigned OffsetVal;
-            OffsetVal = Get32u(DirEntry+8);
+            OffsetVal = Get32u(Ctx, DirEntry+8);
             // If its bigger than 4 bytes, the dir entry contains an offset.
             if (OffsetVal+ByteCount > ExifLength){
                 // Bogus pointer offset and / or bytecount value
@@ -555,8 +548,8 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
             }
             ValuePtr = OffsetBase+OffsetVal;
 
-            if (OffsetVal > ImageInfo.LargestExifOffset){
-                ImageInfo.LargestExifOffset = OffsetVal;
+            if (OffsetVal > Ctx->ImageInfo.LargestExifOffset){
+                Ctx->ImageInfo.LargestExifOffset = OffsetVal;
             }
 
             if (DumpExifMap){
@@ -567,11 +560,17 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
             ValuePtr = DirEntry+8;
         }
 
+        if (Ctx->DateTimeOnly
+                && (Tag == TAG_MAKER_NOTE || Tag == TAG_GPSINFO || Tag == TAG_INTEROP_OFFSET)){
+            // these directories never hold the date
+            continue;
+        }
+
         if (Tag == TAG_MAKER_NOTE){
             if (ShowTags){
                 xprintf("%s    Maker note: ",IndentString);
             }
-            ProcessMakerNote(ValuePtr, ByteCount, OffsetBase, ExifLength);
+            ProcessMakerNote(Ctx, ValuePtr, ByteCount, OffsetBase, ExifLength);
             continue;
         }
 
@@ -594,7 +593,7 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
                     if(ByteCount>1){
                         xprintf("%.*ls\n", ByteCount/2, (wchar_t *)ValuePtr);
                     }else{
-                        PrintFormatNumber(ValuePtr, Format, ByteCount);
+                        PrintFormatNumber(Ctx, ValuePtr, Format, ByteCount);
                         xprintf("\n");
                     }
                     break;
@@ -626,7 +625,7 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
 
                 default:
                     // Handle arrays of numbers later (will there ever be?)
-                    PrintFormatNumber(ValuePtr, Format, ByteCount);
+                    PrintFormatNumber(Ctx, ValuePtr, Format, ByteCount);
                     xprintf("\n");
             }
         }
@@ -635,36 +634,37 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
         switch(Tag){
 
             case TAG_MAKE:
-                strncpy(ImageInfo.CameraMake, (char *)ValuePtr, ByteCount < 31 ? ByteCount : 31);
+                strncpy(Ctx->ImageInfo.CameraMake, (char *)ValuePtr, ByteCount < 31 ? ByteCount : 31);
                 break;
 
             case TAG_MODEL:
-                strncpy(ImageInfo.CameraModel, (char *)ValuePtr, ByteCount < 39 ? ByteCount : 39);
+                strncpy(Ctx->ImageInfo.CameraModel, (char *)ValuePtr, ByteCount < 39 ? ByteCount : 39);
                 break;
 
             case TAG_DATETIME_ORIGINAL:
                 // If we get a DATETIME_ORIGINAL, we use that one.
-                strncpy(ImageInfo.DateTime, (char *)ValuePtr, 19);
+                strncpy(Ctx->ImageInfo.DateTime, (char *)ValuePtr, 19);
+                Ctx->DateTimeOriginalFound = TRUE;
                 // Fallthru...
 
             case TAG_DATETIME_DIGITIZED:
             case TAG_DATETIME:
-                if (!isdigit(ImageInfo.DateTime[0])){
+                if (!isdigit(Ctx->ImageInfo.DateTime[0])){
                     // If we don't already have a DATETIME_ORIGINAL, use whatever
                     // time fields we may have.
-                    strncpy(ImageInfo.DateTime, (char *)ValuePtr, 19);
+                    strncpy(Ctx->ImageInfo.DateTime, (char *)ValuePtr, 19);
                 }
 
-                if (ImageInfo.numDateTimeTags >= MAX_DATE_COPIES){
+                if (Ctx->ImageInfo.numDateTimeTags >= MAX_DATE_COPIES){
                     ErrNonfatal("More than %d date fields in Exif.  This is nuts", MAX_DATE_COPIES, 0);
                     break;
                 }
-                ImageInfo.DateTimeOffsets[ImageInfo.numDateTimeTags++] = 
+                Ctx->ImageInfo.DateTimeOffsets[Ctx->ImageInfo.numDateTimeTags++] = 
                     (char *)ValuePtr - (char *)OffsetBase;
                 break;
 
             case TAG_WINXP_COMMENT:
-                if (ImageInfo.Comments[0]){ // We already have a jpeg comment.
+                if (Ctx->ImageInfo.Comments[0]){ // We already have a jpeg comment.
                     // Already have a comment (probably windows comment), skip this one.
                     if (ShowTags) xprintf("Windows XP commend and other comment in header\n");
                     break; // Already have a windows comment, skip this one.
@@ -672,13 +672,13 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
 
                 if (ByteCount > 1){
                     if (ByteCount > MAX_COMMENT_SIZE) ByteCount = MAX_COMMENT_SIZE;
-                    memcpy(ImageInfo.Comments, ValuePtr, ByteCount);
-                    ImageInfo.CommentWidthchars = ByteCount/2;
+                    memcpy(Ctx->ImageInfo.Comments, ValuePtr, ByteCount);
+                    Ctx->ImageInfo.CommentWidthchars = ByteCount/2;
                 }
                 break;
 
             case TAG_USERCOMMENT:
-                if (ImageInfo.Comments[0]){ // We already have a jpeg comment.
+                if (Ctx->ImageInfo.Comments[0]){ // We already have a jpeg comment.
                     // Already have a comment (probably windows comment), skip this one.
                     if (ShowTags) xprintf("Multiple comments in exif header\n");
                     break; // Already have a windows comment, skip this one.
@@ -704,12 +704,12 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
                         for (a=5;a<10 && a < msiz;a++){
                             int c = (ValuePtr)[a];
                             if (c != '\0' && c != ' '){
-                                strncpy(ImageInfo.Comments, (char *)ValuePtr+a, msiz-a);
+                                strncpy(Ctx->ImageInfo.Comments, (char *)ValuePtr+a, msiz-a);
                                 break;
                             }
                         }
                     }else{
-                        strncpy(ImageInfo.Comments, (char *)ValuePtr, msiz);
+                        strncpy(Ctx->ImageInfo.Comments, (char *)ValuePtr, msiz);
                     }
                 }
                 break;
@@ -717,147 +717,147 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
             case TAG_FNUMBER:
                 // Simplest way of expressing aperture, so I trust it the most.
                 // (overwrite previously computd value if there is one)
-                ImageInfo.ApertureFNumber = (float)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.ApertureFNumber = (float)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_APERTURE:
             case TAG_MAXAPERTURE:
                 // More relevant info always comes earlier, so only use this field if we don't 
                 // have appropriate aperture information yet.
-                if (ImageInfo.ApertureFNumber == 0){
-                    ImageInfo.ApertureFNumber 
-                        = (float)exp(ConvertAnyFormat(ValuePtr, Format)*log(2)*0.5);
+                if (Ctx->ImageInfo.ApertureFNumber == 0){
+                    Ctx->ImageInfo.ApertureFNumber 
+                        = (float)exp(ConvertAnyFormat(Ctx, ValuePtr, Format)*log(2)*0.5);
                 }
                 break;
 
             case TAG_FOCALLENGTH:
                 // Nice digital cameras actually save the focal length as a function
                 // of how farthey are zoomed in.
-                ImageInfo.FocalLength = (float)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.FocalLength = (float)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_SUBJECT_DISTANCE:
                 // Inidcates the distacne the autofocus camera is focused to.
                 // Tends to be less accurate as distance increases.
-                ImageInfo.Distance = (float)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.Distance = (float)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_EXPOSURETIME:
                 // Simplest way of expressing exposure time, so I trust it most.
                 // (overwrite previously computd value if there is one)
-                ImageInfo.ExposureTime = (float)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.ExposureTime = (float)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_SHUTTERSPEED:
                 // More complicated way of expressing exposure time, so only use
                 // this value if we don't already have it from somewhere else.
-                if (ImageInfo.ExposureTime == 0){
-                    ImageInfo.ExposureTime 
-                        = (float)(1/exp(ConvertAnyFormat(ValuePtr, Format)*log(2)));
+                if (Ctx->ImageInfo.ExposureTime == 0){
+                    Ctx->ImageInfo.ExposureTime 
+                        = (float)(1/exp(ConvertAnyFormat(Ctx, ValuePtr, Format)*log(2)));
                 }
                 break;
 
 
             case TAG_FLASH:
-                ImageInfo.FlashUsed=(int)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.FlashUsed=(int)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_ORIENTATION:
-                if (NumOrientations >= 2){
+                if (Ctx->NumOrientations >= 2){
                     // Can have another orientation tag for the thumbnail, but if there's
                     // a third one, things are stringae.
                     ErrNonfatal("More than two orientation in Exif",0,0);
                     break;
                 }
-                OrientationPtr[NumOrientations] = ValuePtr;
-                OrientationNumFormat[NumOrientations] = Format;
-                if (NumOrientations == 0){
-                    ImageInfo.Orientation = (int)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->OrientationPtr[Ctx->NumOrientations] = ValuePtr;
+                Ctx->OrientationNumFormat[Ctx->NumOrientations] = Format;
+                if (Ctx->NumOrientations == 0){
+                    Ctx->ImageInfo.Orientation = (int)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 }
-                if (ImageInfo.Orientation < 0 || ImageInfo.Orientation > 8){
-                    ErrNonfatal("Undefined rotation value %d in Exif", ImageInfo.Orientation, 0);
-                    ImageInfo.Orientation = 0;
+                if (Ctx->ImageInfo.Orientation < 0 || Ctx->ImageInfo.Orientation > 8){
+                    ErrNonfatal("Undefined rotation value %d in Exif", Ctx->ImageInfo.Orientation, 0);
+                    Ctx->ImageInfo.Orientation = 0;
                 }
-                NumOrientations += 1;
+                Ctx->NumOrientations += 1;
                 break;
 
             case TAG_PIXEL_Y_DIMENSION:
             case TAG_PIXEL_X_DIMENSION:
                 // Use largest of height and width to deal with images that have been
                 // rotated to portrait format.
-                a = (int)ConvertAnyFormat(ValuePtr, Format);
-                if (ExifImageWidth < a) ExifImageWidth = a;
+                a = (int)ConvertAnyFormat(Ctx, ValuePtr, Format);
+                if (Ctx->ExifImageWidth < a) Ctx->ExifImageWidth = a;
                 break;
 
             case TAG_FOCAL_PLANE_XRES:
-                FocalplaneXRes = ConvertAnyFormat(ValuePtr, Format);
+                Ctx->FocalplaneXRes = ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_FOCAL_PLANE_UNITS:
-                switch((int)ConvertAnyFormat(ValuePtr, Format)){
-                    case 1: FocalplaneUnits = 25.4; break; // inch
+                switch((int)ConvertAnyFormat(Ctx, ValuePtr, Format)){
+                    case 1: Ctx->FocalplaneUnits = 25.4; break; // inch
                     case 2: 
                         // According to the information I was using, 2 means meters.
                         // But looking at the Cannon powershot's files, inches is the only
                         // sensible value.
-                        FocalplaneUnits = 25.4;
+                        Ctx->FocalplaneUnits = 25.4;
                         break;
 
-                    case 3: FocalplaneUnits = 10;   break;  // centimeter
-                    case 4: FocalplaneUnits = 1;    break;  // millimeter
-                    case 5: FocalplaneUnits = .001; break;  // micrometer
+                    case 3: Ctx->FocalplaneUnits = 10;   break;  // centimeter
+                    case 4: Ctx->FocalplaneUnits = 1;    break;  // millimeter
+                    case 5: Ctx->FocalplaneUnits = .001; break;  // micrometer
                 }
                 break;
 
             case TAG_EXPOSURE_BIAS:
-                ImageInfo.ExposureBias = (float)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.ExposureBias = (float)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_WHITEBALANCE:
-                ImageInfo.Whitebalance = (int)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.Whitebalance = (int)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_LIGHT_SOURCE:
-                ImageInfo.LightSource = (int)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.LightSource = (int)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_METERING_MODE:
-                ImageInfo.MeteringMode = (int)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.MeteringMode = (int)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_EXPOSURE_PROGRAM:
-                ImageInfo.ExposureProgram = (int)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.ExposureProgram = (int)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_EXPOSURE_INDEX:
-                if (ImageInfo.ISOequivalent == 0){
+                if (Ctx->ImageInfo.ISOequivalent == 0){
                     // Exposure index and ISO equivalent are often used interchangeably,
                     // so we will do the same in jhead.
                     // http://photography.about.com/library/glossary/bldef_ei.htm
-                    ImageInfo.ISOequivalent = (int)ConvertAnyFormat(ValuePtr, Format);
+                    Ctx->ImageInfo.ISOequivalent = (int)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 }
                 break;
 
             case TAG_EXPOSURE_MODE:
-                ImageInfo.ExposureMode = (int)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.ExposureMode = (int)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_ISO_EQUIVALENT:
-                ImageInfo.ISOequivalent = (int)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.ISOequivalent = (int)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_DIGITALZOOMRATIO:
-                ImageInfo.DigitalZoomRatio = (float)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.DigitalZoomRatio = (float)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_THUMBNAIL_OFFSET:
-                ThumbnailOffset = (unsigned)ConvertAnyFormat(ValuePtr, Format);
-                DirWithThumbnailPtrs = DirStart;
+                ThumbnailOffset = (unsigned)ConvertAnyFormat(Ctx, ValuePtr, Format);
+                Ctx->DirWithThumbnailPtrs = DirStart;
                 break;
 
             case TAG_THUMBNAIL_LENGTH:
-                ThumbnailSize = (unsigned)ConvertAnyFormat(ValuePtr, Format);
-                ImageInfo.ThumbnailSizeOffset = ValuePtr-OffsetBase;
+                ThumbnailSize = (unsigned)ConvertAnyFormat(Ctx, ValuePtr, Format);
+                Ctx->ImageInfo.ThumbnailSizeOffset = ValuePtr-OffsetBase;
                 break;
 
             case TAG_EXIF_OFFSET:
@@ -867,11 +867,11 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
                 if (Tag == TAG_INTEROP_OFFSET && ShowTags) xprintf("%s    Interop Dir:",IndentString);
                 {
                     unsigned char * SubdirStart;
-                    SubdirStart = OffsetBase + Get32u(ValuePtr);
+                    SubdirStart = OffsetBase + Get32u(Ctx, ValuePtr);
                     if (SubdirStart < OffsetBase || SubdirStart > OffsetBase+ExifLength){
                         ErrNonfatal("Illegal Exif or interop ofset directory link",0,0);
                     }else{
-                        ProcessExifDir(SubdirStart, OffsetBase, ExifLength, NestingLevel+1);
+                        ProcessExifDir(Ctx, SubdirStart, OffsetBase, ExifLength, NestingLevel+1);
                     }
                     continue;
                 }
@@ -881,11 +881,11 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
                 if (ShowTags) xprintf("%s    GPS info dir:",IndentString);
                 {
                     unsigned char * SubdirStart;
-                    SubdirStart = OffsetBase + Get32u(ValuePtr);
+                    SubdirStart = OffsetBase + Get32u(Ctx, ValuePtr);
                     if (SubdirStart < OffsetBase || SubdirStart > OffsetBase+ExifLength){
                         ErrNonfatal("Illegal GPS directory link in Exif",0,0);
                     }else{
-                        ProcessGpsInfo(SubdirStart, OffsetBase, ExifLength);
+                        ProcessGpsInfo(Ctx, SubdirStart, OffsetBase, ExifLength);
                     }
                     continue;
                 }
@@ -895,36 +895,36 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
                 // The focal length equivalent 35 mm is a 2.2 tag (defined as of April 2002)
                 // if its present, use it to compute equivalent focal length instead of 
                 // computing it from sensor geometry and actual focal length.
-                ImageInfo.FocalLength35mmEquiv = (unsigned)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.FocalLength35mmEquiv = (unsigned)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
             case TAG_DISTANCE_RANGE:
                 // Three possible standard values:
                 //   1 = macro, 2 = close, 3 = distant
-                ImageInfo.DistanceRange = (int)ConvertAnyFormat(ValuePtr, Format);
+                Ctx->ImageInfo.DistanceRange = (int)ConvertAnyFormat(Ctx, ValuePtr, Format);
                 break;
 
 
 
             case TAG_X_RESOLUTION:
                 if (NestingLevel==0) {// Only use the values from the top level directory
-                    ImageInfo.xResolution = (float)ConvertAnyFormat(ValuePtr,Format);
+                    Ctx->ImageInfo.xResolution = (float)ConvertAnyFormat(Ctx, ValuePtr,Format);
                     // if yResolution has not been set, use the value of xResolution
-                    if (ImageInfo.yResolution == 0.0) ImageInfo.yResolution = ImageInfo.xResolution;
+                    if (Ctx->ImageInfo.yResolution == 0.0) Ctx->ImageInfo.yResolution = Ctx->ImageInfo.xResolution;
                 }
                 break;
 
             case TAG_Y_RESOLUTION:
                 if (NestingLevel==0) {// Only use the values from the top level directory
-                    ImageInfo.yResolution = (float)ConvertAnyFormat(ValuePtr,Format);
+                    Ctx->ImageInfo.yResolution = (float)ConvertAnyFormat(Ctx, ValuePtr,Format);
                     // if xResolution has not been set, use the value of yResolution
-                    if (ImageInfo.xResolution == 0.0) ImageInfo.xResolution = ImageInfo.yResolution;
+                    if (Ctx->ImageInfo.xResolution == 0.0) Ctx->ImageInfo.xResolution = Ctx->ImageInfo.yResolution;
                 }
                 break;
 
             case TAG_RESOLUTION_UNIT:
                 if (NestingLevel==0) {// Only use the values from the top level directory
-                    ImageInfo.ResolutionUnit = (int) ConvertAnyFormat(ValuePtr,Format);
+                    Ctx->ImageInfo.ResolutionUnit = (int) ConvertAnyFormat(Ctx, ValuePtr,Format);
                 }
                 break;
 
@@ -940,7 +940,7 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
         unsigned Offset;
 
         if (DIR_ENTRY_ADDR(DirStart, NumDirEntries) + 4 <= OffsetBase+ExifLength){
-            Offset = Get32u(DirStart+2+12*NumDirEntries);
+            Offset = Get32u(Ctx, DirStart+2+12*NumDirEntries);
             if (Offset){
                 SubdirStart = OffsetBase + Offset;
                 if (SubdirStart > OffsetBase+ExifLength || SubdirStart < OffsetBase){
@@ -955,11 +955,11 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
                 }else{
                     if (SubdirStart <= OffsetBase+ExifLength){
                         if (ShowTags) xprintf("%s    Continued directory ",IndentString);
-                        ProcessExifDir(SubdirStart, OffsetBase, ExifLength, NestingLevel+1);
+                        ProcessExifDir(Ctx, SubdirStart, OffsetBase, ExifLength, NestingLevel+1);
                     }
                 }
-                if (Offset > ImageInfo.LargestExifOffset){
-                    ImageInfo.LargestExifOffset = Offset;
+                if (Offset > Ctx->ImageInfo.LargestExifOffset){
+                    Ctx->ImageInfo.LargestExifOffset = Offset;
                 }
             }
         }else{
@@ -968,7 +968,7 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
     }
 
     if (ThumbnailOffset){
-        ImageInfo.ThumbnailAtEnd = FALSE;
+        Ctx->ImageInfo.ThumbnailAtEnd = FALSE;
 
         if (DumpExifMap){
             xprintf("Map: %05d-%05d: Thumbnail\n",ThumbnailOffset, ThumbnailOffset+ThumbnailSize);
@@ -984,8 +984,8 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
 
             }
             // The thumbnail pointer appears to be valid.  Store it.
-            ImageInfo.ThumbnailOffset = ThumbnailOffset;
-            ImageInfo.ThumbnailSize = ThumbnailSize;
+            Ctx->ImageInfo.ThumbnailOffset = ThumbnailOffset;
+            Ctx->ImageInfo.ThumbnailSize = ThumbnailSize;
 
             if (ShowTags){
                 xprintf("Thumbnail size: %d bytes\n",ThumbnailSize);
@@ -999,14 +999,15 @@ static void ProcessExifDir(unsigned char * DirStart, unsigned char * OffsetBase,
 // Process a EXIF marker
 // Describes all the drivel that most digital cameras include...
 //--------------------------------------------------------------------------
-void process_EXIF (unsigned char * ExifSection, unsigned int length)
+void process_EXIF (JheadContext_t * Ctx, unsigned char * ExifSection, unsigned int length)
 {
     unsigned int FirstOffset;
 
-    FocalplaneXRes = 0;
-    FocalplaneUnits = 0;
-    ExifImageWidth = 0;
-    NumOrientations = 0;
+    Ctx->FocalplaneXRes = 0;
+    Ctx->FocalplaneUnits = 0;
+    Ctx->ExifImageWidth = 0;
+    Ctx->NumOrientations = 0;
+    Ctx->DateTimeOriginalFound = FALSE;
 
     if (ShowTags){
         xprintf("Exif header %d bytes long\n",length);
@@ -1022,11 +1023,11 @@ void process_EXIF (unsigned char * ExifSection, unsigned int length)
 
     if (memcmp(ExifSection+8,"II",2) == 0){
         if (ShowTags) xprintf("Exif section in Intel order\n");
-        MotorolaOrder = 0;
+        Ctx->MotorolaOrder = 0;
     }else{
         if (memcmp(ExifSection+8,"MM",2) == 0){
             if (ShowTags) xprintf("Exif section in Motorola order\n");
-            MotorolaOrder = 1;
+            Ctx->MotorolaOrder = 1;
         }else{
             ErrNonfatal("Invalid Exif alignment marker.",0,0);
             return;
@@ -1034,12 +1035,12 @@ void process_EXIF (unsigned char * ExifSection, unsigned int length)
     }
 
     // Check the next value for correctness.
-    if (Get16u(ExifSection+10) != 0x2a){
+    if (Get16u(Ctx, ExifSection+10) != 0x2a){
         ErrNonfatal("Invalid Exif start (1)",0,0);
         return;
     }
 
-    FirstOffset = Get32u(ExifSection+12);
+    FirstOffset = Get32u(Ctx, ExifSection+12);
     if (FirstOffset < 8 || FirstOffset > 16){
         if (FirstOffset < 16 || FirstOffset > length-16){
             ErrNonfatal("invalid offset for first Exif IFD value",0,0);
@@ -1049,13 +1050,13 @@ void process_EXIF (unsigned char * ExifSection, unsigned int length)
         ErrNonfatal("Suspicious offset of first Exif IFD value",0,0);
     }
 
-    DirWithThumbnailPtrs = NULL;
+    Ctx->DirWithThumbnailPtrs = NULL;
 
 
     // First directory starts 16 bytes in.  All offset are relative to 8 bytes in.
-    ProcessExifDir(ExifSection+8+FirstOffset, ExifSection+8, length-8, 0);
+    ProcessExifDir(Ctx, ExifSection+8+FirstOffset, ExifSection+8, length-8, 0);
 
-    ImageInfo.ThumbnailAtEnd = ImageInfo.ThumbnailOffset >= ImageInfo.LargestExifOffset ? TRUE : FALSE;
+    Ctx->ImageInfo.ThumbnailAtEnd = Ctx->ImageInfo.ThumbnailOffset >= Ctx->ImageInfo.LargestExifOffset ? TRUE : FALSE;
 
     if (DumpExifMap){
         unsigned a,b;
@@ -1069,17 +1070,17 @@ void process_EXIF (unsigned char * ExifSection, unsigned int length)
 
 
     // Compute the CCD width, in millimeters.
-    if (FocalplaneXRes != 0 && ExifImageWidth != 0){
+    if (Ctx->FocalplaneXRes != 0 && Ctx->ExifImageWidth != 0){
         // Note: With some cameras, its not possible to compute this correctly because
         // they don't adjust the indicated focal plane resolution units when using less
         // than maximum resolution, so the CCDWidth value comes out too small.  Nothing
         // that Jhad can do about it - its a camera problem.
-        ImageInfo.CCDWidth = (float)(ExifImageWidth * FocalplaneUnits / FocalplaneXRes);
+        Ctx->ImageInfo.CCDWidth = (float)(Ctx->ExifImageWidth * Ctx->FocalplaneUnits / Ctx->FocalplaneXRes);
 
-        if (ImageInfo.FocalLength && ImageInfo.FocalLength35mmEquiv == 0){
+        if (Ctx->ImageInfo.FocalLength && Ctx->ImageInfo.FocalLength35mmEquiv == 0){
             // Compute 35 mm equivalent focal length based on sensor geometry if we haven't
             // already got it explicitly from a tag.
-            ImageInfo.FocalLength35mmEquiv = (int)(ImageInfo.FocalLength/ImageInfo.CCDWidth*36 + 0.5);
+            Ctx->ImageInfo.FocalLength35mmEquiv = (int)(Ctx->ImageInfo.FocalLength/Ctx->ImageInfo.CCDWidth*36 + 0.5);
         }
     }
 }
@@ -1089,7 +1090,7 @@ void process_EXIF (unsigned char * ExifSection, unsigned int length)
 // Create minimal exif header - just date and thumbnail pointers,
 // so that date and thumbnail may be filled later.
 //--------------------------------------------------------------------------
-void create_EXIF(void)
+void create_EXIF(JheadContext_t * Ctx)
 {
     char Buffer[256];
 
@@ -1099,47 +1100,47 @@ void create_EXIF(void)
     int DirIndex;
     int DirContinuation;
     
-    MotorolaOrder = 0;
+    Ctx->MotorolaOrder = 0;
 
     memcpy(Buffer+2, "Exif\0\0II",8);
-    Put16u(Buffer+10, 0x2a);
+    Put16u(Ctx, Buffer+10, 0x2a);
 
     DataWriteIndex = 16;
-    Put32u(Buffer+12, DataWriteIndex-8); // first IFD offset.  Means start 16 bytes in.
+    Put32u(Ctx, Buffer+12, DataWriteIndex-8); // first IFD offset.  Means start 16 bytes in.
 
     {
         DirIndex = DataWriteIndex;
         NumEntries = 2;
         DataWriteIndex += 2 + NumEntries*12 + 4;
 
-        Put16u(Buffer+DirIndex, NumEntries); // Number of entries
+        Put16u(Ctx, Buffer+DirIndex, NumEntries); // Number of entries
         DirIndex += 2;
   
         // Enitries go here...
         {
             // Date/time entry
-            Put16u(Buffer+DirIndex, TAG_DATETIME);         // Tag
-            Put16u(Buffer+DirIndex + 2, FMT_STRING);       // Format
-            Put32u(Buffer+DirIndex + 4, 20);               // Components
-            Put32u(Buffer+DirIndex + 8, DataWriteIndex-8); // Pointer or value.
+            Put16u(Ctx, Buffer+DirIndex, TAG_DATETIME);         // Tag
+            Put16u(Ctx, Buffer+DirIndex + 2, FMT_STRING);       // Format
+            Put32u(Ctx, Buffer+DirIndex + 4, 20);               // Components
+            Put32u(Ctx, Buffer+DirIndex + 8, DataWriteIndex-8); // Pointer or value.
             DirIndex += 12;
 
             DateIndex = DataWriteIndex;
-            if (ImageInfo.numDateTimeTags){
+            if (Ctx->ImageInfo.numDateTimeTags){
                 // If we had a pre-existing exif header, use time from that.
-                memcpy(Buffer+DataWriteIndex, ImageInfo.DateTime, 19);
+                memcpy(Buffer+DataWriteIndex, Ctx->ImageInfo.DateTime, 19);
                 Buffer[DataWriteIndex+19] = '\0';
             }else{
                 // Oterwise, use the file's timestamp.
-                FileTimeAsString(Buffer+DataWriteIndex);
+                FileTimeAsString(Ctx, Buffer+DataWriteIndex);
             }
             DataWriteIndex += 20;
         
             // Link to exif dir entry
-            Put16u(Buffer+DirIndex, TAG_EXIF_OFFSET);      // Tag
-            Put16u(Buffer+DirIndex + 2, FMT_ULONG);        // Format
-            Put32u(Buffer+DirIndex + 4, 1);                // Components
-            Put32u(Buffer+DirIndex + 8, DataWriteIndex-8); // Pointer or value.
+            Put16u(Ctx, Buffer+DirIndex, TAG_EXIF_OFFSET);      // Tag
+            Put16u(Ctx, Buffer+DirIndex + 2, FMT_ULONG);        // Format
+            Put32u(Ctx, Buffer+DirIndex + 4, 1);                // Components
+            Put32u(Ctx, Buffer+DirIndex + 8, DataWriteIndex-8); // Pointer or value.
             DirIndex += 12;
         }
 
@@ -1152,52 +1153,52 @@ void create_EXIF(void)
         NumEntries = 1;
         DataWriteIndex += 2 + NumEntries*12 + 4;
 
-        Put16u(Buffer+DirIndex, NumEntries); // Number of entries
+        Put16u(Ctx, Buffer+DirIndex, NumEntries); // Number of entries
         DirIndex += 2;
 
         // Original date/time entry
-        Put16u(Buffer+DirIndex, TAG_DATETIME_ORIGINAL);         // Tag
-        Put16u(Buffer+DirIndex + 2, FMT_STRING);       // Format
-        Put32u(Buffer+DirIndex + 4, 20);               // Components
-        Put32u(Buffer+DirIndex + 8, DataWriteIndex-8); // Pointer or value.
+        Put16u(Ctx, Buffer+DirIndex, TAG_DATETIME_ORIGINAL);         // Tag
+        Put16u(Ctx, Buffer+DirIndex + 2, FMT_STRING);       // Format
+        Put32u(Ctx, Buffer+DirIndex + 4, 20);               // Components
+        Put32u(Ctx, Buffer+DirIndex + 8, DataWriteIndex-8); // Pointer or value.
         DirIndex += 12;
 
         memcpy(Buffer+DataWriteIndex, Buffer+DateIndex, 20);
         DataWriteIndex += 20;
         
         // End of directory - contains optional link to continued directory.
-        Put32u(Buffer+DirIndex, 0);
+        Put32u(Ctx, Buffer+DirIndex, 0);
     }
 
     {
         //Continuation which links to this directory;
-        Put32u(Buffer+DirContinuation, DataWriteIndex-8);
+        Put32u(Ctx, Buffer+DirContinuation, DataWriteIndex-8);
         DirIndex = DataWriteIndex;
         NumEntries = 2;
         DataWriteIndex += 2 + NumEntries*12 + 4;
 
-        Put16u(Buffer+DirIndex, NumEntries); // Number of entries
+        Put16u(Ctx, Buffer+DirIndex, NumEntries); // Number of entries
         DirIndex += 2;
         {
             // Link to exif dir entry
-            Put16u(Buffer+DirIndex, TAG_THUMBNAIL_OFFSET);         // Tag
-            Put16u(Buffer+DirIndex + 2, FMT_ULONG);       // Format
-            Put32u(Buffer+DirIndex + 4, 1);               // Components
-            Put32u(Buffer+DirIndex + 8, DataWriteIndex-8); // Pointer or value.
+            Put16u(Ctx, Buffer+DirIndex, TAG_THUMBNAIL_OFFSET);         // Tag
+            Put16u(Ctx, Buffer+DirIndex + 2, FMT_ULONG);       // Format
+            Put32u(Ctx, Buffer+DirIndex + 4, 1);               // Components
+            Put32u(Ctx, Buffer+DirIndex + 8, DataWriteIndex-8); // Pointer or value.
             DirIndex += 12;
         }
 
         {
             // Link to exif dir entry
-            Put16u(Buffer+DirIndex, TAG_THUMBNAIL_LENGTH);         // Tag
-            Put16u(Buffer+DirIndex + 2, FMT_ULONG);       // Format
-            Put32u(Buffer+DirIndex + 4, 1);               // Components
-            Put32u(Buffer+DirIndex + 8, 0); // Pointer or value.
+            Put16u(Ctx, Buffer+DirIndex, TAG_THUMBNAIL_LENGTH);         // Tag
+            Put16u(Ctx, Buffer+DirIndex + 2, FMT_ULONG);       // Format
+            Put32u(Ctx, Buffer+DirIndex + 4, 1);               // Components
+            Put32u(Ctx, Buffer+DirIndex + 8, 0); // Pointer or value.
             DirIndex += 12;
         }
 
         // End of directory - contains optional link to continued directory.
-        Put32u(Buffer+DirIndex, 0);
+        Put32u(Ctx, Buffer+DirIndex, 0);
     }
 
     
@@ -1205,7 +1206,7 @@ void create_EXIF(void)
     Buffer[1] = (unsigned char)DataWriteIndex;
 
     // Remove old exif section, if there was one.
-    RemoveSectionType(M_EXIF);
+    RemoveSectionType(Ctx, M_EXIF);
 
     {
         // Sections need malloced buffers, so do that now, especially because
@@ -1216,41 +1217,41 @@ void create_EXIF(void)
         }
         memcpy(NewBuf, Buffer, DataWriteIndex);
 
-        CreateSection(M_EXIF, NewBuf, DataWriteIndex);
+        CreateSection(Ctx, M_EXIF, NewBuf, DataWriteIndex);
 
         // Re-parse new exif section, now that its in place
         // otherwise, we risk touching data that has already been freed.
-        process_EXIF(NewBuf, DataWriteIndex);
+        process_EXIF(Ctx, NewBuf, DataWriteIndex);
     }
 }
 
 //--------------------------------------------------------------------------
 // Cler the rotation tag in the exif header to 1.
 //--------------------------------------------------------------------------
-const char * ClearOrientation(void)
+const char * ClearOrientation(JheadContext_t * Ctx)
 {
     int a;
-    if (NumOrientations == 0) return NULL;
+    if (Ctx->NumOrientations == 0) return NULL;
 
-    for (a=0;a<NumOrientations;a++){
-        switch(OrientationNumFormat[a]){
+    for (a=0;a<Ctx->NumOrientations;a++){
+        switch(Ctx->OrientationNumFormat[a]){
             case FMT_SBYTE:
             case FMT_BYTE:      
-                *(uchar *)(OrientationPtr[a]) = 1;
+                *(uchar *)(Ctx->OrientationPtr[a]) = 1;
                 break;
 
             case FMT_USHORT:    
-                Put16u(OrientationPtr[a], 1);                
+                Put16u(Ctx, Ctx->OrientationPtr[a], 1);                
                 break;
 
             case FMT_ULONG:     
             case FMT_SLONG:     
-                memset(OrientationPtr[a], 0, 4);
+                memset(Ctx->OrientationPtr[a], 0, 4);
                 // Can't be bothered to write  generic Put32 if I only use it once.
-                if (MotorolaOrder){
-                    ((uchar *)OrientationPtr[a])[3] = 1;
+                if (Ctx->MotorolaOrder){
+                    ((uchar *)Ctx->OrientationPtr[a])[3] = 1;
                 }else{
-                    ((uchar *)OrientationPtr[a])[0] = 1;
+                    ((uchar *)Ctx->OrientationPtr[a])[0] = 1;
                 }
                 break;
 
@@ -1259,7 +1260,7 @@ const char * ClearOrientation(void)
         }
     }
 
-    return OrientTab[ImageInfo.Orientation];
+    return OrientTab[Ctx->ImageInfo.Orientation];
 }
 
 //--------------------------------------------------------------------------
@@ -1306,41 +1307,41 @@ int Exif2tm(struct tm * timeptr, char * ExifTime)
 // Show the collected image info, displaying camera F-stop and shutter speed
 // in a consistent and legible fashion.
 //--------------------------------------------------------------------------
-void ShowImageInfo(int ShowFileInfo)
+void ShowImageInfo(JheadContext_t * Ctx, int ShowFileInfo)
 {
     if (ShowFileInfo){
-        xprintf("File name    : %s\n",ImageInfo.FileName);
-        xprintf("File size    : %d bytes\n",ImageInfo.FileSize);
+        xprintf("File name    : %s\n",Ctx->ImageInfo.FileName);
+        xprintf("File size    : %d bytes\n",Ctx->ImageInfo.FileSize);
 
         {
             char Temp[20];
-            FileTimeAsString(Temp);
+            FileTimeAsString(Ctx, Temp);
             xprintf("File date    : %s\n",Temp);
         }
     }
 
-    if (ImageInfo.CameraMake[0]){
-        xprintf("Camera make  : %s\n",ImageInfo.CameraMake);
-        xprintf("Camera model : %s\n",ImageInfo.CameraModel);
+    if (Ctx->ImageInfo.CameraMake[0]){
+        xprintf("Camera make  : %s\n",Ctx->ImageInfo.CameraMake);
+        xprintf("Camera model : %s\n",Ctx->ImageInfo.CameraModel);
     }
-    if (ImageInfo.DateTime[0]){
-        xprintf("Date/Time    : %s\n",ImageInfo.DateTime);
+    if (Ctx->ImageInfo.DateTime[0]){
+        xprintf("Date/Time    : %s\n",Ctx->ImageInfo.DateTime);
     }
-    xprintf("Resolution   : %d x %d\n",ImageInfo.Width, ImageInfo.Height);
+    xprintf("Resolution   : %d x %d\n",Ctx->ImageInfo.Width, Ctx->ImageInfo.Height);
 
-    if (ImageInfo.Orientation > 1){
+    if (Ctx->ImageInfo.Orientation > 1){
         // Only print orientation if one was supplied, and if its not 1 (normal orientation)
-        xprintf("Orientation  : %s\n", OrientTab[ImageInfo.Orientation]);
+        xprintf("Orientation  : %s\n", OrientTab[Ctx->ImageInfo.Orientation]);
     }
 
-    if (ImageInfo.IsColor == 0){
+    if (Ctx->ImageInfo.IsColor == 0){
         xprintf("Color/bw     : Black and white\n");
     }
 
-    if (ImageInfo.FlashUsed >= 0){
-        if (ImageInfo.FlashUsed & 1){    
+    if (Ctx->ImageInfo.FlashUsed >= 0){
+        if (Ctx->ImageInfo.FlashUsed & 1){    
             xprintf("Flash used   : Yes");
-            switch (ImageInfo.FlashUsed){
+            switch (Ctx->ImageInfo.FlashUsed){
                 case 0x5: xprintf(" (Strobe light not detected)"); break;
                 case 0x7: xprintf(" (Strobe light detected) "); break;
                 case 0x9: xprintf(" (manual)"); break;
@@ -1361,7 +1362,7 @@ void ShowImageInfo(int ShowFileInfo)
             }
         }else{
             xprintf("Flash used   : No");
-            switch (ImageInfo.FlashUsed){
+            switch (Ctx->ImageInfo.FlashUsed){
                 case 0x18:xprintf(" (auto)"); break;
             }
         }
@@ -1369,56 +1370,56 @@ void ShowImageInfo(int ShowFileInfo)
     }
 
 
-    if (ImageInfo.FocalLength){
-        xprintf("Focal length : %4.1fmm",(double)ImageInfo.FocalLength);
-        if (ImageInfo.FocalLength35mmEquiv){
-            xprintf("  (35mm equivalent: %dmm)", ImageInfo.FocalLength35mmEquiv);
+    if (Ctx->ImageInfo.FocalLength){
+        xprintf("Focal length : %4.1fmm",(double)Ctx->ImageInfo.FocalLength);
+        if (Ctx->ImageInfo.FocalLength35mmEquiv){
+            xprintf("  (35mm equivalent: %dmm)", Ctx->ImageInfo.FocalLength35mmEquiv);
         }
         xprintf("\n");
     }
 
-    if (ImageInfo.DigitalZoomRatio > 1){
+    if (Ctx->ImageInfo.DigitalZoomRatio > 1){
         // Digital zoom used.  Shame on you!
-        xprintf("Digital Zoom : %1.3fx\n", (double)ImageInfo.DigitalZoomRatio);
+        xprintf("Digital Zoom : %1.3fx\n", (double)Ctx->ImageInfo.DigitalZoomRatio);
     }
 
-    if (ImageInfo.CCDWidth){
-        xprintf("CCD width    : %4.2fmm\n",(double)ImageInfo.CCDWidth);
+    if (Ctx->ImageInfo.CCDWidth){
+        xprintf("CCD width    : %4.2fmm\n",(double)Ctx->ImageInfo.CCDWidth);
     }
 
-    if (ImageInfo.ExposureTime){
-        if (ImageInfo.ExposureTime < 0.010){
-            xprintf("Exposure time: %6.4f s ",(double)ImageInfo.ExposureTime);
+    if (Ctx->ImageInfo.ExposureTime){
+        if (Ctx->ImageInfo.ExposureTime < 0.010){
+            xprintf("Exposure time: %6.4f s ",(double)Ctx->ImageInfo.ExposureTime);
         }else{
-            xprintf("Exposure time: %5.3f s ",(double)ImageInfo.ExposureTime);
+            xprintf("Exposure time: %5.3f s ",(double)Ctx->ImageInfo.ExposureTime);
         }
-        if (ImageInfo.ExposureTime <= 0.5){
-            xprintf(" (1/%d)",(int)(0.5 + 1/ImageInfo.ExposureTime));
+        if (Ctx->ImageInfo.ExposureTime <= 0.5){
+            xprintf(" (1/%d)",(int)(0.5 + 1/Ctx->ImageInfo.ExposureTime));
         }
         xprintf("\n");
     }
-    if (ImageInfo.ApertureFNumber){
-        xprintf("Aperture     : f/%3.1f\n",(double)ImageInfo.ApertureFNumber);
+    if (Ctx->ImageInfo.ApertureFNumber){
+        xprintf("Aperture     : f/%3.1f\n",(double)Ctx->ImageInfo.ApertureFNumber);
     }
-    if (ImageInfo.Distance){
-        if (ImageInfo.Distance < 0){
+    if (Ctx->ImageInfo.Distance){
+        if (Ctx->ImageInfo.Distance < 0){
             xprintf("Focus dist.  : Infinite\n");
         }else{
-            xprintf("Focus dist.  : %4.2fm\n",(double)ImageInfo.Distance);
+            xprintf("Focus dist.  : %4.2fm\n",(double)Ctx->ImageInfo.Distance);
         }
     }
 
-    if (ImageInfo.ISOequivalent){
-        xprintf("ISO equiv.   : %2d\n",(int)ImageInfo.ISOequivalent);
+    if (Ctx->ImageInfo.ISOequivalent){
+        xprintf("ISO equiv.   : %2d\n",(int)Ctx->ImageInfo.ISOequivalent);
     }
 
-    if (ImageInfo.ExposureBias){
+    if (Ctx->ImageInfo.ExposureBias){
         // If exposure bias was specified, but set to zero, presumably its no bias at all,
         // so only show it if its nonzero.
-        xprintf("Exposure bias: %4.2f\n",(double)ImageInfo.ExposureBias);
+        xprintf("Exposure bias: %4.2f\n",(double)Ctx->ImageInfo.ExposureBias);
     }
         
-    switch(ImageInfo.Whitebalance) {
+    switch(Ctx->ImageInfo.Whitebalance) {
         case 1:
             xprintf("Whitebalance : Manual\n");
             break;
@@ -1428,7 +1429,7 @@ void ShowImageInfo(int ShowFileInfo)
     }
 
     //Quercus: 17-1-2004 Added LightSource, some cams return this, whitebalance or both
-    switch(ImageInfo.LightSource) {
+    switch(Ctx->ImageInfo.LightSource) {
         case 1:
             xprintf("Light Source : Daylight\n");
             break;
@@ -1452,9 +1453,9 @@ void ShowImageInfo(int ShowFileInfo)
             // don't bother showing it - it doesn't add any useful information.
     }
 
-    if (ImageInfo.MeteringMode > 0){ // 05-jan-2001 vcs
+    if (Ctx->ImageInfo.MeteringMode > 0){ // 05-jan-2001 vcs
         xprintf("Metering Mode: ");
-        switch(ImageInfo.MeteringMode) {
+        switch(Ctx->ImageInfo.MeteringMode) {
         case 1: xprintf("average\n"); break;
         case 2: xprintf("center weight\n"); break;
         case 3: xprintf("spot\n"); break;
@@ -1462,12 +1463,12 @@ void ShowImageInfo(int ShowFileInfo)
         case 5: xprintf("pattern\n"); break;
         case 6: xprintf("partial\n");  break;
         case 255: xprintf("other\n");  break;
-        default: xprintf("unknown (%d)\n",ImageInfo.MeteringMode); break;
+        default: xprintf("unknown (%d)\n",Ctx->ImageInfo.MeteringMode); break;
         }
     }
 
-    if (ImageInfo.ExposureProgram){ // 05-jan-2001 vcs
-        switch(ImageInfo.ExposureProgram) {
+    if (Ctx->ImageInfo.ExposureProgram){ // 05-jan-2001 vcs
+        switch(Ctx->ImageInfo.ExposureProgram) {
         case 1:
             xprintf("Exposure     : Manual\n");
             break;
@@ -1496,7 +1497,7 @@ void ShowImageInfo(int ShowFileInfo)
             break;
         }
     }
-    switch(ImageInfo.ExposureMode){
+    switch(Ctx->ImageInfo.ExposureMode){
         case 0: // Automatic (not worth cluttering up output for)
             break;
         case 1: xprintf("Exposure Mode: Manual\n");
@@ -1505,9 +1506,9 @@ void ShowImageInfo(int ShowFileInfo)
             break;
     }
 
-    if (ImageInfo.DistanceRange) {
+    if (Ctx->ImageInfo.DistanceRange) {
         xprintf("Focus range  : ");
-        switch(ImageInfo.DistanceRange) {
+        switch(Ctx->ImageInfo.DistanceRange) {
             case 1:
                 xprintf("macro");
                 break;
@@ -1523,7 +1524,7 @@ void ShowImageInfo(int ShowFileInfo)
 
 
 
-    if (ImageInfo.Process != M_SOF0){
+    if (Ctx->ImageInfo.Process != M_SOF0){
         // don't show it if its the plain old boring 'baseline' process, but do
         // show it if its something else, like 'progressive' (used on web sometimes)
         unsigned a;
@@ -1533,34 +1534,34 @@ void ShowImageInfo(int ShowFileInfo)
                 xprintf("Jpeg process : Unknown\n");
                 break;
             }
-            if (ProcessTable[a].Tag == ImageInfo.Process){
+            if (ProcessTable[a].Tag == Ctx->ImageInfo.Process){
                 xprintf("Jpeg process : %s\n",ProcessTable[a].Desc);
                 break;
             }
         }
     }
 
-    if (ImageInfo.GpsInfoPresent){
-        xprintf("GPS Latitude : %s\n",ImageInfo.GpsLat);
-        xprintf("GPS Longitude: %s\n",ImageInfo.GpsLong);
-        if (ImageInfo.GpsAlt[0]) xprintf("GPS Altitude : %s\n",ImageInfo.GpsAlt);
+    if (Ctx->ImageInfo.GpsInfoPresent){
+        xprintf("GPS Latitude : %s\n",Ctx->ImageInfo.GpsLat);
+        xprintf("GPS Longitude: %s\n",Ctx->ImageInfo.GpsLong);
+        if (Ctx->ImageInfo.GpsAlt[0]) xprintf("GPS Altitude : %s\n",Ctx->ImageInfo.GpsAlt);
     }
 
-    if (ImageInfo.QualityGuess){
-        xprintf("JPEG Quality : %d\n", ImageInfo.QualityGuess);
+    if (Ctx->ImageInfo.QualityGuess){
+        xprintf("JPEG Quality : %d\n", Ctx->ImageInfo.QualityGuess);
     }
 
     // Print the comment. Print 'Comment:' for each new line of comment.
-    if (ImageInfo.Comments[0]){
+    if (Ctx->ImageInfo.Comments[0]){
         int a,c;
         xprintf("Comment      : ");
-        if (!ImageInfo.CommentWidthchars){
+        if (!Ctx->ImageInfo.CommentWidthchars){
             for (a=0;a<MAX_COMMENT_SIZE;a++){
-                c = ImageInfo.Comments[a];
+                c = Ctx->ImageInfo.Comments[a];
                 if (c == '\0') break;
                 if (c == '\n'){
                     // Do not start a new line if the string ends with a carriage return.
-                    if (ImageInfo.Comments[a+1] != '\0'){
+                    if (Ctx->ImageInfo.Comments[a+1] != '\0'){
                         xprintf("\nComment      : ");
                     }else{
                         xprintf("\n");
@@ -1571,7 +1572,7 @@ void ShowImageInfo(int ShowFileInfo)
             }
             xprintf("\n");
         }else{
-            xprintf("%.*ls\n", ImageInfo.CommentWidthchars, (wchar_t *)ImageInfo.Comments);
+            xprintf("%.*ls\n", Ctx->ImageInfo.CommentWidthchars, (wchar_t *)Ctx->ImageInfo.Comments);
         }
     }
 }
@@ -1580,33 +1581,33 @@ void ShowImageInfo(int ShowFileInfo)
 //--------------------------------------------------------------------------
 // Summarize highlights of image info on one line (suitable for grep-ing)
 //--------------------------------------------------------------------------
-void ShowConciseImageInfo(void)
+void ShowConciseImageInfo(JheadContext_t * Ctx)
 {
-    xprintf("\"%s\"",ImageInfo.FileName);
+    xprintf("\"%s\"",Ctx->ImageInfo.FileName);
 
-    xprintf(" %dx%d",ImageInfo.Width, ImageInfo.Height);
+    xprintf(" %dx%d",Ctx->ImageInfo.Width, Ctx->ImageInfo.Height);
 
-    if (ImageInfo.ExposureTime){
-        if (ImageInfo.ExposureTime <= 0.5){
-            xprintf(" (1/%d)",(int)(0.5 + 1/ImageInfo.ExposureTime));
+    if (Ctx->ImageInfo.ExposureTime){
+        if (Ctx->ImageInfo.ExposureTime <= 0.5){
+            xprintf(" (1/%d)",(int)(0.5 + 1/Ctx->ImageInfo.ExposureTime));
         }else{
-            xprintf(" (%1.1f)",ImageInfo.ExposureTime);
+            xprintf(" (%1.1f)",Ctx->ImageInfo.ExposureTime);
         }
     }
 
-    if (ImageInfo.ApertureFNumber){
-        xprintf(" f/%3.1f",(double)ImageInfo.ApertureFNumber);
+    if (Ctx->ImageInfo.ApertureFNumber){
+        xprintf(" f/%3.1f",(double)Ctx->ImageInfo.ApertureFNumber);
     }
 
-    if (ImageInfo.FocalLength35mmEquiv){
-        xprintf(" f(35)=%dmm",ImageInfo.FocalLength35mmEquiv);
+    if (Ctx->ImageInfo.FocalLength35mmEquiv){
+        xprintf(" f(35)=%dmm",Ctx->ImageInfo.FocalLength35mmEquiv);
     }
 
-    if (ImageInfo.FlashUsed >= 0 && ImageInfo.FlashUsed & 1){
+    if (Ctx->ImageInfo.FlashUsed >= 0 && Ctx->ImageInfo.FlashUsed & 1){
         xprintf(" (flash)");
     }
 
-    if (ImageInfo.IsColor == 0){
+    if (Ctx->ImageInfo.IsColor == 0){
         xprintf(" (bw)");
     }
 
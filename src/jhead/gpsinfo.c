@@ -74,23 +74,23 @@ static const char * GpsTags[MAX_GPS_TAG+1]= {
 //--------------------------------------------------------------------------
 // Process GPS info directory
 //--------------------------------------------------------------------------
-void ProcessGpsInfo(unsigned char * DirStart, unsigned char * OffsetBase, unsigned ExifLength)
+void ProcessGpsInfo(JheadContext_t * Ctx, unsigned char * DirStart, unsigned char * OffsetBase, unsigned ExifLength)
 {
     int de;
     unsigned a;
     int NumDirEntries;
 
-    NumDirEntries = Get16u(DirStart);
+    NumDirEntries = Get16u(Ctx, DirStart);
     #define DIR_ENTRY_ADDR(Start, Entry) (Start+2+12*(Entry))
 
     if (ShowTags){
         xprintf("(dir has %d entries)\n",NumDirEntries);
     }
 
-    ImageInfo.GpsInfoPresent = TRUE;
-    strcpy(ImageInfo.GpsLat, "? ?");
-    strcpy(ImageInfo.GpsLong, "? ?");
-    ImageInfo.GpsAlt[0] = 0; 
+    Ctx->ImageInfo.GpsInfoPresent = TRUE;
+    strcpy(Ctx->ImageInfo.GpsLat, "? ?");
+    strcpy(Ctx->ImageInfo.GpsLong, "? ?");
+    Ctx->ImageInfo.GpsAlt[0] = 0; 
 
     for (de=0;de<NumDirEntries;de++){
         unsigned Tag, Format, Components;
@@ -105,9 +105,9 @@ void ProcessGpsInfo(unsigned char * DirStart, unsigned char * OffsetBase, unsign
             return;
         }
 
-        Tag = Get16u(DirEntry);
-        Format = Get16u(DirEntry+2);
-        Components = Get32u(DirEntry+4);
+        Tag = Get16u(Ctx, DirEntry);
+        Format = Get16u(Ctx, DirEntry+2);
+        Components = Get32u(Ctx, DirEntry+4);
 
         if ((Format-1) >= NUM_FORMATS) {
             // (-1) catches illegal zero case as unsigned underflows to positive large.
@@ -120,7 +120,7 @@ void ProcessGpsInfo(unsigned char * DirStart, unsigned char * OffsetBase, unsign
 
         if (ByteCount > 4){
             unsigned OffsetVal;
-            OffsetVal = Get32u(DirEntry+8);
+            OffsetVal = Get32u(Ctx, DirEntry+8);
             // If its bigger than 4 bytes, the dir entry contains an offset.
             if (OffsetVal+ByteCount > ExifLength){
                 // Bogus pointer offset and / or bytecount value
@@ -139,11 +139,11 @@ void ProcessGpsInfo(unsigned char * DirStart, unsigned char * OffsetBase, unsign
             double Values[3];
 
             case TAG_GPS_LAT_REF:
-                ImageInfo.GpsLat[0] = ValuePtr[0];
+                Ctx->ImageInfo.GpsLat[0] = ValuePtr[0];
                 break;
 
             case TAG_GPS_LONG_REF:
-                ImageInfo.GpsLong[0] = ValuePtr[0];
+                Ctx->ImageInfo.GpsLong[0] = ValuePtr[0];
                 break;
 
             case TAG_GPS_LAT:
@@ -155,7 +155,7 @@ void ProcessGpsInfo(unsigned char * DirStart, unsigned char * OffsetBase, unsign
                 for (a=0;a<3;a++){
                     int den, digits;
 
-                    den = Get32s(ValuePtr+4+a*ComponentSize);
+                    den = Get32s(Ctx, ValuePtr+4+a*ComponentSize);
                     digits = 0;
                     while (den > 1 && digits <= 6){
                         den = den / 10;
@@ -165,25 +165,25 @@ void ProcessGpsInfo(unsigned char * DirStart, unsigned char * OffsetBase, unsign
                     FmtString[1+a*7] = (char)('2'+digits+(digits ? 1 : 0));
                     FmtString[3+a*7] = (char)('0'+digits);
 
-                    Values[a] = ConvertAnyFormat(ValuePtr+a*ComponentSize, Format);
+                    Values[a] = ConvertAnyFormat(Ctx, ValuePtr+a*ComponentSize, Format);
                 }
 
                 sprintf(TempString, FmtString, Values[0], Values[1], Values[2]);
 
                 if (Tag == TAG_GPS_LAT){
-                    strncpy(ImageInfo.GpsLat+2, TempString, 29);
+                    strncpy(Ctx->ImageInfo.GpsLat+2, TempString, 29);
                 }else{
-                    strncpy(ImageInfo.GpsLong+2, TempString, 29);
+                    strncpy(Ctx->ImageInfo.GpsLong+2, TempString, 29);
                 }
                 break;
 
             case TAG_GPS_ALT_REF:
-                ImageInfo.GpsAlt[0] = (char)(ValuePtr[0] ? '-' : ' ');
+                Ctx->ImageInfo.GpsAlt[0] = (char)(ValuePtr[0] ? '-' : ' ');
                 break;
 
             case TAG_GPS_ALT:
-                sprintf(ImageInfo.GpsAlt + 1, "%.2fm", 
-                    ConvertAnyFormat(ValuePtr, Format));
+                sprintf(Ctx->ImageInfo.GpsAlt + 1, "%.2fm", 
+                    ConvertAnyFormat(Ctx, ValuePtr, Format));
                 break;
         }
 
@@ -225,7 +225,7 @@ void ProcessGpsInfo(unsigned char * DirStart, unsigned char * OffsetBase, unsign
                 default:
                     // Handle arrays of numbers later (will there ever be?)
                     for (a=0;;){
-                        PrintFormatNumber(ValuePtr+a*ComponentSize, Format, ByteCount);
+                        PrintFormatNumber(Ctx, ValuePtr+a*ComponentSize, Format, ByteCount);
                         if (++a >= Components) break;
                         xprintf(", ");
                     }
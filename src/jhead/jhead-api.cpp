@@ -42,10 +42,10 @@ int DumpExifMap  = FALSE;
 int xprintf(const char *, ...) { return 0; }
 
 // not used - only defined to get exif.c to compile
-void FileTimeAsString(char * TimeStr)
+void FileTimeAsString(JheadContext_t * Ctx, char * TimeStr)
 {
     struct tm ts;
-    ts = *localtime(&ImageInfo.FileDateTime);
+    localtime_r(&Ctx->ImageInfo.FileDateTime, &ts);
     strftime(TimeStr, 20, "%Y:%m:%d %H:%M:%S", &ts);
 }
 
@@ -136,7 +136,7 @@ void ErrNonfatal(const char * msg, int a1, int a2)
 // Show the collected image info, displaying camera F-stop and shutter speed
 // in a consistent and legible fashion.
 //--------------------------------------------------------------------------
-void appendImageInfo(QStringList &metadata)
+void appendImageInfo(const ImageInfo_t &ImageInfo, QStringList &metadata)
 {
     if (ImageInfo.CameraMake[0]){
         metadata.append(QObject::tr("Make:%1").arg(QString::fromUtf8(ImageInfo.CameraMake)));
@@ -542,59 +542,92 @@ corrupt:
 }
 
 // copied from jhead.c ProcessFile()
-QStringList jhead_readJpegFile(const char *FileName, bool *error)
+bool jhead_readJpegFile(JheadContext_t *Ctx, const char *FileName, ReadMode_t ReadMode, bool *error)
 {
-    QStringList metadata;
     *error = false;
 
-
-    ReadMode_t ReadMode;
-
     if (strlen(FileName) >= PATH_MAX-1){
         // Protect against buffer overruns in strcpy / strcat's on filename
         *error = true;
-        return metadata;
+        return false;
     }
 
-    ReadMode = READ_METADATA;
-
-    ResetJpgfile();
+    ResetJpgfile(Ctx);
 
     // Start with an empty image information structure.
-    memset(&ImageInfo, 0, sizeof(ImageInfo));
-    ImageInfo.FlashUsed = -1;
-    ImageInfo.MeteringMode = -1;
-    ImageInfo.Whitebalance = -1;
+    memset(&Ctx->ImageInfo, 0, sizeof(Ctx->ImageInfo));
+    Ctx->ImageInfo.FlashUsed = -1;
+    Ctx->ImageInfo.MeteringMode = -1;
+    Ctx->ImageInfo.Whitebalance = -1;
 
     // Store file date/time.
     {
         struct stat st;
         if (stat(FileName, &st) >= 0){
-            ImageInfo.FileDateTime = st.st_mtime;
-            ImageInfo.FileSize = st.st_size;
+            Ctx->ImageInfo.FileDateTime = st.st_mtime;
+            Ctx->ImageInfo.FileSize = st.st_size;
         }else{
             // file not found
             *error = true;
-            return metadata;
+            return false;
         }
     }
 
-    strncpy(ImageInfo.FileName, FileName, PATH_MAX);
+    strncpy(Ctx->ImageInfo.FileName, FileName, PATH_MAX);
 
-    if (!ReadJpegFile(FileName, ReadMode)) return metadata;
+    return ReadJpegFile(Ctx, FileName, ReadMode);
+}
+
+QStringList jhead_readJpegFile(const char *FileName, bool *error)
+{
+    QStringList metadata;
 
-    appendImageInfo(metadata);
+    // each call gets its own context so that multiple files
+    // can be parsed at the same time from different threads
+    JheadContext_t ctx;
+    InitJheadContext(&ctx);
+
+    if (!jhead_readJpegFile(&ctx, FileName, READ_METADATA, error)) {
+        FreeJheadContext(&ctx);
+        return metadata;
+    }
+
+    appendImageInfo(ctx.ImageInfo, metadata);
 
     {
         // if IPTC section is present, show it also.
         Section_t * IptcSection;
-        IptcSection = FindSection(M_IPTC);
+        IptcSection = FindSection(&ctx, M_IPTC);
 
         if (IptcSection){
             appendIPTC(IptcSection->Data, IptcSection->Size, metadata);
         }
     }
 
-    DiscardData();
+    FreeJheadContext(&ctx);
     return metadata;
 }
+
+time_t jhead_readCaptureTime(const char *FileName)
+{
+    time_t result = 0;
+    bool error = false;
+
+    JheadContext_t ctx;
+    InitJheadContext(&ctx);
+    ctx.DateTimeOnly = TRUE; // skip makernotes, GPS, IPTC, and the rest of exif
+
+    if (jhead_readJpegFile(&ctx, FileName, READ_METADATA, &error) && ctx.ImageInfo.DateTime[0]){
+        // DateTime is taken from DateTimeOriginal if available, see exif.c
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        tm.tm_isdst = -1; // Exif times are local time, let mktime() decide about DST
+        if (Exif2tm(&tm, ctx.ImageInfo.DateTime)){
+            result = mktime(&tm);
+            if (result < 0) result = 0;
+        }
+    }
+
+    FreeJheadContext(&ctx);
+    return result;
+}
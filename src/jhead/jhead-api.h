@@ -47,6 +47,19 @@ extern "C" {
 }
 #endif
 
-void showImageInfo(QStringList &metadata);
+void appendImageInfo(const ImageInfo_t &ImageInfo, QStringList &metadata);
 
+// Reads the sections of a JPEG file into Ctx. The context must have been
+// initialised with InitJheadContext() and is owned by the caller.
+// Returns false if the file is not a JPEG file. Sets error if the file
+// cannot be accessed at all.
+bool jhead_readJpegFile(JheadContext_t *Ctx, const char *FileName, ReadMode_t ReadMode, bool *error);
+
+// Reads all metadata of a JPEG file. This is reentrant and can be called from
+// multiple threads at the same time.
 QStringList jhead_readJpegFile(const char *FileName, bool *error);
+
+// Reads the time when a JPEG photo was taken, as stored in its Exif data.
+// Returns 0 if the file has no such information. This is reentrant.
+// Parsing stops once the date is found, other metadata is skipped.
+time_t jhead_readCaptureTime(const char *FileName);
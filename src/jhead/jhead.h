@@ -165,6 +165,42 @@ typedef struct {
     int  QualityGuess;
 }ImageInfo_t;
 
+//--------------------------------------------------------------------------
+// This structure holds all state of one parser run. Upstream jhead keeps
+// this in globals, which makes it impossible to parse more than one file
+// at a time. Every function that reads or writes parser state takes a
+// pointer to a context instead, so each thread can use its own context.
+typedef struct {
+    ImageInfo_t ImageInfo;
+
+    // jpgfile.c: sections read from the file
+    Section_t * Sections;
+    int SectionsAllocated;
+    int SectionsRead;
+    int HaveAll;
+
+    // jpgfile.c: the beginning of the file, if read in place; sections
+    // then point into this buffer instead of owning their data
+    uchar * HeaderData;
+    size_t HeaderSize;
+
+    // exif.c: only read the date, see jhead_readCaptureTime(); the walk
+    // skips other directories and stops once DateTimeOriginal is found
+    int DateTimeOnly;
+    int DateTimeOriginalFound;
+
+    // exif.c: state while walking the exif directories
+    unsigned char * DirWithThumbnailPtrs;
+    double FocalplaneXRes;
+    double FocalplaneUnits;
+    int ExifImageWidth;
+    int MotorolaOrder;
+
+    // exif.c: for fixing the rotation
+    void * OrientationPtr[2];
+    int    OrientationNumFormat[2];
+    int NumOrientations;
+}JheadContext_t;
 
 
 #define EXIT_FAILURE  1
@@ -182,21 +218,21 @@ typedef enum {
 // prototypes for jhead.c functions
 void ErrFatal(const char * msg);
 void ErrNonfatal(const char * msg, int a1, int a2);
-void FileTimeAsString(char * TimeStr);
+void FileTimeAsString(JheadContext_t * Ctx, char * TimeStr);
 
 // Prototypes for exif.c functions.
 int Exif2tm(struct tm * timeptr, char * ExifTime);
-void process_EXIF (unsigned char * CharBuf, unsigned int length);
-void ShowImageInfo(int ShowFileInfo);
-void ShowConciseImageInfo(void);
-const char * ClearOrientation(void);
-void PrintFormatNumber(void * ValuePtr, int Format, int ByteCount);
-double ConvertAnyFormat(void * ValuePtr, int Format);
-int Get16u(void * Short);
-unsigned Get32u(void * Long);
-int Get32s(void * Long);
-void Put32u(void * Value, unsigned PutValue);
-void create_EXIF(void);
+void process_EXIF (JheadContext_t * Ctx, unsigned char * CharBuf, unsigned int length);
+void ShowImageInfo(JheadContext_t * Ctx, int ShowFileInfo);
+void ShowConciseImageInfo(JheadContext_t * Ctx);
+const char * ClearOrientation(JheadContext_t * Ctx);
+void PrintFormatNumber(JheadContext_t * Ctx, void * ValuePtr, int Format, int ByteCount);
+double ConvertAnyFormat(JheadContext_t * Ctx, void * ValuePtr, int Format);
+int Get16u(JheadContext_t * Ctx, void * Short);
+unsigned Get32u(JheadContext_t * Ctx, void * Long);
+int Get32s(JheadContext_t * Ctx, void * Long);
+void Put32u(JheadContext_t * Ctx, void * Value, unsigned PutValue);
+void create_EXIF(JheadContext_t * Ctx);
 
 //--------------------------------------------------------------------------
 // Exif format descriptor stuff
@@ -218,11 +254,11 @@ extern const int BytesPerFormat[];
 
 
 // makernote.c prototypes
-extern void ProcessMakerNote(unsigned char * DirStart, int ByteCount,
+extern void ProcessMakerNote(JheadContext_t * Ctx, unsigned char * DirStart, int ByteCount,
                  unsigned char * OffsetBase, unsigned ExifLength);
 
 // gpsinfo.c prototypes
-void ProcessGpsInfo(unsigned char * ValuePtr,  
+void ProcessGpsInfo(JheadContext_t * Ctx, unsigned char * ValuePtr,  
                 unsigned char * OffsetBase, unsigned ExifLength);
 
 // iptc.c prototpyes
@@ -240,25 +276,29 @@ int EnsurePathExists(const char * FileName);
 void CatPath(char * BasePath, const char * FilePath);
 
 // Prototypes from jpgfile.c
-int ReadJpegSections (FILE * infile, ReadMode_t ReadMode);
-void DiscardData(void);
-void DiscardAllButExif(void);
-int ReadJpegFile(const char * FileName, ReadMode_t ReadMode);
-int ReplaceThumbnail(const char * ThumbFileName);
-int SaveThumbnail(char * ThumbFileName);
-int RemoveSectionType(int SectionType);
-int RemoveUnknownSections(void);
-void WriteJpegFile(const char * FileName);
-Section_t * FindSection(int SectionType);
-Section_t * CreateSection(int SectionType, unsigned char * Data, int size);
-void ResetJpgfile(void);
+int ReadJpegSections (JheadContext_t * Ctx, FILE * infile, ReadMode_t ReadMode);
+int ReadJpegSectionsBuffered (JheadContext_t * Ctx, uchar * FileData, size_t FileSize, ReadMode_t ReadMode);
+void DiscardData(JheadContext_t * Ctx);
+void DiscardAllButExif(JheadContext_t * Ctx);
+int ReadJpegFile(JheadContext_t * Ctx, const char * FileName, ReadMode_t ReadMode);
+int ReplaceThumbnail(JheadContext_t * Ctx, const char * ThumbFileName);
+int SaveThumbnail(JheadContext_t * Ctx, char * ThumbFileName);
+int RemoveSectionType(JheadContext_t * Ctx, int SectionType);
+int RemoveUnknownSections(JheadContext_t * Ctx);
+void WriteJpegFile(JheadContext_t * Ctx, const char * FileName);
+Section_t * FindSection(JheadContext_t * Ctx, int SectionType);
+Section_t * CreateSection(JheadContext_t * Ctx, int SectionType, unsigned char * Data, int size);
+void ResetJpgfile(JheadContext_t * Ctx);
 
 // Prototypes from jpgqguess.c
-void process_DQT (const uchar * Data, int length);
+void process_DQT (JheadContext_t * Ctx, const uchar * Data, int length);
 void process_DHT (const uchar * Data, int length);
 
+// Prototypes for the parser context, see JheadContext_t
+void InitJheadContext(JheadContext_t * Ctx);
+void FreeJheadContext(JheadContext_t * Ctx);
+
 // Variables from jhead.c used by exif.c
-extern ImageInfo_t ImageInfo;
 extern int ShowTags;
 
 //--------------------------------------------------------------------------
@@ -29,18 +29,21 @@
 //--------------------------------------------------------------------------
 #include "jhead.h"
 
-// Storage for simplified info extracted from file.
-ImageInfo_t ImageInfo;
-
-
-static Section_t * Sections = NULL;
-static int SectionsAllocated;
-static int SectionsRead;
-static int HaveAll;
+#include <fcntl.h>
+#include <sys/stat.h>
 
+// Storage for simplified info extracted from file and all sections
+// lives in JheadContext_t (see jhead.h).
 
 
 #define PSEUDO_IMAGE_MARKER 0x123; // Extra value.
+
+// Number of bytes read into a buffer for the headers when only reading.
+// Exif data is limited to 64 KiB, so this is usually enough. Files with
+// larger headers are read section by section instead.
+#ifndef JHEAD_HEADER_READ_SIZE
+#define JHEAD_HEADER_READ_SIZE (256*1024)
+#endif
 //--------------------------------------------------------------------------
 // Get 16 bits motorola order (always) for jpeg header stuff.
 //--------------------------------------------------------------------------
@@ -55,7 +58,7 @@ static int Get16m(const void * Short)
 // We want to print out the marker contents as legible text;
 // we must guard against random junk and varying newline representations.
 //--------------------------------------------------------------------------
-static void process_COM (const uchar * Data, int length)
+static void process_COM (JheadContext_t * Ctx, const uchar * Data, int length)
 {
     int ch;
     char Comment[MAX_COMMENT_SIZE+1];
@@ -84,34 +87,34 @@ static void process_COM (const uchar * Data, int length)
         xprintf("COM marker comment: %s\n",Comment);
     }
 
-    strcpy(ImageInfo.Comments,Comment);
-    ImageInfo.CommentWidthchars = 0;
+    strcpy(Ctx->ImageInfo.Comments,Comment);
+    Ctx->ImageInfo.CommentWidthchars = 0;
 }
 
  
 //--------------------------------------------------------------------------
 // Process a SOFn marker.  This is useful for the image dimensions
 //--------------------------------------------------------------------------
-static void process_SOFn (const uchar * Data, int marker)
+static void process_SOFn (JheadContext_t * Ctx, const uchar * Data, int marker)
 {
     int data_precision, num_components;
 
     data_precision = Data[2];
-    ImageInfo.Height = Get16m(Data+3);
-    ImageInfo.Width = Get16m(Data+5);
+    Ctx->ImageInfo.Height = Get16m(Data+3);
+    Ctx->ImageInfo.Width = Get16m(Data+5);
     num_components = Data[7];
 
     if (num_components == 3){
-        ImageInfo.IsColor = 1;
+        Ctx->ImageInfo.IsColor = 1;
     }else{
-        ImageInfo.IsColor = 0;
+        Ctx->ImageInfo.IsColor = 0;
     }
 
-    ImageInfo.Process = marker;
+    Ctx->ImageInfo.Process = marker;
 
     if (ShowTags){
         xprintf("JPEG image is %uw * %uh, %d color components, %d bits per sample\n",
-                   ImageInfo.Width, ImageInfo.Height, num_components, data_precision);
+                   Ctx->ImageInfo.Width, Ctx->ImageInfo.Height, num_components, data_precision);
     }
 }
 
@@ -119,16 +122,16 @@ static void process_SOFn (const uchar * Data, int marker)
 //--------------------------------------------------------------------------
 // Check sections array to see if it needs to be increased in size.
 //--------------------------------------------------------------------------
-static int CheckSectionsAllocated(void)
+static int CheckSectionsAllocated(JheadContext_t * Ctx)
 {
-    if (SectionsRead > SectionsAllocated){
+    if (Ctx->SectionsRead > Ctx->SectionsAllocated){
         ErrFatal("allocation screwup");
         return FALSE;
     }
-    if (SectionsRead >= SectionsAllocated){
-        SectionsAllocated += SectionsAllocated/2;
-        Sections = (Section_t *)realloc(Sections, sizeof(Section_t)*SectionsAllocated);
-        if (Sections == NULL){
+    if (Ctx->SectionsRead >= Ctx->SectionsAllocated){
+        Ctx->SectionsAllocated += Ctx->SectionsAllocated/2;
+        Ctx->Sections = (Section_t *)realloc(Ctx->Sections, sizeof(Section_t)*Ctx->SectionsAllocated);
+        if (Ctx->Sections == NULL){
             ErrFatal("could not allocate data for entire image");
             return FALSE;
         }
@@ -137,10 +140,156 @@ static int CheckSectionsAllocated(void)
 }
 
 
+//--------------------------------------------------------------------------
+// Result of processing one section, see ProcessSection()
+//--------------------------------------------------------------------------
+typedef enum {
+    SECTION_KEEP,       // keep the section and continue
+    SECTION_DISCARD,    // drop the section and continue
+    SECTION_LAST,       // start of compressed data reached, stop here
+    SECTION_INVALID     // not a usable jpeg stream
+}SectionResult_t;
+
+//--------------------------------------------------------------------------
+// Process one section. Shared between the stream reader and the reader of
+// the header buffer, which differ only in how they get hold of the data.
+//--------------------------------------------------------------------------
+static SectionResult_t ProcessSection(JheadContext_t * Ctx, Section_t * Section,
+        ReadMode_t ReadMode, int * HaveCom)
+{
+    uchar * Data = Section->Data;
+    int itemlen = Section->Size;
+    int marker = Section->Type;
+
+    switch(marker){
+
+        case M_SOS:   // stop before hitting compressed data 
+            return SECTION_LAST;
+
+        case M_DQT:
+            // Use for jpeg quality guessing
+            process_DQT(Ctx, Data, itemlen);
+            break;
+
+        case M_DHT:   
+            // Use for jpeg quality guessing
+            process_DHT(Data, itemlen);
+            break;
+
+
+        case M_EOI:   // in case it's a tables-only JPEG stream
+            fprintf(stderr,"No image in jpeg!\n");
+            return SECTION_INVALID;
+
+        case M_COM: // Comment section
+            if (*HaveCom || ((ReadMode & READ_METADATA) == 0)){
+                // Discard this section.
+                return SECTION_DISCARD;
+            }else{
+                process_COM(Ctx, Data, itemlen);
+                *HaveCom = TRUE;
+            }
+            break;
+
+        case M_JFIF:
+            // Regular jpegs always have this tag, exif images have the exif
+            // marker instead, althogh ACDsee will write images with both markers.
+            // this program will re-create this marker on absence of exif marker.
+            // hence no need to keep the copy from the file.
+            if (memcmp(Data+2, "JFIF\0",5)){
+                fprintf(stderr,"Header missing JFIF marker\n");
+            }
+            if (itemlen < 16){
+                fprintf(stderr,"Jfif header too short\n");
+                return SECTION_DISCARD;
+            }
+
+            Ctx->ImageInfo.JfifHeader.Present = TRUE;
+            Ctx->ImageInfo.JfifHeader.ResolutionUnits = Data[9];
+            Ctx->ImageInfo.JfifHeader.XDensity = (Data[10]<<8) | Data[11];
+            Ctx->ImageInfo.JfifHeader.YDensity = (Data[12]<<8) | Data[13];
+            if (ShowTags){
+                xprintf("JFIF SOI marker: Units: %d ",Ctx->ImageInfo.JfifHeader.ResolutionUnits);
+                switch(Ctx->ImageInfo.JfifHeader.ResolutionUnits){
+                    case 0: xprintf("(aspect ratio)"); break;
+                    case 1: xprintf("(dots per inch)"); break;
+                    case 2: xprintf("(dots per cm)"); break;
+                    default: xprintf("(unknown)"); break;
+                }
+                xprintf("  X-density=%d Y-density=%d\n",Ctx->ImageInfo.JfifHeader.XDensity, Ctx->ImageInfo.JfifHeader.YDensity);
+
+                if (Data[14] || Data[15]){
+                    fprintf(stderr,"Ignoring jfif header thumbnail\n");
+                }
+            }
+
+            return SECTION_DISCARD;
+
+        case M_EXIF:
+            // There can be different section using the same marker.
+            if (ReadMode & READ_METADATA){
+                if (memcmp(Data+2, "Exif", 4) == 0){
+                    process_EXIF(Ctx, Data, itemlen);
+                    // the date is only stored in exif, nothing else is needed
+                    if (Ctx->DateTimeOnly) return SECTION_LAST;
+                    break;
+                }else if (memcmp(Data+2, "http:", 5) == 0){
+                    Section->Type = M_XMP; // Change tag for internal purposes.
+                    if (ShowTags){
+                        xprintf("Image cotains XMP section, %d bytes long\n", itemlen);
+                        if (ShowTags){
+                            ShowXmp(*Section);
+                        }
+                    }
+                    break;
+                }
+            }
+            // Oterwise, discard this section.
+            return SECTION_DISCARD;
+
+        case M_IPTC:
+            if (ReadMode & READ_METADATA){
+                if (ShowTags){
+                    xprintf("Image cotains IPTC section, %d bytes long\n", itemlen);
+                }
+                // Note: We just store the IPTC section.  Its relatively straightforward
+                // and we don't act on any part of it, so just display it at parse time.
+            }else{
+                return SECTION_DISCARD;
+            }
+            break;
+       
+        case M_SOF0: 
+        case M_SOF1: 
+        case M_SOF2: 
+        case M_SOF3: 
+        case M_SOF5: 
+        case M_SOF6: 
+        case M_SOF7: 
+        case M_SOF9: 
+        case M_SOF10:
+        case M_SOF11:
+        case M_SOF13:
+        case M_SOF14:
+        case M_SOF15:
+            process_SOFn(Ctx, Data, marker);
+            break;
+        default:
+            // Skip any other sections.
+            if (ShowTags){
+                xprintf("Jpeg section marker 0x%02x size %d\n",marker, itemlen);
+            }
+            break;
+    }
+
+    return SECTION_KEEP;
+}
+
+
 //--------------------------------------------------------------------------
 // Parse the marker stream until SOS or EOI is seen;
 //--------------------------------------------------------------------------
-int ReadJpegSections (FILE * infile, ReadMode_t ReadMode)
+int ReadJpegSections (JheadContext_t * Ctx, FILE * infile, ReadMode_t ReadMode)
 {
     int a;
     int HaveCom = FALSE;
@@ -151,8 +300,8 @@ int ReadJpegSections (FILE * infile, ReadMode_t ReadMode)
         return FALSE;
     }
 
-    ImageInfo.JfifHeader.XDensity = ImageInfo.JfifHeader.YDensity = 300;
-    ImageInfo.JfifHeader.ResolutionUnits = 1;
+    Ctx->ImageInfo.JfifHeader.XDensity = Ctx->ImageInfo.JfifHeader.YDensity = 300;
+    Ctx->ImageInfo.JfifHeader.ResolutionUnits = 1;
 
     for(;;){
         int itemlen;
@@ -161,7 +310,7 @@ int ReadJpegSections (FILE * infile, ReadMode_t ReadMode)
         int ll,lh, got;
         uchar * Data;
 
-        if (!CheckSectionsAllocated()) return FALSE;
+        if (!CheckSectionsAllocated(Ctx)) return FALSE;
 
         prev = 0;
         for (a=0;;a++){
@@ -178,7 +327,7 @@ int ReadJpegSections (FILE * infile, ReadMode_t ReadMode)
             ErrNonfatal("Extraneous %d padding bytes before section %02X",a-1,marker);
         }
 
-        Sections[SectionsRead].Type = marker;
+        Ctx->Sections[Ctx->SectionsRead].Type = marker;
   
         // Read the length of the section.
         lh = fgetc(infile);
@@ -195,14 +344,14 @@ int ReadJpegSections (FILE * infile, ReadMode_t ReadMode)
             return FALSE;
         }
 
-        Sections[SectionsRead].Size = itemlen;
+        Ctx->Sections[Ctx->SectionsRead].Size = itemlen;
 
         Data = (uchar *)malloc(itemlen);
         if (Data == NULL){
             ErrFatal("Could not allocate memory");
             return FALSE;
         }
-        Sections[SectionsRead].Data = Data;
+        Ctx->Sections[Ctx->SectionsRead].Data = Data;
 
         // Store first two pre-read bytes.
         Data[0] = (uchar)lh;
@@ -213,11 +362,20 @@ int ReadJpegSections (FILE * infile, ReadMode_t ReadMode)
             ErrFatal("Premature end of file?");
             return FALSE;
         }
-        SectionsRead += 1;
+        Ctx->SectionsRead += 1;
 
-        switch(marker){
+        switch(ProcessSection(Ctx, &Ctx->Sections[Ctx->SectionsRead-1], ReadMode, &HaveCom)){
+            case SECTION_KEEP:
+                break;
 
-            case M_SOS:   // stop before hitting compressed data 
+            case SECTION_DISCARD:
+                free(Ctx->Sections[--Ctx->SectionsRead].Data);
+                break;
+
+            case SECTION_INVALID:
+                return FALSE;
+
+            case SECTION_LAST:
                 // If reading entire image is requested, read the rest of the data.
                 if (ReadMode & READ_IMAGE){
                     int cp, ep, size;
@@ -240,170 +398,237 @@ int ReadJpegSections (FILE * infile, ReadMode_t ReadMode)
                         return FALSE;
                     }
 
-                    if (!CheckSectionsAllocated()) return FALSE;
-                    Sections[SectionsRead].Data = Data;
-                    Sections[SectionsRead].Size = size;
-                    Sections[SectionsRead].Type = PSEUDO_IMAGE_MARKER;
-                    SectionsRead ++;
-                    HaveAll = 1;
+                    if (!CheckSectionsAllocated(Ctx)) return FALSE;
+                    Ctx->Sections[Ctx->SectionsRead].Data = Data;
+                    Ctx->Sections[Ctx->SectionsRead].Size = size;
+                    Ctx->Sections[Ctx->SectionsRead].Type = PSEUDO_IMAGE_MARKER;
+                    Ctx->SectionsRead ++;
+                    Ctx->HaveAll = 1;
                 }
                 return TRUE;
+        }
+    }
+    return TRUE;
+}
 
-            case M_DQT:
-                // Use for jpeg quality guessing
-                process_DQT(Data, itemlen);
-                break;
+//--------------------------------------------------------------------------
+// Parse the marker stream of a file whose beginning was read into memory,
+// until SOS or EOI is seen. Nothing is copied: sections point directly into
+// the buffer, and the compressed image data is never touched.
+// Only usable for reading, i.e. not with READ_IMAGE.
+//--------------------------------------------------------------------------
+int ReadJpegSectionsBuffered (JheadContext_t * Ctx, uchar * FileData, size_t FileSize, ReadMode_t ReadMode)
+{
+    size_t Pos;
+    int HaveCom = FALSE;
 
-            case M_DHT:   
-                // Use for jpeg quality guessing
-                process_DHT(Data, itemlen);
-                break;
+    if (FileSize < 4 || FileData[0] != 0xff || FileData[1] != M_SOI){
+        return FALSE;
+    }
+    Pos = 2;
 
+    Ctx->ImageInfo.JfifHeader.XDensity = Ctx->ImageInfo.JfifHeader.YDensity = 300;
+    Ctx->ImageInfo.JfifHeader.ResolutionUnits = 1;
 
-            case M_EOI:   // in case it's a tables-only JPEG stream
-                fprintf(stderr,"No image in jpeg!\n");
-                return FALSE;
+    for(;;){
+        int a;
+        int itemlen;
+        int prev;
+        int marker = 0;
 
-            case M_COM: // Comment section
-                if (HaveCom || ((ReadMode & READ_METADATA) == 0)){
-                    // Discard this section.
-                    free(Sections[--SectionsRead].Data);
-                }else{
-                    process_COM(Data, itemlen);
-                    HaveCom = TRUE;
-                }
-                break;
+        if (!CheckSectionsAllocated(Ctx)) return FALSE;
 
-            case M_JFIF:
-                // Regular jpegs always have this tag, exif images have the exif
-                // marker instead, althogh ACDsee will write images with both markers.
-                // this program will re-create this marker on absence of exif marker.
-                // hence no need to keep the copy from the file.
-                if (memcmp(Data+2, "JFIF\0",5)){
-                    fprintf(stderr,"Header missing JFIF marker\n");
-                }
-                if (itemlen < 16){
-                    fprintf(stderr,"Jfif header too short\n");
-                    goto ignore;
-                }
+        prev = 0;
+        for (a=0;;a++){
+            if (Pos >= FileSize){
+                ErrFatal("Unexpected end of file");
+                return FALSE;
+            }
+            marker = FileData[Pos++];
+            if (marker != 0xff && prev == 0xff) break;
+            prev = marker;
+        }
 
-                ImageInfo.JfifHeader.Present = TRUE;
-                ImageInfo.JfifHeader.ResolutionUnits = Data[9];
-                ImageInfo.JfifHeader.XDensity = (Data[10]<<8) | Data[11];
-                ImageInfo.JfifHeader.YDensity = (Data[12]<<8) | Data[13];
-                if (ShowTags){
-                    xprintf("JFIF SOI marker: Units: %d ",ImageInfo.JfifHeader.ResolutionUnits);
-                    switch(ImageInfo.JfifHeader.ResolutionUnits){
-                        case 0: xprintf("(aspect ratio)"); break;
-                        case 1: xprintf("(dots per inch)"); break;
-                        case 2: xprintf("(dots per cm)"); break;
-                        default: xprintf("(unknown)"); break;
-                    }
-                    xprintf("  X-density=%d Y-density=%d\n",ImageInfo.JfifHeader.XDensity, ImageInfo.JfifHeader.YDensity);
+        if (a > 10){
+            ErrNonfatal("Extraneous %d padding bytes before section %02X",a-1,marker);
+        }
 
-                    if (Data[14] || Data[15]){
-                        fprintf(stderr,"Ignoring jfif header thumbnail\n");
-                    }
-                }
+        if (Pos+2 > FileSize){
+            ErrFatal("Unexpected end of file");
+            return FALSE;
+        }
 
-                ignore:
+        itemlen = Get16m(FileData+Pos);
 
-                free(Sections[--SectionsRead].Data);
-                break;
+        if (itemlen < 2){
+            ErrFatal("invalid marker");
+            return FALSE;
+        }
 
-            case M_EXIF:
-                // There can be different section using the same marker.
-                if (ReadMode & READ_METADATA){
-                    if (memcmp(Data+2, "Exif", 4) == 0){
-                        process_EXIF(Data, itemlen);
-                        break;
-                    }else if (memcmp(Data+2, "http:", 5) == 0){
-                        Sections[SectionsRead-1].Type = M_XMP; // Change tag for internal purposes.
-                        if (ShowTags){
-                            xprintf("Image cotains XMP section, %d bytes long\n", itemlen);
-                            if (ShowTags){
-                                ShowXmp(Sections[SectionsRead-1]);
-                            }
-                        }
-                        break;
-                    }
-                }
-                // Oterwise, discard this section.
-                free(Sections[--SectionsRead].Data);
-                break;
+        // Some section parsers look one byte past the end of the section.
+        // A valid section is always followed by at least another marker.
+        if (Pos+itemlen >= FileSize){
+            ErrFatal("Premature end of file?");
+            return FALSE;
+        }
 
-            case M_IPTC:
-                if (ReadMode & READ_METADATA){
-                    if (ShowTags){
-                        xprintf("Image cotains IPTC section, %d bytes long\n", itemlen);
-                    }
-                    // Note: We just store the IPTC section.  Its relatively straightforward
-                    // and we don't act on any part of it, so just display it at parse time.
-                }else{
-                    free(Sections[--SectionsRead].Data);
-                }
-                break;
-           
-            case M_SOF0: 
-            case M_SOF1: 
-            case M_SOF2: 
-            case M_SOF3: 
-            case M_SOF5: 
-            case M_SOF6: 
-            case M_SOF7: 
-            case M_SOF9: 
-            case M_SOF10:
-            case M_SOF11:
-            case M_SOF13:
-            case M_SOF14:
-            case M_SOF15:
-                process_SOFn(Data, marker);
+        Ctx->Sections[Ctx->SectionsRead].Type = marker;
+        Ctx->Sections[Ctx->SectionsRead].Size = itemlen;
+        Ctx->Sections[Ctx->SectionsRead].Data = FileData+Pos;
+        Ctx->SectionsRead += 1;
+        Pos += itemlen;
+
+        switch(ProcessSection(Ctx, &Ctx->Sections[Ctx->SectionsRead-1], ReadMode, &HaveCom)){
+            case SECTION_KEEP:
                 break;
-            default:
-                // Skip any other sections.
-                if (ShowTags){
-                    xprintf("Jpeg section marker 0x%02x size %d\n",marker, itemlen);
-                }
+            case SECTION_DISCARD:
+                Ctx->SectionsRead -= 1;
                 break;
+            case SECTION_INVALID:
+                return FALSE;
+            case SECTION_LAST:
+                return TRUE;
         }
     }
     return TRUE;
 }
 
+//--------------------------------------------------------------------------
+// Free section data, unless it points into the header buffer.
+//--------------------------------------------------------------------------
+static void FreeSectionData(JheadContext_t * Ctx, uchar * Data)
+{
+    if (Ctx->HeaderData != NULL
+            && Data >= Ctx->HeaderData && Data < Ctx->HeaderData+Ctx->HeaderSize){
+        return;
+    }
+    free(Data);
+}
+
+//--------------------------------------------------------------------------
+// Release the header buffer, if any.
+//--------------------------------------------------------------------------
+static void FreeJpegHeader(JheadContext_t * Ctx)
+{
+    free(Ctx->HeaderData);
+    Ctx->HeaderData = NULL;
+    Ctx->HeaderSize = 0;
+}
+
+//--------------------------------------------------------------------------
+// Read the first bytes of a file, which hold the headers, into a buffer.
+// Returns FALSE if that is not possible, e.g. for empty files.
+//
+// The file is read instead of mapped: files may be truncated at any time,
+// and reading a mapping past the new end would raise SIGBUS. The buffer is
+// private, so the parser may change the data in place (e.g. when trimming
+// comments). Sets *Complete to FALSE if only the beginning was read.
+//--------------------------------------------------------------------------
+static int ReadJpegHeader(JheadContext_t * Ctx, const char * FileName, int * Complete)
+{
+    int fd;
+    struct stat st;
+    size_t FileSize;
+    size_t Size;
+    size_t Done = 0;
+    uchar * Buffer;
+
+    fd = open(FileName, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return FALSE;
+
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0){
+        close(fd);
+        return FALSE;
+    }
+
+    FileSize = (size_t)st.st_size;
+    Size = FileSize < JHEAD_HEADER_READ_SIZE ? FileSize : JHEAD_HEADER_READ_SIZE;
+
+    Buffer = (uchar *)malloc(Size);
+    if (Buffer == NULL){
+        close(fd);
+        return FALSE;
+    }
+
+    while (Done < Size){
+        ssize_t got = pread(fd, Buffer+Done, Size-Done, (off_t)Done);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break; // the file got shorter
+        Done += (size_t)got;
+    }
+    close(fd);
+
+    if (Done == 0){
+        free(Buffer);
+        return FALSE;
+    }
+
+    Ctx->HeaderData = Buffer;
+    Ctx->HeaderSize = Done;
+    *Complete = (Done == FileSize);
+    return TRUE;
+}
+
 //--------------------------------------------------------------------------
 // Discard read data.
 //--------------------------------------------------------------------------
-void DiscardData(void)
+void DiscardData(JheadContext_t * Ctx)
 {
     int a;
 
-    for (a=0;a<SectionsRead;a++){
-        free(Sections[a].Data);
+    for (a=0;a<Ctx->SectionsRead;a++){
+        FreeSectionData(Ctx, Ctx->Sections[a].Data);
     }
+    FreeJpegHeader(Ctx);
 
-    memset(&ImageInfo, 0, sizeof(ImageInfo));
-    SectionsRead = 0;
-    HaveAll = 0;
+    memset(&Ctx->ImageInfo, 0, sizeof(Ctx->ImageInfo));
+    Ctx->SectionsRead = 0;
+    Ctx->HaveAll = 0;
 }
 
 //--------------------------------------------------------------------------
 // Read image data.
 //--------------------------------------------------------------------------
-int ReadJpegFile(const char * FileName, ReadMode_t ReadMode)
+int ReadJpegFile(JheadContext_t * Ctx, const char * FileName, ReadMode_t ReadMode)
 {
     FILE * infile;
-    int ret;
+    int ret = FALSE;
+    int Complete;
+    int ReadStream = TRUE;
+    ImageInfo_t * Info = NULL;
+
+    if ((ReadMode & READ_IMAGE) == 0 && ReadJpegHeader(Ctx, FileName, &Complete)){
+        if (!Complete){
+            // keep the file info in case the headers have to be read again
+            Info = (ImageInfo_t *)malloc(sizeof(ImageInfo_t));
+            if (Info != NULL) memcpy(Info, &Ctx->ImageInfo, sizeof(ImageInfo_t));
+        }
 
-    infile = fopen(FileName, "rb"); // Unix ignores 'b', windows needs it.
+        // Only headers are needed: scan them in place without copying.
+        ret = ReadJpegSectionsBuffered(Ctx, Ctx->HeaderData, Ctx->HeaderSize, ReadMode);
 
-    if (infile == NULL) {
-        fprintf(stderr, "can't open '%s'\n", FileName);
-        return FALSE;
+        ReadStream = (!ret && Info != NULL);
+        if (ReadStream){
+            // The headers did not fit into the buffer read for them.
+            DiscardData(Ctx);
+            memcpy(&Ctx->ImageInfo, Info, sizeof(ImageInfo_t));
+        }
+        free(Info);
     }
 
+    if (ReadStream){
+        infile = fopen(FileName, "rb"); // Unix ignores 'b', windows needs it.
+
+        if (infile == NULL) {
+            fprintf(stderr, "can't open '%s'\n", FileName);
+            return FALSE;
+        }
+
+        // Scan the JPEG headers.
+        ret = ReadJpegSections(Ctx, infile, ReadMode);
+        fclose(infile);
+    }
 
-    // Scan the JPEG headers.
-    ret = ReadJpegSections(infile, ReadMode);
     if (!ret){
         if (ReadMode == READ_ANY){
             // Process any files mode.  Ignore the fact that it's not
@@ -414,10 +639,8 @@ int ReadJpegFile(const char * FileName, ReadMode_t ReadMode)
         }
     }
 
-    fclose(infile);
-
     if (ret == FALSE){
-        DiscardData();
+        DiscardData(Ctx);
     }
     return ret;
 }
@@ -426,11 +649,11 @@ int ReadJpegFile(const char * FileName, ReadMode_t ReadMode)
 //--------------------------------------------------------------------------
 // Replace or remove exif thumbnail
 //--------------------------------------------------------------------------
-int SaveThumbnail(char * ThumbFileName)
+int SaveThumbnail(JheadContext_t * Ctx, char * ThumbFileName)
 {
     FILE * ThumbnailFile;
 
-    if (ImageInfo.ThumbnailOffset == 0 || ImageInfo.ThumbnailSize == 0){
+    if (Ctx->ImageInfo.ThumbnailOffset == 0 || Ctx->ImageInfo.ThumbnailSize == 0){
         fprintf(stderr,"Image contains no thumbnail\n");
         return FALSE;
     }
@@ -446,10 +669,10 @@ int SaveThumbnail(char * ThumbFileName)
     if (ThumbnailFile){
         uchar * ThumbnailPointer;
         Section_t * ExifSection;
-        ExifSection = FindSection(M_EXIF);
-        ThumbnailPointer = ExifSection->Data+ImageInfo.ThumbnailOffset+8;
+        ExifSection = FindSection(Ctx, M_EXIF);
+        ThumbnailPointer = ExifSection->Data+Ctx->ImageInfo.ThumbnailOffset+8;
 
-        fwrite(ThumbnailPointer, ImageInfo.ThumbnailSize ,1, ThumbnailFile);
+        fwrite(ThumbnailPointer, Ctx->ImageInfo.ThumbnailSize ,1, ThumbnailFile);
         fclose(ThumbnailFile);
         return TRUE;
     }else{
@@ -461,14 +684,14 @@ int SaveThumbnail(char * ThumbFileName)
 //--------------------------------------------------------------------------
 // Replace or remove exif thumbnail
 //--------------------------------------------------------------------------
-int ReplaceThumbnail(const char * ThumbFileName)
+int ReplaceThumbnail(JheadContext_t * Ctx, const char * ThumbFileName)
 {
     FILE * ThumbnailFile;
     int ThumbLen, NewExifSize;
     Section_t * ExifSection;
     uchar * ThumbnailPointer;
 
-    if (ImageInfo.ThumbnailOffset == 0 || ImageInfo.ThumbnailAtEnd == FALSE){
+    if (Ctx->ImageInfo.ThumbnailOffset == 0 || Ctx->ImageInfo.ThumbnailAtEnd == FALSE){
         if (ThumbFileName == NULL){
             // Delete of nonexistent thumbnail (not even pointers present)
             // No action, no error.
@@ -495,11 +718,11 @@ int ReplaceThumbnail(const char * ThumbFileName)
         ThumbLen = ftell(ThumbnailFile);
         fseek(ThumbnailFile, 0, SEEK_SET);
 
-        if (ThumbLen + ImageInfo.ThumbnailOffset > 0x10000-20){
+        if (ThumbLen + Ctx->ImageInfo.ThumbnailOffset > 0x10000-20){
             ErrFatal("Thumbnail is too large to insert into exif header");
         }
     }else{
-        if (ImageInfo.ThumbnailSize == 0){
+        if (Ctx->ImageInfo.ThumbnailSize == 0){
              return FALSE;
         }
 
@@ -507,12 +730,12 @@ int ReplaceThumbnail(const char * ThumbFileName)
         ThumbnailFile = NULL;
     }
 
-    ExifSection = FindSection(M_EXIF);
+    ExifSection = FindSection(Ctx, M_EXIF);
 
-    NewExifSize = ImageInfo.ThumbnailOffset+8+ThumbLen;
+    NewExifSize = Ctx->ImageInfo.ThumbnailOffset+8+ThumbLen;
     ExifSection->Data = (uchar *)realloc(ExifSection->Data, NewExifSize);
 
-    ThumbnailPointer = ExifSection->Data+ImageInfo.ThumbnailOffset+8;
+    ThumbnailPointer = ExifSection->Data+Ctx->ImageInfo.ThumbnailOffset+8;
 
     if (ThumbnailFile){
         int res = fread(ThumbnailPointer, ThumbLen, 1, ThumbnailFile);
@@ -520,9 +743,9 @@ int ReplaceThumbnail(const char * ThumbFileName)
         fclose(ThumbnailFile);
     }
 
-    ImageInfo.ThumbnailSize = ThumbLen;
+    Ctx->ImageInfo.ThumbnailSize = ThumbLen;
 
-    Put32u(ExifSection->Data+ImageInfo.ThumbnailSizeOffset+8, ThumbLen);
+    Put32u(Ctx, ExifSection->Data+Ctx->ImageInfo.ThumbnailSizeOffset+8, ThumbLen);
 
     ExifSection->Data[0] = (uchar)(NewExifSize >> 8);
     ExifSection->Data[1] = (uchar)NewExifSize;
@@ -535,7 +758,7 @@ int ReplaceThumbnail(const char * ThumbFileName)
 //--------------------------------------------------------------------------
 // Discard everything but the exif and comment sections.
 //--------------------------------------------------------------------------
-void DiscardAllButExif(void)
+void DiscardAllButExif(JheadContext_t * Ctx)
 {
     Section_t ExifKeeper;
     Section_t CommentKeeper;
@@ -548,48 +771,48 @@ void DiscardAllButExif(void)
     memset(&IptcKeeper, 0, sizeof(IptcKeeper));
     memset(&XmpKeeper, 0, sizeof(IptcKeeper));
 
-    for (a=0;a<SectionsRead;a++){
-        if (Sections[a].Type == M_EXIF && ExifKeeper.Type == 0){
-           ExifKeeper = Sections[a];
-        }else if (Sections[a].Type == M_XMP && XmpKeeper.Type == 0){
-           XmpKeeper = Sections[a];
-        }else if (Sections[a].Type == M_COM && CommentKeeper.Type == 0){
-            CommentKeeper = Sections[a];
-        }else if (Sections[a].Type == M_IPTC && IptcKeeper.Type == 0){
-            IptcKeeper = Sections[a];
+    for (a=0;a<Ctx->SectionsRead;a++){
+        if (Ctx->Sections[a].Type == M_EXIF && ExifKeeper.Type == 0){
+           ExifKeeper = Ctx->Sections[a];
+        }else if (Ctx->Sections[a].Type == M_XMP && XmpKeeper.Type == 0){
+           XmpKeeper = Ctx->Sections[a];
+        }else if (Ctx->Sections[a].Type == M_COM && CommentKeeper.Type == 0){
+            CommentKeeper = Ctx->Sections[a];
+        }else if (Ctx->Sections[a].Type == M_IPTC && IptcKeeper.Type == 0){
+            IptcKeeper = Ctx->Sections[a];
         }else{
-            free(Sections[a].Data);
+            FreeSectionData(Ctx, Ctx->Sections[a].Data);
         }
     }
-    SectionsRead = 0;
+    Ctx->SectionsRead = 0;
     if (ExifKeeper.Type){
-        CheckSectionsAllocated();
-        Sections[SectionsRead++] = ExifKeeper;
+        CheckSectionsAllocated(Ctx);
+        Ctx->Sections[Ctx->SectionsRead++] = ExifKeeper;
     }
     if (CommentKeeper.Type){
-        CheckSectionsAllocated();
-        Sections[SectionsRead++] = CommentKeeper;
+        CheckSectionsAllocated(Ctx);
+        Ctx->Sections[Ctx->SectionsRead++] = CommentKeeper;
     }
     if (IptcKeeper.Type){
-        CheckSectionsAllocated();
-        Sections[SectionsRead++] = IptcKeeper;
+        CheckSectionsAllocated(Ctx);
+        Ctx->Sections[Ctx->SectionsRead++] = IptcKeeper;
     }
 
     if (XmpKeeper.Type){
-        CheckSectionsAllocated();
-        Sections[SectionsRead++] = XmpKeeper;
+        CheckSectionsAllocated(Ctx);
+        Ctx->Sections[Ctx->SectionsRead++] = XmpKeeper;
     }
 }    
 
 //--------------------------------------------------------------------------
 // Write image data back to disk.
 //--------------------------------------------------------------------------
-void WriteJpegFile(const char * FileName)
+void WriteJpegFile(JheadContext_t * Ctx, const char * FileName)
 {
     FILE * outfile;
     int a;
 
-    if (!HaveAll){
+    if (!Ctx->HaveAll){
         ErrFatal("Can't write back - didn't read all");
     }
 
@@ -602,58 +825,58 @@ void WriteJpegFile(const char * FileName)
     fputc(0xff,outfile);
     fputc(0xd8,outfile);
     
-    if (Sections[0].Type != M_EXIF && Sections[0].Type != M_JFIF){
+    if (Ctx->Sections[0].Type != M_EXIF && Ctx->Sections[0].Type != M_JFIF){
         // The image must start with an exif or jfif marker.  If we threw those away, create one.
-        static uchar JfifHead[18] = {
+        uchar JfifHead[18] = {
             0xff, M_JFIF,
             0x00, 0x10, 'J' , 'F' , 'I' , 'F' , 0x00, 0x01, 
             0x01, 0x01, 0x01, 0x2C, 0x01, 0x2C, 0x00, 0x00 
         };
 
-        if (ImageInfo.ResolutionUnit == 2 || ImageInfo.ResolutionUnit == 3){
+        if (Ctx->ImageInfo.ResolutionUnit == 2 || Ctx->ImageInfo.ResolutionUnit == 3){
             // Use the exif resolution info to fill out the jfif header.
             // Usually, for exif images, there's no jfif header, so if wediscard
             // the exif header, use info from the exif header for the jfif header.
             
-            ImageInfo.JfifHeader.ResolutionUnits = (char)(ImageInfo.ResolutionUnit-1);
+            Ctx->ImageInfo.JfifHeader.ResolutionUnits = (char)(Ctx->ImageInfo.ResolutionUnit-1);
             // Jfif is 1 and 2, Exif is 2 and 3 for In and cm respecively
-            ImageInfo.JfifHeader.XDensity = (int)ImageInfo.xResolution;
-            ImageInfo.JfifHeader.YDensity = (int)ImageInfo.yResolution;
+            Ctx->ImageInfo.JfifHeader.XDensity = (int)Ctx->ImageInfo.xResolution;
+            Ctx->ImageInfo.JfifHeader.YDensity = (int)Ctx->ImageInfo.yResolution;
         }
 
-        JfifHead[11] = ImageInfo.JfifHeader.ResolutionUnits;
-        JfifHead[12] = (uchar)(ImageInfo.JfifHeader.XDensity >> 8);
-        JfifHead[13] = (uchar)ImageInfo.JfifHeader.XDensity;
-        JfifHead[14] = (uchar)(ImageInfo.JfifHeader.YDensity >> 8);
-        JfifHead[15] = (uchar)ImageInfo.JfifHeader.YDensity;
+        JfifHead[11] = Ctx->ImageInfo.JfifHeader.ResolutionUnits;
+        JfifHead[12] = (uchar)(Ctx->ImageInfo.JfifHeader.XDensity >> 8);
+        JfifHead[13] = (uchar)Ctx->ImageInfo.JfifHeader.XDensity;
+        JfifHead[14] = (uchar)(Ctx->ImageInfo.JfifHeader.YDensity >> 8);
+        JfifHead[15] = (uchar)Ctx->ImageInfo.JfifHeader.YDensity;
         
 
         fwrite(JfifHead, 18, 1, outfile);
 
         // use the values from the exif data for the jfif header, if we have found values
-        if (ImageInfo.ResolutionUnit != 0) { 
+        if (Ctx->ImageInfo.ResolutionUnit != 0) { 
             // JFIF.ResolutionUnit is {1,2}, EXIF.ResolutionUnit is {2,3}
-            JfifHead[11] = (uchar)ImageInfo.ResolutionUnit - 1; 
+            JfifHead[11] = (uchar)Ctx->ImageInfo.ResolutionUnit - 1; 
         }
-        if (ImageInfo.xResolution > 0.0 && ImageInfo.yResolution > 0.0) { 
-            JfifHead[12] = (uchar)((int)ImageInfo.xResolution>>8);
-            JfifHead[13] = (uchar)((int)ImageInfo.xResolution);
+        if (Ctx->ImageInfo.xResolution > 0.0 && Ctx->ImageInfo.yResolution > 0.0) { 
+            JfifHead[12] = (uchar)((int)Ctx->ImageInfo.xResolution>>8);
+            JfifHead[13] = (uchar)((int)Ctx->ImageInfo.xResolution);
 
-            JfifHead[14] = (uchar)((int)ImageInfo.yResolution>>8);
-            JfifHead[15] = (uchar)((int)ImageInfo.yResolution);
+            JfifHead[14] = (uchar)((int)Ctx->ImageInfo.yResolution>>8);
+            JfifHead[15] = (uchar)((int)Ctx->ImageInfo.yResolution);
         }
     }
 
 
     // Write all the misc sections
-    for (a=0;a<SectionsRead-1;a++){
+    for (a=0;a<Ctx->SectionsRead-1;a++){
         fputc(0xff,outfile);
-        fputc((unsigned char)Sections[a].Type, outfile);
-        fwrite(Sections[a].Data, Sections[a].Size, 1, outfile);
+        fputc((unsigned char)Ctx->Sections[a].Type, outfile);
+        fwrite(Ctx->Sections[a].Data, Ctx->Sections[a].Size, 1, outfile);
     }
 
     // Write the remaining image data.
-    fwrite(Sections[a].Data, Sections[a].Size, 1, outfile);
+    fwrite(Ctx->Sections[a].Data, Ctx->Sections[a].Size, 1, outfile);
        
     fclose(outfile);
 }
@@ -662,13 +885,13 @@ void WriteJpegFile(const char * FileName)
 //--------------------------------------------------------------------------
 // Check if image has exif header.
 //--------------------------------------------------------------------------
-Section_t * FindSection(int SectionType)
+Section_t * FindSection(JheadContext_t * Ctx, int SectionType)
 {
     int a;
 
-    for (a=0;a<SectionsRead;a++){
-        if (Sections[a].Type == SectionType){
-            return &Sections[a];
+    for (a=0;a<Ctx->SectionsRead;a++){
+        if (Ctx->Sections[a].Type == SectionType){
+            return &Ctx->Sections[a];
         }
     }
     // Could not be found.
@@ -678,16 +901,16 @@ Section_t * FindSection(int SectionType)
 //--------------------------------------------------------------------------
 // Remove a certain type of section.
 //--------------------------------------------------------------------------
-int RemoveSectionType(int SectionType)
+int RemoveSectionType(JheadContext_t * Ctx, int SectionType)
 {
     int a;
-    for (a=0;a<SectionsRead-1;a++){
-        if (Sections[a].Type == SectionType){
+    for (a=0;a<Ctx->SectionsRead-1;a++){
+        if (Ctx->Sections[a].Type == SectionType){
             // Free up this section
-            free (Sections[a].Data);
+            FreeSectionData(Ctx, Ctx->Sections[a].Data);
             // Move succeding sections back by one to close space in array.
-            memmove(Sections+a, Sections+a+1, sizeof(Section_t) * (SectionsRead-a));
-            SectionsRead -= 1;
+            memmove(Ctx->Sections+a, Ctx->Sections+a+1, sizeof(Section_t) * (Ctx->SectionsRead-a));
+            Ctx->SectionsRead -= 1;
             return TRUE;
         }
     }
@@ -697,12 +920,12 @@ int RemoveSectionType(int SectionType)
 //--------------------------------------------------------------------------
 // Remove sectons not part of image and not exif or comment sections.
 //--------------------------------------------------------------------------
-int RemoveUnknownSections(void)
+int RemoveUnknownSections(JheadContext_t * Ctx)
 {
     int a;
     int Modified = FALSE;
-    for (a=0;a<SectionsRead-1;){
-        switch(Sections[a].Type){
+    for (a=0;a<Ctx->SectionsRead-1;){
+        switch(Ctx->Sections[a].Type){
             case  M_SOF0:
             case  M_SOF1:
             case  M_SOF2:
@@ -732,10 +955,10 @@ int RemoveUnknownSections(void)
                 break;
             default:
                 // Unknown.  Delete.
-                free (Sections[a].Data);
+                FreeSectionData(Ctx, Ctx->Sections[a].Data);
                 // Move succeding sections back by one to close space in array.
-                memmove(Sections+a, Sections+a+1, sizeof(Section_t) * (SectionsRead-a));
-                SectionsRead -= 1;
+                memmove(Ctx->Sections+a, Ctx->Sections+a+1, sizeof(Section_t) * (Ctx->SectionsRead-a));
+                Ctx->SectionsRead -= 1;
                 Modified = TRUE;
         }
     }
@@ -746,7 +969,7 @@ int RemoveUnknownSections(void)
 // Add a section (assume it doesn't already exist) - used for 
 // adding comment sections and exif sections
 //--------------------------------------------------------------------------
-Section_t * CreateSection(int SectionType, unsigned char * Data, int Size)
+Section_t * CreateSection(JheadContext_t * Ctx, int SectionType, unsigned char * Data, int Size)
 {
     Section_t * NewSection;
     int a;
@@ -757,23 +980,23 @@ Section_t * CreateSection(int SectionType, unsigned char * Data, int Size)
         // Exif alwas goes first!
     }else{
         for (;NewIndex < 3;NewIndex++){ // Maximum fourth position (just for the heck of it)
-            if (Sections[NewIndex].Type == M_JFIF) continue; // Put it after Jfif
-            if (Sections[NewIndex].Type == M_EXIF) continue; // Put it after Exif
+            if (Ctx->Sections[NewIndex].Type == M_JFIF) continue; // Put it after Jfif
+            if (Ctx->Sections[NewIndex].Type == M_EXIF) continue; // Put it after Exif
             break;
         }
     }
 
-    if (SectionsRead < NewIndex){
+    if (Ctx->SectionsRead < NewIndex){
         ErrFatal("Too few sections!");
     }
 
-    CheckSectionsAllocated();
-    for (a=SectionsRead;a>NewIndex;a--){
-        Sections[a] = Sections[a-1];          
+    CheckSectionsAllocated(Ctx);
+    for (a=Ctx->SectionsRead;a>NewIndex;a--){
+        Ctx->Sections[a] = Ctx->Sections[a-1];          
     }
-    SectionsRead += 1;
+    Ctx->SectionsRead += 1;
 
-    NewSection = Sections+NewIndex;
+    NewSection = Ctx->Sections+NewIndex;
 
     NewSection->Type = SectionType;
     NewSection->Size = Size;
@@ -783,16 +1006,37 @@ Section_t * CreateSection(int SectionType, unsigned char * Data, int Size)
 }
 
 
+//--------------------------------------------------------------------------
+// Prepare a fresh parser context. Must be called once before first use.
+//--------------------------------------------------------------------------
+void InitJheadContext(JheadContext_t * Ctx)
+{
+    memset(Ctx, 0, sizeof(JheadContext_t));
+}
+
+//--------------------------------------------------------------------------
+// Release everything a parser context owns.
+//--------------------------------------------------------------------------
+void FreeJheadContext(JheadContext_t * Ctx)
+{
+    DiscardData(Ctx);
+    free(Ctx->Sections);
+    Ctx->Sections = NULL;
+    Ctx->SectionsAllocated = 0;
+}
+
 //--------------------------------------------------------------------------
 // Initialisation.
 //--------------------------------------------------------------------------
-void ResetJpgfile(void)
+void ResetJpgfile(JheadContext_t * Ctx)
 {
-    if (Sections == NULL){
-        Sections = (Section_t *)malloc(sizeof(Section_t)*5);
-        SectionsAllocated = 5;
+    FreeJpegHeader(Ctx);
+
+    if (Ctx->Sections == NULL){
+        Ctx->Sections = (Section_t *)malloc(sizeof(Section_t)*5);
+        Ctx->SectionsAllocated = 5;
     }
 
-    SectionsRead = 0;
-    HaveAll = 0;
+    Ctx->SectionsRead = 0;
+    Ctx->HaveAll = 0;
 }
@@ -98,7 +98,7 @@ static int jpeg_zigzag_order[64] = {
  * this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
- void process_DQT (const uchar * Data, int length)
+ void process_DQT (JheadContext_t * Ctx, const uchar * Data, int length)
 {
     int a;
     int c;
@@ -172,7 +172,7 @@ static int jpeg_zigzag_order[64] = {
                      tableindex, qual, cumsf, var);
             } else {
                 if (tableindex == 0){
-                    ImageInfo.QualityGuess = (int)(qual+0.5);
+                    Ctx->ImageInfo.QualityGuess = (int)(qual+0.5);
                 }
             }
         }
@@ -25,19 +25,18 @@
 //--------------------------------------------------------------------------
 #include "jhead.h"
 
-extern int MotorolaOrder;
 
 //--------------------------------------------------------------------------
 // Process exif format directory, as used by Cannon maker note
 //--------------------------------------------------------------------------
-static void ProcessCanonMakerNoteDir(unsigned char * DirStart, unsigned char * OffsetBase, 
+static void ProcessCanonMakerNoteDir(JheadContext_t * Ctx, unsigned char * DirStart, unsigned char * OffsetBase, 
         unsigned ExifLength)
 {
     int de;
     int a;
     int NumDirEntries;
 
-    NumDirEntries = Get16u(DirStart);
+    NumDirEntries = Get16u(Ctx, DirStart);
     #define DIR_ENTRY_ADDR(Start, Entry) (Start+2+12*(Entry))
 
     {
@@ -64,9 +63,9 @@ static void ProcessCanonMakerNoteDir(unsigned char * DirStart, unsigned char * O
         unsigned char * DirEntry;
         DirEntry = DIR_ENTRY_ADDR(DirStart, de);
 
-        Tag = Get16u(DirEntry);
-        Format = Get16u(DirEntry+2);
-        Components = Get32u(DirEntry+4);
+        Tag = Get16u(Ctx, DirEntry);
+        Format = Get16u(Ctx, DirEntry+2);
+        Components = Get32u(Ctx, DirEntry+4);
 
         if ((Format-1) >= NUM_FORMATS) {
             // (-1) catches illegal zero case as unsigned underflows to positive large.
@@ -83,7 +82,7 @@ static void ProcessCanonMakerNoteDir(unsigned char * DirStart, unsigned char * O
 
         if (ByteCount > 4){
             unsigned OffsetVal;
-            OffsetVal = Get32u(DirEntry+8);
+            OffsetVal = Get32u(Ctx, DirEntry+8);
             // If its bigger than 4 bytes, the dir entry contains an offset.
             if (OffsetVal+ByteCount > ExifLength){
                 // Bogus pointer offset and / or bytecount value
@@ -135,37 +134,37 @@ static void ProcessCanonMakerNoteDir(unsigned char * DirStart, unsigned char * O
 
             default:
                 if (ShowTags){
-                    PrintFormatNumber(ValuePtr, Format, ByteCount);
+                    PrintFormatNumber(Ctx, ValuePtr, Format, ByteCount);
                     xprintf("\n");
                 }
         }
         if (Tag == 1 && Components > 16){
-            int IsoCode = Get16u(ValuePtr + 16*sizeof(unsigned short));
+            int IsoCode = Get16u(Ctx, ValuePtr + 16*sizeof(unsigned short));
             if (IsoCode >= 16 && IsoCode <= 24){
-                ImageInfo.ISOequivalent = 50 << (IsoCode-16);
+                Ctx->ImageInfo.ISOequivalent = 50 << (IsoCode-16);
             } 
         }
 
         if (Tag == 4 && Format == FMT_USHORT){
             if (Components > 7){
-                int WhiteBalance = Get16u(ValuePtr + 7*sizeof(unsigned short));
+                int WhiteBalance = Get16u(Ctx, ValuePtr + 7*sizeof(unsigned short));
                 switch(WhiteBalance){
                     // 0=Auto, 6=Custom
-                    case 1: ImageInfo.LightSource = 1; break; // Sunny
-                    case 2: ImageInfo.LightSource = 1; break; // Cloudy
-                    case 3: ImageInfo.LightSource = 3; break; // Thungsten
-                    case 4: ImageInfo.LightSource = 2; break; // Fourescent
-                    case 5: ImageInfo.LightSource = 4; break; // Flash
+                    case 1: Ctx->ImageInfo.LightSource = 1; break; // Sunny
+                    case 2: Ctx->ImageInfo.LightSource = 1; break; // Cloudy
+                    case 3: Ctx->ImageInfo.LightSource = 3; break; // Thungsten
+                    case 4: Ctx->ImageInfo.LightSource = 2; break; // Fourescent
+                    case 5: Ctx->ImageInfo.LightSource = 4; break; // Flash
                 }
             }
-            if (Components > 19 && ImageInfo.Distance <= 0) {
+            if (Components > 19 && Ctx->ImageInfo.Distance <= 0) {
                 // Indicates the distance the autofocus camera is focused to.
                 // Tends to be less accurate as distance increases.
-                int temp_dist = Get16u(ValuePtr + 19*sizeof(unsigned short));
+                int temp_dist = Get16u(Ctx, ValuePtr + 19*sizeof(unsigned short));
                 if (temp_dist != 65535){
-                    ImageInfo.Distance = (float)temp_dist/100;
+                    Ctx->ImageInfo.Distance = (float)temp_dist/100;
                 }else{
-                    ImageInfo.Distance = -1 /* infinity */;
+                    Ctx->ImageInfo.Distance = -1 /* infinity */;
                 }
             }
         }
@@ -192,17 +191,17 @@ static void ShowMakerNoteGeneric(unsigned char * ValuePtr, int ByteCount)
 //--------------------------------------------------------------------------
 // Process maker note - to the limited extent that its supported.
 //--------------------------------------------------------------------------
-void ProcessMakerNote(unsigned char * ValuePtr, int ByteCount, 
+void ProcessMakerNote(JheadContext_t * Ctx, unsigned char * ValuePtr, int ByteCount, 
         unsigned char * OffsetBase, unsigned ExifLength)
 {
-    if (strstr(ImageInfo.CameraMake, "Canon")){
+    if (strstr(Ctx->ImageInfo.CameraMake, "Canon")){
         // So it turns out that some canons cameras use big endian, others use little
         // endian in the main exif header.  But the maker note is always little endian.
-        static int MotorolaOrderSave;
-        MotorolaOrderSave = MotorolaOrder;
-        MotorolaOrder = 0; // Temporarily switch to little endian.
-        ProcessCanonMakerNoteDir(ValuePtr, OffsetBase, ExifLength);
-        MotorolaOrder = MotorolaOrderSave;
+        int MotorolaOrderSave;
+        MotorolaOrderSave = Ctx->MotorolaOrder;
+        Ctx->MotorolaOrder = 0; // Temporarily switch to little endian.
+        ProcessCanonMakerNoteDir(Ctx, ValuePtr, OffsetBase, ExifLength);
+        Ctx->MotorolaOrder = MotorolaOrderSave;
     }else{
         if (ShowTags){
             ShowMakerNoteGeneric(ValuePtr, ByteCount);
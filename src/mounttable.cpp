@@ -0,0 +1,229 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sysmacros.h>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSocketNotifier>
+#include "mounttable.h"
+
+MountTable* MountTable::instance()
+{
+    static MountTable* table = new MountTable(qApp);
+    return table;
+}
+
+MountTable::MountTable(QObject* parent) : QObject(parent)
+{
+    m_fd = ::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+
+    if (m_fd < 0) {
+        qWarning() << "[MountTable] failed to open mount table, mounts are unknown";
+        return;
+    }
+
+    m_mounts = parse(readTable());
+
+    // the kernel flags the file with priority data (POLLPRI) when mounts
+    // change, which is what Qt watches for 'exception' notifiers
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Exception, this);
+    connect(m_notifier, SIGNAL(activated(int)), this, SLOT(reload()));
+}
+
+MountTable::~MountTable()
+{
+    if (m_fd >= 0) ::close(m_fd);
+}
+
+MountTable::Mount MountTable::mountFor(const QString& path) const
+{
+    QString current = QDir::cleanPath(path);
+    if (!current.startsWith('/')) return Mount();
+
+    QMutexLocker locker(&m_mutex);
+
+    while (true) {
+        auto found = m_mounts.constFind(current);
+        if (found != m_mounts.constEnd()) return *found;
+        if (current == "/") break;
+
+        int slash = current.lastIndexOf('/');
+        current = (slash <= 0) ? QStringLiteral("/") : current.left(slash);
+    }
+
+    return Mount();
+}
+
+bool MountTable::isMountPoint(const QString& path) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_mounts.contains(QDir::cleanPath(path));
+}
+
+bool MountTable::isSameMount(const QString& a, const QString& b) const
+{
+    Mount first = mountFor(a);
+    return first.isValid() && first.id == mountFor(b).id;
+}
+
+QList<MountTable::Mount> MountTable::mounts() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_mounts.values();
+}
+
+MountTable::StorageType MountTable::storageType(const Mount& mount)
+{
+    if (!mount.isValid() || major(mount.device) == 0) return UnknownStorage;
+
+    QString device = QFileInfo(QString("/sys/dev/block/%1:%2").arg(major(mount.device))
+                               .arg(minor(mount.device))).canonicalFilePath();
+    if (device.isEmpty()) return UnknownStorage;
+
+    // partitions are subdirectories of their disk
+    if (!QFileInfo::exists(device + "/queue")) device = QFileInfo(device).path();
+
+    auto read = [](const QString& file) -> QByteArray {
+        QFile f(file);
+        if (!f.open(QIODevice::ReadOnly)) return QByteArray();
+        return f.readAll().trimmed();
+    };
+
+    if (read(device + "/queue/rotational") == "1") return RotationalStorage;
+    if (read(device + "/device/type") == "SD") return SdCardStorage;
+    if (read(device + "/removable") == "1" || device.contains("/usb")) return RemovableStorage;
+    return FlashStorage;
+}
+
+void MountTable::reload()
+{
+    QMap<QString, Mount> fresh = parse(readTable());
+    QStringList added, removed;
+
+    {
+        QMutexLocker locker(&m_mutex);
+
+        for (auto i = m_mounts.constBegin(); i != m_mounts.constEnd(); ++i) {
+            auto other = fresh.constFind(i.key());
+            if (other == fresh.constEnd() || other->id != i->id) removed.append(i.key());
+        }
+
+        for (auto i = fresh.constBegin(); i != fresh.constEnd(); ++i) {
+            auto other = m_mounts.constFind(i.key());
+            if (other == m_mounts.constEnd() || other->id != i->id) added.append(i.key());
+        }
+
+        m_mounts = fresh;
+    }
+
+    if (added.isEmpty() && removed.isEmpty()) return;
+    qDebug() << "[MountTable] mounts changed: added" << added << "removed" << removed;
+
+    for (const auto& path : removed) emit unmounted(path);
+    for (const auto& path : added) emit mounted(path);
+    emit changed();
+}
+
+QByteArray MountTable::readTable()
+{
+    QByteArray data;
+    if (::lseek(m_fd, 0, SEEK_SET) < 0) return data;
+
+    char buffer[4096];
+    ssize_t count = 0;
+
+    while ((count = ::read(m_fd, buffer, sizeof(buffer))) != 0) {
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            qWarning() << "[MountTable] failed to read mount table:" << strerror(errno);
+            break;
+        }
+
+        data.append(buffer, int(count));
+    }
+
+    return data;
+}
+
+QMap<QString, MountTable::Mount> MountTable::parse(const QByteArray& data)
+{
+    // Each line looks like this, see proc(5):
+    // 36 35 98:0 /mnt1 /mnt/parent rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+    // The number of optional fields before the separator varies.
+    QMap<QString, Mount> result;
+
+    for (const auto& line : data.split('\n')) {
+        QList<QByteArray> fields = line.split(' ');
+        int separator = fields.indexOf("-");
+        if (separator < 6 || fields.length() < separator + 3) continue;
+
+        QList<QByteArray> device = fields.at(2).split(':');
+        if (device.length() != 2) continue;
+
+        Mount mount;
+        mount.id = fields.at(0).toInt();
+        mount.parentId = fields.at(1).toInt();
+        mount.device = quint64(makedev(device.at(0).toUInt(), device.at(1).toUInt()));
+        mount.root = unescape(fields.at(3));
+        mount.path = unescape(fields.at(4));
+        mount.options = QString::fromLatin1(fields.at(5));
+        mount.type = QString::fromLatin1(fields.at(separator + 1));
+        mount.source = unescape(fields.at(separator + 2));
+
+        // later mounts hide earlier mounts on the same mount point
+        result.insert(mount.path, mount);
+    }
+
+    return result;
+}
+
+QString MountTable::unescape(const QByteArray& field)
+{
+    // spaces, tabs, newlines, and backslashes are escaped as octal numbers
+    if (!field.contains('\\')) return QFile::decodeName(field);
+
+    QByteArray decoded;
+    decoded.reserve(field.length());
+
+    for (int i = 0; i < field.length(); ++i) {
+        if (field.at(i) == '\\' && i + 3 < field.length()) {
+            bool ok = false;
+            char c = char(field.mid(i + 1, 3).toInt(&ok, 8));
+
+            if (ok) {
+                decoded.append(c);
+                i += 3;
+                continue;
+            }
+        }
+
+        decoded.append(field.at(i));
+    }
+
+    return QFile::decodeName(decoded);
+}
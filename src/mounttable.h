@@ -0,0 +1,102 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOUNTTABLE_H
+#define MOUNTTABLE_H
+
+#include <QObject>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+class QSocketNotifier;
+
+/**
+ * @brief The MountTable class keeps track of all mounted file systems.
+ *
+ * The mount table is read from /proc/self/mountinfo once and read again
+ * only when the kernel signals a change, i.e. when the file becomes
+ * readable with priority data (POLLPRI). Changes are reported through
+ * the mounted() and unmounted() signals.
+ *
+ * Mounts are indexed by mount point, so the mount containing a path is
+ * found by looking up the path and its parents. Lookups are thread-safe.
+ * The instance must first be created in the main thread.
+ */
+class MountTable : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Mount {
+        int id = {-1};
+        int parentId = {-1};
+        quint64 device = {0}; // same as st_dev of files on the mount
+        QString root; // root of the mount inside its file system
+        QString path; // mount point
+        QString type; // file system type
+        QString source; // e.g. the device file
+        QString options;
+        bool isValid() const { return id >= 0; }
+    };
+
+    enum StorageType {
+        UnknownStorage, // no block device, e.g. network or virtual file systems
+        RotationalStorage, // hard disks
+        RemovableStorage, // e.g. USB drives
+        SdCardStorage,
+        FlashStorage // internal eMMC, UFS or SSD
+    };
+
+    static MountTable* instance();
+    ~MountTable();
+
+    // Returns the mount containing the path, i.e. the mount with the longest
+    // mount point that is a prefix of the path. Symlinks are not resolved.
+    Mount mountFor(const QString& path) const;
+
+    bool isMountPoint(const QString& path) const;
+    bool isSameMount(const QString& a, const QString& b) const;
+    QList<Mount> mounts() const;
+
+    // Returns the kind of storage the mount is on, as reported by sysfs.
+    static StorageType storageType(const Mount& mount);
+
+signals:
+    void mounted(QString path);
+    void unmounted(QString path);
+    void changed();
+
+private slots:
+    void reload();
+
+private:
+    explicit MountTable(QObject* parent = nullptr);
+    static QMap<QString, Mount> parse(const QByteArray& data);
+    static QString unescape(const QByteArray& field);
+    QByteArray readTable();
+
+    int m_fd = {-1};
+    QSocketNotifier* m_notifier = {nullptr};
+    QMap<QString, Mount> m_mounts; // by mount point
+    mutable QMutex m_mutex;
+};
+
+#endif // MOUNTTABLE_H
@@ -0,0 +1,218 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QTimer>
+#include "processrunner.h"
+
+// Maximum number of processes running at the same time.
+#ifndef PROCESSRUNNER_MAX_RUNNING
+#define PROCESSRUNNER_MAX_RUNNING 4
+#endif
+
+// Default time in milliseconds after which processes are killed.
+#ifndef PROCESSRUNNER_TIMEOUT
+#define PROCESSRUNNER_TIMEOUT 30000
+#endif
+
+ProcessRunner* ProcessRunner::instance()
+{
+    static ProcessRunner* runner = new ProcessRunner(qApp);
+    return runner;
+}
+
+ProcessRunner::ProcessRunner(QObject* parent) : QObject(parent) {}
+
+int ProcessRunner::run(QString command, QStringList arguments, Flags flags, int timeout)
+{
+    int requestId = ++m_lastRequest;
+
+    Job job;
+    job.id = requestId;
+    job.command = command;
+    job.arguments = arguments;
+    job.flags = flags;
+    job.timeout = (timeout < 0 ? PROCESSRUNNER_TIMEOUT : timeout);
+
+    if (flags.testFlag(CacheResult)) {
+        auto cached = m_cache.constFind(cacheKey(job));
+
+        if (cached != m_cache.constEnd()) {
+            // send the result when control returns to the event loop,
+            // so that callers know the id
+            QString output = *cached;
+            QTimer::singleShot(0, this, [this, requestId, output]() {
+                emit finished(requestId, 0, false, output);
+            });
+            return requestId;
+        }
+    }
+
+    m_jobs.insert(requestId, job);
+    startQueued();
+    return requestId;
+}
+
+void ProcessRunner::cancel(int requestId)
+{
+    auto job = m_jobs.find(requestId);
+    if (job == m_jobs.end()) return;
+
+    if (job->process) {
+        qDebug() << "[ProcessRunner] killing cancelled process:" << job->command;
+        job->process->kill();
+    }
+
+    remove(requestId);
+    startQueued();
+}
+
+void ProcessRunner::readOutput()
+{
+    Job* job = jobFor(sender());
+    if (!job) return;
+
+    if (job->flags.testFlag(StreamLines)) {
+        while (job->process->canReadLine()) {
+            emit lineRead(job->id, QString::fromUtf8(job->process->readLine()));
+        }
+    } else {
+        job->output.append(job->process->readAll());
+    }
+}
+
+void ProcessRunner::handleFinished(int exitCode, QProcess::ExitStatus status)
+{
+    Job* job = jobFor(sender());
+    if (!job) return;
+
+    // send the last line even if it does not end with a line break
+    QByteArray rest = job->process->readAll();
+
+    if (job->flags.testFlag(StreamLines)) {
+        if (!rest.isEmpty()) emit lineRead(job->id, QString::fromUtf8(rest));
+    } else {
+        job->output.append(rest);
+    }
+
+    int requestId = job->id;
+    bool crashed = (status == QProcess::CrashExit);
+    QString output = QString::fromUtf8(job->output);
+
+    if (job->flags.testFlag(CacheResult) && !crashed && exitCode == 0) {
+        m_cache.insert(cacheKey(*job), output);
+    }
+
+    remove(requestId);
+    startQueued();
+    emit finished(requestId, exitCode, crashed, output);
+}
+
+void ProcessRunner::handleError(QProcess::ProcessError error)
+{
+    // All other errors are followed by finished() or are
+    // handled there, e.g. crashes.
+    if (error != QProcess::FailedToStart) return;
+
+    Job* job = jobFor(sender());
+    if (!job) return;
+
+    qDebug() << "[ProcessRunner] failed to start:" << job->command;
+    int requestId = job->id;
+    remove(requestId);
+    startQueued();
+    emit failed(requestId, error);
+}
+
+void ProcessRunner::startQueued()
+{
+    for (auto i = m_jobs.begin(); i != m_jobs.end() && m_running < PROCESSRUNNER_MAX_RUNNING; ++i) {
+        if (!i->process) start(*i);
+    }
+}
+
+void ProcessRunner::start(Job& job)
+{
+    job.process = new QProcess(this);
+    job.process->setReadChannel(QProcess::StandardOutput);
+
+    if (job.flags.testFlag(MergeErrorStream)) {
+        job.process->setProcessChannelMode(QProcess::MergedChannels);
+    }
+
+    m_processes.insert(job.process, job.id);
+    m_running++;
+
+    connect(job.process, SIGNAL(readyReadStandardOutput()), this, SLOT(readOutput()));
+    connect(job.process, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(handleFinished(int, QProcess::ExitStatus)));
+    connect(job.process, SIGNAL(error(QProcess::ProcessError)), this, SLOT(handleError(QProcess::ProcessError)));
+
+    if (job.timeout > 0) {
+        int requestId = job.id;
+        QTimer::singleShot(job.timeout, this, [this, requestId]() { expire(requestId); });
+    }
+
+    job.process->start(job.command, job.arguments);
+}
+
+void ProcessRunner::expire(int requestId)
+{
+    auto job = m_jobs.find(requestId);
+    if (job == m_jobs.end() || !job->process) return; // already finished
+
+    qDebug() << "[ProcessRunner] killing process after timeout:" << job->command;
+    job->process->kill();
+    remove(requestId);
+    startQueued();
+    emit failed(requestId, QProcess::Timedout);
+}
+
+void ProcessRunner::remove(int requestId)
+{
+    auto job = m_jobs.find(requestId);
+    if (job == m_jobs.end()) return;
+
+    if (job->process) {
+        // the process is deleted once it is dead; its
+        // remaining signals are ignored
+        job->process->disconnect(this);
+        m_processes.remove(job->process);
+        connect(job->process, SIGNAL(finished(int, QProcess::ExitStatus)), job->process, SLOT(deleteLater()));
+        if (job->process->state() == QProcess::NotRunning) job->process->deleteLater();
+        m_running--;
+    }
+
+    m_jobs.erase(job);
+}
+
+ProcessRunner::Job* ProcessRunner::jobFor(QObject* process)
+{
+    auto id = m_processes.constFind(process);
+    if (id == m_processes.constEnd()) return nullptr;
+
+    auto job = m_jobs.find(*id);
+    return (job == m_jobs.end()) ? nullptr : &(*job);
+}
+
+QString ProcessRunner::cacheKey(const Job& job)
+{
+    return QString::number(int(job.flags)) + '\n' + job.command + '\n' + job.arguments.join('\n');
+}
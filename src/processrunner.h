@@ -0,0 +1,105 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROCESSRUNNER_H
+#define PROCESSRUNNER_H
+
+#include <QObject>
+#include <QHash>
+#include <QMap>
+#include <QProcess>
+#include <QStringList>
+
+/**
+ * @brief The ProcessRunner class runs external commands without blocking.
+ *
+ * Commands are started in the order they were requested, but only a few of
+ * them run at the same time. Output is collected and sent when the process
+ * finishes, or sent line by line while it runs. Processes are killed when
+ * they are cancelled or take too long.
+ *
+ * Results of idempotent queries (e.g. 'busybox --list') can be cached
+ * for the lifetime of the app.
+ *
+ * The instance must be used from the main thread only. Running processes
+ * are killed when the app quits.
+ */
+class ProcessRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Flag {
+        NoFlags = 0x0,
+        MergeErrorStream = 0x1, // collect stderr together with stdout
+        StreamLines = 0x2, // send output with lineRead() instead of collecting it
+        CacheResult = 0x4, // cache the output of successful runs
+    };
+    Q_DECLARE_FLAGS(Flags, Flag)
+
+    static ProcessRunner* instance();
+
+    // Starts a command and returns a request id. Results are sent with
+    // finished() or failed(). A timeout of 0 or less disables the timeout.
+    int run(QString command, QStringList arguments, Flags flags = NoFlags,
+            int timeout = -1 /* default timeout */);
+
+    // Kills the process or removes it from the queue. No results are sent.
+    void cancel(int requestId);
+
+signals:
+    void lineRead(int requestId, QString line);
+    void finished(int requestId, int exitCode, bool crashed, QString output);
+    void failed(int requestId, QProcess::ProcessError error);
+
+private slots:
+    void readOutput();
+    void handleFinished(int exitCode, QProcess::ExitStatus status);
+    void handleError(QProcess::ProcessError error);
+
+private:
+    struct Job {
+        int id = {0};
+        QString command;
+        QStringList arguments;
+        Flags flags = {NoFlags};
+        int timeout = {0};
+        QProcess* process = {nullptr};
+        QByteArray output;
+    };
+
+    explicit ProcessRunner(QObject* parent = nullptr);
+    void startQueued();
+    void start(Job& job);
+    void expire(int requestId);
+    void remove(int requestId);
+    Job* jobFor(QObject* process);
+    static QString cacheKey(const Job& job);
+
+    int m_lastRequest = {0};
+    int m_running = {0};
+    QMap<int, Job> m_jobs; // by request id, i.e. in order of requests
+    QHash<QObject*, int> m_processes; // process to request id
+    QHash<QString, QString> m_cache; // command line to output
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(ProcessRunner::Flags)
+
+#endif // PROCESSRUNNER_H
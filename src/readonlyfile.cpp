@@ -0,0 +1,142 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <QCoreApplication>
+#include <QFile>
+#include "readonlyfile.h"
+
+// Number of bytes read at once when scanning for bytes.
+#ifndef READONLYFILE_SCAN_BLOCK_SIZE
+#define READONLYFILE_SCAN_BLOCK_SIZE (16*1024)
+#endif
+
+ReadOnlyFile::ReadOnlyFile(const QString& path) : m_path(path)
+{
+    m_fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+
+    if (m_fd < 0) {
+        m_errorString = QString::fromLocal8Bit(strerror(errno));
+        return;
+    }
+
+    struct stat st;
+    if (::fstat(m_fd, &st) != 0) {
+        m_errorString = QString::fromLocal8Bit(strerror(errno));
+        return;
+    } else if (!S_ISREG(st.st_mode)) {
+        // special files may never end or change when they are read
+        m_errorString = QCoreApplication::translate("ReadOnlyFile", "Cannot read this type of file");
+        return;
+    }
+
+    m_size = qint64(st.st_size);
+    m_valid = true;
+}
+
+ReadOnlyFile::~ReadOnlyFile()
+{
+    if (m_fd >= 0) ::close(m_fd);
+}
+
+qint64 ReadOnlyFile::read(qint64 offset, char* buffer, qint64 length) const
+{
+    if (!m_valid || offset < 0 || length < 0) return -1;
+
+    qint64 done = 0;
+
+    while (done < length) {
+        ssize_t got = ::pread(m_fd, buffer + done, size_t(length - done), off_t(offset + done));
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) return (done > 0) ? done : -1;
+        if (got == 0) break; // the file got shorter
+        done += qint64(got);
+    }
+
+    return done;
+}
+
+qint64 ReadOnlyFile::indexOf(char byte, qint64 from, qint64 to, qint64 n) const
+{
+    char buffer[READONLYFILE_SCAN_BLOCK_SIZE];
+
+    while (from < to) {
+        qint64 length = read(from, buffer, qMin(to - from, qint64(sizeof(buffer))));
+        if (length <= 0) return -1;
+
+        const char* current = buffer;
+        const char* end = buffer + length;
+
+        while (current < end) {
+            auto found = static_cast<const char*>(memchr(current, byte, size_t(end - current)));
+            if (!found) break;
+            if (--n <= 0) return from + (found - buffer);
+            current = found + 1;
+        }
+
+        from += length;
+    }
+
+    return -1;
+}
+
+qint64 ReadOnlyFile::count(char byte, qint64 from, qint64 to) const
+{
+    char buffer[READONLYFILE_SCAN_BLOCK_SIZE];
+    qint64 found = 0;
+
+    while (from < to) {
+        qint64 length = read(from, buffer, qMin(to - from, qint64(sizeof(buffer))));
+        if (length <= 0) break;
+
+        const char* current = buffer;
+        const char* end = buffer + length;
+
+        while (current < end) {
+            auto next = static_cast<const char*>(memchr(current, byte, size_t(end - current)));
+            if (!next) break;
+            found++;
+            current = next + 1;
+        }
+
+        from += length;
+    }
+
+    return found;
+}
+
+void ReadOnlyFile::advise(qint64 offset, qint64 length, Advice advice) const
+{
+    if (!m_valid || offset >= m_size || length <= 0) return;
+
+    int flag = POSIX_FADV_NORMAL;
+    switch (advice) {
+    case Normal: flag = POSIX_FADV_NORMAL; break;
+    case Sequential: flag = POSIX_FADV_SEQUENTIAL; break;
+    case Random: flag = POSIX_FADV_RANDOM; break;
+    case DontNeed: flag = POSIX_FADV_DONTNEED; break;
+    }
+
+    ::posix_fadvise(m_fd, off_t(offset), off_t(length), flag);
+}
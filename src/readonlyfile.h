@@ -0,0 +1,78 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef READONLYFILE_H
+#define READONLYFILE_H
+
+#include <QString>
+
+/**
+ * @brief The ReadOnlyFile class reads parts of a regular file on demand.
+ *
+ * Parts are read with pread(), so even very large files can be opened
+ * instantly, and instances can be used from multiple threads at once.
+ * Files are not mapped into memory: other programs may truncate a file at
+ * any time, e.g. when rotating logs, and touching a mapping past the new
+ * end raises SIGBUS. Reading just returns less data instead.
+ *
+ * Instances are usually shared between the UI thread and workers through
+ * a QSharedPointer, so that the file stays open until all users are done.
+ */
+class ReadOnlyFile
+{
+public:
+    enum Advice { Normal, Sequential, Random, DontNeed };
+
+    explicit ReadOnlyFile(const QString& path);
+    ~ReadOnlyFile();
+
+    bool isValid() const { return m_valid; }
+    QString errorString() const { return m_errorString; }
+    QString path() const { return m_path; }
+
+    // the size when the file was opened, it may have changed since
+    qint64 size() const { return m_size; }
+
+    // Reads up to 'length' bytes at 'offset' into 'buffer'. Returns the
+    // number of bytes read, which is less than 'length' if the file got
+    // shorter, or -1 if nothing could be read.
+    qint64 read(qint64 offset, char* buffer, qint64 length) const;
+
+    // Returns the offset of the n-th 'byte' in [from, to), or -1.
+    qint64 indexOf(char byte, qint64 from, qint64 to, qint64 n = 1) const;
+
+    // Returns how often 'byte' occurs in [from, to).
+    qint64 count(char byte, qint64 from, qint64 to) const;
+
+    // Tells the kernel how a range will be read. Use DontNeed to
+    // drop cached pages of ranges that have been read already.
+    void advise(qint64 offset, qint64 length, Advice advice) const;
+
+private:
+    Q_DISABLE_COPY(ReadOnlyFile)
+
+    QString m_path;
+    QString m_errorString;
+    bool m_valid = {false};
+    int m_fd = {-1};
+    qint64 m_size = {0};
+};
+
+#endif // READONLYFILE_H
@@ -87,6 +87,8 @@ public:
     uint ownerId() const { return m_fileInfo.ownerId(); }
     qint64 size() const { return m_fileInfo.size(); }
     qint64 lastModifiedStat() const { return m_stat.st_mtime; }
+    dev_t device() const { return m_stat.st_dev; }
+    ino_t inode() const { return m_stat.st_ino; }
     QDateTime lastModified() const { return m_fileInfo.lastModified(); }
     QDateTime created() const { return m_fileInfo.created(); }
     bool exists() const;
@@ -0,0 +1,732 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
+#include <strings.h>
+#include <QVector>
+#include <QRegularExpression>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QDebug>
+#include "textdocumentmodel.h"
+#include "readonlyfile.h"
+
+// The start offset of every n-th line is stored in the index. Other lines
+// are found by scanning forward from the previous indexed line.
+#ifndef TEXTDOCUMENT_INDEX_STRIDE
+#define TEXTDOCUMENT_INDEX_STRIDE 64
+#endif
+
+// Number of bytes indexed between checks for cancellation.
+#ifndef TEXTDOCUMENT_CHUNK_SIZE
+#define TEXTDOCUMENT_CHUNK_SIZE (4*1024*1024)
+#endif
+
+// Minimum time in milliseconds between updates while indexing.
+#ifndef TEXTDOCUMENT_UPDATE_INTERVAL
+#define TEXTDOCUMENT_UPDATE_INTERVAL 100
+#endif
+
+// Files with null bytes in the first n bytes are considered binary.
+#ifndef TEXTDOCUMENT_BINARY_PROBE
+#define TEXTDOCUMENT_BINARY_PROBE (64*1024)
+#endif
+
+// Longer lines are clipped when shown.
+#ifndef TEXTDOCUMENT_MAX_LINE_LENGTH
+#define TEXTDOCUMENT_MAX_LINE_LENGTH 4096
+#endif
+
+// Searches stop after finding this many lines with matches.
+#ifndef TEXTDOCUMENT_MAX_MATCHES
+#define TEXTDOCUMENT_MAX_MATCHES 100000
+#endif
+
+enum {
+    TextRole = Qt::UserRole + 1,
+    LineNumberRole = Qt::UserRole + 2
+};
+
+// Index of one file, shared between the model and the indexer.
+class TextDocumentModel::IndexState
+{
+public:
+    explicit IndexState(QString path) : path(path) {}
+
+    QString path;
+    QAtomicInt cancelled = {0};
+
+    QMutex mutex;
+    QSharedPointer<ReadOnlyFile> file; // set once when opened
+    bool binary = {false};
+    QString errorMessage;
+    QVector<qint64> checkpoints; // start of every TEXTDOCUMENT_INDEX_STRIDE-th line
+    qint64 lineCount = {0};
+    qint64 indexedBytes = {0};
+};
+
+class TextDocumentModel::Indexer : public QRunnable
+{
+public:
+    Indexer(TextDocumentModel* model, int generation, QSharedPointer<IndexState> state) :
+        m_model(model), m_generation(generation), m_state(state) {}
+
+    void run() override {
+        QSharedPointer<ReadOnlyFile> file(new ReadOnlyFile(m_state->path));
+        bool binary = false;
+
+        if (file->isValid()) {
+            QByteArray probe(int(qMin(file->size(), qint64(TEXTDOCUMENT_BINARY_PROBE))), Qt::Uninitialized);
+            qint64 length = file->read(0, probe.data(), probe.size());
+            binary = (length > 0 && memchr(probe.constData(), '\0', size_t(length)) != nullptr);
+        }
+
+        {
+            QMutexLocker locker(&m_state->mutex);
+
+            if (!file->isValid()) {
+                m_state->errorMessage = file->errorString();
+            } else {
+                m_state->file = file;
+                m_state->binary = binary;
+            }
+        }
+
+        if (!file->isValid() || binary) {
+            finish();
+            return;
+        }
+
+        qint64 size = file->size();
+        QByteArray buffer(int(qMin(size, qint64(TEXTDOCUMENT_CHUNK_SIZE))), Qt::Uninitialized);
+        char* data = buffer.data();
+
+        QVector<qint64> batch;
+        qint64 lines = 0;
+        qint64 pos = 0;
+        QElapsedTimer timer;
+        timer.start();
+
+        if (size > 0) {
+            batch.append(0);
+            lines = 1;
+        }
+
+        file->advise(0, size, ReadOnlyFile::Sequential);
+
+        while (pos < size) {
+            const qint64 chunkStart = pos;
+            const qint64 length = qMax(qint64(0), file->read(chunkStart, data,
+                                                             qMin(size - chunkStart, qint64(buffer.size()))));
+            const qint64 chunkEnd = chunkStart + length;
+
+            // the file got shorter, index what is left of it
+            if (chunkEnd < qMin(size, chunkStart + buffer.size())) size = chunkEnd;
+
+            // memchr() is vectorized in the C library, so this
+            // is as fast as scanning gets without extra code
+            while (pos < chunkEnd) {
+                auto found = static_cast<const char*>(
+                            memchr(data + (pos - chunkStart), '\n', size_t(chunkEnd - pos)));
+                if (!found) {
+                    pos = chunkEnd;
+                    break;
+                }
+
+                pos = chunkStart + (found - data) + 1;
+                if (pos >= size) break; // no line after the last line break
+
+                if (lines % TEXTDOCUMENT_INDEX_STRIDE == 0) batch.append(pos);
+                lines++;
+            }
+
+            // indexed pages are not needed anymore, so they
+            // do not have to stay in memory
+            file->advise(chunkStart, pos - chunkStart, ReadOnlyFile::DontNeed);
+
+            if (m_state->cancelled.loadAcquire() != 0) return;
+
+            if (pos >= size || timer.elapsed() >= TEXTDOCUMENT_UPDATE_INTERVAL) {
+                publish(batch, lines, pos);
+                batch.clear();
+                timer.restart();
+            }
+        }
+
+        finish();
+    }
+
+private:
+    void publish(const QVector<qint64>& batch, qint64 lines, qint64 indexed) {
+        {
+            QMutexLocker locker(&m_state->mutex);
+            m_state->checkpoints += batch;
+            m_state->lineCount = lines;
+            m_state->indexedBytes = indexed;
+        }
+
+        QMetaObject::invokeMethod(m_model, "updateIndex", Qt::QueuedConnection,
+                                  Q_ARG(int, m_generation));
+    }
+
+    void finish() {
+        QMetaObject::invokeMethod(m_model, "finishIndex", Qt::QueuedConnection,
+                                  Q_ARG(int, m_generation));
+    }
+
+    TextDocumentModel* m_model;
+    int m_generation;
+    QSharedPointer<IndexState> m_state;
+};
+
+// Matches of one search, shared between the model and the searcher.
+class TextDocumentModel::SearchState
+{
+public:
+    SearchState(QString path, QString text, bool regularExpression, bool caseSensitive) :
+        path(path), needle(text.toUtf8()), useRegex(regularExpression),
+        caseSensitive(caseSensitive),
+        regex(text, caseSensitive ? QRegularExpression::NoPatternOption :
+                                    QRegularExpression::CaseInsensitiveOption) {}
+
+    QString path;
+    QByteArray needle;
+    bool useRegex;
+    bool caseSensitive;
+    QRegularExpression regex;
+    QAtomicInt cancelled = {0};
+
+    QMutex mutex;
+    QVector<qint64> matches; // sorted offsets, at most one per line
+    bool clipped = {false};
+    QString errorMessage;
+};
+
+class TextDocumentModel::Searcher : public QRunnable
+{
+public:
+    Searcher(TextDocumentModel* model, int generation, QSharedPointer<SearchState> state) :
+        m_model(model), m_generation(generation), m_state(state) {}
+
+    void run() override {
+        // the file is opened again so that searching does not
+        // have to wait until it is opened for indexing
+        ReadOnlyFile file(m_state->path);
+
+        if (!file.isValid()) {
+            QMutexLocker locker(&m_state->mutex);
+            m_state->errorMessage = file.errorString();
+        } else if (m_state->useRegex && !m_state->regex.isValid()) {
+            QMutexLocker locker(&m_state->mutex);
+            m_state->errorMessage = m_state->regex.errorString();
+        } else if (!m_state->needle.isEmpty()) {
+            if (!scan(file)) return; // cancelled
+        }
+
+        QMetaObject::invokeMethod(m_model, "finishSearch", Qt::QueuedConnection,
+                                  Q_ARG(int, m_generation));
+    }
+
+private:
+    bool scan(const ReadOnlyFile& file) {
+        const qint64 size = file.size();
+        QByteArray buffer(int(qMin(size, qint64(TEXTDOCUMENT_CHUNK_SIZE))), Qt::Uninitialized);
+        char* data = buffer.data();
+
+        QVector<qint64> batch;
+        qint64 found = 0;
+        qint64 pos = 0;
+        QElapsedTimer timer;
+        timer.start();
+
+        file.advise(0, size, ReadOnlyFile::Sequential);
+
+        while (pos < size) {
+            const qint64 chunkStart = pos;
+            const qint64 wanted = qMin(size - chunkStart, qint64(buffer.size()));
+            qint64 length = file.read(chunkStart, data, wanted);
+            if (length <= 0) break; // the file got shorter
+
+            // Only complete lines are searched, so matches never cross the
+            // end of the chunk. Lines longer than a chunk are only searched
+            // in their first part.
+            bool longLine = false;
+            if (length == wanted && chunkStart + length < size) {
+                auto last = static_cast<const char*>(memrchr(data, '\n', size_t(length)));
+                if (last) length = (last - data) + 1;
+                else longLine = true;
+            }
+
+            qint64 at = 0;
+
+            while (at < length && found < TEXTDOCUMENT_MAX_MATCHES) {
+                // continue on the next line, so there is one match per line
+                qint64 next = length;
+                qint64 match = m_state->useRegex ? findRegex(data, length, at, &next) :
+                                                   findText(data, length, at, &next);
+                at = next;
+                if (match < 0) break;
+
+                batch.append(chunkStart + match);
+                found++;
+            }
+
+            pos = chunkStart + at;
+
+            if (longLine && at >= length) {
+                qint64 end = file.indexOf('\n', pos, size);
+                pos = (end < 0) ? size : end + 1;
+            }
+
+            file.advise(chunkStart, pos - chunkStart, ReadOnlyFile::DontNeed);
+            if (m_state->cancelled.loadAcquire() != 0) return false;
+
+            bool clipped = (found >= TEXTDOCUMENT_MAX_MATCHES);
+
+            if (clipped || pos >= size || timer.elapsed() >= TEXTDOCUMENT_UPDATE_INTERVAL) {
+                {
+                    QMutexLocker locker(&m_state->mutex);
+                    m_state->matches += batch;
+                    m_state->clipped = clipped;
+                }
+
+                batch.clear();
+                timer.restart();
+                QMetaObject::invokeMethod(m_model, "updateSearch", Qt::QueuedConnection,
+                                          Q_ARG(int, m_generation));
+
+                if (clipped) break;
+            }
+        }
+
+        if (!batch.isEmpty()) {
+            // the file got shorter before the last update
+            QMutexLocker locker(&m_state->mutex);
+            m_state->matches += batch;
+        }
+
+        return true;
+    }
+
+    // Returns the offset of the first match in [from, size), or -1.
+    // Sets 'next' to the start of the line after the match.
+    qint64 findText(const char* data, qint64 size, qint64 from, qint64* next) const {
+        const QByteArray& needle = m_state->needle;
+        const qint64 length = needle.size();
+        const char* match = nullptr;
+
+        if (size - from < length) return -1;
+
+        if (m_state->caseSensitive) {
+            // memmem() uses the two-way algorithm and vectorized scans
+            match = static_cast<const char*>(
+                        memmem(data + from, size_t(size - from), needle.constData(), size_t(length)));
+        } else {
+            // Without case, look for the first byte in both cases using memchr()
+            // and compare candidates. Only ASCII letters are folded.
+            const char lower = char(tolower(static_cast<unsigned char>(needle.at(0))));
+            const char upper = char(toupper(static_cast<unsigned char>(needle.at(0))));
+            const char* current = data + from;
+            const char* last = data + size - length + 1;
+
+            while (current < last) {
+                auto a = static_cast<const char*>(memchr(current, lower, size_t(last - current)));
+                auto b = (lower == upper) ? nullptr : static_cast<const char*>(
+                            memchr(current, upper, size_t((a ? a : last) - current)));
+                const char* candidate = b ? b : a;
+
+                if (!candidate) break;
+                if (strncasecmp(candidate, needle.constData(), size_t(length)) == 0) {
+                    match = candidate;
+                    break;
+                }
+                current = candidate + 1;
+            }
+        }
+
+        if (!match) return -1;
+
+        auto end = static_cast<const char*>(memchr(match, '\n', size_t(data + size - match)));
+        *next = end ? (end - data) + 1 : size;
+        return match - data;
+    }
+
+    // Returns the start of the first line in [from, size) matching the
+    // expression, or -1. Lines are matched after decoding them.
+    // Sets 'next' to the start of the line after the last examined line.
+    qint64 findRegex(const char* data, qint64 size, qint64 from, qint64* next) const {
+        qint64 start = from;
+
+        while (start < size) {
+            auto found = static_cast<const char*>(memchr(data + start, '\n', size_t(size - start)));
+            qint64 end = found ? (found - data) : size;
+            qint64 length = qMin(end - start, qint64(16 * TEXTDOCUMENT_MAX_LINE_LENGTH));
+            *next = qMin(end + 1, size);
+
+            if (m_state->regex.match(QString::fromUtf8(data + start, int(length))).hasMatch()) {
+                return start;
+            }
+
+            start = end + 1;
+        }
+
+        return -1;
+    }
+
+    TextDocumentModel* m_model;
+    int m_generation;
+    QSharedPointer<SearchState> m_state;
+};
+
+TextDocumentModel::TextDocumentModel(QObject *parent) : QAbstractListModel(parent)
+{
+    m_pool.setMaxThreadCount(1);
+    m_searchPool.setMaxThreadCount(1);
+}
+
+TextDocumentModel::~TextDocumentModel()
+{
+    cancel();
+    cancelSearch();
+    m_pool.waitForDone();
+    m_searchPool.waitForDone();
+}
+
+int TextDocumentModel::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return m_lineCount;
+}
+
+QVariant TextDocumentModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() > m_lineCount-1)
+        return QVariant();
+
+    switch (role) {
+
+    case Qt::DisplayRole:
+    case TextRole:
+        return line(index.row());
+
+    case LineNumberRole:
+        return index.row() + 1;
+
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> TextDocumentModel::roleNames() const
+{
+    QHash<int, QByteArray> roles = QAbstractListModel::roleNames();
+    roles.insert(TextRole, QByteArray("text"));
+    roles.insert(LineNumberRole, QByteArray("lineNumber"));
+    return roles;
+}
+
+void TextDocumentModel::setPath(QString path)
+{
+    if (m_path == path) return;
+    m_path = path;
+    emit pathChanged();
+    reload();
+}
+
+qreal TextDocumentModel::progress() const
+{
+    if (!m_state || !m_indexing) return 1.0;
+
+    QMutexLocker locker(&m_state->mutex);
+    if (!m_state->file || m_state->file->size() <= 0) return 0.0;
+    return qreal(m_state->indexedBytes) / qreal(m_state->file->size());
+}
+
+QString TextDocumentModel::line(int index) const
+{
+    if (index < 0 || index >= m_lineCount || !m_state) return QString();
+
+    qint64 end = 0;
+    qint64 start = lineOffset(index, &end);
+    if (start < 0) return QString();
+
+    qint64 length = end - start;
+    bool clipped = false;
+
+    if (length > TEXTDOCUMENT_MAX_LINE_LENGTH) {
+        length = TEXTDOCUMENT_MAX_LINE_LENGTH;
+        clipped = true;
+    }
+
+    // reads less if the file got shorter since it was indexed
+    char data[TEXTDOCUMENT_MAX_LINE_LENGTH];
+    length = qMax(qint64(0), m_state->file->read(start, data, length));
+
+    if (!clipped && length > 0 && data[length - 1] == '\r') {
+        length--; // Windows line endings
+    }
+
+    QString text = QString::fromUtf8(data, int(length));
+    if (clipped) text.append(QChar(0x2026)); // ellipsis
+    return text;
+}
+
+void TextDocumentModel::reload()
+{
+    cancel();
+    cancelSearch();
+
+    beginResetModel();
+    m_lineCount = 0;
+    m_binary = false;
+    m_errorMessage.clear();
+    endResetModel();
+
+    emit lineCountChanged();
+    emit loaded();
+
+    if (m_path.isEmpty()) return;
+
+    qDebug() << "[TextDocumentModel] indexing" << m_path;
+    m_state.reset(new IndexState(m_path));
+    m_pool.start(new Indexer(this, ++m_generation, m_state));
+    setIndexing(true);
+}
+
+void TextDocumentModel::updateIndex(int generation)
+{
+    if (generation != m_generation || !m_state) return; // outdated
+
+    qint64 lines = 0;
+    bool binary = false;
+    QString errorMessage;
+
+    {
+        QMutexLocker locker(&m_state->mutex);
+        lines = qMin(m_state->lineCount, qint64(std::numeric_limits<int>::max()));
+        binary = m_state->binary;
+        errorMessage = m_state->errorMessage;
+    }
+
+    if (binary != m_binary || errorMessage != m_errorMessage) {
+        m_binary = binary;
+        m_errorMessage = errorMessage;
+        emit loaded();
+    }
+
+    if (lines > m_lineCount) {
+        beginInsertRows(QModelIndex(), m_lineCount, int(lines) - 1);
+        m_lineCount = int(lines);
+        endInsertRows();
+    }
+
+    emit lineCountChanged();
+}
+
+void TextDocumentModel::finishIndex(int generation)
+{
+    if (generation != m_generation || !m_state) return; // outdated
+
+    updateIndex(generation);
+    setIndexing(false);
+    emit lineCountChanged(); // progress is complete
+}
+
+void TextDocumentModel::search(QString text, bool regularExpression, bool caseSensitive)
+{
+    cancelSearch();
+    if (m_path.isEmpty() || text.isEmpty()) return;
+
+    qDebug() << "[TextDocumentModel] searching" << m_path;
+    m_searchState.reset(new SearchState(m_path, text, regularExpression, caseSensitive));
+    m_searchPool.start(new Searcher(this, ++m_searchGeneration, m_searchState));
+    m_searching = true;
+    emit searchingChanged();
+}
+
+void TextDocumentModel::cancelSearch()
+{
+    if (m_searchState) {
+        m_searchState->cancelled.storeRelease(1);
+        m_searchState.clear();
+    }
+
+    bool hadMatches = (m_matchCount > 0 || m_matchesClipped);
+    m_matchCount = 0;
+    m_matchesClipped = false;
+    if (hadMatches) emit matchesChanged();
+
+    if (m_searching || !m_searchError.isEmpty()) {
+        m_searching = false;
+        m_searchError.clear();
+        emit searchingChanged();
+    }
+}
+
+int TextDocumentModel::nextMatchLine(int line) const
+{
+    if (!m_searchState || !m_state) return -1;
+
+    // the first match after the end of the given line
+    qint64 from = 0;
+    if (line >= 0) {
+        qint64 end = 0;
+        if (line >= m_lineCount || lineOffset(line, &end) < 0) return -1;
+        from = end + 1;
+    }
+
+    qint64 match = -1;
+
+    {
+        QMutexLocker locker(&m_searchState->mutex);
+        const QVector<qint64>& matches = m_searchState->matches;
+        auto found = std::lower_bound(matches.constBegin(), matches.constEnd(), from);
+        if (found != matches.constEnd()) match = *found;
+    }
+
+    return (match < 0) ? -1 : lineForOffset(match);
+}
+
+int TextDocumentModel::previousMatchLine(int line) const
+{
+    if (!m_searchState || !m_state) return -1;
+
+    // the last match before the start of the given line
+    qint64 before = std::numeric_limits<qint64>::max();
+    if (line >= 0 && line < m_lineCount) {
+        qint64 end = 0;
+        before = lineOffset(line, &end);
+        if (before < 0) return -1;
+    }
+
+    qint64 match = -1;
+
+    {
+        QMutexLocker locker(&m_searchState->mutex);
+        const QVector<qint64>& matches = m_searchState->matches;
+        auto found = std::lower_bound(matches.constBegin(), matches.constEnd(), before);
+        if (found != matches.constBegin()) match = *(found - 1);
+    }
+
+    return (match < 0) ? -1 : lineForOffset(match);
+}
+
+void TextDocumentModel::updateSearch(int generation)
+{
+    if (generation != m_searchGeneration || !m_searchState) return; // outdated
+
+    {
+        QMutexLocker locker(&m_searchState->mutex);
+        m_matchCount = m_searchState->matches.size();
+        m_matchesClipped = m_searchState->clipped;
+    }
+
+    emit matchesChanged();
+}
+
+void TextDocumentModel::finishSearch(int generation)
+{
+    if (generation != m_searchGeneration || !m_searchState) return; // outdated
+
+    updateSearch(generation);
+
+    {
+        QMutexLocker locker(&m_searchState->mutex);
+        m_searchError = m_searchState->errorMessage;
+    }
+
+    m_searching = false;
+    emit searchingChanged();
+}
+
+qint64 TextDocumentModel::lineOffset(int index, qint64* end) const
+{
+    qint64 start = 0;
+
+    {
+        QMutexLocker locker(&m_state->mutex);
+        int checkpoint = index / TEXTDOCUMENT_INDEX_STRIDE;
+        if (!m_state->file || checkpoint >= m_state->checkpoints.size()) return -1;
+        start = m_state->checkpoints.at(checkpoint);
+    }
+
+    // the file is never replaced once it is opened
+    const ReadOnlyFile& file = *m_state->file;
+    const qint64 size = file.size();
+
+    if (int skip = index % TEXTDOCUMENT_INDEX_STRIDE) {
+        qint64 found = file.indexOf('\n', start, size, skip);
+        if (found < 0) return -1;
+        start = found + 1;
+    }
+
+    qint64 found = file.indexOf('\n', start, size);
+    *end = (found < 0) ? size : found;
+    return start;
+}
+
+int TextDocumentModel::lineForOffset(qint64 offset) const
+{
+    qint64 start = 0;
+    int line = 0;
+
+    {
+        QMutexLocker locker(&m_state->mutex);
+        const QVector<qint64>& checkpoints = m_state->checkpoints;
+        if (!m_state->file || checkpoints.isEmpty()) return -1;
+
+        // the last indexed line starting at or before the offset
+        auto found = std::upper_bound(checkpoints.constBegin(), checkpoints.constEnd(), offset) - 1;
+
+        // lines after the last checkpoint may not be indexed yet
+        if (found == checkpoints.constEnd() - 1 && m_state->indexedBytes < offset) return -1;
+
+        start = *found;
+        line = int(found - checkpoints.constBegin()) * TEXTDOCUMENT_INDEX_STRIDE;
+    }
+
+    // lines starting at or before the offset
+    line += int(m_state->file->count('\n', start, offset));
+
+    return (line < m_lineCount) ? line : -1;
+}
+
+void TextDocumentModel::setIndexing(bool indexing)
+{
+    if (m_indexing == indexing) return;
+    m_indexing = indexing;
+    emit indexingChanged();
+}
+
+void TextDocumentModel::cancel()
+{
+    if (m_state) {
+        m_state->cancelled.storeRelease(1);
+        m_state.clear();
+    }
+
+    setIndexing(false);
+}
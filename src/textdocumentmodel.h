@@ -0,0 +1,136 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEXTDOCUMENTMODEL_H
+#define TEXTDOCUMENTMODEL_H
+
+#include <QAbstractListModel>
+#include <QSharedPointer>
+#include <QThreadPool>
+
+class ReadOnlyFile;
+
+/**
+ * @brief The TextDocumentModel class provides the lines of a text file.
+ *
+ * The lines of the file are indexed in the background. The model grows while
+ * lines are being indexed, so the beginning of the file can be shown
+ * immediately. Lines are only read and decoded when they are requested.
+ *
+ * The index only stores the start of every few lines, so memory usage stays
+ * low even for files with millions of lines.
+ *
+ * The file can be searched in the background. Matches are reported per line
+ * while the search is running, and can be visited with nextMatchLine() and
+ * previousMatchLine().
+ */
+class TextDocumentModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(QString path READ path() WRITE setPath(QString) NOTIFY pathChanged())
+    Q_PROPERTY(int lineCount READ lineCount() NOTIFY lineCountChanged())
+    Q_PROPERTY(bool indexing READ indexing() NOTIFY indexingChanged())
+    Q_PROPERTY(qreal progress READ progress() NOTIFY lineCountChanged())
+    Q_PROPERTY(bool binary READ binary() NOTIFY loaded())
+    Q_PROPERTY(QString errorMessage READ errorMessage() NOTIFY loaded())
+    Q_PROPERTY(bool searching READ searching() NOTIFY searchingChanged())
+    Q_PROPERTY(int matchCount READ matchCount() NOTIFY matchesChanged())
+    Q_PROPERTY(bool matchesClipped READ matchesClipped() NOTIFY matchesChanged())
+    Q_PROPERTY(QString searchError READ searchError() NOTIFY searchingChanged())
+
+public:
+    explicit TextDocumentModel(QObject *parent = nullptr);
+    ~TextDocumentModel();
+
+    // methods needed by ListView
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QHash<int, QByteArray> roleNames() const;
+
+    // property accessors
+    QString path() const { return m_path; }
+    void setPath(QString path);
+    int lineCount() const { return m_lineCount; }
+    bool indexing() const { return m_indexing; }
+    qreal progress() const;
+    bool binary() const { return m_binary; }
+    QString errorMessage() const { return m_errorMessage; }
+    bool searching() const { return m_searching; }
+    int matchCount() const { return m_matchCount; }
+    bool matchesClipped() const { return m_matchesClipped; }
+    QString searchError() const { return m_searchError; }
+
+    // methods accessible from QML
+    Q_INVOKABLE QString line(int index) const;
+    Q_INVOKABLE void reload();
+
+    // searching: the search runs in the background and lines with matches
+    // are reported through matchesChanged(); the *MatchLine methods return
+    // -1 if there is no match or if the line is not indexed yet
+    Q_INVOKABLE void search(QString text, bool regularExpression, bool caseSensitive);
+    Q_INVOKABLE void cancelSearch();
+    Q_INVOKABLE int nextMatchLine(int line) const;
+    Q_INVOKABLE int previousMatchLine(int line) const;
+
+signals:
+    void pathChanged();
+    void lineCountChanged();
+    void indexingChanged();
+    void loaded();
+    void searchingChanged();
+    void matchesChanged();
+
+private slots:
+    void updateIndex(int generation);
+    void finishIndex(int generation);
+    void updateSearch(int generation);
+    void finishSearch(int generation);
+
+private:
+    class IndexState;
+    class Indexer;
+    class SearchState;
+    class Searcher;
+
+    qint64 lineOffset(int index, qint64* end) const;
+    int lineForOffset(qint64 offset) const;
+    void setIndexing(bool indexing);
+    void cancel();
+
+    QString m_path;
+    int m_lineCount = {0};
+    bool m_indexing = {false};
+    bool m_binary = {false};
+    QString m_errorMessage;
+
+    int m_generation = {0};
+    QSharedPointer<IndexState> m_state;
+    QThreadPool m_pool;
+
+    bool m_searching = {false};
+    int m_matchCount = {0};
+    bool m_matchesClipped = {false};
+    QString m_searchError;
+    int m_searchGeneration = {0};
+    QSharedPointer<SearchState> m_searchState;
+    QThreadPool m_searchPool;
+};
+
+#endif // TEXTDOCUMENTMODEL_H
@@ -0,0 +1,406 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <QDir>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QAtomicInt>
+#include <QDebug>
+#include "transferjournal.h"
+#include "directorysizeindex.h"
+
+// Minimum interval in milliseconds between batches of records.
+// Every batch syncs the target file system, so this must not be too short.
+#ifndef TRANSFERJOURNAL_FLUSH_INTERVAL
+#define TRANSFERJOURNAL_FLUSH_INTERVAL 2000
+#endif
+
+#define TRANSFERJOURNAL_MAGIC 0x4642544a // FBTJ
+#define TRANSFERJOURNAL_VERSION 1
+
+TransferJournal::TransferJournal() {}
+
+TransferJournal::~TransferJournal()
+{
+    close(false);
+}
+
+QString TransferJournal::create(int type, const QString &destDirectory, const QStringList &filenames)
+{
+    static QAtomicInt counter;
+
+    QString dir = directory();
+    if (!QDir().mkpath(dir)) return QString();
+
+    QString path = QString("%1/%2-%3-%4.journal").arg(dir)
+            .arg(QDateTime::currentMSecsSinceEpoch()).arg(::getpid()).arg(counter.fetchAndAddRelaxed(1));
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return QString();
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << quint32(TRANSFERJOURNAL_MAGIC) << quint32(TRANSFERJOURNAL_VERSION)
+        << qint32(type) << destDirectory << filenames;
+
+    if (!file.commit()) {
+        qDebug() << "[TransferJournal] failed to create journal" << path;
+        return QString();
+    }
+
+    return path;
+}
+
+QList<TransferJournal::Info> TransferJournal::interrupted()
+{
+    QList<Info> journals;
+    QDir dir(directory());
+
+    for (const QString& name : dir.entryList(QStringList() << "*.journal", QDir::Files, QDir::Name)) {
+        QFile file(dir.absoluteFilePath(name));
+        if (!file.open(QIODevice::ReadOnly)) continue;
+
+        // journals of running jobs are locked
+        if (::flock(file.handle(), LOCK_SH | LOCK_NB) != 0) continue;
+
+        QDataStream in(&file);
+        in.setVersion(QDataStream::Qt_5_6);
+
+        Info info;
+        if (readHeader(in, &info)) {
+            info.path = file.fileName();
+            journals.append(info);
+        } else {
+            qDebug() << "[TransferJournal] ignoring invalid journal" << file.fileName();
+        }
+    }
+
+    return journals;
+}
+
+void TransferJournal::discard(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return;
+    if (::flock(file.handle(), LOCK_EX | LOCK_NB) != 0) return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    Info info;
+    QHash<QString, QString> targets;
+    QHash<QByteArray, FileState> files;
+    if (readHeader(in, &info)) readRecords(in, &targets, &files);
+
+    // partial copies are of no use without the journal
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+        struct stat st;
+        if (it->targetSize >= 0 || ::lstat(it.key().constData(), &st) != 0) continue;
+        if (S_ISREG(st.st_mode) && st.st_size <= it->sourceSize) ::unlink(it.key().constData());
+    }
+
+    file.remove();
+}
+
+bool TransferJournal::open(const QString &path)
+{
+    close(false);
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        qDebug() << "[TransferJournal] cannot open journal" << path << m_file.errorString();
+        return false;
+    }
+
+    if (::flock(m_file.handle(), LOCK_EX | LOCK_NB) != 0) {
+        qDebug() << "[TransferJournal] journal is in use" << path;
+        m_file.close();
+        return false;
+    }
+
+    QDataStream in(&m_file);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    Info info;
+    if (!readHeader(in, &info)) {
+        qDebug() << "[TransferJournal] ignoring invalid journal" << path;
+        m_file.close();
+        return false;
+    }
+
+    // drop a record that was cut off, so that new records can be appended
+    qint64 end = readRecords(in, &m_targets, &m_resume);
+    if (end != m_file.size()) m_file.resize(end);
+    m_file.seek(end);
+
+    m_destDirectory = info.destDirectory;
+    m_flushTimer.start();
+    m_open = true;
+    return true;
+}
+
+void TransferJournal::close(bool complete)
+{
+    if (!m_open) return;
+
+    if (complete) {
+        m_file.remove();
+    } else {
+        flush(true);
+        m_file.close();
+    }
+
+    m_open = false;
+    m_targets.clear();
+    m_resume.clear();
+    m_active.clear();
+    m_finished.clear();
+    m_pendingTargets.clear();
+}
+
+void TransferJournal::setTarget(const QString &source, const QString &target)
+{
+    if (!m_open) return;
+    m_targets.insert(source, target);
+
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << quint8(TargetRecord) << source << target;
+
+    // kept until written, together with records that failed before
+    m_pendingTargets += record;
+    if (append(m_pendingTargets, false)) m_pendingTargets.clear();
+}
+
+QString TransferJournal::targetFor(const QString &source) const
+{
+    return m_targets.value(source);
+}
+
+void TransferJournal::fileStarted(const QByteArray &target, const struct stat &source)
+{
+    if (!m_open) return;
+
+    FileState state;
+    state.sourceSize = qint64(source.st_size);
+    state.sourceTime = DirectorySizeIndex::modTimeOf(source);
+
+    QMutexLocker locker(&m_mutex);
+    m_active.insert(target, state);
+}
+
+void TransferJournal::fileProgressed(const QByteArray &target, qint64 offset)
+{
+    if (!m_open) return;
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_active.find(target);
+    if (it != m_active.end()) it->offset = offset;
+}
+
+void TransferJournal::fileFinished(const QByteArray &target)
+{
+    if (!m_open) return;
+
+    struct stat st;
+    bool ok = (::lstat(target.constData(), &st) == 0);
+
+    QMutexLocker locker(&m_mutex);
+    FileState state = m_active.take(target);
+    if (!ok) return;
+
+    state.targetSize = qint64(st.st_size);
+    state.targetTime = DirectorySizeIndex::modTimeOf(st);
+    m_finished.append(qMakePair(target, state));
+}
+
+void TransferJournal::fileFailed(const QByteArray &target)
+{
+    if (!m_open) return;
+
+    QMutexLocker locker(&m_mutex);
+    m_active.remove(target);
+}
+
+bool TransferJournal::isComplete(const QByteArray &target, const struct stat &source) const
+{
+    auto it = m_resume.constFind(target);
+    if (it == m_resume.constEnd() || it->targetSize < 0) return false;
+
+    if (it->sourceSize != qint64(source.st_size) ||
+            it->sourceTime != DirectorySizeIndex::modTimeOf(source)) {
+        return false;
+    }
+
+    struct stat st;
+    return ::lstat(target.constData(), &st) == 0 && S_ISREG(st.st_mode) &&
+            qint64(st.st_size) == it->targetSize && DirectorySizeIndex::modTimeOf(st) == it->targetTime;
+}
+
+qint64 TransferJournal::resumeOffset(const QByteArray &target, const struct stat &source) const
+{
+    auto it = m_resume.constFind(target);
+    if (it == m_resume.constEnd()) return 0;
+
+    if (it->sourceSize != qint64(source.st_size) ||
+            it->sourceTime != DirectorySizeIndex::modTimeOf(source)) {
+        return 0;
+    }
+
+    struct stat st;
+    if (::lstat(target.constData(), &st) != 0 || !S_ISREG(st.st_mode) || qint64(st.st_size) < it->offset) {
+        return 0;
+    }
+
+    return qMin(it->offset, qint64(source.st_size));
+}
+
+void TransferJournal::flush(bool force)
+{
+    if (!m_open) return;
+    if (!force && m_flushTimer.elapsed() < TRANSFERJOURNAL_FLUSH_INTERVAL) return;
+    m_flushTimer.restart();
+
+    QByteArray records = m_pendingTargets;
+    QDataStream out(&records, QIODevice::Append);
+    out.setVersion(QDataStream::Qt_5_6);
+
+    // Records stay pending until they are written. Files may finish
+    // while writing, so only the records written here are dropped.
+    QHash<QByteArray, qint64> offsets;
+    int finished = 0;
+
+    m_mutex.lock();
+    for (const auto& file : m_finished) {
+        out << quint8(CompleteRecord) << file.first << file.second.sourceSize << file.second.sourceTime
+            << file.second.targetSize << file.second.targetTime;
+    }
+    finished = m_finished.size();
+
+    for (auto it = m_active.constBegin(); it != m_active.constEnd(); ++it) {
+        if (it->offset <= qMax(it->recordedOffset, qint64(0))) continue;
+        offsets.insert(it.key(), it->offset);
+        out << quint8(OffsetRecord) << it.key() << it->sourceSize << it->sourceTime << it->offset;
+    }
+    m_mutex.unlock();
+
+    if (records.isEmpty() || !append(records, true)) return;
+
+    m_pendingTargets.clear();
+
+    QMutexLocker locker(&m_mutex);
+    m_finished.erase(m_finished.begin(), m_finished.begin() + finished);
+
+    for (auto it = offsets.constBegin(); it != offsets.constEnd(); ++it) {
+        auto file = m_active.find(it.key());
+        if (file != m_active.end()) file->recordedOffset = qMax(file->recordedOffset, it.value());
+    }
+}
+
+QString TransferJournal::directory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/journals";
+}
+
+bool TransferJournal::readHeader(QDataStream &in, Info *info)
+{
+    quint32 magic, version;
+    qint32 type;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != TRANSFERJOURNAL_MAGIC ||
+            version != TRANSFERJOURNAL_VERSION) {
+        return false;
+    }
+
+    in >> type >> info->destDirectory >> info->filenames;
+    info->type = type;
+    return in.status() == QDataStream::Ok;
+}
+
+qint64 TransferJournal::readRecords(QDataStream &in, QHash<QString, QString> *targets,
+                                    QHash<QByteArray, FileState> *files)
+{
+    qint64 end = in.device()->pos();
+
+    while (!in.atEnd()) {
+        quint8 kind = 0;
+        in >> kind;
+
+        if (kind == TargetRecord) {
+            QString source, target;
+            in >> source >> target;
+            if (in.status() != QDataStream::Ok) break;
+            targets->insert(source, target);
+
+        } else if (kind == OffsetRecord) {
+            QByteArray target;
+            FileState state;
+            in >> target >> state.sourceSize >> state.sourceTime >> state.offset;
+            if (in.status() != QDataStream::Ok) break;
+            files->insert(target, state);
+
+        } else if (kind == CompleteRecord) {
+            QByteArray target;
+            FileState state;
+            in >> target >> state.sourceSize >> state.sourceTime >> state.targetSize >> state.targetTime;
+            if (in.status() != QDataStream::Ok) break;
+            state.offset = state.targetSize;
+            files->insert(target, state);
+
+        } else {
+            break;
+        }
+
+        end = in.device()->pos();
+    }
+
+    return end;
+}
+
+bool TransferJournal::append(const QByteArray &records, bool syncTarget)
+{
+    if (syncTarget) {
+        // everything a record claims must be stored before the record
+        int fd = ::open(QFile::encodeName(m_destDirectory).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) return false;
+        bool synced = (::syncfs(fd) == 0);
+        ::close(fd);
+        if (!synced) return false;
+    }
+
+    qint64 end = m_file.pos();
+
+    if (m_file.write(records) != records.size() || !m_file.flush() || ::fdatasync(m_file.handle()) != 0) {
+        qDebug() << "[TransferJournal] failed to write journal" << m_file.fileName();
+
+        // drop what was written of the batch, it is written again later
+        if (m_file.resize(end)) m_file.seek(end);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,145 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRANSFERJOURNAL_H
+#define TRANSFERJOURNAL_H
+
+#include <sys/types.h>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QFile>
+#include <QMutex>
+#include <QElapsedTimer>
+
+struct stat;
+class QDataStream;
+
+/**
+ * @brief The TransferJournal class records the progress of a copy or move job on disk.
+ *
+ * A journal lets a job continue where it stopped when it was cancelled, or
+ * when the app or the device went down. It starts with the planned job: its
+ * type, target folder and source entries. While the job runs, records are
+ * appended for the target chosen for each source entry, for files that are
+ * complete, and for the offset up to which a file has been copied.
+ *
+ * Records are written in batches. The file system of the target is synced
+ * before a batch is written, so that records never claim more than what is
+ * actually stored. When resuming, a complete file is only skipped, and a
+ * partial file only continued, if its source still has the recorded size and
+ * modification time, and the target still has the recorded size (and time,
+ * for complete files).
+ *
+ * Journals are kept in the app data directory and are locked while in use,
+ * so that other instances of the app do not list them as interrupted.
+ * Recording and lookups are thread-safe, flush() must be called from one
+ * thread only.
+ */
+class TransferJournal
+{
+public:
+    struct Info {
+        QString path;
+        int type = {0};
+        QString destDirectory;
+        QStringList filenames;
+    };
+
+    TransferJournal();
+    ~TransferJournal();
+
+    // Creates the journal of a new job and returns its path,
+    // or an empty string if it could not be written.
+    static QString create(int type, const QString& destDirectory, const QStringList& filenames);
+
+    // Lists the journals of jobs that did not complete and are not in use.
+    static QList<Info> interrupted();
+
+    // Removes a journal that is not in use, and the partial files it records.
+    static void discard(const QString& path);
+
+    // Opens and locks a journal, and reads its records for resuming.
+    bool open(const QString& path);
+    bool isOpen() const { return m_open; }
+
+    // Writes pending records and closes the journal.
+    // The journal is removed if the job is complete.
+    void close(bool complete);
+
+    // The target chosen for a source entry is recorded right away.
+    void setTarget(const QString& source, const QString& target);
+    QString targetFor(const QString& source) const;
+
+    // called while copying files
+    void fileStarted(const QByteArray& target, const struct stat& source);
+    void fileProgressed(const QByteArray& target, qint64 offset);
+    void fileFinished(const QByteArray& target);
+    void fileFailed(const QByteArray& target);
+
+    // Returns true if the target is a complete copy of the source.
+    bool isComplete(const QByteArray& target, const struct stat& source) const;
+
+    // Returns the offset up to which the target is a copy of the source.
+    qint64 resumeOffset(const QByteArray& target, const struct stat& source) const;
+
+    // Writes pending records if the last batch is old enough.
+    void flush(bool force = false);
+
+private:
+    enum Record {
+        TargetRecord = 1, OffsetRecord = 2, CompleteRecord = 3
+    };
+    struct FileState {
+        qint64 sourceSize = {0};
+        qint64 sourceTime = {0};
+        qint64 offset = {0};
+        qint64 targetSize = {-1}; // set for complete files
+        qint64 targetTime = {0};
+        qint64 recordedOffset = {-1};
+    };
+
+    static QString directory();
+    static bool readHeader(QDataStream& in, Info* info);
+    // returns the position after the last complete record
+    static qint64 readRecords(QDataStream& in, QHash<QString, QString>* targets,
+                              QHash<QByteArray, FileState>* files);
+    // returns false if the records could not be written
+    bool append(const QByteArray& records, bool syncTarget);
+
+    QFile m_file;
+    bool m_open = {false};
+    QString m_destDirectory;
+    QElapsedTimer m_flushTimer;
+
+    // read when opening, only changed by setTarget() afterwards
+    QHash<QString, QString> m_targets; // by source
+    QHash<QByteArray, FileState> m_resume; // by target
+
+    mutable QMutex m_mutex;
+    QHash<QByteArray, FileState> m_active; // by target, guarded by the mutex
+    QList<QPair<QByteArray, FileState>> m_finished; // guarded by the mutex
+    QByteArray m_pendingTargets; // target records not written yet
+};
+
+#endif // TRANSFERJOURNAL_H
@@ -0,0 +1,142 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <dirent.h>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include "transferplanner.h"
+#include "mounttable.h"
+
+TransferPlanner::TransferPlanner() {}
+
+bool TransferPlanner::plan(const QStringList& sources, const QString& destDirectory, bool copying)
+{
+    m_entries.clear();
+    m_error = NoError;
+    m_errorFile.clear();
+
+    if (!readNames(destDirectory)) {
+        m_error = MissingTarget;
+        m_errorFile = destDirectory;
+        return false;
+    }
+
+    QDir dest(destDirectory);
+    QSet<QString> reserved;
+
+    for (const QString& source : sources) {
+        Entry entry;
+        entry.source = source;
+        QString name = QFileInfo(source).fileName();
+        entry.target = dest.absoluteFilePath(name);
+
+        if (source == entry.target) {
+            if (!copying) {
+                m_error = OverwritesItself;
+                m_errorFile = entry.target;
+                return false;
+            }
+            entry.renamed = true; // numbered below
+        } else if (entry.target.startsWith(source.endsWith('/') ? source : source + '/')) {
+            m_error = IntoItself;
+            m_errorFile = source;
+            return false;
+        } else {
+            entry.exists = m_names.contains(key(name));
+            reserved.insert(key(name));
+        }
+
+        m_entries.append(entry);
+    }
+
+    // Numbered names must not be taken by the other pasted files either,
+    // else a numbered copy would be replaced by a file pasted after it.
+    m_names.unite(reserved);
+
+    for (Entry& entry : m_entries) {
+        if (!entry.renamed) continue;
+
+        QString name = QFileInfo(entry.source).fileName();
+        QString numbered;
+        int number = 2;
+        do {
+            numbered = numberedName(name, number++);
+        } while (m_names.contains(key(numbered)));
+
+        m_names.insert(key(numbered));
+        entry.target = dest.absoluteFilePath(numbered);
+    }
+
+    return true;
+}
+
+QStringList TransferPlanner::targets() const
+{
+    QStringList targets;
+    for (const Entry& entry : m_entries) {
+        targets.append(entry.target);
+    }
+    return targets;
+}
+
+QStringList TransferPlanner::existingNames() const
+{
+    QStringList names;
+    for (const Entry& entry : m_entries) {
+        if (entry.exists) names.append(QFileInfo(entry.target).fileName());
+    }
+    return names;
+}
+
+QString TransferPlanner::numberedName(const QString& name, int number)
+{
+    // a leading dot marks a hidden file, not a suffix
+    int dotpos = name.lastIndexOf('.');
+    if (dotpos <= 0) return QString("%1 (%2)").arg(name).arg(number);
+    return QString("%1 (%2)%3").arg(name.left(dotpos)).arg(number).arg(name.mid(dotpos));
+}
+
+bool TransferPlanner::readNames(const QString& destDirectory)
+{
+    m_names.clear();
+
+    QString type = MountTable::instance()->mountFor(destDirectory).type;
+    m_ignoresCase = (type == "vfat" || type == "msdos" || type == "exfat");
+
+    DIR* dir = opendir(QFile::encodeName(destDirectory).constData());
+    if (!dir) {
+        qDebug() << "[TransferPlanner] cannot read target folder" << destDirectory;
+        return false;
+    }
+
+    while (struct dirent* entry = readdir(dir)) {
+        m_names.insert(key(QFile::decodeName(entry->d_name)));
+    }
+
+    closedir(dir);
+    return true;
+}
+
+QString TransferPlanner::key(const QString& name) const
+{
+    return m_ignoresCase ? name.toCaseFolded() : name;
+}
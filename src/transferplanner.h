@@ -0,0 +1,88 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRANSFERPLANNER_H
+#define TRANSFERPLANNER_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QSet>
+
+/**
+ * @brief The TransferPlanner class decides where the files of a paste go.
+ *
+ * The target folder is read once into a set of names, and the whole plan is
+ * then computed in memory instead of probing the file system for every name:
+ * which targets exist already, which sources are pasted onto themselves and
+ * need a numbered name like "Document (2).txt", and whether a folder would be
+ * pasted into itself. The names of all other pasted files are added to the
+ * set before numbered names are chosen, and numbered names are added when
+ * chosen, so that no numbered copy gets the name of another target.
+ *
+ * Names are compared case-insensitively on file systems that ignore case,
+ * e.g. FAT formatted SD cards.
+ */
+class TransferPlanner
+{
+public:
+    enum Error {
+        NoError,
+        MissingTarget, // the target folder cannot be read
+        OverwritesItself, // a source would be moved onto itself
+        IntoItself // the target folder is inside a source folder
+    };
+
+    struct Entry {
+        QString source;
+        QString target;
+        bool exists = {false}; // the target exists and would be replaced
+        bool renamed = {false}; // pasted onto itself, the target is a numbered name
+    };
+
+    TransferPlanner();
+
+    // Plans pasting the sources into the target folder. Sources pasted onto
+    // themselves get numbered names when copying, and are an error otherwise.
+    // Returns false if the paste is not possible, see error().
+    bool plan(const QStringList& sources, const QString& destDirectory, bool copying);
+
+    Error error() const { return m_error; }
+    QString errorFile() const { return m_errorFile; }
+
+    const QList<Entry>& entries() const { return m_entries; }
+    QStringList targets() const;
+    QStringList existingNames() const; // names of targets that would be replaced
+
+    // Returns e.g. "Document (2).txt" for "Document.txt" and 2.
+    static QString numberedName(const QString& name, int number);
+
+private:
+    bool readNames(const QString& destDirectory);
+    QString key(const QString& name) const;
+
+    QList<Entry> m_entries;
+    QSet<QString> m_names;
+    bool m_ignoresCase = {false};
+    Error m_error = {NoError};
+    QString m_errorFile;
+};
+
+#endif // TRANSFERPLANNER_H
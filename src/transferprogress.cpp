@@ -0,0 +1,107 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "transferprogress.h"
+
+// every entry counts like this many bytes when calculating the progress,
+// so that copying many small files or empty folders progresses as well
+#ifndef TRANSFERPROGRESS_ENTRY_WEIGHT
+#define TRANSFERPROGRESS_ENTRY_WEIGHT 16384
+#endif
+
+void TransferProgress::reset(qint64 entriesTotal, qint64 bytesTotal)
+{
+    m_bytesDone.storeRelease(0);
+    m_bytesTotal.storeRelease(bytesTotal);
+    m_entriesDone.storeRelease(0);
+    m_entriesTotal.storeRelease(entriesTotal);
+    m_bytesSparse.storeRelease(0);
+    m_finished.storeRelease(0);
+    setFilename(QString());
+}
+
+void TransferProgress::add(qint64 bytes, qint64 entries)
+{
+    if (bytes != 0) m_bytesDone.fetchAndAddRelaxed(bytes);
+    if (entries != 0) m_entriesDone.fetchAndAddRelaxed(entries);
+    if (m_filenamePending) publishFilename();
+    m_serial.fetchAndAddRelease(1);
+}
+
+void TransferProgress::addSparse(qint64 bytes)
+{
+    m_bytesSparse.fetchAndAddRelaxed(bytes);
+    m_serial.fetchAndAddRelease(1);
+}
+
+void TransferProgress::setFilename(const QString& filename)
+{
+    m_pendingFilename = filename;
+    m_filenamePending = true;
+    publishFilename();
+    m_serial.fetchAndAddRelease(1);
+}
+
+void TransferProgress::finish()
+{
+    m_finished.storeRelease(1);
+
+    // the final state must not be lost, so wait for the reader here
+    QMutexLocker lock(&m_filenameMutex);
+    m_filename.clear();
+    m_filenamePending = false;
+    m_serial.fetchAndAddRelease(1);
+}
+
+void TransferProgress::publishFilename()
+{
+    if (!m_filenameMutex.tryLock()) return; // the reader is busy, try again later
+    m_filename = m_pendingFilename;
+    m_filenameMutex.unlock();
+    m_filenamePending = false;
+}
+
+TransferProgress::Snapshot TransferProgress::snapshot() const
+{
+    Snapshot s;
+    s.bytesDone = m_bytesDone.loadAcquire();
+    s.bytesTotal = m_bytesTotal.loadAcquire();
+    s.entriesDone = m_entriesDone.loadAcquire();
+    s.entriesTotal = m_entriesTotal.loadAcquire();
+    s.bytesSparse = m_bytesSparse.loadAcquire();
+
+    m_filenameMutex.lock();
+    s.filename = m_filename;
+    m_filenameMutex.unlock();
+
+    // Hard links are counted once when scanning but copied every time,
+    // so the counters may overshoot slightly.
+    s.bytesTotal = qMax(s.bytesDone, s.bytesTotal);
+
+    if (m_finished.loadAcquire()) {
+        s.progress = 100;
+    } else {
+        qint64 done = s.bytesDone + s.entriesDone * TRANSFERPROGRESS_ENTRY_WEIGHT;
+        qint64 total = s.bytesTotal + s.entriesTotal * TRANSFERPROGRESS_ENTRY_WEIGHT;
+        s.progress = total > 0 ? int(qMin(Q_INT64_C(99), 100 * done / total)) : 0;
+    }
+
+    return s;
+}
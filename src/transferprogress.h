@@ -0,0 +1,81 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRANSFERPROGRESS_H
+#define TRANSFERPROGRESS_H
+
+#include <QString>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QMutex>
+
+/**
+ * @brief The TransferProgress class is a progress record shared between a
+ * worker thread and the UI.
+ *
+ * The worker updates it as often as it likes without signalling, and the
+ * UI samples it at its own pace. Counters are atomic. The current file name
+ * is published without blocking the worker: if the UI is reading it, the
+ * name is published on one of the next updates instead.
+ *
+ * There must be only one writer.
+ */
+class TransferProgress
+{
+public:
+    struct Snapshot {
+        int progress = {0}; // percent
+        QString filename;
+        qint64 bytesDone = {0};
+        qint64 bytesTotal = {0};
+        qint64 entriesDone = {0};
+        qint64 entriesTotal = {0};
+        qint64 bytesSparse = {0}; // holes kept instead of written, part of bytesDone
+    };
+
+    // writer side
+    void reset(qint64 entriesTotal, qint64 bytesTotal = 0);
+    void add(qint64 bytes, qint64 entries);
+    void addSparse(qint64 bytes);
+    void setFilename(const QString& filename);
+    void finish(); // marks progress as complete and clears the file name
+
+    // reader side; the serial changes whenever the record is updated
+    int serial() const { return m_serial.loadAcquire(); }
+    Snapshot snapshot() const;
+
+private:
+    void publishFilename();
+
+    QAtomicInteger<qint64> m_bytesDone = {0};
+    QAtomicInteger<qint64> m_bytesTotal = {0};
+    QAtomicInteger<qint64> m_entriesDone = {0};
+    QAtomicInteger<qint64> m_entriesTotal = {0};
+    QAtomicInteger<qint64> m_bytesSparse = {0};
+    QAtomicInt m_finished = {0};
+    QAtomicInt m_serial = {0};
+
+    mutable QMutex m_filenameMutex;
+    QString m_filename; // guarded by the mutex
+    QString m_pendingFilename; // only used by the writer
+    bool m_filenamePending = {false};
+};
+
+#endif // TRANSFERPROGRESS_H
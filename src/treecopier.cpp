@@ -0,0 +1,359 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QThreadPool>
+#include "treecopier.h"
+#include "filecopier.h"
+#include "mounttable.h"
+
+// Maximum number of files waiting in the queue.
+#ifndef TREECOPIER_QUEUE_SIZE
+#define TREECOPIER_QUEUE_SIZE 256
+#endif
+
+// Minimum interval in milliseconds between progress reports.
+#ifndef TREECOPIER_REPORT_INTERVAL
+#define TREECOPIER_REPORT_INTERVAL 50
+#endif
+
+// Number of copier threads per kind of storage.
+#ifndef TREECOPIER_COPIERS_FLASH
+#define TREECOPIER_COPIERS_FLASH 4
+#endif
+#ifndef TREECOPIER_COPIERS_DEFAULT
+#define TREECOPIER_COPIERS_DEFAULT 2
+#endif
+#ifndef TREECOPIER_COPIERS_SLOW
+#define TREECOPIER_COPIERS_SLOW 1
+#endif
+
+class TreeCopier::Copier : public QRunnable
+{
+public:
+    explicit Copier(TreeCopier* tree) : m_tree(tree) {}
+
+    void run() override
+    {
+        FileCopier copier;
+        copier.setVerifyEnabled(m_tree->m_removeSources);
+        copier.setJournal(m_tree->m_journal);
+        copier.setCancelCheck([this](){ return m_tree->shouldStop(); });
+        copier.setProgressCallback([this](qint64 bytes){ m_tree->m_bytes.fetchAndAddRelaxed(bytes); });
+        copier.setSparseCallback([this](qint64 bytes){ m_tree->m_sparse.fetchAndAddRelaxed(bytes); });
+
+        Item item;
+        while (m_tree->take(&item)) {
+            if (copier.copy(QFile::decodeName(item.source), QFile::decodeName(item.dest))) {
+                if (m_tree->m_removeSources && ::unlink(item.source.constData()) != 0) {
+                    m_tree->fail(item.sequence, errno, item.source);
+                    break;
+                }
+                m_tree->m_entries.fetchAndAddRelaxed(1);
+            } else if (!copier.wasCancelled()) {
+                m_tree->fail(item.sequence, copier.errorString(), item.source);
+            }
+        }
+    }
+
+private:
+    TreeCopier* m_tree;
+};
+
+TreeCopier::TreeCopier(const QString &source, const QString &dest) :
+    m_source(QFile::encodeName(source)), m_dest(QFile::encodeName(dest))
+{
+    while (m_source.length() > 1 && m_source.endsWith('/')) m_source.chop(1);
+    while (m_dest.length() > 1 && m_dest.endsWith('/')) m_dest.chop(1);
+}
+
+int TreeCopier::copierCountFor(const QStringList &paths)
+{
+    MountTable* mounts = MountTable::instance();
+    int count = TREECOPIER_COPIERS_FLASH;
+
+    for (const QString& path : paths) {
+        switch (MountTable::storageType(mounts->mountFor(path))) {
+        case MountTable::FlashStorage:
+            break;
+        case MountTable::RotationalStorage:
+        case MountTable::RemovableStorage:
+            count = qMin(count, TREECOPIER_COPIERS_SLOW);
+            break;
+        case MountTable::SdCardStorage:
+        case MountTable::UnknownStorage:
+            count = qMin(count, TREECOPIER_COPIERS_DEFAULT);
+            break;
+        }
+    }
+
+    return count;
+}
+
+bool TreeCopier::copy()
+{
+    m_reportTimer.start();
+
+    if (::mkdir(m_dest.constData(), 0777) != 0) {
+        struct stat st;
+        if (errno != EEXIST || ::stat(m_dest.constData(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            m_errorString = QCoreApplication::translate("TreeCopier", "Cannot create target folder %1")
+                    .arg(QFile::decodeName(m_dest));
+            m_errorPath = m_source;
+            return false;
+        }
+    }
+    m_entries.fetchAndAddRelaxed(1);
+
+    int fd = ::open(m_source.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        fail(m_nextSequence++, errno, m_source);
+        return false;
+    }
+
+    QThreadPool copiers;
+    copiers.setMaxThreadCount(m_copierCount);
+    for (int i = 0; i < m_copierCount; ++i) {
+        copiers.start(new Copier(this));
+    }
+
+    walk(fd, m_source, m_dest);
+
+    m_mutex.lock();
+    m_walkDone = true;
+    m_notEmpty.wakeAll();
+    m_mutex.unlock();
+
+    while (!copiers.waitForDone(TREECOPIER_REPORT_INTERVAL)) {
+        reportProgress(false);
+    }
+    reportProgress(true);
+
+    if (m_errorSequence >= 0) {
+        return false;
+    } else if (m_isCancelled && m_isCancelled()) {
+        m_cancelled = true;
+        m_errorString = QCoreApplication::translate("TreeCopier", "Cancelled");
+        return false;
+    }
+
+    return !m_removeSources || removeSourceDirs();
+}
+
+bool TreeCopier::walk(int dirFd, const QByteArray& source, const QByteArray& dest)
+{
+    DIR* dir = ::fdopendir(dirFd);
+    if (!dir) {
+        fail(m_nextSequence++, errno, source);
+        ::close(dirFd);
+        return false;
+    }
+
+    struct dirent* entry;
+    struct stat st;
+
+    while (!shouldStop()) {
+        errno = 0;
+        if ((entry = ::readdir(dir)) == nullptr) {
+            if (errno != 0) fail(m_nextSequence++, errno, source);
+            break;
+        }
+
+        const char* name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+
+        if (m_isCancelled && m_isCancelled()) {
+            stop();
+            break;
+        }
+        reportProgress(false);
+
+        qint64 sequence = m_nextSequence++;
+        QByteArray sourcePath = source + '/' + name;
+        QByteArray destPath = dest + '/' + name;
+
+        if (::fstatat(::dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            fail(sequence, errno, sourcePath);
+            break;
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            if (m_removeSources) m_sourceDirs.append(sourcePath);
+
+            // create folders right away so that copiers never wait for them
+            struct stat existing;
+            if (::mkdir(destPath.constData(), 0777) != 0 && !(errno == EEXIST &&
+                    ::stat(destPath.constData(), &existing) == 0 && S_ISDIR(existing.st_mode))) {
+                fail(sequence, errno, sourcePath);
+                break;
+            }
+            m_entries.fetchAndAddRelaxed(1);
+
+            int fd = ::openat(::dirfd(dir), name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (fd < 0) {
+                fail(sequence, errno, sourcePath);
+                break;
+            }
+            if (!walk(fd, sourcePath, destPath)) break;
+
+        } else if (S_ISLNK(st.st_mode)) {
+            if (!copySymLink(::dirfd(dir), name, destPath) ||
+                    (m_removeSources && ::unlinkat(::dirfd(dir), name, 0) != 0)) {
+                fail(sequence, errno, sourcePath);
+                break;
+            }
+            m_entries.fetchAndAddRelaxed(1);
+
+        } else if (S_ISREG(st.st_mode)) {
+            if (!push(Item{sequence, sourcePath, destPath})) break;
+        }
+    }
+
+    ::closedir(dir);
+    return !shouldStop();
+}
+
+bool TreeCopier::copySymLink(int dirFd, const char *name, const QByteArray &dest)
+{
+    QByteArray target(PATH_MAX, '\0');
+    ssize_t length = ::readlinkat(dirFd, name, target.data(), size_t(target.size()));
+    if (length < 0) return false;
+    target.truncate(int(length));
+
+    if (::symlink(target.constData(), dest.constData()) == 0) return true;
+
+    // replace existing files, but not folders
+    struct stat st;
+    if (errno != EEXIST || ::lstat(dest.constData(), &st) != 0 || S_ISDIR(st.st_mode)) {
+        return false;
+    }
+    return ::unlink(dest.constData()) == 0 && ::symlink(target.constData(), dest.constData()) == 0;
+}
+
+bool TreeCopier::removeSourceDirs()
+{
+    // Folders were recorded before their subfolders, so removing them in
+    // reverse order removes children first. Removing fails if a folder still
+    // contains anything that was not moved, e.g. special files.
+    m_sourceDirs.prepend(m_source);
+
+    for (int i = m_sourceDirs.length() - 1; i >= 0; --i) {
+        if (::rmdir(m_sourceDirs.at(i).constData()) != 0) {
+            m_errorString = QString::fromLocal8Bit(strerror(errno));
+            m_errorPath = m_sourceDirs.at(i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool TreeCopier::push(Item item)
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (m_queue.size() >= TREECOPIER_QUEUE_SIZE && !shouldStop()) {
+        m_notFull.wait(&m_mutex, TREECOPIER_REPORT_INTERVAL);
+        locker.unlock();
+        reportProgress(false);
+        locker.relock();
+    }
+
+    if (shouldStop()) return false;
+    m_queue.push_back(std::move(item));
+    m_notEmpty.wakeOne();
+    return true;
+}
+
+bool TreeCopier::take(Item *item)
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (m_queue.empty() && !m_walkDone && !shouldStop()) {
+        m_notEmpty.wait(&m_mutex);
+    }
+
+    if (m_queue.empty() || shouldStop()) return false;
+    *item = std::move(m_queue.front());
+    m_queue.pop_front();
+    m_currentFile = item->source;
+    m_notFull.wakeOne();
+    return true;
+}
+
+void TreeCopier::fail(qint64 sequence, const QString &message, const QByteArray &path)
+{
+    m_errorMutex.lock();
+    if (m_errorSequence < 0 || sequence < m_errorSequence) {
+        m_errorSequence = sequence;
+        m_errorString = message;
+        m_errorPath = path;
+    }
+    m_errorMutex.unlock();
+    stop();
+}
+
+void TreeCopier::fail(qint64 sequence, int error, const QByteArray &path)
+{
+    fail(sequence, QString::fromLocal8Bit(strerror(error)), path);
+}
+
+bool TreeCopier::shouldStop() const
+{
+    return m_stop.loadAcquire() != 0 || (m_isCancelled && m_isCancelled());
+}
+
+void TreeCopier::stop()
+{
+    m_stop.storeRelease(1);
+
+    QMutexLocker locker(&m_mutex);
+    m_notEmpty.wakeAll();
+    m_notFull.wakeAll();
+}
+
+void TreeCopier::reportProgress(bool force)
+{
+    if (!m_progress) return;
+    if (!force && m_reportTimer.elapsed() < TREECOPIER_REPORT_INTERVAL) return;
+    m_reportTimer.restart();
+
+    qint64 bytes = m_bytes.fetchAndStoreRelaxed(0);
+    qint64 entries = m_entries.fetchAndStoreRelaxed(0);
+    qint64 sparse = m_sparse.fetchAndStoreRelaxed(0);
+    if (sparse > 0 && m_sparseProgress) m_sparseProgress(sparse);
+
+    m_mutex.lock();
+    QByteArray current = m_currentFile;
+    m_mutex.unlock();
+
+    int slash = current.lastIndexOf('/');
+    m_progress(bytes, entries, QFile::decodeName(current.mid(slash + 1)));
+}
@@ -0,0 +1,151 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TREECOPIER_H
+#define TREECOPIER_H
+
+#include <functional>
+#include <deque>
+#include <QString>
+#include <QFile>
+#include <QStringList>
+#include <QByteArray>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+
+class TransferJournal;
+
+/**
+ * @brief The TreeCopier class copies a directory tree with a pipeline of threads.
+ *
+ * The calling thread walks the source tree with openat() relative to
+ * directory descriptors. It creates directories and symbolic links right
+ * away, and puts regular files in a bounded queue. A few copier threads
+ * take files from the queue and copy them with FileCopier. This way, the
+ * latency of opening, creating and closing many small files overlaps.
+ *
+ * Entries are numbered in the order they are walked. If several files
+ * fail, the one walked first is reported, no matter which copier
+ * noticed its failure first. Copying stops at the first error.
+ *
+ * Symbolic links are copied as links with the same target. Special files
+ * like sockets or device nodes are skipped.
+ *
+ * When moving, each source file is removed as soon as its copy has been
+ * synced and checked (see FileCopier::setVerifyEnabled()), and source
+ * folders are removed once they are empty.
+ * An interrupted move leaves only the entries that have not been moved yet.
+ */
+class TreeCopier
+{
+public:
+    TreeCopier(const QString& source, const QString& dest);
+
+    // Called regularly from all threads. Copying stops if it returns true.
+    void setCancelCheck(std::function<bool()> isCancelled) { m_isCancelled = isCancelled; }
+
+    // Called from the thread running copy() only, at most a few times per
+    // second, with the bytes and entries copied since the last call and the
+    // name of a file currently being copied.
+    void setProgressCallback(std::function<void(qint64 bytes, qint64 entries,
+                                                const QString& filename)> progress) {
+        m_progress = progress;
+    }
+
+    // Called like the progress callback, with the size of holes in sparse
+    // files that were kept instead of written.
+    void setSparseCallback(std::function<void(qint64 bytes)> sparse) { m_sparseProgress = sparse; }
+
+    void setCopierCount(int count) { m_copierCount = qMax(1, count); }
+
+    // Removes the sources after copying them, see above.
+    void setRemoveSources(bool remove) { m_removeSources = remove; }
+
+    // Records copied files in the journal and resumes from it, see FileCopier.
+    void setJournal(TransferJournal* journal) { m_journal = journal; }
+
+    // Returns a number of copiers that suits the storage of all paths:
+    // internal flash storage handles parallel requests well, while SD cards
+    // and USB drives slow down when accessed in parallel.
+    static int copierCountFor(const QStringList& paths);
+
+    // Copies the source tree into dest, which may exist already.
+    // Existing files are overwritten. Blocks until done.
+    bool copy();
+
+    QString errorString() const { return m_errorString; }
+    QString errorPath() const { return QFile::decodeName(m_errorPath); }
+    bool wasCancelled() const { return m_cancelled; }
+
+private:
+    struct Item {
+        qint64 sequence;
+        QByteArray source;
+        QByteArray dest;
+    };
+    class Copier;
+
+    bool walk(int dirFd, const QByteArray& source, const QByteArray& dest);
+    bool copySymLink(int dirFd, const char* name, const QByteArray& dest);
+    bool removeSourceDirs();
+    bool push(Item item);
+    bool take(Item* item);
+    void fail(qint64 sequence, const QString& message, const QByteArray& path);
+    void fail(qint64 sequence, int error, const QByteArray& path);
+    bool shouldStop() const;
+    void stop();
+    void reportProgress(bool force);
+
+    QByteArray m_source;
+    QByteArray m_dest;
+    std::function<bool()> m_isCancelled;
+    std::function<void(qint64, qint64, const QString&)> m_progress;
+    std::function<void(qint64)> m_sparseProgress;
+    int m_copierCount = {1};
+    bool m_removeSources = {false};
+    TransferJournal* m_journal = {nullptr};
+    QList<QByteArray> m_sourceDirs; // only used by the walking thread
+
+    // the queue of files, guarded by the mutex
+    QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    std::deque<Item> m_queue;
+    bool m_walkDone = {false};
+    QByteArray m_currentFile;
+
+    qint64 m_nextSequence = {0}; // only used by the walking thread
+    QAtomicInt m_stop = {0};
+    QAtomicInteger<qint64> m_bytes = {0}; // not yet reported
+    QAtomicInteger<qint64> m_entries = {0}; // not yet reported
+    QAtomicInteger<qint64> m_sparse = {0}; // not yet reported
+    QElapsedTimer m_reportTimer;
+
+    QMutex m_errorMutex;
+    qint64 m_errorSequence = {-1};
+    QString m_errorString;
+    QByteArray m_errorPath;
+    bool m_cancelled = {false};
+};
+
+#endif // TREECOPIER_H
@@ -0,0 +1,285 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QThreadPool>
+#include "treedeleter.h"
+#include "mounttable.h"
+
+// Minimum interval in milliseconds between progress reports.
+#ifndef TREEDELETER_REPORT_INTERVAL
+#define TREEDELETER_REPORT_INTERVAL 50
+#endif
+
+// Number of threads deleting subtrees on flash storage.
+#ifndef TREEDELETER_THREADS_FLASH
+#define TREEDELETER_THREADS_FLASH 4
+#endif
+
+class TreeDeleter::Remover : public QRunnable
+{
+public:
+    explicit Remover(TreeDeleter* tree) : m_tree(tree) {}
+
+    void run() override
+    {
+        QByteArray name;
+        while (m_tree->takeSubtree(&name)) {
+            if (!m_tree->removeTree(m_tree->m_rootFd, name.constData(), m_tree->m_path + '/' + name)) break;
+        }
+    }
+
+private:
+    TreeDeleter* m_tree;
+};
+
+TreeDeleter::TreeDeleter(const QString &path) : m_path(QFile::encodeName(path))
+{
+    while (m_path.length() > 1 && m_path.endsWith('/')) m_path.chop(1);
+}
+
+int TreeDeleter::threadCountFor(const QString &path)
+{
+    MountTable::Mount mount = MountTable::instance()->mountFor(path);
+    return MountTable::storageType(mount) == MountTable::FlashStorage ? TREEDELETER_THREADS_FLASH : 1;
+}
+
+bool TreeDeleter::remove()
+{
+    m_owner = QThread::currentThreadId();
+    m_reportTimer.start();
+
+    struct stat st;
+    if (::lstat(m_path.constData(), &st) != 0) {
+        fail(errno, m_path);
+    } else if (!S_ISDIR(st.st_mode)) {
+        if (::unlink(m_path.constData()) != 0) fail(errno, m_path);
+        else m_entries.fetchAndAddRelaxed(1);
+    } else if (m_threadCount > 1) {
+        removeSubtrees();
+    } else {
+        removeTree(AT_FDCWD, m_path.constData(), m_path);
+    }
+
+    reportProgress(true);
+
+    if (!m_errorString.isEmpty()) {
+        return false;
+    } else if (m_isCancelled && m_isCancelled()) {
+        m_cancelled = true;
+        m_errorString = QCoreApplication::translate("TreeDeleter", "Cancelled");
+        return false;
+    }
+
+    return true;
+}
+
+bool TreeDeleter::removeTree(int parentFd, const char *name, const QByteArray &path)
+{
+    int fd = ::openat(parentFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        fail(errno, path);
+        return false;
+    }
+
+    DIR* dir = ::fdopendir(fd);
+    if (!dir) {
+        fail(errno, path);
+        ::close(fd);
+        return false;
+    }
+
+    setCurrent(path);
+    struct dirent* entry;
+    struct stat st;
+
+    while (!shouldStop()) {
+        errno = 0;
+        if ((entry = ::readdir(dir)) == nullptr) {
+            if (errno != 0) fail(errno, path);
+            break;
+        }
+
+        const char* child = entry->d_name;
+        if (child[0] == '.' && (child[1] == '\0' || (child[1] == '.' && child[2] == '\0'))) {
+            continue;
+        }
+
+        bool isDir = (entry->d_type == DT_DIR);
+        if (entry->d_type == DT_UNKNOWN && ::fstatat(::dirfd(dir), child, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+            isDir = S_ISDIR(st.st_mode);
+        }
+
+        if (isDir) {
+            if (!removeTree(::dirfd(dir), child, path + '/' + child)) break;
+        } else if (::unlinkat(::dirfd(dir), child, 0) != 0 && errno != ENOENT) {
+            fail(errno, path + '/' + child);
+            break;
+        } else {
+            m_entries.fetchAndAddRelaxed(1);
+        }
+
+        reportProgress(false);
+    }
+
+    ::closedir(dir);
+    if (shouldStop()) return false;
+
+    if (::unlinkat(parentFd, name, AT_REMOVEDIR) != 0) {
+        fail(errno, path);
+        return false;
+    }
+
+    m_entries.fetchAndAddRelaxed(1);
+    return true;
+}
+
+bool TreeDeleter::removeSubtrees()
+{
+    // Files in the root are removed right away, subdirectories are
+    // collected and removed by several threads.
+    m_rootFd = ::open(m_path.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (m_rootFd < 0) {
+        fail(errno, m_path);
+        return false;
+    }
+
+    DIR* dir = ::fdopendir(::dup(m_rootFd));
+    if (!dir) {
+        fail(errno, m_path);
+        ::close(m_rootFd);
+        return false;
+    }
+
+    setCurrent(m_path);
+    struct dirent* entry;
+    struct stat st;
+
+    while (!shouldStop()) {
+        errno = 0;
+        if ((entry = ::readdir(dir)) == nullptr) {
+            if (errno != 0) fail(errno, m_path);
+            break;
+        }
+
+        const char* child = entry->d_name;
+        if (child[0] == '.' && (child[1] == '\0' || (child[1] == '.' && child[2] == '\0'))) {
+            continue;
+        }
+
+        bool isDir = (entry->d_type == DT_DIR);
+        if (entry->d_type == DT_UNKNOWN && ::fstatat(m_rootFd, child, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+            isDir = S_ISDIR(st.st_mode);
+        }
+
+        if (isDir) {
+            m_subtrees.append(QByteArray(child));
+        } else if (::unlinkat(m_rootFd, child, 0) != 0 && errno != ENOENT) {
+            fail(errno, m_path + '/' + child);
+            break;
+        } else {
+            m_entries.fetchAndAddRelaxed(1);
+        }
+
+        reportProgress(false);
+    }
+
+    ::closedir(dir);
+
+    if (!shouldStop() && !m_subtrees.isEmpty()) {
+        QThreadPool removers;
+        int count = qMin(m_threadCount, m_subtrees.count());
+        removers.setMaxThreadCount(count);
+        for (int i = 0; i < count; ++i) {
+            removers.start(new Remover(this));
+        }
+
+        while (!removers.waitForDone(TREEDELETER_REPORT_INTERVAL)) {
+            reportProgress(false);
+        }
+    }
+
+    ::close(m_rootFd);
+    m_rootFd = -1;
+    if (shouldStop()) return false;
+
+    if (::rmdir(m_path.constData()) != 0) {
+        fail(errno, m_path);
+        return false;
+    }
+
+    m_entries.fetchAndAddRelaxed(1);
+    return true;
+}
+
+bool TreeDeleter::takeSubtree(QByteArray *name)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_subtrees.isEmpty() || shouldStop()) return false;
+    *name = m_subtrees.takeFirst();
+    return true;
+}
+
+void TreeDeleter::fail(int error, const QByteArray &path)
+{
+    m_mutex.lock();
+    if (m_errorString.isEmpty()) {
+        m_errorString = QString::fromLocal8Bit(strerror(error));
+        m_errorPath = path;
+    }
+    m_mutex.unlock();
+    m_stop.storeRelease(1);
+}
+
+bool TreeDeleter::shouldStop() const
+{
+    return m_stop.loadAcquire() != 0 || (m_isCancelled && m_isCancelled());
+}
+
+void TreeDeleter::setCurrent(const QByteArray &path)
+{
+    if (!m_progress) return;
+    QMutexLocker locker(&m_mutex);
+    m_current = path;
+}
+
+void TreeDeleter::reportProgress(bool force)
+{
+    // only the thread running remove() may report
+    if (!m_progress || QThread::currentThreadId() != m_owner) return;
+    if (!force && m_reportTimer.elapsed() < TREEDELETER_REPORT_INTERVAL) return;
+    m_reportTimer.restart();
+
+    qint64 entries = m_entries.fetchAndStoreRelaxed(0);
+
+    m_mutex.lock();
+    QByteArray current = m_current;
+    m_mutex.unlock();
+
+    int slash = current.lastIndexOf('/');
+    m_progress(entries, QFile::decodeName(current.mid(slash + 1)));
+}
@@ -0,0 +1,106 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TREEDELETER_H
+#define TREEDELETER_H
+
+#include <functional>
+#include <QString>
+#include <QFile>
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QThread>
+
+/**
+ * @brief The TreeDeleter class deletes a directory tree.
+ *
+ * Directories are read with readdir() and entries are removed with
+ * unlinkat() relative to directory descriptors, so no file info objects
+ * are created and paths are resolved only once. Symbolic links are
+ * removed, never followed.
+ *
+ * Cancellation is checked between entries. Deleting stops at the first
+ * error, which names the path that could not be removed.
+ *
+ * Subdirectories of the root can be deleted by several threads in
+ * parallel, which helps on flash storage.
+ */
+class TreeDeleter
+{
+public:
+    explicit TreeDeleter(const QString& path);
+
+    // Called regularly from all threads. Deleting stops if it returns true.
+    void setCancelCheck(std::function<bool()> isCancelled) { m_isCancelled = isCancelled; }
+
+    // Called from the thread running remove() only, at most a few times per
+    // second, with the entries removed since the last call and the name of
+    // an entry currently being removed.
+    void setProgressCallback(std::function<void(qint64 entries, const QString& filename)> progress) {
+        m_progress = progress;
+    }
+
+    void setThreadCount(int count) { m_threadCount = qMax(1, count); }
+
+    // Returns a number of threads that suits the storage of the path.
+    static int threadCountFor(const QString& path);
+
+    // Removes the tree including its root. Blocks until done.
+    bool remove();
+
+    QString errorString() const { return m_errorString; }
+    QString errorPath() const { return QFile::decodeName(m_errorPath); }
+    bool wasCancelled() const { return m_cancelled; }
+
+private:
+    class Remover;
+
+    bool removeTree(int parentFd, const char* name, const QByteArray& path);
+    bool removeSubtrees();
+    bool takeSubtree(QByteArray* name);
+    void fail(int error, const QByteArray& path);
+    bool shouldStop() const;
+    void setCurrent(const QByteArray& path);
+    void reportProgress(bool force);
+
+    QByteArray m_path;
+    std::function<bool()> m_isCancelled;
+    std::function<void(qint64, const QString&)> m_progress;
+    int m_threadCount = {1};
+    Qt::HANDLE m_owner = {nullptr}; // the thread running remove()
+
+    QMutex m_mutex; // guards everything below that is not atomic
+    QList<QByteArray> m_subtrees; // names of subdirectories not yet taken
+    int m_rootFd = {-1};
+    QByteArray m_current;
+    QString m_errorString;
+    QByteArray m_errorPath;
+
+    QAtomicInt m_stop = {0};
+    QAtomicInteger<qint64> m_entries = {0}; // not yet reported
+    QElapsedTimer m_reportTimer;
+    bool m_cancelled = {false};
+};
+
+#endif // TREEDELETER_H
@@ -0,0 +1,395 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <QFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutexLocker>
+#include "treewalker.h"
+#include "directorysizeindex.h"
+
+// number of entries a thread processes before it
+// publishes its totals and checks for cancellation
+#define TREEWALKER_FLUSH_INTERVAL 256
+
+// minimum time between progress reports in milliseconds
+#define TREEWALKER_PROGRESS_INTERVAL 250
+
+// maximum time in milliseconds that idle threads wait for work
+// before checking for cancellation
+#define TREEWALKER_IDLE_TIMEOUT 100
+
+class TreeWalker::Runner : public QRunnable
+{
+public:
+    Runner(TreeWalker* walker, int self) : m_walker(walker), m_self(self) {}
+    void run() override { m_walker->runThread(m_self); }
+
+private:
+    TreeWalker* m_walker;
+    int m_self;
+};
+
+void TreeWalker::Totals::add(const TreeWalker::Totals &other)
+{
+    apparentSize += other.apparentSize;
+    allocatedSize += other.allocatedSize;
+    dirs += other.dirs;
+    files += other.files;
+}
+
+TreeWalker::TreeWalker(const QStringList &roots) : m_roots(roots) {}
+
+TreeWalker::Totals TreeWalker::walk(std::function<bool ()> isCancelled,
+                                    std::function<void (const Totals &)> progress)
+{
+    m_isCancelled = isCancelled;
+    m_progress = progress;
+    m_totals = Totals();
+    m_seen.clear();
+    m_pending.storeRelease(0);
+    m_progressTimer.start();
+
+    int threads = qMax(1, QThread::idealThreadCount());
+    m_queues.clear();
+    for (int i = 0; i < threads; ++i) {
+        m_queues.emplace_back(new Queue);
+    }
+
+    Totals totals;
+    for (const auto& i : m_roots) {
+        addRoot(i, totals);
+    }
+    flush(totals);
+
+    // Listing directories is mostly waiting for I/O, so we use a
+    // private pool to not block the global pool used elsewhere.
+    // The calling thread does its share of the work, too.
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    for (int i = 1; i < threads; ++i) {
+        pool.start(new Runner(this, i));
+    }
+
+    runThread(0);
+    pool.waitForDone();
+
+    QMutexLocker locker(&m_totalsMutex);
+    return m_totals;
+}
+
+void TreeWalker::runThread(int self)
+{
+    Totals totals;
+    Dir dir;
+
+    while (!m_isCancelled()) {
+        int serial = m_workSerial.loadAcquire();
+
+        if (takeWork(self, &dir)) {
+            processDir(self, dir, totals);
+            if (m_pending.fetchAndAddOrdered(-1) == 1) {
+                wakeIdle(true); // everything is done
+            }
+        } else if (m_pending.loadAcquire() == 0) {
+            break; // everything is done
+        } else {
+            // other threads are still busy and may push more work
+            QMutexLocker locker(&m_idleMutex);
+            m_idleThreads.fetchAndAddOrdered(1);
+            if (m_workSerial.loadAcquire() == serial) {
+                m_idleCondition.wait(&m_idleMutex, TREEWALKER_IDLE_TIMEOUT);
+            }
+            m_idleThreads.fetchAndAddOrdered(-1);
+        }
+    }
+
+    flush(totals);
+}
+
+void TreeWalker::addRoot(const QString &root, Totals &totals)
+{
+    QByteArray path = QFile::encodeName(root);
+    struct stat st;
+
+    int result = m_followSymLinks ? ::stat(path.constData(), &st) : ::lstat(path.constData(), &st);
+    if (result != 0) {
+        if (::lstat(path.constData(), &st) == 0 && S_ISLNK(st.st_mode)) {
+            totals.files++; // broken link
+        }
+        return;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        if (!markSeen(st.st_dev, st.st_ino)) return;
+        totals.dirs++;
+        totals.apparentSize += st.st_size;
+        totals.allocatedSize += qint64(st.st_blocks) * 512;
+        pushWork(m_pending.loadAcquire() % int(m_queues.size()), makeDir(path, st, nullptr));
+    } else if (S_ISREG(st.st_mode) || S_ISLNK(st.st_mode)) {
+        totals.files++;
+        if ((m_followSymLinks || st.st_nlink > 1) && !markSeen(st.st_dev, st.st_ino)) return;
+        totals.apparentSize += st.st_size;
+        totals.allocatedSize += qint64(st.st_blocks) * 512;
+    }
+}
+
+void TreeWalker::processDir(int self, const Dir &dir, Totals &totals)
+{
+    Totals own; // contents of this directory only
+
+    if (!m_index || !processIndexedDir(self, dir, totals, own)) {
+        listDir(self, dir, totals, own);
+    }
+
+    if (dir.node) finishNode(dir.node, own);
+}
+
+void TreeWalker::listDir(int self, const Dir &dir, Totals &totals, Totals &own)
+{
+    DIR* handle = ::opendir(dir.path.constData());
+    if (!handle) return;
+
+    int fd = ::dirfd(handle);
+    int statFlags = m_followSymLinks ? 0 : AT_SYMLINK_NOFOLLOW;
+    int counter = 0;
+    bool complete = true;
+    struct dirent* entry;
+    struct stat st;
+    DirectorySizeIndex::Entry indexed;
+
+    while ((entry = ::readdir(handle)) != nullptr) {
+        const char* name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+
+        if (++counter % TREEWALKER_FLUSH_INTERVAL == 0) {
+            if (m_isCancelled()) {
+                complete = false;
+                break;
+            }
+            flush(totals);
+        }
+
+        if (::fstatat(fd, name, &st, statFlags) != 0) {
+            if (::fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISLNK(st.st_mode)) {
+                own.files++; // broken link
+            }
+            continue;
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            if (st.st_dev != dir.device) continue; // other file system
+            if (m_index) indexed.dirs.append(QByteArray(name));
+            addSubdir(self, dir, name, st, totals);
+        } else if (S_ISREG(st.st_mode) || S_ISLNK(st.st_mode)) {
+            own.files++;
+            // files can be reached more than once through hard links
+            // and symbolic links, so their sizes are only counted once
+            if ((m_followSymLinks || st.st_nlink > 1) && !markSeen(st.st_dev, st.st_ino)) continue;
+            own.apparentSize += st.st_size;
+            own.allocatedSize += qint64(st.st_blocks) * 512;
+            if (m_fileVisitor && S_ISREG(st.st_mode)) m_fileVisitor(dir.path, name, st);
+        }
+    }
+
+    ::closedir(handle);
+    totals.add(own);
+
+    if (m_index && complete) {
+        indexed.modTime = dir.modTime;
+        indexed.files = own.files;
+        indexed.apparentSize = own.apparentSize;
+        indexed.allocatedSize = own.allocatedSize;
+        m_index->insert(dir.device, dir.inode, dir.path, indexed);
+    }
+}
+
+bool TreeWalker::processIndexedDir(int self, const Dir &dir, Totals &totals, Totals &own)
+{
+    DirectorySizeIndex::Entry indexed;
+    if (!m_index->lookup(dir.device, dir.inode, dir.modTime, dir.path, &indexed)) {
+        return false;
+    }
+
+    own.files = indexed.files;
+    own.apparentSize = indexed.apparentSize;
+    own.allocatedSize = indexed.allocatedSize;
+    totals.add(own);
+
+    // subdirectories may have changed, so they are checked individually
+    int fd = ::open(dir.path.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return true;
+
+    struct stat st;
+    int statFlags = m_followSymLinks ? 0 : AT_SYMLINK_NOFOLLOW;
+    for (const auto& name : indexed.dirs) {
+        if (m_isCancelled()) break;
+        if (::fstatat(fd, name.constData(), &st, statFlags) != 0) continue;
+        if (!S_ISDIR(st.st_mode) || st.st_dev != dir.device) continue;
+        addSubdir(self, dir, name.constData(), st, totals);
+    }
+
+    ::close(fd);
+    return true;
+}
+
+void TreeWalker::addSubdir(int self, const Dir &parent, const char *name,
+                           const struct stat &st, Totals &totals)
+{
+    if (!markSeen(st.st_dev, st.st_ino)) return; // loop or already counted
+    totals.dirs++;
+    totals.apparentSize += st.st_size;
+    totals.allocatedSize += qint64(st.st_blocks) * 512;
+
+    QByteArray path;
+    path.reserve(parent.path.size() + 1 + int(strlen(name)));
+    path.append(parent.path);
+    if (!path.endsWith('/')) path.append('/');
+    path.append(name);
+    pushWork(self, makeDir(path, st, &parent));
+}
+
+TreeWalker::Dir TreeWalker::makeDir(const QByteArray &path, const struct stat &st, const Dir *parent)
+{
+    Dir dir{path, st.st_dev, st.st_ino, DirectorySizeIndex::modTimeOf(st), nullptr};
+    if (!m_dirVisitor) return dir;
+
+    dir.node = std::make_shared<Node>();
+    dir.node->path = path;
+    dir.node->totals.dirs = 1;
+    dir.node->totals.apparentSize = st.st_size;
+    dir.node->totals.allocatedSize = qint64(st.st_blocks) * 512;
+
+    if (parent && parent->node) {
+        dir.node->parent = parent->node;
+        QMutexLocker locker(&parent->node->mutex);
+        parent->node->pending++;
+    }
+
+    return dir;
+}
+
+void TreeWalker::finishNode(std::shared_ptr<Node> node, const Totals &own)
+{
+    Totals subtree = own;
+
+    // pass finished subtrees up until reaching a directory
+    // that still waits for other subdirectories
+    while (node) {
+        {
+            QMutexLocker locker(&node->mutex);
+            node->totals.add(subtree);
+            if (--node->pending > 0) return;
+            subtree = node->totals;
+        }
+
+        m_dirVisitor(node->path, subtree);
+        node = node->parent;
+    }
+}
+
+void TreeWalker::pushWork(int self, TreeWalker::Dir dir)
+{
+    m_pending.fetchAndAddOrdered(1);
+    {
+        Queue* queue = m_queues[size_t(self)].get();
+        QMutexLocker locker(&queue->mutex);
+        queue->dirs.push_back(std::move(dir));
+    }
+    wakeIdle(false);
+}
+
+void TreeWalker::wakeIdle(bool all)
+{
+    // Idle threads register before they compare the serial, so either they
+    // see the new serial or they are counted here and get woken up.
+    m_workSerial.fetchAndAddOrdered(1);
+    if (m_idleThreads.loadAcquire() == 0) return;
+
+    QMutexLocker locker(&m_idleMutex);
+    if (all) m_idleCondition.wakeAll();
+    else m_idleCondition.wakeOne();
+}
+
+bool TreeWalker::takeWork(int self, TreeWalker::Dir *dir)
+{
+    // take the newest directory from our own queue (depth first)...
+    {
+        Queue* queue = m_queues[size_t(self)].get();
+        QMutexLocker locker(&queue->mutex);
+        if (!queue->dirs.empty()) {
+            *dir = std::move(queue->dirs.back());
+            queue->dirs.pop_back();
+            return true;
+        }
+    }
+
+    // ... or steal the oldest directory from another queue,
+    // which is likely near the top and has the most work below it
+    int count = int(m_queues.size());
+    for (int i = 1; i < count; ++i) {
+        Queue* queue = m_queues[size_t((self + i) % count)].get();
+        QMutexLocker locker(&queue->mutex);
+        if (!queue->dirs.empty()) {
+            *dir = std::move(queue->dirs.front());
+            queue->dirs.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool TreeWalker::markSeen(dev_t device, ino_t inode)
+{
+    auto key = qMakePair(quint64(device), quint64(inode));
+    QMutexLocker locker(&m_seenMutex);
+    if (m_seen.contains(key)) return false;
+    m_seen.insert(key);
+    return true;
+}
+
+void TreeWalker::flush(Totals &totals)
+{
+    Totals current;
+
+    {
+        QMutexLocker locker(&m_totalsMutex);
+        m_totals.add(totals);
+        totals = Totals();
+
+        if (!m_progress || m_progressTimer.elapsed() < TREEWALKER_PROGRESS_INTERVAL) {
+            return;
+        }
+
+        m_progressTimer.restart();
+        current = m_totals;
+    }
+
+    m_progress(current);
+}
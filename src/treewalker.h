@@ -0,0 +1,149 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TREEWALKER_H
+#define TREEWALKER_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <sys/types.h>
+#include <QStringList>
+#include <QByteArray>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QPair>
+
+class DirectorySizeIndex;
+
+/**
+ * @brief The TreeWalker class collects size info of directory trees in one pass.
+ *
+ * Directories are traversed in parallel: each thread works on its own queue
+ * of directories and steals work from other threads when it runs out.
+ * Symbolic links are followed by default. The traversal stays on the file
+ * system of each root path. Files and directories reached more than once,
+ * through hard links or symbolic links, are only counted once.
+ *
+ * Visitors can be set to analyze the tree while it is walked. Totals of
+ * subtrees are only collected when a directory visitor is set.
+ *
+ * With a DirectorySizeIndex, directories that did not change since they
+ * were last listed are not listed again; only their subdirectories are
+ * checked. Files reached through multiple unchanged directories may then
+ * be counted more than once.
+ */
+class TreeWalker
+{
+public:
+    struct Totals {
+        qint64 apparentSize = {0}; // sum of file sizes
+        qint64 allocatedSize = {0}; // sum of allocated blocks
+        qint64 dirs = {0};
+        qint64 files = {0}; // regular files and broken links
+        void add(const Totals& other);
+    };
+
+    // Visitors are called from any thread and must be thread-safe.
+    // The file visitor is called for every counted regular file, and the
+    // directory visitor when a directory and all its contents are done.
+    typedef std::function<void(const QByteArray& dir, const char* name,
+                               const struct stat& st)> FileVisitor;
+    typedef std::function<void(const QByteArray& path, const Totals& totals)> DirVisitor;
+
+    explicit TreeWalker(const QStringList& roots);
+    void setIndex(DirectorySizeIndex* index) { m_index = index; }
+    void setFollowSymLinks(bool follow) { m_followSymLinks = follow; }
+    void setFileVisitor(FileVisitor visitor) { m_fileVisitor = visitor; }
+    void setDirVisitor(DirVisitor visitor) { m_dirVisitor = visitor; }
+
+    // Walks all roots and blocks until done or until isCancelled() returns true.
+    // progress() is called at most a few times per second from any thread.
+    Totals walk(std::function<bool()> isCancelled,
+                std::function<void(const Totals&)> progress = nullptr);
+
+private:
+    // Totals of a subtree, which are passed on to the parent
+    // when the directory and all its subdirectories are done.
+    struct Node {
+        std::shared_ptr<Node> parent;
+        QByteArray path;
+        QMutex mutex;
+        Totals totals;
+        int pending = {1}; // own listing and unfinished subdirectories
+    };
+    struct Dir {
+        QByteArray path;
+        dev_t device;
+        ino_t inode;
+        qint64 modTime;
+        std::shared_ptr<Node> node; // only with a directory visitor
+    };
+    struct Queue {
+        QMutex mutex;
+        std::deque<Dir> dirs;
+    };
+    class Runner;
+
+    void runThread(int self);
+    void addRoot(const QString& root, Totals& totals);
+    void processDir(int self, const Dir& dir, Totals& totals);
+    bool processIndexedDir(int self, const Dir& dir, Totals& totals, Totals& own);
+    void listDir(int self, const Dir& dir, Totals& totals, Totals& own);
+    void addSubdir(int self, const Dir& parent, const char* name,
+                   const struct stat& st, Totals& totals);
+    Dir makeDir(const QByteArray& path, const struct stat& st, const Dir* parent);
+    void finishNode(std::shared_ptr<Node> node, const Totals& own);
+    void pushWork(int self, Dir dir);
+    bool takeWork(int self, Dir* dir);
+    void wakeIdle(bool all);
+    bool markSeen(dev_t device, ino_t inode);
+    void flush(Totals& totals);
+
+    QStringList m_roots;
+    DirectorySizeIndex* m_index = {nullptr};
+    bool m_followSymLinks = {true};
+    FileVisitor m_fileVisitor;
+    DirVisitor m_dirVisitor;
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    QAtomicInt m_pending = {0}; // queued or running directories
+
+    // threads without work wait until work is pushed or all is done
+    QMutex m_idleMutex;
+    QWaitCondition m_idleCondition;
+    QAtomicInt m_idleThreads = {0};
+    QAtomicInt m_workSerial = {0}; // changes whenever idle threads should look again
+
+    QMutex m_seenMutex;
+    QSet<QPair<quint64, quint64>> m_seen;
+
+    QMutex m_totalsMutex;
+    Totals m_totals;
+    QElapsedTimer m_progressTimer;
+
+    std::function<bool()> m_isCancelled;
+    std::function<void(const Totals&)> m_progress;
+};
+
+#endif // TREEWALKER_H